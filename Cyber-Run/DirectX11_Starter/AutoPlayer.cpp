@@ -0,0 +1,131 @@
+#include "AutoPlayer.h"
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+// Half depth of the player's collision volume, plus some slack
+static const float BodyReach = 0.25f + 0.1f;
+
+// Bars centered below this are jumped over, above it ducked under
+static const float TrackMiddle = -0.5f;
+
+// How early (in seconds) to react to what's coming.  A jump keeps
+// us in the air for over two seconds, so jumping late is safest.
+static const float JumpLead = 0.4f;
+static const float HoldLead = 0.15f;
+static const float DuckLead = 0.2f;
+
+// New bars show up about one platform ahead of us.  Once that's
+// closer than our reaction time we can't see them coming, so we
+// just stay in the air (and ducked) as much as we can.
+static const float SpawnDistance = 10.0f;
+
+// Collectibles closer than this are too late to steer for
+static const float MinSteerTime = 0.1f;
+
+// How far off a lane's center still counts as being in it
+static const float LaneTolerance = 0.1f;
+
+AutoPlayer::AutoPlayer()
+{
+	Reset();
+	Begin(XMFLOAT3(0, 0, 0), 1.0f, true, false);
+}
+
+AutoPlayer::~AutoPlayer()
+{ }
+
+void AutoPlayer::Reset()
+{
+	heldLeft = false;
+	heldRight = false;
+}
+
+// --------------------------------------------------------
+// Starts a new frame - forgets last frame's hazards
+// --------------------------------------------------------
+void AutoPlayer::Begin(const XMFLOAT3& playerPosition, float forwardSpeed, bool _grounded, bool _gameOver)
+{
+	player = playerPosition;
+	speed = fmaxf(forwardSpeed, 0.01f);
+	grounded = _grounded;
+	gameOver = _gameOver;
+
+	nextLowBar = FLT_MAX;
+	nextHighBar = FLT_MAX;
+	targetLane = player.x;
+	targetTime = FLT_MAX;
+}
+
+// --------------------------------------------------------
+// Notes when we'll reach a bar, if it isn't behind us yet
+// --------------------------------------------------------
+void AutoPlayer::AddObstacle(const XMFLOAT3& center, const XMFLOAT3& halfSize)
+{
+	float reach = halfSize.z + BodyReach;
+	float distance = center.z - player.z;
+	if (distance + reach < 0)
+		return;
+
+	float time = (distance - reach) / speed;
+	if (center.y < TrackMiddle)
+		nextLowBar = fminf(nextLowBar, time);
+	else
+		nextHighBar = fminf(nextHighBar, time);
+}
+
+// --------------------------------------------------------
+// Keeps the closest collectible we still have time to reach
+// --------------------------------------------------------
+void AutoPlayer::AddCollectible(const XMFLOAT3& center)
+{
+	float time = (center.z - player.z) / speed;
+	if (time < MinSteerTime || time >= targetTime)
+		return;
+
+	targetTime = time;
+	targetLane = center.x;
+}
+
+// --------------------------------------------------------
+// Turns what's coming up into this frame's controls
+// --------------------------------------------------------
+InputState AutoPlayer::Decide()
+{
+	InputState input = {};
+
+	// Just get straight back into it
+	if (gameOver)
+	{
+		input.Restart = true;
+		Reset();
+		return input;
+	}
+
+	bool blind = speed * JumpLead > SpawnDistance;
+
+	// Jump shortly before a low bar.  Landing only happens once
+	// jump is released, so if we're coming down on top of a bar
+	// keep holding it until we're past.
+	if (grounded)
+		input.Jump = nextLowBar < JumpLead || blind;
+	else
+		input.Jump = nextLowBar < HoldLead;
+
+	// Duck early and stay down until the bar is behind us.  Ducking
+	// in the air costs nothing, and then clears both kinds of bar.
+	input.Duck = nextHighBar < DuckLead || !grounded || input.Jump;
+
+	// Lanes change when the key comes back up, so alternate
+	// between pressing and releasing until we're there
+	float offset = targetLane - player.x;
+	if (offset < -LaneTolerance)
+		input.Left = !heldLeft;
+	else if (offset > LaneTolerance)
+		input.Right = !heldRight;
+
+	heldLeft = input.Left;
+	heldRight = input.Right;
+	return input;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include "InputState.h"
+
+// --------------------------------------------------------
+// Heuristic bot that plays the game, for long benchmark and
+// soak runs.  Each frame it is given the player's state and
+// everything that is coming up, and returns the controls:
+//
+//   bot.Begin(position, speed, grounded, gameOver);
+//   for (...) bot.AddObstacle(center, halfSize);
+//   for (...) bot.AddCollectible(center);
+//   InputState input = bot.Decide();
+//
+// It jumps over low bars, ducks under high bars, and steers
+// toward the next collectible.  Decisions are made in time
+// rather than distance, so they hold at any running speed.
+// --------------------------------------------------------
+class AutoPlayer
+{
+public:
+	AutoPlayer();
+	~AutoPlayer();
+
+	// Forgets any half-finished lane change
+	void Reset();
+
+	// Describing the world for this frame
+	void Begin(const DirectX::XMFLOAT3& playerPosition, float forwardSpeed, bool grounded, bool gameOver);
+	void AddObstacle(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& halfSize);
+	void AddCollectible(const DirectX::XMFLOAT3& center);
+
+	// Picks the controls for this frame
+	InputState Decide();
+
+private:
+	// This frame's player state
+	DirectX::XMFLOAT3 player;
+	float speed;
+	bool grounded;
+	bool gameOver;
+
+	// Seconds until we reach the nearest bar of each kind
+	// (negative while we're passing it)
+	float nextLowBar;
+	float nextHighBar;
+
+	// Lane of the nearest collectible we can still reach
+	float targetLane;
+	float targetTime;
+
+	// Lane changes happen when the key is released, so we
+	// remember what was held last frame
+	bool heldLeft;
+	bool heldRight;
+};
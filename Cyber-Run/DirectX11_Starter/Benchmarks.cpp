@@ -0,0 +1,1197 @@
+#include "Benchmarks.h"
+#include "BloomFilter.h"
+#include "Camera.h"
+#include "DynamicResolution.h"
+#include "FrameStats.h"
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+#include "LightClusters.h"
+#include "MemoryTracker.h"
+#include "MyDemoGame.h"
+#include "Profiler.h"
+
+#include <Windows.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace DirectX;
+
+// Simple wall clock helper for timing benchmark loops
+typedef std::chrono::high_resolution_clock BenchClock;
+static double MillisecondsSince(BenchClock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// Checks for "-bench" anywhere on the command line
+// --------------------------------------------------------
+bool Benchmarks::IsRequested(const char* cmdLine)
+{
+	return cmdLine != 0 && strstr(cmdLine, "-bench") != 0;
+}
+
+// --------------------------------------------------------
+// Parses "-bench <name> [count]" and runs that benchmark
+// --------------------------------------------------------
+int Benchmarks::Run(const char* cmdLine)
+{
+	AttachToConsole();
+
+	char name[64] = {};
+	int count = 0;
+	const char* args = strstr(cmdLine, "-bench") + strlen("-bench");
+	sscanf_s(args, "%63s %d", name, (unsigned)sizeof(name), &count);
+
+	if (strcmp(name, "culling") == 0)
+		return FrustumCulling(count > 0 ? count : 100000);
+	if (strcmp(name, "jobs") == 0)
+		return JobScaling(count > 0 ? count : 2048);
+	if (strcmp(name, "soak") == 0)
+		return Soak(count > 0 ? count : 60 * 60 * 10);
+	if (strcmp(name, "shader") == 0)
+		return ShaderSetters(count > 0 ? count : 1000000);
+	if (strcmp(name, "constants") == 0)
+		return ConstantUploads(count > 0 ? count : 2000);
+	if (strcmp(name, "bloom") == 0)
+		return Bloom(count > 0 ? count : 10);
+	if (strcmp(name, "software") == 0)
+		return Software(count > 0 ? count : 60 * 10);
+	if (strcmp(name, "occlusion") == 0)
+		return Occlusion(count > 0 ? count : 60 * 60);
+	if (strcmp(name, "lights") == 0)
+		return Lights(count > 0 ? count : LightClusters::MaxLights);
+	if (strcmp(name, "resolution") == 0)
+		return Resolution(count > 0 ? count : 60 * 10);
+	if (strcmp(name, "profile") == 0)
+		return Profile(count > 0 ? count : 60 * 5);
+	if (strcmp(name, "frames") == 0)
+		return Frames(count > 0 ? count : 60 * 60);
+	if (strcmp(name, "memory") == 0)
+		return Memory(count > 0 ? count : 60 * 60 * 5);
+
+	printf("Unknown benchmark '%s'\n", name);
+	printf("Available: culling, jobs, soak, shader, constants, bloom, software, occlusion, lights, resolution, profile, frames, memory\n");
+	return 1;
+}
+
+// --------------------------------------------------------
+// We're a windowed app, so borrow the console we were started
+// from (or make one) so printf output is visible
+// --------------------------------------------------------
+void Benchmarks::AttachToConsole()
+{
+	if (!AttachConsole(ATTACH_PARENT_PROCESS))
+		AllocConsole();
+
+	FILE* stream;
+	freopen_s(&stream, "CONOUT$", "w", stdout);
+	freopen_s(&stream, "CONOUT$", "w", stderr);
+}
+
+// --------------------------------------------------------
+// Culls "count" random boxes scattered along the track
+// against the game camera's frustum, comparing the SIMD
+// path to the one-at-a-time reference
+// --------------------------------------------------------
+int Benchmarks::FrustumCulling(int count)
+{
+	const int iterations = 100;
+
+	// Same camera setup as the game
+	Camera camera(0, 0, -5);
+	camera.UpdateProjectionMatrix(800.0f / 600.0f);
+	camera.UpdateViewMatrix();
+
+	XMFLOAT4 planes[6];
+	camera.GetFrustumPlanes(planes);
+
+	// Random boxes in and around the view
+	FrustumCuller culler;
+	srand(1234);
+	for (int i = 0; i < count; i++)
+	{
+		XMFLOAT3 center(
+			(rand() / (float)RAND_MAX) * 100.0f - 50.0f,
+			(rand() / (float)RAND_MAX) * 20.0f - 10.0f,
+			(rand() / (float)RAND_MAX) * 220.0f - 20.0f);
+		XMFLOAT3 extents(
+			(rand() / (float)RAND_MAX) * 2.0f + 0.05f,
+			(rand() / (float)RAND_MAX) * 2.0f + 0.05f,
+			(rand() / (float)RAND_MAX) * 2.0f + 0.05f);
+		culler.Add(center, extents);
+	}
+
+	std::vector<int> visible;
+	std::vector<int> reference;
+	visible.reserve(count);
+	reference.reserve(count);
+
+	BenchClock::time_point start = BenchClock::now();
+	for (int i = 0; i < iterations; i++)
+		culler.CullScalar(planes, reference);
+	double scalarMs = MillisecondsSince(start) / iterations;
+
+	start = BenchClock::now();
+	for (int i = 0; i < iterations; i++)
+		culler.Cull(planes, visible);
+	double simdMs = MillisecondsSince(start) / iterations;
+
+	printf("Frustum culling - %d bounds, %d iterations\n", count, iterations);
+	printf("  Visible: %d  Culled: %d\n", (int)visible.size(), count - (int)visible.size());
+	printf("  Scalar:  %8.3f ms  (%6.2f ns / object)\n", scalarMs, scalarMs * 1000000.0 / count);
+	printf("  SIMD x%d: %8.3f ms  (%6.2f ns / object)\n", FrustumCuller::GetBatchWidth(), simdMs, simdMs * 1000000.0 / count);
+	printf("  Speedup: %.2fx\n", scalarMs / simdMs);
+
+	// Both paths must agree exactly
+	if (visible != reference)
+	{
+		printf("  MISMATCH between SIMD and scalar results!\n");
+		return 1;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------
+// Job graph used by the scaling benchmark: a root with a
+// number of group jobs, each of which fans out into leaves
+// that do a fixed amount of math
+// --------------------------------------------------------
+struct BenchGroupData
+{
+	JobSystem* System;
+	float* Results;
+	int First;
+	int Count;
+};
+
+struct BenchLeafData
+{
+	float* Result;
+	int Seed;
+};
+
+static void BenchLeafJob(Job* job, const void* rawData)
+{
+	const BenchLeafData* data = (const BenchLeafData*)rawData;
+
+	// Roughly a few microseconds of work that can't be optimized away
+	float value = (float)data->Seed;
+	for (int i = 0; i < 2000; i++)
+		value = value * 0.999f + 1.0f;
+	*data->Result = value;
+}
+
+static void BenchGroupJob(Job* job, const void* rawData)
+{
+	const BenchGroupData* data = (const BenchGroupData*)rawData;
+	for (int i = 0; i < data->Count; i++)
+	{
+		BenchLeafData leaf = { &data->Results[data->First + i], data->First + i };
+		data->System->Run(data->System->CreateJobAsChild(job, BenchLeafJob, &leaf, sizeof(leaf)));
+	}
+}
+
+// --------------------------------------------------------
+// Runs the same fan-out job graph with 1, 2, 4... workers up
+// to the number of hardware threads and reports the speedup
+// --------------------------------------------------------
+int Benchmarks::JobScaling(int count)
+{
+	const int iterations = 20;
+	const int groupCount = 32;
+
+	// Workers recycle their jobs after MaxJobCount, and with a
+	// single worker the root has to survive the whole graph
+	int leavesPerGroup = count / groupCount;
+	int maxLeavesPerGroup = (int)JobSystem::MaxJobCount / 2 / groupCount;
+	if (leavesPerGroup < 1) leavesPerGroup = 1;
+	if (leavesPerGroup > maxLeavesPerGroup) leavesPerGroup = maxLeavesPerGroup;
+	int leafCount = leavesPerGroup * groupCount;
+
+	// Single threaded answer to check every run against
+	std::vector<float> expected(leafCount);
+	for (int i = 0; i < leafCount; i++)
+	{
+		BenchLeafData leaf = { &expected[i], i };
+		BenchLeafJob(0, &leaf);
+	}
+
+	// 1, 2, 4... and finally every hardware thread
+	int maxWorkers = (int)std::thread::hardware_concurrency();
+	if (maxWorkers < 1) maxWorkers = 1;
+	std::vector<int> workerCounts;
+	for (int w = 1; w < maxWorkers; w *= 2)
+		workerCounts.push_back(w);
+	workerCounts.push_back(maxWorkers);
+
+	printf("Job scaling - %d groups x %d leaves, %d iterations\n", groupCount, leavesPerGroup, iterations);
+
+	std::vector<float> results(leafCount);
+	double baseMs = 0;
+	int status = 0;
+	for (unsigned int w = 0; w < workerCounts.size(); w++)
+	{
+		int workers = workerCounts[w];
+		JobSystem jobs(workers);
+
+		BenchClock::time_point start = BenchClock::now();
+		for (int it = 0; it < iterations; it++)
+		{
+			Job* root = jobs.CreateJob(0);
+			for (int g = 0; g < groupCount; g++)
+			{
+				BenchGroupData group = { &jobs, &results[0], g * leavesPerGroup, leavesPerGroup };
+				jobs.Run(jobs.CreateJobAsChild(root, BenchGroupJob, &group, sizeof(group)));
+			}
+			jobs.Run(root);
+			jobs.Wait(root);
+		}
+		double ms = MillisecondsSince(start) / iterations;
+		if (workers == 1)
+			baseMs = ms;
+
+		printf("  %2d workers: %8.3f ms  (%.2fx)\n", workers, ms, baseMs / ms);
+
+		if (results != expected)
+		{
+			printf("  MISMATCH with %d workers!\n", workers);
+			status = 1;
+		}
+	}
+	return status;
+}
+
+// --------------------------------------------------------
+// Lets the AutoPlayer play a headless game for "frames" fixed
+// 60 Hz steps (ten minutes of play by default).  Deaths restart
+// straight away, so runs can be as long as needed.  Reports
+// simulation throughput and how the session went.
+// --------------------------------------------------------
+int Benchmarks::Soak(int frames)
+{
+	const float deltaTime = 1.0f / 60.0f;
+	const int reportInterval = 60 * 60;
+
+	MyDemoGame game(GetModuleHandle(0));
+	game.SetAutoPlay(true);
+	if (!game.InitHeadless())
+	{
+		printf("Could not set up a headless game\n");
+		return 1;
+	}
+
+	printf("Soak - %d frames at 60 Hz (%.1f minutes of play)\n", frames, frames * deltaTime / 60.0f);
+
+	int deaths = 0;
+	int bestScore = 0;
+	int maxEntities = 0;
+	bool wasGameOver = false;
+	FrameStats stats;
+
+	BenchClock::time_point start = BenchClock::now();
+	for (int i = 0; i < frames; i++)
+	{
+		stats.BeginStage(FrameStats::StageUpdate);
+		game.StepHeadless(deltaTime, i * deltaTime);
+		stats.EndStage(FrameStats::StageUpdate);
+		stats.EndFrame();
+
+		bool gameOver = game.IsGameOver();
+		if (gameOver && !wasGameOver) deaths++;
+		wasGameOver = gameOver;
+
+		if (game.GetScore() > bestScore) bestScore = game.GetScore();
+		if (game.GetEntityCount() > maxEntities) maxEntities = game.GetEntityCount();
+
+		if ((i + 1) % reportInterval == 0)
+		{
+			printf("  %6d frames: distance %10.1f  score %6d  deaths %d  entities %d\n",
+				i + 1, game.GetDistance(), game.GetScore(), deaths, game.GetEntityCount());
+		}
+	}
+	double totalMs = MillisecondsSince(start);
+
+	FrameStageStats update = stats.GetSessionStats(FrameStats::StageUpdate);
+	printf("  Simulated:   %.1f ms total, %.4f ms / frame avg\n", totalMs, totalMs / frames);
+	printf("  Update:      %.3f ms p50, %.3f ms p99, %.3f ms max\n", update.P50, update.P99, update.Max);
+	printf("  Throughput:  %.0f frames / second\n", frames * 1000.0 / totalMs);
+	printf("  Best score:  %d  Deaths: %d  Max entities: %d\n", bestScore, deaths, maxEntities);
+	return 0;
+}
+
+// --------------------------------------------------------
+// Times the three ways of setting shader variables - by
+// std::string, by "name"_sn and by handle - with the game's
+// real vertex shader.  Uses a NULL driver device, so it needs
+// no window or GPU, only VertexShader.cso in the working dir.
+// --------------------------------------------------------
+int Benchmarks::ShaderSetters(int count)
+{
+	ID3D11Device* device = 0;
+	ID3D11DeviceContext* context = 0;
+	HRESULT hr = D3D11CreateDevice(0, D3D_DRIVER_TYPE_NULL, 0, 0, 0, 0, D3D11_SDK_VERSION, &device, 0, &context);
+	if (FAILED(hr))
+	{
+		printf("Could not create a NULL driver device\n");
+		return 1;
+	}
+
+	int status = 0;
+	{
+		SimpleVertexShader vs(device, context);
+		if (!vs.LoadShaderFile(L"VertexShader.cso"))
+		{
+			printf("Could not load VertexShader.cso - run from the game's working directory\n");
+			status = 1;
+		}
+		else
+		{
+			// Two per-object matrices per iteration, like DrawItem
+			XMFLOAT4X4 world;
+			XMFLOAT4X4 worldViewProj;
+			XMStoreFloat4x4(&world, XMMatrixIdentity());
+			XMStoreFloat4x4(&worldViewProj, XMMatrixIdentity());
+			int sets = count * 2;
+
+			int stringOk = 0;
+			BenchClock::time_point start = BenchClock::now();
+			for (int i = 0; i < count; i++)
+			{
+				world._41 = (float)i;
+				stringOk += vs.SetMatrix4x4("world", world);
+				stringOk += vs.SetMatrix4x4("worldViewProj", worldViewProj);
+			}
+			double stringMs = MillisecondsSince(start);
+
+			int hashedOk = 0;
+			start = BenchClock::now();
+			for (int i = 0; i < count; i++)
+			{
+				world._41 = (float)i;
+				hashedOk += vs.SetMatrix4x4("world"_sn, world);
+				hashedOk += vs.SetMatrix4x4("worldViewProj"_sn, worldViewProj);
+			}
+			double hashedMs = MillisecondsSince(start);
+
+			SimpleShaderHandle worldHandle = vs.GetVariableHandle("world");
+			SimpleShaderHandle worldViewProjHandle = vs.GetVariableHandle("worldViewProj");
+			int handleOk = 0;
+			start = BenchClock::now();
+			for (int i = 0; i < count; i++)
+			{
+				world._41 = (float)i;
+				handleOk += vs.SetMatrix4x4(worldHandle, world);
+				handleOk += vs.SetMatrix4x4(worldViewProjHandle, worldViewProj);
+			}
+			double handleMs = MillisecondsSince(start);
+
+			printf("Shader setters - %d sets of a 4x4 matrix\n", sets);
+			printf("  String:  %8.3f ms  (%6.2f ns / set)\n", stringMs, stringMs * 1000000.0 / sets);
+			printf("  Hashed:  %8.3f ms  (%6.2f ns / set)\n", hashedMs, hashedMs * 1000000.0 / sets);
+			printf("  Handle:  %8.3f ms  (%6.2f ns / set)\n", handleMs, handleMs * 1000000.0 / sets);
+			printf("  Speedup: %.2fx hashed, %.2fx handle\n", stringMs / hashedMs, stringMs / handleMs);
+
+			// Every set has to have found its variable
+			if (stringOk != sets || hashedOk != sets || handleOk != sets)
+			{
+				printf("  FAILED sets: string %d  hashed %d  handle %d\n", sets - stringOk, sets - hashedOk, sets - handleOk);
+				status = 1;
+			}
+		}
+	}
+
+	ISimpleShader::ClearShaderFileCache();
+	context->Release();
+	device->Release();
+	return status;
+}
+
+// --------------------------------------------------------
+// Uploads and binds "count" draws' perObject data a frame,
+// for a few hundred frames, three ways: the shader's own
+// buffer rewritten per draw, the constant ring with offset
+// binds, and the ring's fallback.  NULL driver device again,
+// so this is the runtime's CPU cost only, along with the bytes
+// each way uploads a frame.  The game's HUD shows the same
+// count for whole frames.
+// --------------------------------------------------------
+int Benchmarks::ConstantUploads(int count)
+{
+	const int frames = 300;
+
+	ID3D11Device* device = 0;
+	ID3D11DeviceContext* context = 0;
+	HRESULT hr = D3D11CreateDevice(0, D3D_DRIVER_TYPE_NULL, 0, 0, 0, 0, D3D11_SDK_VERSION, &device, 0, &context);
+	if (FAILED(hr))
+	{
+		printf("Could not create a NULL driver device\n");
+		return 1;
+	}
+
+	int status = 0;
+	{
+		StateCache stateCache(context);
+		ConstantRing ring(device, &stateCache);
+		ConstantRing fallback(device, &stateCache, 1024 * 1024, false);
+
+		SimpleVertexShader vs(device, context);
+		if (!vs.LoadShaderFile(L"VertexShader.cso"))
+		{
+			printf("Could not load VertexShader.cso - run from the game's working directory\n");
+			status = 1;
+		}
+		else
+		{
+			vs.SetBufferDynamic("perObject");
+			SimpleShaderHandle worldHandle = vs.GetVariableHandle("world");
+			XMFLOAT4X4 world;
+			XMStoreFloat4x4(&world, XMMatrixIdentity());
+			std::vector<ConstantAllocation> allocations(count);
+			int draws = count * frames;
+
+			// Every draw maps the shader's own buffer
+			ISimpleShader::ResetUploadCounters();
+			BenchClock::time_point start = BenchClock::now();
+			for (int f = 0; f < frames; f++)
+			{
+				for (int i = 0; i < count; i++)
+				{
+					world._41 = (float)i;
+					vs.SetMatrix4x4(worldHandle, world);
+					vs.CopyBufferData("perObject");
+					vs.SetShader(false);
+				}
+			}
+			double perDrawMs = MillisecondsSince(start);
+			unsigned int perDrawBytes = ISimpleShader::GetUploadedBytes() / frames;
+			unsigned int perDrawMaps = ISimpleShader::GetUploadCount() / frames;
+
+			// Both rings the way DrawScene uses them
+			ConstantRing* rings[2] = { &ring, &fallback };
+			double ringMs[2];
+			for (int r = 0; r < 2; r++)
+			{
+				stateCache.Invalidate();
+				start = BenchClock::now();
+				for (int f = 0; f < frames; f++)
+				{
+					rings[r]->BeginFrame();
+					for (int i = 0; i < count; i++)
+					{
+						world._41 = (float)i;
+						vs.SetMatrix4x4(worldHandle, world);
+						allocations[i] = vs.AllocateBufferData("perObject", rings[r]);
+					}
+					rings[r]->Upload();
+					for (int i = 0; i < count; i++)
+						vs.BindBufferData(&stateCache, "perObject", rings[r], allocations[i]);
+				}
+				ringMs[r] = MillisecondsSince(start);
+			}
+
+			printf("Constant uploads - %d draws a frame, %d frames\n", count, frames);
+			printf("  Per draw:  %8.3f ms  (%6.2f ns / draw)\n", perDrawMs, perDrawMs * 1000000.0 / draws);
+			printf("  Ring:      %8.3f ms  (%6.2f ns / draw)%s\n", ringMs[0], ringMs[0] * 1000000.0 / draws,
+				ring.HasOffsets() ? "" : "  - no offset binds, so this is the fallback too");
+			printf("  Fallback:  %8.3f ms  (%6.2f ns / draw)\n", ringMs[1], ringMs[1] * 1000000.0 / draws);
+			printf("  Ring use:  %u of %u KB a frame, %u wraps, %u grows\n",
+				ring.GetFrameBytes() / 1024, ring.GetCapacity() / 1024, ring.GetWrapCount(), ring.GetGrowCount());
+			printf("  Uploaded a frame:  per draw %u bytes in %u maps, ring %u bytes in 1 map\n",
+				perDrawBytes, perDrawMaps, ring.GetFrameBytes());
+
+			if (ring.GetAllocationCount() != (unsigned int)count || allocations[0].Size == 0)
+			{
+				printf("  FAILED: %u of %d draws allocated\n", ring.GetAllocationCount(), count);
+				status = 1;
+			}
+		}
+	}
+
+	ISimpleShader::ClearShaderFileCache();
+	context->Release();
+	device->Release();
+	return status;
+}
+
+// --------------------------------------------------------
+// Runs the CPU bloom chain "count" times over a made up
+// 1280x720 scene, against the box blur it replaced at the
+// same blur width.  The result is compared against
+// bloom.golden (checked in next to materials.txt), so changes
+// to the passes or the settings show up.  A missing or
+// different golden fails, and leaves the new result in
+// bloom.actual - rename it to bloom.golden once the change
+// has been checked.  Tools/BloomCheck runs the same comparison
+// without Windows.
+// --------------------------------------------------------
+int Benchmarks::Bloom(int count)
+{
+	BloomSettings settings = BloomFilter::GetGoldenSettings();
+	BloomImage scene;
+	BloomFilter::MakeGoldenScene(scene);
+	const int width = scene.Width;
+	const int height = scene.Height;
+
+	BloomImage result;
+	BenchClock::time_point start = BenchClock::now();
+	for (int i = 0; i < count; i++)
+		BloomFilter::Run(scene, result, settings);
+	double chainMs = MillisecondsSince(start) / count;
+
+	// Half resolution taps cover twice the distance
+	BloomImage boxed(width, height);
+	int boxSamples = 0;
+	start = BenchClock::now();
+	for (int i = 0; i < count; i++)
+		boxSamples = BloomFilter::BoxBlur(scene, boxed, settings.Radius * 2);
+	double boxMs = MillisecondsSince(start) / count;
+
+	// SIMD against one channel at a time
+	BloomImage half(width / 2, height / 2), simd(width / 2, height / 2), scalar(width / 2, height / 2);
+	BloomFilter::ThresholdDownsample(scene, half, settings);
+	start = BenchClock::now();
+	for (int i = 0; i < count; i++)
+		BloomFilter::Blur(half, simd, settings, true);
+	double simdMs = MillisecondsSince(start) / count;
+	start = BenchClock::now();
+	for (int i = 0; i < count; i++)
+		BloomFilter::BlurScalar(half, scalar, settings, true);
+	double scalarMs = MillisecondsSince(start) / count;
+
+	printf("Bloom - %dx%d, radius %d, %d runs\n", width, height, settings.Radius, count);
+	printf("  Chain:     %8.3f ms  (%5.2f samples / pixel)\n", chainMs, BloomFilter::ChainSamplesPerPixel(settings));
+	printf("  Box blur:  %8.3f ms  (%5d samples / pixel)\n", boxMs, boxSamples);
+	printf("  Blur pass: %8.3f ms SIMD, %8.3f ms scalar\n", simdMs, scalarMs);
+
+	int status = 0;
+	float simdError = BloomFilter::MaxDifference(simd, scalar);
+	if (simdError != 0.0f)
+	{
+		printf("  FAILED: SIMD blur differs from scalar by %g\n", simdError);
+		status = 1;
+	}
+
+	BloomImage actual;
+	BloomFilter::SampleGolden(result, actual);
+	BloomImage expected(actual.Width, actual.Height);
+	bool goldenMatches = false;
+	if (BloomFilter::ReadGolden("bloom.golden", expected))
+	{
+		float error = BloomFilter::MaxDifference(actual, expected);
+		printf("  Golden:    max difference %g\n", error);
+		goldenMatches = error <= 0.0001f;
+		if (!goldenMatches)
+			printf("  FAILED: differs from bloom.golden\n");
+	}
+	else
+	{
+		printf("  FAILED: bloom.golden is missing or the wrong size - run from the game's working directory\n");
+	}
+
+	if (!goldenMatches)
+	{
+		status = 1;
+		if (BloomFilter::WriteGolden("bloom.actual", actual))
+			printf("  Saved this result to bloom.actual\n");
+	}
+	return status;
+}
+
+// --------------------------------------------------------
+// Lets the AutoPlayer play a headless game for "frames" 60 Hz
+// steps, drawing every few steps with the SoftwareRasterizer.
+// Saves a screenshot (software_<frame>.tga) every two seconds
+// of play, and reports each stage's time and what the frames
+// cost to draw.  Windows only, as the game is - off Windows,
+// Tools/SoftwareRender.cpp draws the level's first frame.
+// --------------------------------------------------------
+int Benchmarks::Software(int frames)
+{
+	const float deltaTime = 1.0f / 60.0f;
+	const int drawInterval = 6;
+	const int screenshotInterval = 120;
+	const int width = 800;
+	const int height = 600;
+
+	MyDemoGame game(GetModuleHandle(0));
+	game.SetAutoPlay(true);
+	if (!game.InitHeadless() || !game.InitSoftwareRendering(width, height))
+	{
+		printf("Could not set up a headless game\n");
+		return 1;
+	}
+	SoftwareRasterizer* rasterizer = game.GetSoftwareRasterizer();
+
+	printf("Software - %d frames at 60 Hz, drawn every %d at %dx%d\n", frames, drawInterval, width, height);
+
+	SoftwareStats totals = {};
+	SoftwareStats worst = {};
+	double totalMs = 0;
+	double worstMs = 0;
+	int drawn = 0;
+	for (int i = 0; i < frames; i++)
+	{
+		game.StepHeadless(deltaTime, i * deltaTime);
+		if (i % drawInterval != 0)
+			continue;
+
+		BenchClock::time_point start = BenchClock::now();
+		game.DrawSoftware();
+		double ms = MillisecondsSince(start);
+		totalMs += ms;
+		if (ms > worstMs) worstMs = ms;
+		drawn++;
+
+		const SoftwareStats& stats = rasterizer->GetStats();
+		totals.Draws += stats.Draws;
+		totals.Triangles += stats.Triangles;
+		totals.Culled += stats.Culled;
+		totals.Clipped += stats.Clipped;
+		totals.TileTriangles += stats.TileTriangles;
+		totals.PixelsCovered += stats.PixelsCovered;
+		totals.PixelsShaded += stats.PixelsShaded;
+		totals.VertexMs += stats.VertexMs;
+		totals.BinMs += stats.BinMs;
+		totals.RasterMs += stats.RasterMs;
+		if (stats.Triangles > worst.Triangles) worst.Triangles = stats.Triangles;
+		if (stats.PixelsShaded > worst.PixelsShaded) worst.PixelsShaded = stats.PixelsShaded;
+
+		if (i % screenshotInterval == 0)
+		{
+			char path[64];
+			sprintf_s(path, sizeof(path), "software_%d.tga", i);
+			if (rasterizer->SaveTGA(path))
+				printf("  Saved %s  (%d draws, %d triangles, %.2f ms)\n", path, stats.Draws, stats.Triangles, ms);
+		}
+	}
+
+	if (drawn == 0)
+		return 0;
+	double pixels = (double)width * height;
+	int tileSize = SoftwareRasterizer::TileSize;
+	int tiles = ((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize);
+	printf("  Frame:      %8.3f ms avg, %8.3f ms worst, %d drawn\n", totalMs / drawn, worstMs, drawn);
+	printf("  Vertices:   %8.3f ms avg\n", totals.VertexMs / drawn);
+	printf("  Binning:    %8.3f ms avg\n", totals.BinMs / drawn);
+	printf("  Raster:     %8.3f ms avg\n", totals.RasterMs / drawn);
+	printf("  Draws:      %8.1f avg\n", (double)totals.Draws / drawn);
+	printf("  Triangles:  %8.1f avg, %d most  (%.1f culled, %.1f clipped)\n",
+		(double)totals.Triangles / drawn, worst.Triangles, (double)totals.Culled / drawn, (double)totals.Clipped / drawn);
+	printf("  Binned:     %8.1f triangles / tile avg\n", (double)totals.TileTriangles / drawn / tiles);
+	printf("  Overdraw:   %8.2f covered, %.2f shaded per pixel  (%lld shaded most)\n",
+		(double)totals.PixelsCovered / drawn / pixels, (double)totals.PixelsShaded / drawn / pixels, worst.PixelsShaded);
+	return 0;
+}
+
+// --------------------------------------------------------
+// Lets the AutoPlayer play a headless game for "frames" 60 Hz
+// steps, culling each one, and reports how much occlusion
+// culling removed on top of frustum culling and what it cost
+// on this one thread
+// --------------------------------------------------------
+int Benchmarks::Occlusion(int frames)
+{
+	const float deltaTime = 1.0f / 60.0f;
+
+	MyDemoGame game(GetModuleHandle(0));
+	game.SetAutoPlay(true);
+	if (!game.InitHeadless())
+	{
+		printf("Could not set up a headless game\n");
+		return 1;
+	}
+
+	printf("Occlusion - %d frames at 60 Hz, %dx%d depth buffer\n", frames, OcclusionCuller::Width, OcclusionCuller::Height);
+
+	long long visible = 0;
+	long long culled = 0;
+	long long occluded = 0;
+	int mostOccluded = 0;
+	double totalMs = 0;
+	double worstMs = 0;
+	for (int i = 0; i < frames; i++)
+	{
+		game.StepHeadless(deltaTime, i * deltaTime);
+		game.CullHeadless();
+
+		visible += game.GetVisibleCount();
+		culled += game.GetCulledCount();
+		occluded += game.GetOccludedCount();
+		if (game.GetOccludedCount() > mostOccluded) mostOccluded = game.GetOccludedCount();
+
+		double ms = game.GetOcclusionMs();
+		totalMs += ms;
+		if (ms > worstMs) worstMs = ms;
+	}
+
+	printf("  Per frame:  %.2f visible, %.2f outside the frustum, %.2f occluded (%d most)\n",
+		(double)visible / frames, (double)culled / frames, (double)occluded / frames, mostOccluded);
+	printf("  Occlusion:  %.4f ms avg, %.4f ms worst\n", totalMs / frames, worstMs);
+	return 0;
+}
+
+// --------------------------------------------------------
+// Bins "count" random point lights into the game camera's
+// clusters, with SSE on the job workers and one at a time on
+// this thread, and checks both give the same lists.  Then
+// checks random points in view: every light that reaches a
+// point has to be in its cluster's list.
+// --------------------------------------------------------
+int Benchmarks::Lights(int count)
+{
+	const int iterations = 100;
+	const int width = 800;
+	const int height = 600;
+	if (count > LightClusters::MaxLights)
+		count = LightClusters::MaxLights;
+
+	Camera camera(0, 0, -5);
+	camera.UpdateProjectionMatrix((float)width / height);
+	XMFLOAT4X4 projection = camera.GetProjection();
+	float xScale = projection.m[0][0];
+	float yScale = projection.m[1][1];
+
+	// Lights are made in view space, so the view is identity
+	XMFLOAT4X4 view;
+	XMStoreFloat4x4(&view, XMMatrixIdentity());
+
+	srand(1234);
+	std::vector<ClusterLight> lights(count);
+	for (int i = 0; i < count; i++)
+	{
+		float z = (rand() / (float)RAND_MAX) * 60.0f + 0.5f;
+		lights[i].Position = XMFLOAT3(
+			((rand() / (float)RAND_MAX) * 2.4f - 1.2f) * z / xScale,
+			((rand() / (float)RAND_MAX) * 2.4f - 1.2f) * z / yScale,
+			z);
+		lights[i].Radius = (rand() / (float)RAND_MAX) * 2.5f + 0.5f;
+		lights[i].Color = XMFLOAT3(1, 1, 1);
+		lights[i].Intensity = 1.0f;
+	}
+
+	JobSystem jobs;
+	LightClusters clusters(&jobs);
+	LightClusters reference(0);
+	clusters.SetProjection(projection);
+	reference.SetProjection(projection);
+
+	BenchClock::time_point start = BenchClock::now();
+	for (int i = 0; i < iterations; i++)
+		reference.BinScalar(view, &lights[0], count);
+	double scalarMs = MillisecondsSince(start) / iterations;
+
+	start = BenchClock::now();
+	for (int i = 0; i < iterations; i++)
+		clusters.Bin(view, &lights[0], count);
+	double simdMs = MillisecondsSince(start) / iterations;
+
+	printf("Light clusters - %d lights, %dx%dx%d clusters, %d iterations\n", count,
+		LightClusters::CountX, LightClusters::CountY, LightClusters::CountZ, iterations);
+	printf("  Indices: %d  Busiest cluster: %d  Dropped: %d\n",
+		clusters.GetIndexCount(), clusters.GetBusiestCluster(), clusters.GetDroppedCount());
+	printf("  Scalar:      %8.3f ms\n", scalarMs);
+	printf("  SSE + jobs:  %8.3f ms  (%.2fx)\n", simdMs, scalarMs / simdMs);
+
+	int status = 0;
+	bool same = clusters.GetIndices() == reference.GetIndices();
+	for (int c = 0; c < LightClusters::ClusterCount && same; c++)
+	{
+		same = clusters.GetRanges()[c].Offset == reference.GetRanges()[c].Offset &&
+			clusters.GetRanges()[c].Count == reference.GetRanges()[c].Count;
+	}
+	if (!same)
+	{
+		printf("  FAILED: SIMD lists differ from scalar\n");
+		status = 1;
+	}
+
+	// Lists can't be trusted once they've been cut short
+	if (clusters.GetDroppedCount() == 0)
+	{
+		const int samples = 100000;
+		int missed = 0;
+		for (int i = 0; i < samples; i++)
+		{
+			float px = (rand() / (float)RAND_MAX) * width;
+			float py = (rand() / (float)RAND_MAX) * height;
+			float depth = (rand() / (float)RAND_MAX) * 60.0f + 0.2f;
+			XMFLOAT3 point(
+				(px / width * 2.0f - 1.0f) * depth / xScale,
+				(1.0f - py / height * 2.0f) * depth / yScale,
+				depth);
+
+			const ClusterRange& range = clusters.GetRanges()[clusters.GetCluster(px, py, depth, (float)width, (float)height)];
+			const unsigned int* list = range.Count > 0 ? &clusters.GetIndices()[range.Offset] : 0;
+			for (int l = 0; l < count; l++)
+			{
+				float dx = lights[l].Position.x - point.x;
+				float dy = lights[l].Position.y - point.y;
+				float dz = lights[l].Position.z - point.z;
+				// Right on the edge the light has faded out anyway
+				if (dx * dx + dy * dy + dz * dz >= lights[l].Radius * lights[l].Radius * 0.999f)
+					continue;
+
+				bool found = false;
+				for (unsigned int k = 0; k < range.Count && !found; k++)
+					found = list[k] == (unsigned int)l;
+				if (!found)
+					missed++;
+			}
+		}
+		printf("  Missed:  %d lights over %d points\n", missed, samples);
+		if (missed > 0)
+		{
+			printf("  FAILED: clusters are missing lights that reach them\n");
+			status = 1;
+		}
+	}
+	return status;
+}
+
+// --------------------------------------------------------
+// Dynamic resolution on the SoftwareRasterizer.  Full size
+// frames are timed first, and the target is set below that, so
+// the governor has to scale down to hold it.  Halfway through,
+// the output grows from 1280x720 to 1920x1080 (2.25 times the
+// pixels), the way a window resize would.  The second half of
+// each stage, once the governor has settled, has to average
+// within 15% of the target.
+// --------------------------------------------------------
+int Benchmarks::Resolution(int frames)
+{
+	const float deltaTime = 1.0f / 60.0f;
+	const int calibrationFrames = 30;
+	const int sizes[2][2] = { { 1280, 720 }, { 1920, 1080 } };
+
+	MyDemoGame game(GetModuleHandle(0));
+	game.SetAutoPlay(true);
+	if (!game.InitHeadless() || !game.InitSoftwareRendering(sizes[0][0], sizes[0][1]))
+	{
+		printf("Could not set up a headless game\n");
+		return 1;
+	}
+	SoftwareRasterizer* rasterizer = game.GetSoftwareRasterizer();
+
+	double fullMs = 0;
+	int step = 0;
+	for (int i = 0; i < calibrationFrames; i++, step++)
+	{
+		game.StepHeadless(deltaTime, step * deltaTime);
+		BenchClock::time_point start = BenchClock::now();
+		game.DrawSoftware();
+		fullMs += MillisecondsSince(start);
+	}
+	fullMs /= calibrationFrames;
+
+	// The software frames are timed as they're drawn, so nothing arrives late
+	DynamicResolutionSettings settings = { (float)fullMs * 0.7f, 0.5f, 1.0f, 0.15f, 8, 0 };
+	DynamicResolution governor(settings);
+
+	printf("Resolution - %d frames, %.3f ms at full size, target %.3f ms\n", frames, fullMs, settings.TargetMs);
+
+	int status = 0;
+	int stageFrames = frames / 2;
+	for (int stage = 0; stage < 2; stage++)
+	{
+		int outputWidth = sizes[stage][0];
+		int outputHeight = sizes[stage][1];
+		governor.Reset();
+
+		std::vector<double> settled;
+		for (int i = 0; i < stageFrames; i++, step++)
+		{
+			int width = governor.ScaleSize(outputWidth);
+			int height = governor.ScaleSize(outputHeight);
+			if (width != rasterizer->GetWidth() || height != rasterizer->GetHeight())
+				rasterizer->Resize(width, height);
+
+			game.StepHeadless(deltaTime, step * deltaTime);
+			BenchClock::time_point start = BenchClock::now();
+			game.DrawSoftware();
+			double ms = MillisecondsSince(start);
+			governor.AddFrame((float)ms, -1.0f);
+
+			if (i >= stageFrames / 2)
+				settled.push_back(ms);
+		}
+		if (settled.empty())
+			continue;
+
+		double total = 0;
+		for (unsigned int i = 0; i < settled.size(); i++)
+			total += settled[i];
+		double average = total / settled.size();
+		std::sort(settled.begin(), settled.end());
+		double p90 = settled[settled.size() * 9 / 10];
+
+		printf("  %dx%d:  scale %.3f (%dx%d), %.3f ms avg, %.3f ms 90th percentile, %d changes\n",
+			outputWidth, outputHeight, governor.GetScale(), rasterizer->GetWidth(), rasterizer->GetHeight(),
+			average, p90, governor.GetChangeCount());
+
+		if (fabs(average - settings.TargetMs) > settings.TargetMs * 0.15)
+		{
+			if (average > settings.TargetMs && governor.GetScale() <= settings.MinScale)
+				printf("  FAILED: over the target even at the smallest scale\n");
+			else
+				printf("  FAILED: not within 15%% of the target\n");
+			status = 1;
+		}
+	}
+	return status;
+}
+
+// --------------------------------------------------------
+// Plays a headless game for "frames" steps, drawing each one
+// with the SoftwareRasterizer, with the profiler on.  Prints
+// the top zones, what a zone costs, and saves profile.json for
+// chrome://tracing.
+// --------------------------------------------------------
+int Benchmarks::Profile(int frames)
+{
+#ifdef PROFILER_ENABLED
+	const float deltaTime = 1.0f / 60.0f;
+	const int emptyZones = 1000000;
+
+	PROFILE_THREAD("Main");
+	MyDemoGame game(GetModuleHandle(0));
+	game.SetAutoPlay(true);
+	if (!game.InitHeadless() || !game.InitSoftwareRendering(800, 600))
+	{
+		printf("Could not set up a headless game\n");
+		return 1;
+	}
+
+	// Only whole batches of StatsFrames are published
+	frames = (frames + Profiler::StatsFrames - 1) / Profiler::StatsFrames * Profiler::StatsFrames;
+	for (int i = 0; i < frames; i++)
+	{
+		{
+			PROFILE_ZONE("Frame");
+			game.StepHeadless(deltaTime, i * deltaTime);
+			game.DrawSoftware();
+		}
+		PROFILE_END_FRAME();
+	}
+
+	printf("Profile - %d frames, last %d averaged\n", frames, Profiler::StatsFrames);
+	std::vector<ProfileZoneStats> zones;
+	Profiler::GetTopZones(zones, 10);
+	for (unsigned int i = 0; i < zones.size(); i++)
+		printf("  %-24s %8.3f ms  %8.1f calls\n", zones[i].Name, zones[i].Ms, zones[i].Calls);
+
+	if (Profiler::WriteChromeTrace("profile.json"))
+		printf("  Saved profile.json\n");
+	else
+		printf("  Could not write profile.json\n");
+
+	// After saving, since these push the game's zones out of the ring
+	BenchClock::time_point start = BenchClock::now();
+	for (int i = 0; i < emptyZones; i++)
+	{
+		PROFILE_ZONE("Empty");
+	}
+	printf("  Empty zone: %.1f ns\n", MillisecondsSince(start) * 1000000.0 / emptyZones);
+	return 0;
+#else
+	printf("Built with PROFILER_DISABLED\n");
+	return 1;
+#endif
+}
+
+// --------------------------------------------------------
+// Plays a headless game for "frames" 60 Hz steps, drawing
+// each one with the SoftwareRasterizer, and records them with
+// FrameStats - update, then submit (the software draw stands
+// in for it; there's nothing to present).  Prints each stage's percentiles and the
+// slowest frames, checks the histogram's percentiles against
+// the exact ones, and saves the frames and their summary as
+// CSV.
+// --------------------------------------------------------
+int Benchmarks::Frames(int frames)
+{
+	const float deltaTime = 1.0f / 60.0f;
+	const int slowestShown = 5;
+
+	MyDemoGame game(GetModuleHandle(0));
+	game.SetAutoPlay(true);
+	if (!game.InitHeadless() || !game.InitSoftwareRendering(800, 600))
+	{
+		printf("Could not set up a headless game\n");
+		return 1;
+	}
+
+	FrameStats stats;
+	std::string csvPath = FrameStats::MakeSessionPath("bench_frames");
+	if (!stats.OpenCsv(csvPath))
+		printf("  Could not write %s\n", csvPath.c_str());
+
+	// Every frame's times too, to check the histograms against
+	std::vector<float> frameMs[FrameStats::StageCount];
+	for (int s = 0; s < FrameStats::StageCount; s++)
+		frameMs[s].resize(frames);
+
+	for (int i = 0; i < frames; i++)
+	{
+		BenchClock::time_point frameStart = BenchClock::now();
+		game.StepHeadless(deltaTime, i * deltaTime);
+		BenchClock::time_point submitStart = BenchClock::now();
+		game.DrawSoftware();
+
+		float ms[FrameStats::StageCount] = {};
+		ms[FrameStats::StageUpdate] = (float)std::chrono::duration<double, std::milli>(submitStart - frameStart).count();
+		ms[FrameStats::StageSubmit] = (float)MillisecondsSince(submitStart);
+		ms[FrameStats::StageFrame] = (float)MillisecondsSince(frameStart);
+		for (int s = 0; s < FrameStats::StageCount; s++)
+			frameMs[s][i] = ms[s];
+		stats.AddFrame(ms);
+	}
+	stats.CloseCsv();
+
+	printf("Frames - %d frames at 60 Hz, drawn at 800x600\n", frames);
+	printf("  %-8s %9s %9s %9s %9s %9s\n", "", "mean", "p50", "p95", "p99", "max");
+	for (int s = 0; s < FrameStats::StageCount; s++)
+	{
+		FrameStageStats stage = stats.GetSessionStats((FrameStats::Stage)s);
+		printf("  %-8s %9.3f %9.3f %9.3f %9.3f %9.3f\n", FrameStats::GetStageName((FrameStats::Stage)s),
+			stage.Mean, stage.P50, stage.P95, stage.P99, stage.Max);
+	}
+
+	// Which frames hitched, and where the time went
+	std::vector<std::pair<float, int> > slowest(frames);
+	for (int i = 0; i < frames; i++)
+		slowest[i] = std::make_pair(frameMs[FrameStats::StageFrame][i], i);
+	int shown = std::min(slowestShown, frames);
+	std::partial_sort(slowest.begin(), slowest.begin() + shown, slowest.end(), std::greater<std::pair<float, int> >());
+	printf("  Slowest frames:\n");
+	for (int i = 0; i < shown; i++)
+	{
+		int f = slowest[i].second;
+		printf("    %6d  %8.3f ms  (update %.3f, submit %.3f)\n", f, slowest[i].first,
+			frameMs[FrameStats::StageUpdate][f], frameMs[FrameStats::StageSubmit][f]);
+	}
+
+	// The histogram reads each percentile from the top of its
+	// bucket, so it's never under the exact value and at most
+	// 1/64 over it (give or take the microsecond it rounds to)
+	int status = 0;
+	const double percentiles[] = { 50.0, 95.0, 99.0, 100.0 };
+	for (int s = 0; s < FrameStats::StageCount; s++)
+	{
+		if (s == FrameStats::StagePresent)
+			continue;
+		std::vector<float> sorted = frameMs[s];
+		std::sort(sorted.begin(), sorted.end());
+		for (int p = 0; p < 4; p++)
+		{
+			int rank = (int)ceil(percentiles[p] / 100.0 * frames);
+			float exact = sorted[std::max(rank, 1) - 1];
+			float reported = stats.GetSessionHistogram((FrameStats::Stage)s).GetPercentileMs(percentiles[p]);
+			if (reported < exact - 0.002f || reported > exact * (1.0f + 1.0f / 64.0f) + 0.002f)
+			{
+				printf("  FAILED: %s p%g is %.3f ms, exactly %.3f ms\n",
+					FrameStats::GetStageName((FrameStats::Stage)s), percentiles[p], reported, exact);
+				status = 1;
+			}
+		}
+	}
+
+	std::string summaryPath = csvPath.substr(0, csvPath.rfind('.')) + "_summary.csv";
+	if (stats.WriteSummaryCsv(summaryPath))
+		printf("  Saved %s and %s\n", csvPath.c_str(), summaryPath.c_str());
+	return status;
+}
+
+// --------------------------------------------------------
+// Prints what each subsystem holds once a headless game is
+// set up, then lets the AutoPlayer play it for "frames" 60 Hz
+// steps after a few seconds of warm up, drawing each one with
+// the SoftwareRasterizer (which culls and bins the lights as
+// DrawScene does) - that steady state has to make no
+// allocations at all.  Once the game is gone, no subsystem
+// may still hold anything.
+// --------------------------------------------------------
+int Benchmarks::Memory(int frames)
+{
+#ifdef MEMORY_TRACKING_ENABLED
+	const float deltaTime = 1.0f / 60.0f;
+	const int warmUpFrames = 60 * 5;
+
+	int status = 0;
+	{
+		MyDemoGame game(GetModuleHandle(0));
+		game.SetAutoPlay(true);
+		if (!game.InitHeadless() || !game.InitSoftwareRendering(320, 180))
+		{
+			printf("Could not set up a headless game\n");
+			return 1;
+		}
+
+		printf("Memory - %d frames at 60 Hz after %d to warm up\n", frames, warmUpFrames);
+		printf("  %-10s %10s %8s %10s %10s\n", "", "live KB", "blocks", "peak KB", "allocs");
+		for (int t = 0; t < MemoryTracker::TagCount; t++)
+		{
+			MemoryTagStats stats = MemoryTracker::GetStats((MemoryTracker::Tag)t);
+			printf("  %-10s %10.1f %8lld %10.1f %10lld\n", MemoryTracker::GetTagName((MemoryTracker::Tag)t),
+				stats.LiveBytes / 1024.0, stats.LiveCount, stats.PeakBytes / 1024.0, stats.TotalCount);
+		}
+
+		int step = 0;
+		for (; step < warmUpFrames; step++)
+		{
+			game.StepHeadless(deltaTime, step * deltaTime);
+			game.DrawSoftware();
+		}
+		MemoryTracker::EndFrame();
+
+		// Per frame, so a failure says when and how much
+		int allocatingFrames = 0;
+		int firstFrame = -1;
+		long long allocations = 0;
+		long long worstFrame = 0;
+		for (int i = 0; i < frames; i++, step++)
+		{
+			game.StepHeadless(deltaTime, step * deltaTime);
+			game.DrawSoftware();
+			MemoryTracker::EndFrame();
+
+			long long frameAllocations = MemoryTracker::GetTotals().FrameCount;
+			if (frameAllocations == 0)
+				continue;
+			if (firstFrame < 0) firstFrame = i;
+			allocatingFrames++;
+			allocations += frameAllocations;
+			if (frameAllocations > worstFrame) worstFrame = frameAllocations;
+		}
+
+		printf("  Steady state: %lld allocations in %d frames (%lld most in one)\n", allocations, allocatingFrames, worstFrame);
+		printf("  Entities: %d live, pool of %d\n", game.GetEntityCount(), game.GetEntityPoolCapacity());
+		if (allocations > 0)
+		{
+			printf("  FAILED: play allocated, first on frame %d\n", firstFrame);
+			status = 1;
+		}
+	}
+
+	std::string leaks = MemoryTracker::GetLiveReport();
+	if (!leaks.empty())
+	{
+		printf("  FAILED: still live after the game was destroyed\n%s", leaks.c_str());
+		status = 1;
+	}
+	else
+		printf("  Nothing left after the game was destroyed\n");
+	return status;
+#else
+	printf("Built with MEMORY_TRACKING_DISABLED\n");
+	return 1;
+#endif
+}
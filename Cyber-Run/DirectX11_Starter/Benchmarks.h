@@ -0,0 +1,40 @@
+#pragma once
+
+// --------------------------------------------------------
+// Headless benchmarks, run from the command line with
+//
+//   DirectX11_Starter.exe -bench <name> [count]
+//
+// These run before any window or device is created and
+// print their results to the console that launched the game.
+// Run them from the game's working directory, since some of
+// them load the game's meshes.
+// --------------------------------------------------------
+class Benchmarks
+{
+public:
+	// Does the command line ask for a benchmark?
+	static bool IsRequested(const char* cmdLine);
+
+	// Runs the benchmark named on the command line
+	// Returns the exit code for the process
+	static int Run(const char* cmdLine);
+
+private:
+	static void AttachToConsole();
+
+	// Individual benchmarks
+	static int FrustumCulling(int count);
+	static int JobScaling(int count);
+	static int Soak(int frames);
+	static int ShaderSetters(int count);
+	static int ConstantUploads(int count);
+	static int Bloom(int count);
+	static int Software(int frames);
+	static int Occlusion(int frames);
+	static int Lights(int count);
+	static int Resolution(int frames);
+	static int Profile(int frames);
+	static int Frames(int frames);
+	static int Memory(int frames);
+};
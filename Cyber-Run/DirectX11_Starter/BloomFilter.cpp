@@ -0,0 +1,296 @@
+#include "BloomFilter.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define BLOOM_SSE
+#endif
+
+// --------------------------------------------------------
+// One RGBA pixel - an SSE register where there is one, four
+// floats where there isn't
+// --------------------------------------------------------
+#ifdef BLOOM_SSE
+typedef __m128 Pixel;
+static inline Pixel Load(const float* p) { return _mm_loadu_ps(p); }
+static inline void Store(float* p, Pixel v) { _mm_storeu_ps(p, v); }
+static inline Pixel Splat(float f) { return _mm_set1_ps(f); }
+static inline Pixel Add(Pixel a, Pixel b) { return _mm_add_ps(a, b); }
+static inline Pixel Mul(Pixel a, Pixel b) { return _mm_mul_ps(a, b); }
+#else
+struct Pixel { float v[4]; };
+static inline Pixel Load(const float* p) { Pixel r = { { p[0], p[1], p[2], p[3] } }; return r; }
+static inline void Store(float* p, Pixel a) { for (int i = 0; i < 4; i++) p[i] = a.v[i]; }
+static inline Pixel Splat(float f) { Pixel r = { { f, f, f, f } }; return r; }
+static inline Pixel Add(Pixel a, Pixel b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+static inline Pixel Mul(Pixel a, Pixel b) { for (int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+#endif
+
+static inline int Clamp(int i, int low, int high)
+{
+	return i < low ? low : (i > high ? high : i);
+}
+
+// --------------------------------------------------------
+// Sample() with a linear, clamped sampler at (u, v)
+// --------------------------------------------------------
+static Pixel SampleBilinear(const BloomImage& image, float u, float v)
+{
+	float tx = u * image.Width - 0.5f;
+	float ty = v * image.Height - 0.5f;
+	float fx0 = floorf(tx);
+	float fy0 = floorf(ty);
+	float fx = tx - fx0;
+	float fy = ty - fy0;
+
+	int x0 = Clamp((int)fx0, 0, image.Width - 1);
+	int x1 = Clamp((int)fx0 + 1, 0, image.Width - 1);
+	int y0 = Clamp((int)fy0, 0, image.Height - 1);
+	int y1 = Clamp((int)fy0 + 1, 0, image.Height - 1);
+
+	Pixel top = Add(Mul(Load(image.At(x0, y0)), Splat(1.0f - fx)), Mul(Load(image.At(x1, y0)), Splat(fx)));
+	Pixel bottom = Add(Mul(Load(image.At(x0, y1)), Splat(1.0f - fx)), Mul(Load(image.At(x1, y1)), Splat(fx)));
+	return Add(Mul(top, Splat(1.0f - fy)), Mul(bottom, Splat(fy)));
+}
+
+void BloomFilter::GaussianWeights(int radius, float sigma, float weights[MaxRadius + 1])
+{
+	if (radius > MaxRadius) radius = MaxRadius;
+	if (radius < 0) radius = 0;
+	if (sigma <= 0.0f) sigma = 1.0f;
+
+	float total = 0.0f;
+	for (int i = 0; i <= MaxRadius; i++)
+	{
+		weights[i] = i <= radius ? expf(-(float)(i * i) / (2.0f * sigma * sigma)) : 0.0f;
+		total += i == 0 ? weights[i] : 2.0f * weights[i];
+	}
+	for (int i = 0; i <= MaxRadius; i++)
+		weights[i] /= total;
+}
+
+void BloomFilter::Run(const BloomImage& scene, BloomImage& result, const BloomSettings& settings)
+{
+	// Same size the frame graph gives the half resolution targets
+	int halfWidth = scene.Width / 2 > 0 ? scene.Width / 2 : 1;
+	int halfHeight = scene.Height / 2 > 0 ? scene.Height / 2 : 1;
+
+	BloomImage bright(halfWidth, halfHeight);
+	BloomImage blurred(halfWidth, halfHeight);
+	result = BloomImage(scene.Width, scene.Height);
+
+	ThresholdDownsample(scene, bright, settings);
+	Blur(bright, blurred, settings, true);
+	Blur(blurred, bright, settings, false);
+	Combine(scene, bright, result, settings);
+}
+
+// --------------------------------------------------------
+// BloomThresholdPS - one bilinear sample lands between four
+// scene pixels, averaging them, and a soft knee fades bloom
+// in around the threshold
+// --------------------------------------------------------
+int BloomFilter::ThresholdDownsample(const BloomImage& source, BloomImage& dest, const BloomSettings& settings)
+{
+	float knee = settings.Knee;
+	for (int y = 0; y < dest.Height; y++)
+	{
+		float v = (y + 0.5f) / dest.Height;
+		for (int x = 0; x < dest.Width; x++)
+		{
+			float u = (x + 0.5f) / dest.Width;
+			Pixel color = SampleBilinear(source, u, v);
+
+			float rgba[4];
+			Store(rgba, color);
+			float brightness = fmaxf(rgba[0], fmaxf(rgba[1], rgba[2]));
+			float soft = fminf(fmaxf(brightness - settings.Threshold + knee, 0.0f), 2.0f * knee);
+			soft = soft * soft / (4.0f * knee + 0.00001f);
+			float contribution = fmaxf(soft, brightness - settings.Threshold) / fmaxf(brightness, 0.00001f);
+
+			Store(dest.At(x, y), Mul(color, Splat(contribution)));
+		}
+	}
+	return 1;
+}
+
+// --------------------------------------------------------
+// BloomBlurPS - one direction of the Gaussian.  Taps land on
+// texel centers, so no filtering is needed.
+// --------------------------------------------------------
+int BloomFilter::Blur(const BloomImage& source, BloomImage& dest, const BloomSettings& settings, bool horizontal)
+{
+	float weights[MaxRadius + 1];
+	GaussianWeights(settings.Radius, settings.Sigma, weights);
+	int radius = settings.Radius < MaxRadius ? settings.Radius : MaxRadius;
+
+	Pixel splatWeights[MaxRadius + 1];
+	for (int i = 0; i <= radius; i++)
+		splatWeights[i] = Splat(weights[i]);
+
+	for (int y = 0; y < dest.Height; y++)
+	{
+		for (int x = 0; x < dest.Width; x++)
+		{
+			Pixel sum = Mul(Load(source.At(x, y)), splatWeights[0]);
+			for (int i = 1; i <= radius; i++)
+			{
+				Pixel pair;
+				if (horizontal)
+					pair = Add(Load(source.At(Clamp(x - i, 0, source.Width - 1), y)), Load(source.At(Clamp(x + i, 0, source.Width - 1), y)));
+				else
+					pair = Add(Load(source.At(x, Clamp(y - i, 0, source.Height - 1))), Load(source.At(x, Clamp(y + i, 0, source.Height - 1))));
+				sum = Add(sum, Mul(pair, splatWeights[i]));
+			}
+			Store(dest.At(x, y), sum);
+		}
+	}
+	return 2 * radius + 1;
+}
+
+int BloomFilter::BlurScalar(const BloomImage& source, BloomImage& dest, const BloomSettings& settings, bool horizontal)
+{
+	float weights[MaxRadius + 1];
+	GaussianWeights(settings.Radius, settings.Sigma, weights);
+	int radius = settings.Radius < MaxRadius ? settings.Radius : MaxRadius;
+
+	for (int y = 0; y < dest.Height; y++)
+	{
+		for (int x = 0; x < dest.Width; x++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				// Same order of operations as Blur, so both agree exactly
+				float sum = source.At(x, y)[c] * weights[0];
+				for (int i = 1; i <= radius; i++)
+				{
+					float pair = horizontal ?
+						source.At(Clamp(x - i, 0, source.Width - 1), y)[c] + source.At(Clamp(x + i, 0, source.Width - 1), y)[c] :
+						source.At(x, Clamp(y - i, 0, source.Height - 1))[c] + source.At(x, Clamp(y + i, 0, source.Height - 1))[c];
+					sum = sum + pair * weights[i];
+				}
+				dest.At(x, y)[c] = sum;
+			}
+		}
+	}
+	return 2 * radius + 1;
+}
+
+// --------------------------------------------------------
+// BloomCombinePS - the scene at full size, plus the bloom
+// filtered back up to it
+// --------------------------------------------------------
+int BloomFilter::Combine(const BloomImage& scene, const BloomImage& bloom, BloomImage& dest, const BloomSettings& settings)
+{
+	Pixel intensity = Splat(settings.Intensity);
+	for (int y = 0; y < dest.Height; y++)
+	{
+		float v = (y + 0.5f) / dest.Height;
+		for (int x = 0; x < dest.Width; x++)
+		{
+			float u = (x + 0.5f) / dest.Width;
+			float* out = dest.At(x, y);
+			Store(out, Add(Load(scene.At(x, y)), Mul(SampleBilinear(bloom, u, v), intensity)));
+			out[3] = 1.0f;
+		}
+	}
+	return 2;
+}
+
+int BloomFilter::BoxBlur(const BloomImage& source, BloomImage& dest, int radius)
+{
+	Pixel scale = Splat(1.0f / ((2 * radius + 1) * (2 * radius + 1)));
+	for (int y = 0; y < dest.Height; y++)
+	{
+		for (int x = 0; x < dest.Width; x++)
+		{
+			Pixel sum = Splat(0.0f);
+			for (int dy = -radius; dy <= radius; dy++)
+			{
+				int sy = Clamp(y + dy, 0, source.Height - 1);
+				for (int dx = -radius; dx <= radius; dx++)
+					sum = Add(sum, Load(source.At(Clamp(x + dx, 0, source.Width - 1), sy)));
+			}
+			Store(dest.At(x, y), Mul(sum, scale));
+		}
+	}
+	return (2 * radius + 1) * (2 * radius + 1);
+}
+
+float BloomFilter::MaxDifference(const BloomImage& a, const BloomImage& b)
+{
+	if (a.Width != b.Width || a.Height != b.Height)
+		return INFINITY;
+
+	float largest = 0.0f;
+	for (unsigned int i = 0; i < a.Pixels.size(); i++)
+		largest = fmaxf(largest, fabsf(a.Pixels[i] - b.Pixels[i]));
+	return largest;
+}
+
+// Threshold and both blurs run at a quarter of the pixels
+float BloomFilter::ChainSamplesPerPixel(const BloomSettings& settings)
+{
+	int radius = settings.Radius < MaxRadius ? settings.Radius : MaxRadius;
+	return (1.0f + 2.0f * (2 * radius + 1)) / 4.0f + 2.0f;
+}
+
+BloomSettings BloomFilter::GetGoldenSettings()
+{
+	BloomSettings settings = { 0.8f, 0.2f, 4, 2.0f, 1.0f };
+	return settings;
+}
+
+// Bright squares on a dim ramp
+void BloomFilter::MakeGoldenScene(BloomImage& scene)
+{
+	scene = BloomImage(1280, 720);
+	for (int y = 0; y < scene.Height; y++)
+	{
+		for (int x = 0; x < scene.Width; x++)
+		{
+			float value = ((x / 40 + y / 40) % 7 == 0) ? 1.0f : 0.3f * (x % 97) / 97.0f;
+			float* pixel = scene.At(x, y);
+			pixel[0] = value;
+			pixel[1] = value * 0.8f;
+			pixel[2] = value * 0.5f;
+			pixel[3] = 1.0f;
+		}
+	}
+}
+
+void BloomFilter::SampleGolden(const BloomImage& result, BloomImage& samples)
+{
+	samples = BloomImage(result.Width / GoldenStep, result.Height / GoldenStep);
+	for (int y = 0; y < samples.Height; y++)
+	{
+		for (int x = 0; x < samples.Width; x++)
+		{
+			const float* pixel = result.At(x * GoldenStep + GoldenStep / 2, y * GoldenStep + GoldenStep / 2);
+			memcpy(samples.At(x, y), pixel, 4 * sizeof(float));
+		}
+	}
+}
+
+bool BloomFilter::ReadGolden(const std::string& path, BloomImage& samples)
+{
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file || samples.Pixels.empty())
+		return false;
+
+	std::streamsize size = (std::streamsize)(samples.Pixels.size() * sizeof(float));
+	file.read((char*)&samples.Pixels[0], size);
+	return file.gcount() == size && file.peek() == std::ifstream::traits_type::eof();
+}
+
+bool BloomFilter::WriteGolden(const std::string& path, const BloomImage& samples)
+{
+	std::ofstream file(path.c_str(), std::ios::binary);
+	if (!file || samples.Pixels.empty())
+		return false;
+
+	file.write((const char*)&samples.Pixels[0], (std::streamsize)(samples.Pixels.size() * sizeof(float)));
+	return file.good();
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// How the bloom looks.  Shared by the GPU passes (see the
+// Bloom*PS shaders) and the CPU reference below, so both use
+// the same weights.
+// --------------------------------------------------------
+struct BloomSettings
+{
+	float Threshold;	// Brightness where bloom starts
+	float Knee;			// Softens the threshold over +/- this much
+	int Radius;			// Blur taps either side of center, up to MaxRadius
+	float Sigma;		// Gaussian spread, in half resolution texels
+	float Intensity;	// How much bloom is added back
+};
+
+// --------------------------------------------------------
+// An RGBA float image, row by row
+// --------------------------------------------------------
+struct BloomImage
+{
+	int Width;
+	int Height;
+	std::vector<float> Pixels;
+
+	BloomImage() : Width(0), Height(0) { }
+	BloomImage(int width, int height) : Width(width), Height(height), Pixels(width * height * 4, 0.0f) { }
+
+	float* At(int x, int y) { return &Pixels[(y * Width + x) * 4]; }
+	const float* At(int x, int y) const { return &Pixels[(y * Width + x) * 4]; }
+};
+
+// --------------------------------------------------------
+// CPU version of the bloom chain the game draws:
+//
+//   scene -> threshold, half size -> blur across -> blur down
+//         -> scene + bloom (bilinear up to full size)
+//
+// Each pass matches its pixel shader - same sample positions,
+// clamped addressing and bilinear filtering - so GPU output
+// read back can be compared against it.  One pixel (RGBA) is
+// one SIMD register with SSE.
+//
+// Each pass returns how many texture samples the shader takes
+// per output pixel, for comparing against the old box blur.
+// --------------------------------------------------------
+class BloomFilter
+{
+public:
+	static const int MaxRadius = 11;
+
+	// Center weight first, then each step out.  Normalized so
+	// center + 2 * (the rest) = 1.
+	static void GaussianWeights(int radius, float sigma, float weights[MaxRadius + 1]);
+
+	// Everything from scene to result, at the scene's size
+	static void Run(const BloomImage& scene, BloomImage& result, const BloomSettings& settings);
+
+	// The passes - dest must already be the size it's drawn at
+	static int ThresholdDownsample(const BloomImage& source, BloomImage& dest, const BloomSettings& settings);
+	static int Blur(const BloomImage& source, BloomImage& dest, const BloomSettings& settings, bool horizontal);
+	static int Combine(const BloomImage& scene, const BloomImage& bloom, BloomImage& dest, const BloomSettings& settings);
+
+	// One pixel at a time - a reference for Blur
+	static int BlurScalar(const BloomImage& source, BloomImage& dest, const BloomSettings& settings, bool horizontal);
+
+	// The (2r+1)^2 box blur the post process used to do
+	static int BoxBlur(const BloomImage& source, BloomImage& dest, int radius);
+
+	// Largest difference in any channel, for golden comparisons
+	static float MaxDifference(const BloomImage& a, const BloomImage& b);
+
+	// Samples per full resolution pixel for the whole chain
+	static float ChainSamplesPerPixel(const BloomSettings& settings);
+
+	// The reference check, shared by -bench bloom and
+	// Tools/BloomCheck: a made up 1280x720 scene through the
+	// chain with the golden settings, sampled every GoldenStep'th
+	// pixel each way from the middle of each block - enough to
+	// catch a change to any pass without a full size float image
+	// in the repository
+	static const int GoldenStep = 16;
+	static BloomSettings GetGoldenSettings();
+	static void MakeGoldenScene(BloomImage& scene);
+	static void SampleGolden(const BloomImage& result, BloomImage& samples);
+
+	// Raw floats, row by row.  Reading fails unless the file
+	// holds exactly the samples' size.
+	static bool ReadGolden(const std::string& path, BloomImage& samples);
+	static bool WriteGolden(const std::string& path, const BloomImage& samples);
+};
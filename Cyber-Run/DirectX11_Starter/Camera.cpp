@@ -110,6 +110,31 @@ void Camera::UpdateProjectionMatrix(float aspectRatio)
 	XMStoreFloat4x4(&projMatrix, XMMatrixTranspose(P)); // Transpose for HLSL!
 }
 
+// Extracts the six world space frustum planes (left, right, bottom,
+// top, near, far) from view * projection.  Normals point inwards, so
+// a point is inside when dot(plane.xyz, point) + plane.w >= 0
+void Camera::GetFrustumPlanes(XMFLOAT4 planes[6])
+{
+	// Our matrices are stored transposed for HLSL, so the rows of
+	// (projT * viewT) are the columns of (view * proj)
+	XMMATRIX m = XMMatrixMultiply(XMLoadFloat4x4(&projMatrix), XMLoadFloat4x4(&viewMatrix));
+	XMVECTOR c0 = m.r[0];
+	XMVECTOR c1 = m.r[1];
+	XMVECTOR c2 = m.r[2];
+	XMVECTOR c3 = m.r[3];
+
+	XMVECTOR p[6];
+	p[0] = c3 + c0;	// Left
+	p[1] = c3 - c0;	// Right
+	p[2] = c3 + c1;	// Bottom
+	p[3] = c3 - c1;	// Top
+	p[4] = c2;		// Near (D3D depth starts at zero)
+	p[5] = c3 - c2;	// Far
+
+	for (int i = 0; i < 6; i++)
+		XMStoreFloat4(&planes[i], XMPlaneNormalize(p[i]));
+}
+
 void Camera::setSpeed(float _speed)
 {
 	speed = _speed;
@@ -22,6 +22,7 @@ public:
 	DirectX::XMFLOAT3 GetPosition() { return position; }
 	DirectX::XMFLOAT4X4 GetView() { return viewMatrix; }
 	DirectX::XMFLOAT4X4 GetProjection() { return projMatrix; }
+	void GetFrustumPlanes(DirectX::XMFLOAT4 planes[6]);
 	void setSpeed(float _speed);
 
 private:
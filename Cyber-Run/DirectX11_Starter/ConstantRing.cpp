@@ -0,0 +1,177 @@
+#include "ConstantRing.h"
+#include <cstring>
+
+// The most a single constant buffer bind can see
+static const unsigned int MaxBindSize = D3D11_REQ_CONSTANT_BUFFER_ELEMENT_COUNT * 16;
+
+ConstantRing::ConstantRing(ID3D11Device* device, StateCache* stateCache, unsigned int capacity, bool allowOffsets)
+	: device(device),
+	context(stateCache->GetContext()),
+	offsets(false),
+	ring(0),
+	capacity(0),
+	writeCursor(0),
+	frameBase(0),
+	frameBytes(0),
+	allocationCount(0),
+	wrapCount(0),
+	growCount(0)
+{
+	// Offset binds, and NO_OVERWRITE on constant buffers, both
+	// need the 11.1 runtime and a driver that supports them
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	if (allowOffsets &&
+		stateCache->HasConstantOffsets() &&
+		SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) &&
+		options.ConstantBufferOffsetting &&
+		options.MapNoOverwriteOnDynamicConstantBuffer)
+	{
+		offsets = CreateRing(capacity);
+	}
+}
+
+ConstantRing::~ConstantRing()
+{
+	if (ring) ring->Release();
+	for (unsigned int i = 0; i < fallbackBuffers.size(); i++)
+		if (fallbackBuffers[i]) fallbackBuffers[i]->Release();
+}
+
+bool ConstantRing::CreateRing(unsigned int size)
+{
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = size;
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+	ID3D11Buffer* buffer = 0;
+	if (FAILED(device->CreateBuffer(&desc, 0, &buffer)))
+		return false;
+
+	if (ring) ring->Release();
+	ring = buffer;
+	capacity = size;
+	writeCursor = 0;
+	return true;
+}
+
+void ConstantRing::BeginFrame()
+{
+	frameBytes = 0;
+	allocationCount = 0;
+}
+
+ConstantAllocation ConstantRing::Allocate(const void* data, unsigned int size)
+{
+	ConstantAllocation allocation = { 0, 0 };
+	unsigned int aligned = (size + Alignment - 1) & ~(Alignment - 1);
+	if (size == 0 || aligned > MaxBindSize)
+		return allocation;
+
+	if (frameBytes + aligned > staging.size())
+		staging.resize((frameBytes + aligned) * 2);
+
+	// Zero the padding, so what's sent doesn't depend on old frames
+	memcpy(&staging[frameBytes], data, size);
+	memset(&staging[frameBytes + size], 0, aligned - size);
+
+	allocation.Offset = frameBytes;
+	allocation.Size = aligned;
+	frameBytes += aligned;
+	allocationCount++;
+	return allocation;
+}
+
+// --------------------------------------------------------
+// Appends the frame's block after the previous frame's.  When
+// it doesn't fit, the ring starts over from the beginning with
+// DISCARD, which hands us fresh memory while the GPU finishes
+// with the old.  A frame bigger than the whole ring grows it.
+// --------------------------------------------------------
+void ConstantRing::Upload()
+{
+	if (!offsets || frameBytes == 0)
+		return;
+
+	if (frameBytes > capacity)
+	{
+		unsigned int size = capacity;
+		while (size < frameBytes)
+			size *= 2;
+		if (!CreateRing(size))
+		{
+			// Keep going with the fallback rather than draw garbage
+			if (ring) ring->Release();
+			ring = 0;
+			capacity = 0;
+			offsets = false;
+			return;
+		}
+		growCount++;
+	}
+
+	D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (writeCursor + frameBytes > capacity)
+	{
+		writeCursor = 0;
+		wrapCount++;
+	}
+	if (writeCursor == 0)
+		mapType = D3D11_MAP_WRITE_DISCARD;
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(context->Map(ring, 0, mapType, 0, &mapped)))
+		return;
+	memcpy((unsigned char*)mapped.pData + writeCursor, &staging[0], frameBytes);
+	context->Unmap(ring, 0);
+
+	frameBase = writeCursor;
+	writeCursor += frameBytes;
+}
+
+void ConstantRing::Bind(StateCache* cache, StateCache::Stage stage, unsigned int slot, const ConstantAllocation& allocation)
+{
+	if (allocation.Size == 0)
+		return;
+
+	if (offsets)
+	{
+		cache->SetConstantBufferRange(stage, slot, ring, (frameBase + allocation.Offset) / 16, allocation.Size / 16);
+		return;
+	}
+
+	ID3D11Buffer* buffer = GetFallbackBuffer(allocation.Size);
+	if (buffer == 0)
+		return;
+
+	// DISCARD on a deferred context records contents of its own,
+	// so threads can share these buffers
+	ID3D11DeviceContext* target = cache->GetContext();
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(target->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+	memcpy(mapped.pData, &staging[allocation.Offset], allocation.Size);
+	target->Unmap(buffer, 0);
+
+	cache->SetConstantBuffer(stage, slot, buffer);
+}
+
+ID3D11Buffer* ConstantRing::GetFallbackBuffer(unsigned int size)
+{
+	std::lock_guard<std::mutex> lock(fallbackMutex);
+	unsigned int index = size / Alignment - 1;
+	if (index >= fallbackBuffers.size())
+		fallbackBuffers.resize(index + 1, 0);
+
+	if (fallbackBuffers[index] == 0)
+	{
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = size;
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		device->CreateBuffer(&desc, 0, &fallbackBuffers[index]);
+	}
+	return fallbackBuffers[index];
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <d3d11_1.h>
+#include <mutex>
+#include <vector>
+
+#include "StateCache.h"
+
+// --------------------------------------------------------
+// Where a block of constants ended up in a ConstantRing,
+// relative to the start of the frame's data
+// --------------------------------------------------------
+struct ConstantAllocation
+{
+	unsigned int Offset;
+	unsigned int Size;		// Rounded up to the alignment - 0 if nothing was allocated
+};
+
+// --------------------------------------------------------
+// One big DYNAMIC constant buffer that per-draw constants are
+// sub-allocated from, instead of every shader rewriting its
+// own small buffer before every draw (which makes the driver
+// rename or stall on that one buffer over and over).
+//
+// Each frame:
+//
+//   ring->BeginFrame();
+//   ConstantAllocation a = ring->Allocate(data, size);	// per draw
+//   ring->Upload();								// one Map
+//   ring->Bind(cache, stage, slot, a);			// per draw
+//
+// Upload() appends the frame's data after the last frame's with
+// Map(NO_OVERWRITE), so the GPU can still be reading earlier
+// frames, and only starts over (DISCARD) when it reaches the end.
+// Bind() points the slot at the allocation with the 11.1 offset
+// binds.  Without those (older runtimes and drivers), Bind()
+// instead copies the allocation into a small buffer of its own
+// with Map(DISCARD), like every draw did before.
+//
+// Binding only reads the frame's data, so draws can be bound
+// from several threads, each through its own StateCache.
+// --------------------------------------------------------
+class ConstantRing
+{
+public:
+	// Offsets have to be multiples of 16 constants
+	static const unsigned int Alignment = 256;
+
+	// allowOffsets = false forces the fallback path
+	ConstantRing(ID3D11Device* device, StateCache* stateCache, unsigned int capacity = 1024 * 1024, bool allowOffsets = true);
+	~ConstantRing();
+
+	// Is the ring itself being used (rather than the fallback)?
+	bool HasOffsets() { return offsets; }
+
+	void BeginFrame();
+
+	// Copies the data into this frame's block, aligned.  Data over
+	// the 4096 constants a bind can see isn't allocated.
+	ConstantAllocation Allocate(const void* data, unsigned int size);
+
+	// Sends the frame's block to the GPU
+	void Upload();
+
+	// Binds an allocation from this frame (after Upload)
+	void Bind(StateCache* cache, StateCache::Stage stage, unsigned int slot, const ConstantAllocation& allocation);
+
+	// Usage: bytes and allocations this frame, and times the ring
+	// has started over (or had to grow) since it was created
+	unsigned int GetCapacity() { return capacity; }
+	unsigned int GetFrameBytes() { return frameBytes; }
+	unsigned int GetAllocationCount() { return allocationCount; }
+	unsigned int GetWrapCount() { return wrapCount; }
+	unsigned int GetGrowCount() { return growCount; }
+
+private:
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+	bool offsets;
+
+	// The ring, and where this frame's block went in it
+	ID3D11Buffer* ring;
+	unsigned int capacity;
+	unsigned int writeCursor;
+	unsigned int frameBase;
+
+	// This frame's block, built up on the CPU first.  It only ever
+	// grows, so a steady frame doesn't allocate.
+	std::vector<unsigned char> staging;
+	unsigned int frameBytes;
+	unsigned int allocationCount;
+
+	unsigned int wrapCount;
+	unsigned int growCount;
+
+	// Fallback buffers, one per allocation size (in Alignment steps),
+	// made on first use by whichever thread needs them
+	std::vector<ID3D11Buffer*> fallbackBuffers;
+	std::mutex fallbackMutex;
+
+	bool CreateRing(unsigned int size);
+	ID3D11Buffer* GetFallbackBuffer(unsigned int size);
+};
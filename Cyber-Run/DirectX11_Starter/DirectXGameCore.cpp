@@ -10,8 +10,12 @@
 // -------------------------------------------------------------
 
 #include "DirectXGameCore.h"
+#include "SimpleShader.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
 #include <WindowsX.h>
 #include <sstream>
+#include <utility>
 
 #pragma region Global Window Callback
 
@@ -57,6 +61,15 @@ DirectXGameCore::DirectXGameCore(HINSTANCE hInstance)
 	driverType(D3D_DRIVER_TYPE_HARDWARE),
 	featureLevel(D3D_FEATURE_LEVEL_11_0),
 	aspectRatio(0.0f),
+	jobSystem(0),
+	stateCache(0),
+	pipelineCache(0),
+	constantRing(0),
+	frameStats(0),
+	simulationSnapshot(0),
+	renderSnapshot(1),
+	pipelinedLoop(false),
+	pipelinePrimed(false),
 	perfCounterSeconds(0.0),
 	startTime(0),
 	currentTime(0),
@@ -75,6 +88,8 @@ DirectXGameCore::DirectXGameCore(HINSTANCE hInstance)
 	__int64 perfFreq;
 	QueryPerformanceFrequency((LARGE_INTEGER*)&perfFreq);
 	perfCounterSeconds = 1.0 / (double)perfFreq;
+
+	frameStats = new FrameStats();
 }
 
 // --------------------------------------------------------
@@ -91,10 +106,20 @@ DirectXGameCore::~DirectXGameCore(void)
 	// Restore default device settings
 	if( deviceContext )
 		deviceContext->ClearState();
+	ISimpleShader::SetStateCache(0);
+	ISimpleShader::ClearShaderFileCache();
+	delete constantRing;
+	delete stateCache;
+	delete pipelineCache;
 
 	// Release the device context and finally the device itself
 	ReleaseMacro(deviceContext);
 	ReleaseMacro(device);
+
+	// Stop the worker threads
+	delete jobSystem;
+
+	delete frameStats;
 }
 #pragma endregion
 
@@ -105,6 +130,9 @@ DirectXGameCore::~DirectXGameCore(void)
 // --------------------------------------------------------
 bool DirectXGameCore::Init()
 {
+	// Start the job system first, so loading can already use it
+	jobSystem = new JobSystem();
+
 	// Create the actual window itself (no DirectX yet)
 	if(!InitMainWindow())
 		return false;
@@ -238,6 +266,12 @@ bool DirectXGameCore::InitDirect3D()
 		return false;
 	}
 
+	// All drawing goes through the state cache from here on
+	stateCache = new StateCache(deviceContext);
+	ISimpleShader::SetStateCache(stateCache);
+	pipelineCache = new PipelineCache(device);
+	constantRing = new ConstantRing(device, stateCache);
+
 	// There are several remaining steps before we can reasonably use DirectX.
 	// These steps also need to happen each time the window is resized, 
 	// so we simply call the OnResize method here.
@@ -292,9 +326,13 @@ void DirectXGameCore::OnResize()
 	HR(device->CreateTexture2D(&depthStencilDesc, 0, &depthStencilBuffer));
 	HR(device->CreateDepthStencilView(depthStencilBuffer, 0, &depthStencilView));
 
+	// Views may be recreated at the same addresses, so nothing
+	// the state cache remembers can be trusted anymore
+	stateCache->Invalidate();
+
 	// Bind these views to the pipeline, so rendering properly 
 	// uses the underlying textures
-	deviceContext->OMSetRenderTargets(1, &renderTargetView, depthStencilView);
+	stateCache->OMSetRenderTargets(1, &renderTargetView, depthStencilView);
 
 	// Update the viewport to match the new window size and set it on the device
 	viewport.TopLeftX	= 0;
@@ -328,6 +366,14 @@ int DirectXGameCore::Run()
 	// Create a variable to hold the current message
 	MSG msg = {0};
 
+	PROFILE_THREAD("Main");
+
+	// Frame times from here on, and this session's CSV of them
+	// if one was asked for
+	frameStats->Reset();
+	if (!frameStatsCsv.empty())
+		frameStats->OpenCsv(frameStatsCsv);
+
 	// Loop until we get a quit message from windows
 	while(msg.message != WM_QUIT)
 	{
@@ -340,21 +386,112 @@ int DirectXGameCore::Run()
 		}
 		else // No message to handle
 		{
-			// Update the timer for this frame
-			UpdateTimer();
+			{
+				PROFILE_ZONE("Frame");
+
+				// Update the timer for this frame
+				UpdateTimer();
 
-			// Standard game loop type stuff
-			CalculateFrameStats();
-			UpdateScene(deltaTime, totalTime);
-			DrawScene(deltaTime, totalTime);			
+				// Standard game loop type stuff
+				if (pipelinedLoop)
+					RunPipelinedFrame();
+				else
+					RunSerialFrame();
+
+				frameStats->EndFrame();
+				MemoryTracker::EndFrame();
+				CalculateFrameStats();
+			}
+			PROFILE_END_FRAME();
 		}
 	}
 
+	// The session's percentiles next to its frames
+	if (frameStats->IsCsvOpen())
+	{
+		frameStats->CloseCsv();
+		frameStats->WriteSummaryCsv(frameStatsCsv.substr(0, frameStatsCsv.rfind('.')) + "_summary.csv");
+	}
+
 	// If we make it outside the game loop, return the most
 	// recent message's exit code
 	return (int)msg.wParam;
 }
 
+// --------------------------------------------------------
+// Classic loop - simulate, then draw what was just simulated
+// --------------------------------------------------------
+void DirectXGameCore::RunSerialFrame()
+{
+	SampleInput();
+	frameStats->BeginStage(FrameStats::StageUpdate);
+	UpdateScene(deltaTime, totalTime);
+	frameStats->EndStage(FrameStats::StageUpdate);
+
+	std::swap(simulationSnapshot, renderSnapshot);
+	frameStats->BeginStage(FrameStats::StageSubmit);
+	DrawScene(deltaTime, totalTime);
+	frameStats->EndStage(FrameStats::StageSubmit);
+}
+
+// Data for the job that simulates the next frame
+struct UpdateSceneData
+{
+	DirectXGameCore* Game;
+	FrameStats* Stats;
+	float DeltaTime;
+	float TotalTime;
+};
+
+static void UpdateSceneJob(Job* job, const void* rawData)
+{
+	const UpdateSceneData* data = (const UpdateSceneData*)rawData;
+	data->Stats->BeginStage(FrameStats::StageUpdate);
+	data->Game->UpdateScene(data->DeltaTime, data->TotalTime);
+	data->Stats->EndStage(FrameStats::StageUpdate);
+}
+
+// --------------------------------------------------------
+// Two stage pipeline - UpdateScene for frame N+1 runs on a
+// worker while this thread draws frame N from the snapshot
+// that was filled last time.  CPU frame time becomes the
+// longer of the two stages instead of their sum, at the cost
+// of one frame of latency.
+//
+// For this to be safe, UpdateScene may only write to the
+// simulation snapshot, and DrawScene may only read game state
+// through the render snapshot.  Input has to be read in
+// SampleInput(), since GetKeyState() only sees the key
+// messages of the thread that calls it.
+// --------------------------------------------------------
+void DirectXGameCore::RunPipelinedFrame()
+{
+	// The first frame has nothing to draw until something is simulated
+	if (!pipelinePrimed)
+	{
+		SampleInput();
+		frameStats->BeginStage(FrameStats::StageUpdate);
+		UpdateScene(deltaTime, totalTime);
+		frameStats->EndStage(FrameStats::StageUpdate);
+		pipelinePrimed = true;
+	}
+
+	// Last frame's simulation is what we draw now
+	std::swap(simulationSnapshot, renderSnapshot);
+	SampleInput();
+
+	UpdateSceneData data = { this, frameStats, deltaTime, totalTime };
+	Job* update = jobSystem->CreateJob(UpdateSceneJob, &data, sizeof(data));
+	jobSystem->Run(update);
+
+	frameStats->BeginStage(FrameStats::StageSubmit);
+	DrawScene(deltaTime, totalTime);
+	frameStats->EndStage(FrameStats::StageSubmit);
+
+	// Done submitting - help finish the simulation if it's still going
+	jobSystem->Wait(update);
+}
+
 
 // --------------------------------------------------------
 // Updates the timer stats for this frame
@@ -387,25 +524,21 @@ void DirectXGameCore::UpdateTimer()
 // --------------------------------------------------------
 void DirectXGameCore::CalculateFrameStats()
 {
-	static int frameCount = 0;
 	static float timeElapsed = 0.0f;
 
-	frameCount++;
-
-	// Compute averages over ONE SECOND.
+	// Once a second, from the frame stats' window
 	if( (totalTime - timeElapsed) >= 1.0f )
 	{
-		float fps = (float)frameCount; // Count over one second
-		float mspf = 1000.0f / fps;    // Milliseconds per frame
+		FrameStageStats frame = frameStats->GetWindowStats(FrameStats::StageFrame);
 
 		// Quick and dirty string manipulation for title bar text
-		std::wostringstream outs;   
-		outs.precision(6);
+		std::wostringstream outs;
+		outs.setf(std::ios::fixed);
+		outs.precision(1);
 		outs << windowCaption << L"    "
-			/*<< L"Width: " << windowWidth << L"    "
-			<< L"Height: " << windowHeight << L"    "*/
-			<< L"FPS: " << fps << L"    ";
-			/*<< L"Frame Time: " << mspf << L"ms";*/
+			<< L"Frame ms  p50: " << frame.P50
+			<< L"  p99: " << frame.P99
+			<< L"  max: " << frame.Max;
 
 		// Include feature level
 		/*switch(featureLevel)
@@ -422,9 +555,7 @@ void DirectXGameCore::CalculateFrameStats()
 
 		SetWindowText(hMainWnd, outs.str().c_str());
 
-		// Reset frame count, and adjust time elapsed
-		// to wait another second
-		frameCount = 0;
+		// Adjust time elapsed to wait another second
 		timeElapsed += 1.0f;
 	}
 }
@@ -16,6 +16,11 @@
 #include <d3d11.h>
 
 #include "dxerr.h"
+#include "JobSystem.h"
+#include "StateCache.h"
+#include "ConstantRing.h"
+#include "PipelineCache.h"
+#include "FrameStats.h"
 
 // --------------------------------------------------------
 // Convenience macro for releasing COM objects.
@@ -66,6 +71,7 @@ public:
 	// derived classes to implement custom functionality
 	virtual bool Init();
 	virtual void OnResize(); 
+	virtual void SampleInput() { }
 	virtual void UpdateScene(float deltaTime, float totalTime) = 0;
 	virtual void DrawScene(float deltaTime, float totalTime)   = 0;
 	virtual LRESULT ProcessMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
@@ -76,6 +82,14 @@ public:
 	virtual void OnMouseUp(WPARAM btnState, int x, int y)  { }
 	virtual void OnMouseMove(WPARAM btnState, int x, int y){ }
 
+	// Simulates the next frame on a worker while the previous one is
+	// drawn - see RunPipelinedFrame() for what the game has to do
+	void SetPipelinedLoop(bool enabled) { pipelinedLoop = enabled; pipelinePrimed = false; }
+
+	// Where Run() writes every frame's times, and their summary
+	// next to it - "" (the default) for nowhere
+	void SetFrameStatsCsv(const std::string& path) { frameStatsCsv = path; }
+
 protected:
 	// Handles window and Direct3D initialization
 	bool InitMainWindow();
@@ -108,6 +122,31 @@ protected:
 	// The window's aspect ratio, used mostly for your projection matrix
 	float aspectRatio;
 
+	// Engine-wide job scheduler, so systems can fork/join across cores
+	JobSystem* jobSystem;
+
+	// Wraps deviceContext and drops redundant state changes.  Draw
+	// code (shaders, meshes, GUI) should bind state through this.
+	StateCache* stateCache;
+
+	// Every rasterizer, depth, blend and sampler state, shared by
+	// description, and the pipelines built from them
+	PipelineCache* pipelineCache;
+
+	// Per-frame ring that per-draw constants are sub-allocated from
+	ConstantRing* constantRing;
+
+	// Every frame's update, submit and present times.  The loop
+	// times UpdateScene and DrawScene; a DrawScene that presents
+	// should end StageSubmit and time StagePresent itself.
+	FrameStats* frameStats;
+
+	// Double-buffered render snapshots.  UpdateScene writes the
+	// simulation one, DrawScene only reads the render one, and the
+	// loop swaps them between the two stages
+	int simulationSnapshot;
+	int renderSnapshot;
+
 	// Derived class can set these in derived constructor to customize starting values.
 	std::wstring windowCaption;
 	int windowWidth;
@@ -122,11 +161,21 @@ private:
 	float totalTime;
 	float deltaTime;
 
+	// Game loop mode
+	bool pipelinedLoop;
+	bool pipelinePrimed;
+
+	std::string frameStatsCsv;
+
 	// Updates the timer for this frame
 	void UpdateTimer();
 
-	// Calculates stats about the current frame and
-	// updates the window's title bar
+	// One frame of the game loop, one stage after the other or overlapped
+	void RunSerialFrame();
+	void RunPipelinedFrame();
+
+	// Shows the recent frame time percentiles in the
+	// window's title bar
 	void CalculateFrameStats();
 };
 
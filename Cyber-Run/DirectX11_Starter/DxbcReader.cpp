@@ -0,0 +1,378 @@
+#include "DxbcReader.h"
+#include <cctype>
+#include <cstring>
+#include <sstream>
+
+// Container layout
+static const size_t ContainerHeaderSize = 32;
+static const size_t ChunkHeaderSize = 8;
+
+// Strides of the RDEF records for shader models below 5, which
+// don't store them.  5.0 and later list them in the RD11 header.
+static const unsigned int LegacyBindingStride = 32;
+static const unsigned int LegacyBufferStride = 24;
+static const unsigned int LegacyVariableStride = 24;
+
+const DxbcBinding* DxbcReflection::FindBinding(const std::string& name) const
+{
+	for (size_t i = 0; i < Bindings.size(); i++)
+		if (Bindings[i].Name == name)
+			return &Bindings[i];
+	return 0;
+}
+
+// --------------------------------------------------------
+// Bounds checked little-endian reads.  Every offset in the
+// container is checked before use, so a damaged file fails
+// to parse instead of reading past the end.
+// --------------------------------------------------------
+bool DxbcReader::Fail(const std::string& message)
+{
+	error = message;
+	return false;
+}
+
+bool DxbcReader::ReadUInt(size_t offset, unsigned int& value)
+{
+	if (offset + 4 > byteCount || offset + 4 < offset)
+		return Fail("Read past the end of the container");
+
+	value = bytes[offset] | (bytes[offset + 1] << 8) | (bytes[offset + 2] << 16) | ((unsigned int)bytes[offset + 3] << 24);
+	return true;
+}
+
+bool DxbcReader::ReadUShort(size_t offset, unsigned short& value)
+{
+	if (offset + 2 > byteCount || offset + 2 < offset)
+		return Fail("Read past the end of the container");
+
+	value = (unsigned short)(bytes[offset] | (bytes[offset + 1] << 8));
+	return true;
+}
+
+bool DxbcReader::ReadString(size_t offset, std::string& value)
+{
+	size_t end = offset;
+	while (end < byteCount && bytes[end] != 0)
+		end++;
+	if (end >= byteCount)
+		return Fail("Unterminated string");
+
+	value.assign((const char*)bytes + offset, end - offset);
+	return true;
+}
+
+// --------------------------------------------------------
+// Walks the container's chunk table and parses the chunks
+// we care about
+// --------------------------------------------------------
+bool DxbcReader::Parse(const void* data, size_t size)
+{
+	bytes = (const unsigned char*)data;
+	byteCount = size;
+	reflection = DxbcReflection();
+	error.clear();
+
+	if (size < ContainerHeaderSize || memcmp(bytes, "DXBC", 4) != 0)
+		return Fail("Not a DXBC container");
+
+	// Header: magic, checksum (16 bytes), version, total size, chunk count
+	unsigned int totalSize, chunkCount;
+	if (!ReadUInt(24, totalSize) || !ReadUInt(28, chunkCount))
+		return false;
+	if (totalSize > size)
+		return Fail("Container is truncated");
+
+	bool foundResources = false;
+	for (unsigned int c = 0; c < chunkCount; c++)
+	{
+		unsigned int chunkOffset, chunkSize;
+		if (!ReadUInt(ContainerHeaderSize + c * 4, chunkOffset) || !ReadUInt(chunkOffset + 4, chunkSize))
+			return false;
+
+		size_t chunkData = chunkOffset + ChunkHeaderSize;
+		if (chunkData + chunkSize > size)
+			return Fail("Chunk runs past the end of the container");
+
+		const char* fourCC = (const char*)bytes + chunkOffset;
+		if (memcmp(fourCC, "RDEF", 4) == 0)
+		{
+			if (!ParseResourceDefinitions(chunkData, chunkSize))
+				return false;
+			foundResources = true;
+		}
+		else if (memcmp(fourCC, "ISGN", 4) == 0)
+		{
+			if (!ParseSignature(chunkData, chunkSize, false, reflection.Inputs))
+				return false;
+		}
+		else if (memcmp(fourCC, "OSGN", 4) == 0 || memcmp(fourCC, "OSG5", 4) == 0)
+		{
+			// Geometry shaders from 5.0 on use OSG5, which adds the stream
+			if (!ParseSignature(chunkData, chunkSize, fourCC[3] == '5', reflection.Outputs))
+				return false;
+		}
+	}
+
+	// Shaders compiled with /Qstrip_reflect have no RDEF
+	if (!foundResources)
+		return Fail("No resource definitions (RDEF) - was reflection stripped?");
+	return true;
+}
+
+// --------------------------------------------------------
+// RDEF - constant buffers, their variables and types, and
+// resource bindings.  All offsets are from the chunk's data.
+// --------------------------------------------------------
+bool DxbcReader::ParseResourceDefinitions(size_t chunk, size_t chunkSize)
+{
+	unsigned int bufferCount, bufferOffset, bindingCount, bindingOffset, version, flags, creatorOffset;
+	if (!ReadUInt(chunk + 0, bufferCount) ||
+		!ReadUInt(chunk + 4, bufferOffset) ||
+		!ReadUInt(chunk + 8, bindingCount) ||
+		!ReadUInt(chunk + 12, bindingOffset) ||
+		!ReadUInt(chunk + 16, version) ||
+		!ReadUInt(chunk + 20, flags) ||
+		!ReadUInt(chunk + 24, creatorOffset))
+		return false;
+
+	reflection.MinorVersion = version & 0xFF;
+	reflection.MajorVersion = (version >> 8) & 0xFF;
+	reflection.ProgramType = version >> 16;
+	if (!ReadString(chunk + creatorOffset, reflection.Creator))
+		return false;
+
+	unsigned int bindingStride = LegacyBindingStride;
+	unsigned int bufferStride = LegacyBufferStride;
+	unsigned int variableStride = LegacyVariableStride;
+	if (reflection.MajorVersion >= 5)
+	{
+		if (chunk + 32 > byteCount || memcmp(bytes + chunk + 28, "RD11", 4) != 0)
+			return Fail("Missing RD11 header");
+
+		if (!ReadUInt(chunk + 36, bufferStride) ||
+			!ReadUInt(chunk + 40, bindingStride) ||
+			!ReadUInt(chunk + 44, variableStride))
+			return false;
+		if (bufferStride < LegacyBufferStride || bindingStride < LegacyBindingStride || variableStride < LegacyVariableStride)
+			return Fail("Bad RD11 record sizes");
+	}
+
+	// Counts are checked against the chunk before anything is
+	// allocated, so a bad count can't ask for gigabytes
+	if (bindingCount > chunkSize / bindingStride || bufferCount > chunkSize / bufferStride)
+		return Fail("Too many resources for the RDEF chunk");
+
+	// Resource bindings (textures, samplers, cbuffers, ...)
+	reflection.Bindings.resize(bindingCount);
+	for (unsigned int b = 0; b < bindingCount; b++)
+	{
+		size_t record = chunk + bindingOffset + (size_t)b * bindingStride;
+		DxbcBinding& binding = reflection.Bindings[b];
+		unsigned int nameOffset;
+		if (!ReadUInt(record + 0, nameOffset) ||
+			!ReadString(chunk + nameOffset, binding.Name) ||
+			!ReadUInt(record + 4, binding.Type) ||
+			!ReadUInt(record + 12, binding.Dimension) ||
+			!ReadUInt(record + 20, binding.BindPoint) ||
+			!ReadUInt(record + 24, binding.BindCount))
+			return false;
+	}
+
+	// Constant buffers and their variables
+	reflection.ConstantBuffers.resize(bufferCount);
+	for (unsigned int c = 0; c < bufferCount; c++)
+	{
+		size_t record = chunk + bufferOffset + (size_t)c * bufferStride;
+		DxbcConstantBuffer& buffer = reflection.ConstantBuffers[c];
+		unsigned int nameOffset, variableCount, variableOffset;
+		if (!ReadUInt(record + 0, nameOffset) ||
+			!ReadString(chunk + nameOffset, buffer.Name) ||
+			!ReadUInt(record + 4, variableCount) ||
+			!ReadUInt(record + 8, variableOffset) ||
+			!ReadUInt(record + 12, buffer.Size) ||
+			!ReadUInt(record + 20, buffer.Type))
+			return false;
+
+		if (variableCount > chunkSize / variableStride)
+			return Fail("Too many variables for the RDEF chunk");
+		buffer.Variables.resize(variableCount);
+		for (unsigned int v = 0; v < variableCount; v++)
+		{
+			size_t varRecord = chunk + variableOffset + (size_t)v * variableStride;
+			DxbcVariable& variable = buffer.Variables[v];
+			unsigned int varNameOffset, typeOffset;
+			if (!ReadUInt(varRecord + 0, varNameOffset) ||
+				!ReadString(chunk + varNameOffset, variable.Name) ||
+				!ReadUInt(varRecord + 4, variable.Offset) ||
+				!ReadUInt(varRecord + 8, variable.Size) ||
+				!ReadUInt(varRecord + 12, variable.Flags) ||
+				!ReadUInt(varRecord + 16, typeOffset))
+				return false;
+
+			size_t type = chunk + typeOffset;
+			if (!ReadUShort(type + 0, variable.Class) ||
+				!ReadUShort(type + 2, variable.Type) ||
+				!ReadUShort(type + 4, variable.Rows) ||
+				!ReadUShort(type + 6, variable.Columns) ||
+				!ReadUShort(type + 8, variable.Elements))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// ISGN / OSGN - element count, then one 24 byte record each.
+// OSG5 records are 28 bytes, starting with the stream index.
+// --------------------------------------------------------
+bool DxbcReader::ParseSignature(size_t chunk, size_t chunkSize, bool hasStreams, std::vector<DxbcSignatureElement>& elements)
+{
+	unsigned int count;
+	if (!ReadUInt(chunk, count))
+		return false;
+
+	size_t stride = hasStreams ? 28 : 24;
+	if (count > chunkSize / stride)
+		return Fail("Too many elements for the signature chunk");
+	elements.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		size_t record = chunk + 8 + (size_t)i * stride;
+		DxbcSignatureElement& element = elements[i];
+		element.Stream = 0;
+		if (hasStreams)
+		{
+			if (!ReadUInt(record, element.Stream))
+				return false;
+			record += 4;
+		}
+
+		unsigned int nameOffset, masks;
+		if (!ReadUInt(record + 0, nameOffset) ||
+			!ReadString(chunk + nameOffset, element.SemanticName) ||
+			!ReadUInt(record + 4, element.SemanticIndex) ||
+			!ReadUInt(record + 8, element.SystemValue) ||
+			!ReadUInt(record + 12, element.ComponentType) ||
+			!ReadUInt(record + 16, element.Register) ||
+			!ReadUInt(record + 20, masks))
+			return false;
+
+		element.Mask = masks & 0xFF;
+		element.ReadWriteMask = (masks >> 8) & 0xFF;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Picks the C++ type for a cbuffer variable, or returns false
+// if it has no exact match (it's then written as raw floats)
+// --------------------------------------------------------
+static bool MatchingCppType(const DxbcVariable& variable, std::string& type, unsigned int& arrayCount)
+{
+	arrayCount = variable.Elements;
+	unsigned int count = arrayCount > 0 ? arrayCount : 1;
+
+	bool isFloat = variable.Type == DxbcReader::TypeFloat;
+	bool isInt = variable.Type == DxbcReader::TypeInt || variable.Type == DxbcReader::TypeBool;
+	bool isUInt = variable.Type == DxbcReader::TypeUInt;
+
+	// Array elements each start on a 16 byte register, so only
+	// full-register elements match a plain C++ array
+	unsigned int elementSize = arrayCount > 0 ? 16 : 0;
+
+	switch (variable.Class)
+	{
+	case DxbcReader::ClassScalar:
+		if (arrayCount > 0) return false;
+		if (isFloat) type = "float";
+		else if (isInt) type = "int";
+		else if (isUInt) type = "unsigned int";
+		else return false;
+		return variable.Size == 4;
+
+	case DxbcReader::ClassVector:
+	{
+		if (variable.Columns < 2 || variable.Columns > 4) return false;
+		if (arrayCount > 0 && variable.Columns != 4) return false;
+		const char digit[] = { (char)('0' + variable.Columns), 0 };
+		if (isFloat) type = std::string("DirectX::XMFLOAT") + digit;
+		else if (isInt) type = std::string("DirectX::XMINT") + digit;
+		else if (isUInt) type = std::string("DirectX::XMUINT") + digit;
+		else return false;
+		return variable.Size == (arrayCount > 0 ? elementSize * count : variable.Columns * 4u);
+	}
+
+	case DxbcReader::ClassMatrixRows:
+	case DxbcReader::ClassMatrixColumns:
+		if (!isFloat || variable.Rows != 4 || variable.Columns != 4) return false;
+		type = "DirectX::XMFLOAT4X4";
+		return variable.Size == 64 * count;
+	}
+	return false;
+}
+
+// --------------------------------------------------------
+// Writes a header of structs matching each cbuffer exactly -
+// gaps from HLSL's packing rules become explicit padding, and
+// every offset and size is checked at compile time
+// --------------------------------------------------------
+std::string DxbcReader::GenerateHeader(const DxbcReflection& reflection, const std::string& prefix, const std::string& source)
+{
+	std::ostringstream out;
+	out << "// Generated from " << source << " by DxbcTool - do not edit\n";
+	out << "#pragma once\n\n";
+	out << "#include <DirectXMath.h>\n";
+	out << "#include <cstddef>\n";
+
+	for (size_t c = 0; c < reflection.ConstantBuffers.size(); c++)
+	{
+		const DxbcConstantBuffer& buffer = reflection.ConstantBuffers[c];
+		if (buffer.Type != 0 || buffer.Name.empty())
+			continue;
+
+		std::string name = buffer.Name;
+		name[0] = (char)toupper((unsigned char)name[0]);
+		name = prefix + name;
+
+		out << "\n// cbuffer " << buffer.Name << " - " << buffer.Size << " bytes\n";
+		out << "struct " << name << "\n{\n";
+
+		unsigned int cursor = 0;
+		int padCount = 0;
+		for (size_t v = 0; v < buffer.Variables.size(); v++)
+		{
+			const DxbcVariable& variable = buffer.Variables[v];
+			if (variable.Offset > cursor)
+				out << "\tfloat _pad" << padCount++ << "[" << (variable.Offset - cursor) / 4 << "];\n";
+
+			std::string type;
+			unsigned int arrayCount;
+			if (MatchingCppType(variable, type, arrayCount))
+			{
+				out << "\t" << type << " " << variable.Name;
+				if (arrayCount > 0) out << "[" << arrayCount << "]";
+			}
+			else
+			{
+				out << "\tfloat " << variable.Name << "[" << variable.Size / 4 << "]";
+			}
+			out << ";\t// offset " << variable.Offset << "\n";
+			cursor = variable.Offset + variable.Size;
+		}
+		if (buffer.Size > cursor)
+			out << "\tfloat _pad" << padCount++ << "[" << (buffer.Size - cursor) / 4 << "];\n";
+		out << "};\n";
+
+		out << "static_assert(sizeof(" << name << ") == " << buffer.Size << ", \"" << name << " size doesn't match the shader\");\n";
+		for (size_t v = 0; v < buffer.Variables.size(); v++)
+		{
+			const DxbcVariable& variable = buffer.Variables[v];
+			out << "static_assert(offsetof(" << name << ", " << variable.Name << ") == " << variable.Offset <<
+				", \"" << name << "::" << variable.Name << " offset doesn't match the shader\");\n";
+		}
+	}
+
+	return out.str();
+}
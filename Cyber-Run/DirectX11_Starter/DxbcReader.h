@@ -0,0 +1,119 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Reflection data read straight out of a compiled shader.
+// Enum-like fields hold the same values as their D3D
+// counterparts (noted on each), so they can be cast across.
+// --------------------------------------------------------
+struct DxbcVariable
+{
+	std::string Name;
+	unsigned int Offset;		// Bytes from the start of the buffer
+	unsigned int Size;
+	unsigned int Flags;			// D3D_SHADER_VARIABLE_FLAGS
+	unsigned short Class;		// D3D_SHADER_VARIABLE_CLASS
+	unsigned short Type;		// D3D_SHADER_VARIABLE_TYPE
+	unsigned short Rows;
+	unsigned short Columns;
+	unsigned short Elements;	// 0 if not an array
+};
+
+struct DxbcConstantBuffer
+{
+	std::string Name;
+	unsigned int Size;
+	unsigned int Type;			// D3D_CBUFFER_TYPE
+	std::vector<DxbcVariable> Variables;
+};
+
+struct DxbcBinding
+{
+	std::string Name;
+	unsigned int Type;			// D3D_SHADER_INPUT_TYPE
+	unsigned int BindPoint;
+	unsigned int BindCount;
+	unsigned int Dimension;		// D3D_SRV_DIMENSION
+};
+
+struct DxbcSignatureElement
+{
+	std::string SemanticName;
+	unsigned int SemanticIndex;
+	unsigned int SystemValue;	// D3D_NAME
+	unsigned int ComponentType;	// D3D_REGISTER_COMPONENT_TYPE
+	unsigned int Register;
+	unsigned int Stream;		// Geometry shader output stream, otherwise 0
+	unsigned char Mask;
+	unsigned char ReadWriteMask;
+};
+
+struct DxbcReflection
+{
+	unsigned int ProgramType;	// One of the DxbcReader::Program values
+	unsigned int MajorVersion;
+	unsigned int MinorVersion;
+	std::string Creator;
+
+	std::vector<DxbcConstantBuffer> ConstantBuffers;
+	std::vector<DxbcBinding> Bindings;
+	std::vector<DxbcSignatureElement> Inputs;
+	std::vector<DxbcSignatureElement> Outputs;
+
+	const DxbcBinding* FindBinding(const std::string& name) const;
+};
+
+// --------------------------------------------------------
+// Portable reader for DXBC containers (.cso files) - no D3D,
+// COM or Windows headers needed, so it also builds for tools.
+//
+// Reads the RDEF chunk (constant buffers, variables and
+// resource bindings) and the ISGN/OSGN/OSG5 signatures, and can
+// write a C++ header of structs matching each cbuffer.
+// --------------------------------------------------------
+class DxbcReader
+{
+public:
+	// RDEF program types, as stored in the version token
+	enum Program
+	{
+		ProgramPixel = 0xFFFF,
+		ProgramVertex = 0xFFFE,
+		ProgramGeometry = 0x4753,
+		ProgramHull = 0x4853,
+		ProgramDomain = 0x4453,
+		ProgramCompute = 0x4353
+	};
+
+	// Same values as D3D_SHADER_INPUT_TYPE / D3D_SHADER_VARIABLE_CLASS / _TYPE
+	enum { InputCBuffer = 0, InputTBuffer = 1, InputTexture = 2, InputSampler = 3 };
+	enum { ClassScalar = 0, ClassVector = 1, ClassMatrixRows = 2, ClassMatrixColumns = 3, ClassObject = 4, ClassStruct = 5 };
+	enum { TypeBool = 1, TypeInt = 2, TypeFloat = 3, TypeUInt = 19 };
+
+	// Parses a whole container.  Returns false (see GetError) if it
+	// isn't one, or anything in it points outside the data.
+	bool Parse(const void* data, size_t size);
+
+	const DxbcReflection& GetReflection() const { return reflection; }
+	const std::string& GetError() const { return error; }
+
+	// C++ structs matching every cbuffer, named prefix + buffer name,
+	// with explicit padding and static_asserts on every offset
+	static std::string GenerateHeader(const DxbcReflection& reflection, const std::string& prefix, const std::string& source);
+
+private:
+	const unsigned char* bytes;
+	size_t byteCount;
+	DxbcReflection reflection;
+	std::string error;
+
+	bool Fail(const std::string& message);
+	bool ReadUInt(size_t offset, unsigned int& value);
+	bool ReadUShort(size_t offset, unsigned short& value);
+	bool ReadString(size_t offset, std::string& value);
+
+	bool ParseResourceDefinitions(size_t chunk, size_t chunkSize);
+	bool ParseSignature(size_t chunk, size_t chunkSize, bool hasStreams, std::vector<DxbcSignatureElement>& elements);
+};
@@ -0,0 +1,94 @@
+#include "DynamicResolution.h"
+#include "GpuTimer.h"
+#include <cmath>
+
+// Changes smaller than this aren't worth a new render size
+static const float MinStep = 1.0f / 64.0f;
+
+DynamicResolution::DynamicResolution()
+{
+	DynamicResolutionSettings defaults = { 1000.0f / 60.0f, 0.5f, 1.0f, 0.15f, 8, GpuTimer::FrameCount };
+	SetSettings(defaults);
+}
+
+DynamicResolution::DynamicResolution(const DynamicResolutionSettings& settings)
+{
+	SetSettings(settings);
+}
+
+void DynamicResolution::SetSettings(const DynamicResolutionSettings& settings)
+{
+	this->settings = settings;
+	if (this->settings.Window < 1) this->settings.Window = 1;
+	if (this->settings.Window > MaxWindow) this->settings.Window = MaxWindow;
+	if (this->settings.MinScale > this->settings.MaxScale) this->settings.MinScale = this->settings.MaxScale;
+	if (this->settings.Latency < 0) this->settings.Latency = 0;
+	changeCount = 0;
+	Reset();
+}
+
+void DynamicResolution::Reset()
+{
+	scale = settings.MaxScale;
+	sampleCount = 0;
+	skipCount = settings.Latency;
+	averageMs = 0;
+}
+
+// --------------------------------------------------------
+// Decides once a full window of frames has been seen
+// --------------------------------------------------------
+void DynamicResolution::AddFrame(float frameMs, float gpuMs)
+{
+	if (skipCount > 0)
+	{
+		skipCount--;
+		return;
+	}
+
+	samples[sampleCount++] = gpuMs >= 0 ? gpuMs : frameMs;
+	if (sampleCount < settings.Window)
+		return;
+
+	float total = 0;
+	for (int i = 0; i < sampleCount; i++)
+		total += samples[i];
+	averageMs = total / sampleCount;
+	sampleCount = 0;
+	if (averageMs <= 0)
+		return;
+
+	// Halfway to the size that would just hit the target, so a
+	// noisy window can't swing it too far
+	float ideal = scale * sqrtf(settings.TargetMs / averageMs);
+	float next = scale + (ideal - scale) * 0.5f;
+	if (averageMs > settings.TargetMs)
+	{
+		if (next > scale - MinStep) next = scale - MinStep;
+	}
+	else
+	{
+		if (averageMs > settings.TargetMs * (1.0f - settings.Headroom) || next < scale + MinStep)
+			return;
+	}
+
+	if (next < settings.MinScale) next = settings.MinScale;
+	if (next > settings.MaxScale) next = settings.MaxScale;
+	if (next == scale)
+		return;
+
+	scale = next;
+	skipCount = settings.Latency;
+	changeCount++;
+}
+
+float DynamicResolution::GetLodBias()
+{
+	return scale < 1.0f ? log2f(scale) : 0.0f;
+}
+
+int DynamicResolution::ScaleSize(int size)
+{
+	int scaled = (int)(size * scale + 0.5f);
+	return scaled > 0 ? scaled : 1;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+// --------------------------------------------------------
+// How the resolution governor behaves
+// --------------------------------------------------------
+struct DynamicResolutionSettings
+{
+	float TargetMs;		// Frame time to hold
+	float MinScale;		// Render size as a fraction of the output, per axis
+	float MaxScale;
+	float Headroom;		// Only scale up when under the target by this fraction
+	int Window;			// Frames averaged before each decision
+	int Latency;		// Frames before a frame's cost comes back
+};
+
+// --------------------------------------------------------
+// Dynamic resolution - picks the scene's render scale from
+// recent frame times.
+//
+//   governor.AddFrame(frameMs, gpuMs);	// Each frame
+//   ... render the scene at GetScale() times the output size,
+//   ... with GetLodBias() on texture sampling
+//
+// A frame's cost is its GPU time when there is one (only the
+// GPU's work shrinks with resolution), or else the whole frame
+// time.  Once Window frames have been seen, the scale moves
+// toward the size whose pixel count would just hit the target
+// - cost is taken to follow the pixel count, so the scale goes
+// with the square root of target / cost.  Over the target it
+// drops straight away; under it, it only rises with Headroom
+// to spare, so it doesn't flip between two sizes.  GPU times
+// arrive Latency frames late, so after a change (or a Reset)
+// the next Latency samples are still from the old size and
+// are thrown away.
+// --------------------------------------------------------
+class DynamicResolution
+{
+public:
+	static const int MaxWindow = 32;
+
+	DynamicResolution();
+	DynamicResolution(const DynamicResolutionSettings& settings);
+
+	void SetSettings(const DynamicResolutionSettings& settings);
+	const DynamicResolutionSettings& GetSettings() { return settings; }
+
+	// gpuMs < 0 when there's no GPU time for the frame
+	void AddFrame(float frameMs, float gpuMs);
+
+	// Starts again at the largest scale, for when the output
+	// size changes
+	void Reset();
+
+	float GetScale() { return scale; }
+
+	// Mip bias for rendering at GetScale() - negative, so
+	// textures stay as sharp as they would be at full size
+	float GetLodBias();
+
+	// The scale applied to a size, rounded to whole pixels (at
+	// least one)
+	int ScaleSize(int size);
+
+	// The last decision's average cost, and how many times the
+	// scale has changed
+	float GetAverageMs() { return averageMs; }
+	int GetChangeCount() { return changeCount; }
+
+private:
+	DynamicResolutionSettings settings;
+	float scale;
+	float samples[MaxWindow];
+	int sampleCount;
+	int skipCount;
+	float averageMs;
+	int changeCount;
+};
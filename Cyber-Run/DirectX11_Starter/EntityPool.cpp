@@ -0,0 +1,48 @@
+#include "EntityPool.h"
+#include "MemoryTracker.h"
+
+EntityPool::EntityPool()
+{
+}
+
+EntityPool::~EntityPool()
+{
+	for (unsigned int i = 0; i < entities.size(); i++)
+		delete entities[i];
+}
+
+GameEntity* EntityPool::Create(Mesh* mesh, Material* material, bool sky)
+{
+	if (freeEntities.empty())
+		Grow();
+
+	GameEntity* entity = freeEntities.back();
+	freeEntities.pop_back();
+	*entity = GameEntity(mesh, material, sky);
+	return entity;
+}
+
+void EntityPool::Destroy(GameEntity* entity)
+{
+	freeEntities.push_back(entity);
+}
+
+void EntityPool::Reserve(int count)
+{
+	while ((int)entities.size() < count)
+		Grow();
+}
+
+// --------------------------------------------------------
+// One more free entity.  The free list always has room for
+// every entity, so Destroy() never allocates.
+// --------------------------------------------------------
+void EntityPool::Grow()
+{
+	MEMORY_TAG(MemoryTracker::TagGameplay);
+
+	GameEntity* entity = new GameEntity(0, 0, false);
+	entities.push_back(entity);
+	freeEntities.reserve(entities.capacity());
+	freeEntities.push_back(entity);
+}
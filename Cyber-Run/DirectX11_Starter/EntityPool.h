@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include "GameEntity.h"
+
+// --------------------------------------------------------
+// Recycles GameEntities, so spawning and despawning during
+// play doesn't touch the heap.  A new entity is only made
+// when none are free, and the pool deletes every entity it
+// made when it goes, whether it was handed back or not.
+// --------------------------------------------------------
+class EntityPool
+{
+public:
+	EntityPool();
+	~EntityPool();
+
+	// An entity set up as if it had just been constructed
+	GameEntity* Create(Mesh* mesh, Material* material, bool sky);
+
+	// Hands an entity back - it mustn't be used after this
+	void Destroy(GameEntity* entity);
+
+	// Makes entities up front until there are at least "count"
+	void Reserve(int count);
+
+	int GetLiveCount() { return (int)(entities.size() - freeEntities.size()); }
+	int GetCapacity() { return (int)entities.size(); }
+
+private:
+	std::vector<GameEntity*> entities;		// Every one the pool made
+	std::vector<GameEntity*> freeEntities;
+
+	void Grow();
+};
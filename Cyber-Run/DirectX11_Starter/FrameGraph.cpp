@@ -0,0 +1,292 @@
+#include "FrameGraph.h"
+#include "Profiler.h"
+
+#include <cstdio>
+
+// Names for the formats a target is likely to use
+static const char* FormatName(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM: return "RGBA8";
+	case DXGI_FORMAT_R16G16B16A16_FLOAT: return "RGBA16F";
+	case DXGI_FORMAT_R32G32B32A32_FLOAT: return "RGBA32F";
+	case DXGI_FORMAT_R11G11B10_FLOAT: return "R11G11B10F";
+	case DXGI_FORMAT_R16_FLOAT: return "R16F";
+	case DXGI_FORMAT_R32_FLOAT: return "R32F";
+	case DXGI_FORMAT_R8_UNORM: return "R8";
+	default: return "?";
+	}
+}
+
+FrameGraph::FrameGraph(ID3D11Device* device)
+	: pool(device)
+{ }
+
+FrameGraph::~FrameGraph()
+{ }
+
+// --------------------------------------------------------
+// Building
+// --------------------------------------------------------
+int FrameGraph::CreateTarget(const std::string& name, const RenderTargetDesc& desc)
+{
+	Target target = {};
+	target.Name = name;
+	target.Desc = desc;
+	target.Imported = false;
+	target.FirstPass = -1;
+	target.LastPass = -1;
+	targets.push_back(target);
+	return (int)targets.size() - 1;
+}
+
+int FrameGraph::ImportTarget(const std::string& name, ID3D11RenderTargetView* rtv, ID3D11ShaderResourceView* srv, ID3D11DepthStencilView* dsv)
+{
+	Target target = {};
+	target.Name = name;
+	target.Imported = true;
+	target.RTV = rtv;
+	target.SRV = srv;
+	target.DSV = dsv;
+	target.FirstPass = -1;
+	target.LastPass = -1;
+	targets.push_back(target);
+	return (int)targets.size() - 1;
+}
+
+void FrameGraph::SetImportedTarget(int target, ID3D11RenderTargetView* rtv, ID3D11ShaderResourceView* srv, ID3D11DepthStencilView* dsv)
+{
+	targets[target].RTV = rtv;
+	targets[target].SRV = srv;
+	targets[target].DSV = dsv;
+}
+
+int FrameGraph::AddPass(const std::string& name, FramePassFunction function, void* userData)
+{
+	Pass pass;
+	pass.Name = name;
+	pass.Function = function;
+	pass.UserData = userData;
+	pass.Culled = false;
+	passes.push_back(pass);
+	return (int)passes.size() - 1;
+}
+
+void FrameGraph::Read(int pass, int target)
+{
+	passes[pass].Reads.push_back(target);
+}
+
+void FrameGraph::Write(int pass, int target)
+{
+	passes[pass].Writes.push_back(target);
+}
+
+// --------------------------------------------------------
+// Compiling
+// --------------------------------------------------------
+void FrameGraph::Compile()
+{
+	CullPasses();
+	FindLifetimes();
+	AssignTextures();
+}
+
+void FrameGraph::Resize(unsigned int width, unsigned int height)
+{
+	pool.SetScreenSize(width, height);
+	Compile();
+}
+
+// --------------------------------------------------------
+// Walks backwards from the imported targets (what the frame
+// is actually for): a pass runs if something later reads what
+// it writes, or it writes to an imported target
+// --------------------------------------------------------
+void FrameGraph::CullPasses()
+{
+	std::vector<bool> needed(targets.size(), false);
+	for (unsigned int t = 0; t < targets.size(); t++)
+		needed[t] = targets[t].Imported;
+
+	for (int p = (int)passes.size() - 1; p >= 0; p--)
+	{
+		Pass& pass = passes[p];
+		pass.Culled = true;
+		for (unsigned int w = 0; w < pass.Writes.size(); w++)
+			if (needed[pass.Writes[w]])
+				pass.Culled = false;
+
+		if (!pass.Culled)
+			for (unsigned int r = 0; r < pass.Reads.size(); r++)
+				needed[pass.Reads[r]] = true;
+	}
+}
+
+bool FrameGraph::Uses(const Pass& pass, int target)
+{
+	for (unsigned int r = 0; r < pass.Reads.size(); r++)
+		if (pass.Reads[r] == target) return true;
+	for (unsigned int w = 0; w < pass.Writes.size(); w++)
+		if (pass.Writes[w] == target) return true;
+	return false;
+}
+
+void FrameGraph::FindLifetimes()
+{
+	for (unsigned int t = 0; t < targets.size(); t++)
+	{
+		targets[t].FirstPass = -1;
+		targets[t].LastPass = -1;
+		for (unsigned int p = 0; p < passes.size(); p++)
+		{
+			if (passes[p].Culled || !Uses(passes[p], t))
+				continue;
+			if (targets[t].FirstPass < 0)
+				targets[t].FirstPass = p;
+			targets[t].LastPass = p;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Takes each transient target from the pool just before its
+// first pass, and gives it back right after its last, so a
+// later target with the same size and format gets the same
+// texture.  Everything a pass uses is taken before anything it
+// finishes with is given back, so a pass never reads and
+// writes the same texture.
+//
+// The pool only tracks this schedule - once compiled, every
+// texture is back on its free list, ready for the next compile.
+// --------------------------------------------------------
+void FrameGraph::AssignTextures()
+{
+	for (unsigned int t = 0; t < targets.size(); t++)
+	{
+		if (!targets[t].Imported)
+		{
+			targets[t].Pooled = 0;
+			targets[t].RTV = 0;
+			targets[t].SRV = 0;
+		}
+	}
+
+	for (unsigned int p = 0; p < passes.size(); p++)
+	{
+		for (unsigned int t = 0; t < targets.size(); t++)
+		{
+			Target& target = targets[t];
+			if (target.Imported || target.FirstPass != (int)p)
+				continue;
+
+			target.Pooled = pool.Acquire(target.Desc);
+			target.RTV = target.Pooled ? target.Pooled->RTV : 0;
+			target.SRV = target.Pooled ? target.Pooled->SRV : 0;
+		}
+
+		for (unsigned int t = 0; t < targets.size(); t++)
+		{
+			if (!targets[t].Imported && targets[t].LastPass == (int)p)
+				pool.Release(targets[t].Pooled);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Running
+// --------------------------------------------------------
+void FrameGraph::Execute()
+{
+	for (unsigned int p = 0; p < passes.size(); p++)
+	{
+		if (!passes[p].Culled && passes[p].Function)
+		{
+			// The graph lives as long as the game, so its pass
+			// names do too
+			PROFILE_ZONE(passes[p].Name.c_str());
+			passes[p].Function(*this, passes[p].UserData);
+		}
+	}
+}
+
+void FrameGraph::GetSize(int target, unsigned int& width, unsigned int& height)
+{
+	pool.GetSize(targets[target].Desc, width, height);
+}
+
+int FrameGraph::GetCulledCount()
+{
+	int culled = 0;
+	for (unsigned int p = 0; p < passes.size(); p++)
+		if (passes[p].Culled) culled++;
+	return culled;
+}
+
+// --------------------------------------------------------
+// Something like:
+//
+//   Frame graph: 3 passes (0 culled), 2 textures, 3750 KB
+//     0 scene          writes sceneColor depth
+//     1 postProcess    reads sceneColor  writes backBuffer
+//
+//   Target           01  Texture
+//     sceneColor     ##  #0 800x600 RGBA8
+//     backBuffer     .#  imported
+// --------------------------------------------------------
+std::string FrameGraph::Dump()
+{
+	std::string text;
+	char line[256];
+
+	sprintf_s(line, sizeof(line), "Frame graph: %d passes (%d culled), %d textures, %llu KB\n",
+		GetPassCount(), GetCulledCount(), GetTextureCount(), GetMemoryBytes() / 1024);
+	text += line;
+
+	for (unsigned int p = 0; p < passes.size(); p++)
+	{
+		const Pass& pass = passes[p];
+		sprintf_s(line, sizeof(line), "  %2u %-16s", p, pass.Name.c_str());
+		text += line;
+		if (!pass.Reads.empty())
+		{
+			text += " reads";
+			for (unsigned int r = 0; r < pass.Reads.size(); r++)
+				text += " " + targets[pass.Reads[r]].Name;
+		}
+		if (!pass.Writes.empty())
+		{
+			text += " writes";
+			for (unsigned int w = 0; w < pass.Writes.size(); w++)
+				text += " " + targets[pass.Writes[w]].Name;
+		}
+		text += pass.Culled ? "  (culled)\n" : "\n";
+	}
+
+	// One column per pass, # where the target is alive
+	sprintf_s(line, sizeof(line), "\n  %-16s ", "Target");
+	text += line;
+	for (unsigned int p = 0; p < passes.size(); p++)
+		text += (char)('0' + p % 10);
+	text += "  Texture\n";
+
+	for (unsigned int t = 0; t < targets.size(); t++)
+	{
+		const Target& target = targets[t];
+		sprintf_s(line, sizeof(line), "  %-16s ", target.Name.c_str());
+		text += line;
+		for (int p = 0; p < (int)passes.size(); p++)
+			text += (target.FirstPass >= 0 && p >= target.FirstPass && p <= target.LastPass) ? '#' : '.';
+
+		if (target.Imported)
+			sprintf_s(line, sizeof(line), "  imported\n");
+		else if (target.Pooled)
+			sprintf_s(line, sizeof(line), "  #%d %ux%u %s\n", target.Pooled->Index,
+				target.Pooled->Width, target.Pooled->Height, FormatName(target.Pooled->Format));
+		else
+			sprintf_s(line, sizeof(line), "  none\n");
+		text += line;
+	}
+	return text;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <d3d11.h>
+#include <string>
+#include <vector>
+
+#include "RenderTargetPool.h"
+
+class FrameGraph;
+
+// What a pass runs - it finds its targets through the graph
+typedef void (*FramePassFunction)(FrameGraph& graph, void* userData);
+
+// --------------------------------------------------------
+// The frame's rendering as a list of passes, each declaring
+// which targets it reads and writes.
+//
+//   int color = graph->CreateTarget("sceneColor", desc);
+//   int screen = graph->ImportTarget("backBuffer", rtv, 0, 0);
+//   int scene = graph->AddPass("scene", DrawScene, this);
+//   graph->Write(scene, color);
+//   int post = graph->AddPass("post", DrawPost, this);
+//   graph->Read(post, color);
+//   graph->Write(post, screen);
+//   graph->Compile();
+//   ...
+//   graph->Execute();		// every frame
+//
+// Compiling drops passes nothing ends up reading, works out
+// when each created (transient) target is first and last used,
+// and takes them from a RenderTargetPool in pass order, giving
+// each back after its last use.  Targets whose lifetimes don't
+// overlap end up sharing a texture.  Imported targets (the back
+// buffer, the depth buffer) belong to someone else.
+//
+// Resize() rebuilds every transient target at the new size.
+// --------------------------------------------------------
+class FrameGraph
+{
+public:
+	FrameGraph(ID3D11Device* device);
+	~FrameGraph();
+
+	// Targets - both return the target's id
+	int CreateTarget(const std::string& name, const RenderTargetDesc& desc);
+	int ImportTarget(const std::string& name, ID3D11RenderTargetView* rtv, ID3D11ShaderResourceView* srv, ID3D11DepthStencilView* dsv);
+
+	// Imported views change when the window is resized
+	void SetImportedTarget(int target, ID3D11RenderTargetView* rtv, ID3D11ShaderResourceView* srv, ID3D11DepthStencilView* dsv);
+
+	// Passes run in the order they're added
+	int AddPass(const std::string& name, FramePassFunction function, void* userData);
+	void Read(int pass, int target);
+	void Write(int pass, int target);
+
+	// Culls passes and assigns textures - needed after building,
+	// and done again by Resize()
+	void Compile();
+	void Resize(unsigned int width, unsigned int height);
+
+	// Runs the passes that survived compiling
+	void Execute();
+
+	// Views of a target, for the passes (null if it has none)
+	ID3D11RenderTargetView* GetRTV(int target) { return targets[target].RTV; }
+	ID3D11ShaderResourceView* GetSRV(int target) { return targets[target].SRV; }
+	ID3D11DepthStencilView* GetDSV(int target) { return targets[target].DSV; }
+
+	// What a created target works out to at the current size
+	void GetSize(int target, unsigned int& width, unsigned int& height);
+
+	// Passes, targets and their lifetimes, as a table
+	std::string Dump();
+
+	int GetPassCount() { return (int)passes.size(); }
+	int GetCulledCount();
+	int GetTextureCount() { return pool.GetTargetCount(); }
+	unsigned long long GetMemoryBytes() { return pool.GetMemoryBytes(); }
+
+private:
+	struct Target
+	{
+		std::string Name;
+		RenderTargetDesc Desc;
+		bool Imported;
+		RenderTarget* Pooled;	// Transient targets, once compiled
+		ID3D11RenderTargetView* RTV;
+		ID3D11ShaderResourceView* SRV;
+		ID3D11DepthStencilView* DSV;
+		int FirstPass;			// -1 if no pass that runs uses it
+		int LastPass;
+	};
+
+	struct Pass
+	{
+		std::string Name;
+		FramePassFunction Function;
+		void* UserData;
+		std::vector<int> Reads;
+		std::vector<int> Writes;
+		bool Culled;
+	};
+
+	RenderTargetPool pool;
+	std::vector<Target> targets;
+	std::vector<Pass> passes;
+
+	void CullPasses();
+	void FindLifetimes();
+	void AssignTextures();
+	bool Uses(const Pass& pass, int target);
+};
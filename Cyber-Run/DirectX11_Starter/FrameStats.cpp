@@ -0,0 +1,273 @@
+#include "FrameStats.h"
+#include <cmath>
+#include <ctime>
+
+// --------------------------------------------------------
+// Histogram
+// --------------------------------------------------------
+FrameHistogram::FrameHistogram()
+	: counts(BucketCount, 0), count(0), totalUs(0)
+{
+}
+
+// Halves the value until it fits the first SubBucketCount
+// buckets - every halving is another power of two, with half
+// as many new buckets since the bottom half is already covered
+int FrameHistogram::GetBucket(long long us)
+{
+	if (us < SubBucketCount)
+		return us > 0 ? (int)us : 0;
+
+	int shift = 0;
+	while (us >= SubBucketCount)
+	{
+		us >>= 1;
+		shift++;
+	}
+	if (shift > Magnitudes)
+		return BucketCount - 1;
+	return SubBucketCount + (shift - 1) * (SubBucketCount / 2) + (int)(us - SubBucketCount / 2);
+}
+
+long long FrameHistogram::GetBucketTop(int bucket)
+{
+	if (bucket < SubBucketCount)
+		return bucket;
+
+	int shift = (bucket - SubBucketCount) / (SubBucketCount / 2) + 1;
+	long long base = (bucket - SubBucketCount) % (SubBucketCount / 2) + SubBucketCount / 2;
+	return ((base + 1) << shift) - 1;
+}
+
+static long long ToMicroseconds(float ms)
+{
+	return ms > 0 ? (long long)(ms * 1000.0f + 0.5f) : 0;
+}
+
+void FrameHistogram::Record(float ms)
+{
+	long long us = ToMicroseconds(ms);
+	counts[GetBucket(us)]++;
+	count++;
+	totalUs += us;
+}
+
+void FrameHistogram::Remove(float ms)
+{
+	long long us = ToMicroseconds(ms);
+	int bucket = GetBucket(us);
+	if (counts[bucket] == 0)
+		return;
+	counts[bucket]--;
+	count--;
+	totalUs -= us;
+}
+
+void FrameHistogram::Reset()
+{
+	counts.assign(BucketCount, 0);
+	count = 0;
+	totalUs = 0;
+}
+
+float FrameHistogram::GetMeanMs() const
+{
+	return count > 0 ? (float)(totalUs / 1000.0 / count) : 0.0f;
+}
+
+float FrameHistogram::GetPercentileMs(double percentile) const
+{
+	if (count == 0)
+		return 0.0f;
+
+	// The rank'th smallest value, counting from 1
+	long long rank = (long long)ceil(percentile / 100.0 * count);
+	if (rank < 1) rank = 1;
+	if (rank > count) rank = count;
+
+	long long seen = 0;
+	for (int b = 0; b < BucketCount; b++)
+	{
+		seen += counts[b];
+		if (seen >= rank)
+			return GetBucketTop(b) / 1000.0f;
+	}
+	return GetBucketTop(BucketCount - 1) / 1000.0f;
+}
+
+// --------------------------------------------------------
+// Frame stats
+// --------------------------------------------------------
+FrameStats::FrameStats(int windowFrames)
+	: windowFrames(windowFrames > 0 ? windowFrames : 1)
+{
+	windowMs.resize(this->windowFrames * StageCount);
+	Reset();
+}
+
+FrameStats::~FrameStats()
+{
+	CloseCsv();
+}
+
+void FrameStats::Reset()
+{
+	for (int s = 0; s < StageCount; s++)
+	{
+		window[s].Reset();
+		session[s].Reset();
+		stageMs[s] = 0;
+		stageRunning[s] = false;
+	}
+	windowNext = 0;
+	windowCount = 0;
+	frameCount = 0;
+	sessionMs = 0;
+	frameStart = Clock::now();
+}
+
+void FrameStats::BeginStage(Stage stage)
+{
+	stageStart[stage] = Clock::now();
+	stageRunning[stage] = true;
+}
+
+void FrameStats::EndStage(Stage stage)
+{
+	if (!stageRunning[stage])
+		return;
+	stageMs[stage] += std::chrono::duration<float, std::milli>(Clock::now() - stageStart[stage]).count();
+	stageRunning[stage] = false;
+}
+
+void FrameStats::EndFrame()
+{
+	Clock::time_point now = Clock::now();
+	stageMs[StageFrame] = std::chrono::duration<float, std::milli>(now - frameStart).count();
+	frameStart = now;
+
+	AddFrame(stageMs);
+	for (int s = 0; s < StageCount; s++)
+	{
+		stageMs[s] = 0;
+		stageRunning[s] = false;
+	}
+}
+
+// --------------------------------------------------------
+// Into the session, into the window (pushing out its oldest
+// frame once it's full), and out to the CSV
+// --------------------------------------------------------
+void FrameStats::AddFrame(const float ms[StageCount])
+{
+	float* slot = &windowMs[windowNext * StageCount];
+	for (int s = 0; s < StageCount; s++)
+	{
+		session[s].Record(ms[s]);
+		if (windowCount == windowFrames)
+			window[s].Remove(slot[s]);
+		window[s].Record(ms[s]);
+		slot[s] = ms[s];
+	}
+	windowNext = (windowNext + 1) % windowFrames;
+	if (windowCount < windowFrames)
+		windowCount++;
+
+	sessionMs += ms[StageFrame];
+	if (csv.is_open())
+	{
+		csv << frameCount << ',' << sessionMs / 1000.0;
+		for (int s = 0; s < StageCount; s++)
+			csv << ',' << ms[s];
+		csv << '\n';
+	}
+	frameCount++;
+}
+
+FrameStageStats FrameStats::GetStats(const FrameHistogram& histogram)
+{
+	FrameStageStats stats;
+	stats.P50 = histogram.GetPercentileMs(50.0);
+	stats.P95 = histogram.GetPercentileMs(95.0);
+	stats.P99 = histogram.GetPercentileMs(99.0);
+	stats.Max = histogram.GetMaxMs();
+	stats.Mean = histogram.GetMeanMs();
+	stats.Count = histogram.GetCount();
+	return stats;
+}
+
+FrameStageStats FrameStats::GetWindowStats(Stage stage) const
+{
+	return GetStats(window[stage]);
+}
+
+FrameStageStats FrameStats::GetSessionStats(Stage stage) const
+{
+	return GetStats(session[stage]);
+}
+
+// --------------------------------------------------------
+// CSV
+// --------------------------------------------------------
+bool FrameStats::OpenCsv(const std::string& path)
+{
+	CloseCsv();
+	csv.open(path.c_str());
+	if (!csv.is_open())
+		return false;
+
+	csv.setf(std::ios::fixed);
+	csv.precision(3);
+	csv << "frame,time_s";
+	for (int s = 0; s < StageCount; s++)
+		csv << ',' << GetStageName((Stage)s) << "_ms";
+	csv << '\n';
+	return csv.good();
+}
+
+void FrameStats::CloseCsv()
+{
+	if (csv.is_open())
+		csv.close();
+}
+
+bool FrameStats::WriteSummaryCsv(const std::string& path) const
+{
+	std::ofstream file(path.c_str());
+	if (!file.is_open())
+		return false;
+
+	file.setf(std::ios::fixed);
+	file.precision(3);
+	file << "stage,frames,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+	for (int s = 0; s < StageCount; s++)
+	{
+		FrameStageStats stats = GetSessionStats((Stage)s);
+		file << GetStageName((Stage)s) << ',' << stats.Count << ',' << stats.Mean << ',' <<
+			stats.P50 << ',' << stats.P95 << ',' << stats.P99 << ',' << stats.Max << '\n';
+	}
+	return file.good();
+}
+
+std::string FrameStats::MakeSessionPath(const char* prefix)
+{
+	time_t now = time(0);
+	tm local;
+	localtime_s(&local, &now);
+
+	char stamp[32];
+	strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &local);
+	return std::string(prefix) + "_" + stamp + ".csv";
+}
+
+const char* FrameStats::GetStageName(Stage stage)
+{
+	switch (stage)
+	{
+	case StageUpdate:	return "update";
+	case StageSubmit:	return "submit";
+	case StagePresent:	return "present";
+	case StageFrame:	return "frame";
+	default:			return "unknown";
+	}
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// A histogram of durations, bucketed the way HdrHistogram
+// does it - exact to the microsecond under 128 us, then 64
+// buckets per power of two, so every value is kept to within
+// 1/64 of itself from a microsecond to a couple of minutes.
+// Recording is an index calculation and an increment, and
+// values can be removed again, for sliding windows.
+// --------------------------------------------------------
+class FrameHistogram
+{
+public:
+	static const int SubBucketCount = 128;
+	static const int Magnitudes = 20;		// Powers of two above SubBucketCount
+	static const int BucketCount = SubBucketCount + Magnitudes * SubBucketCount / 2;
+
+	FrameHistogram();
+
+	void Record(float ms);
+	void Remove(float ms);
+	void Reset();
+
+	int GetCount() const { return count; }
+	float GetMeanMs() const;
+
+	// The time "percentile" percent of the values are at or
+	// under - the top of that value's bucket, so it never reads
+	// low.  0 when empty.
+	float GetPercentileMs(double percentile) const;
+	float GetMaxMs() const { return GetPercentileMs(100.0); }
+
+	// Which bucket a value lands in, and the largest value that
+	// lands in the same one
+	static int GetBucket(long long us);
+	static long long GetBucketTop(int bucket);
+
+private:
+	std::vector<int> counts;
+	int count;
+	long long totalUs;
+};
+
+// --------------------------------------------------------
+// Percentiles of one stage's times
+// --------------------------------------------------------
+struct FrameStageStats
+{
+	float P50;
+	float P95;
+	float P99;
+	float Max;
+	float Mean;
+	int Count;
+};
+
+// --------------------------------------------------------
+// Frame statistics - every frame's update, submit and present
+// times, and the whole frame's, kept as histograms:
+//
+//   stats->BeginStage(FrameStats::StageUpdate);
+//   UpdateScene(...);
+//   stats->EndStage(FrameStats::StageUpdate);
+//   ...
+//   stats->EndFrame();
+//
+// A frame's time is from one EndFrame() to the next, so it's
+// what the player sees, waits and all.  Stage times add up if
+// a stage runs more than once in a frame, and different
+// stages may be timed on different threads, as long as
+// EndFrame() comes after them all.
+//
+// Percentiles come from the last WindowFrames frames (a
+// sliding window - the oldest frame leaves as each new one
+// comes in) or from the whole session.  With a CSV open,
+// each frame is also written out as a row as it ends.
+// --------------------------------------------------------
+class FrameStats
+{
+public:
+	enum Stage
+	{
+		StageUpdate,	// Simulation
+		StageSubmit,	// Building and sending the frame's GPU work
+		StagePresent,	// Handing the frame to the swap chain
+		StageFrame,		// The whole frame
+		StageCount
+	};
+
+	static const int DefaultWindowFrames = 600;	// 10 seconds at 60 Hz
+
+	FrameStats(int windowFrames = DefaultWindowFrames);
+	~FrameStats();
+
+	// Times part of the current frame.  Ending a stage that
+	// isn't running does nothing.
+	void BeginStage(Stage stage);
+	void EndStage(Stage stage);
+
+	// Records the current frame and starts the next
+	void EndFrame();
+
+	// Records a frame timed some other way.  StageFrame's time
+	// is used as given.
+	void AddFrame(const float ms[StageCount]);
+
+	// Forgets every frame so far, including the window
+	void Reset();
+
+	FrameStageStats GetWindowStats(Stage stage) const;
+	FrameStageStats GetSessionStats(Stage stage) const;
+	const FrameHistogram& GetWindowHistogram(Stage stage) const { return window[stage]; }
+	const FrameHistogram& GetSessionHistogram(Stage stage) const { return session[stage]; }
+
+	int GetFrameCount() const { return frameCount; }
+	int GetWindowFrames() const { return windowFrames; }
+
+	// Starts writing one row per frame to a new file - false if
+	// it can't be created.  Any CSV already open is closed.
+	bool OpenCsv(const std::string& path);
+	void CloseCsv();
+	bool IsCsvOpen() const { return csv.is_open(); }
+
+	// The session's percentiles, one row per stage
+	bool WriteSummaryCsv(const std::string& path) const;
+
+	// "<prefix>_<date>_<time>.csv", for a session's CSV
+	static std::string MakeSessionPath(const char* prefix);
+
+	static const char* GetStageName(Stage stage);
+
+private:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	int windowFrames;
+	FrameHistogram window[StageCount];
+	FrameHistogram session[StageCount];
+
+	// The window's frames, oldest leaving first
+	std::vector<float> windowMs;	// StageCount per frame
+	int windowNext;
+	int windowCount;
+
+	// The frame being timed
+	float stageMs[StageCount];
+	Clock::time_point stageStart[StageCount];
+	bool stageRunning[StageCount];
+	Clock::time_point frameStart;
+
+	int frameCount;
+	double sessionMs;
+	std::ofstream csv;
+
+	static FrameStageStats GetStats(const FrameHistogram& histogram);
+};
@@ -0,0 +1,228 @@
+#include "FrustumCuller.h"
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULL_BATCH 8
+#else
+#include <xmmintrin.h>
+#define CULL_BATCH 4
+#endif
+
+using namespace DirectX;
+
+// Padding objects sit this far away so they are always culled
+static const float FarAway = 1.0e30f;
+
+FrustumCuller::FrustumCuller()
+{
+	count = 0;
+}
+
+FrustumCuller::~FrustumCuller()
+{ }
+
+int FrustumCuller::GetBatchWidth()
+{
+	return CULL_BATCH;
+}
+
+// Room for the batch padding too
+void FrustumCuller::Reserve(int capacity)
+{
+	size_t size = capacity + CULL_BATCH;
+	centerX.reserve(size); centerY.reserve(size); centerZ.reserve(size);
+	extentX.reserve(size); extentY.reserve(size); extentZ.reserve(size);
+	radius.reserve(size);
+}
+
+// --------------------------------------------------------
+// Removes all bounds, but keeps the memory around so a
+// per-frame refill doesn't allocate
+// --------------------------------------------------------
+void FrustumCuller::Clear()
+{
+	count = 0;
+	centerX.clear(); centerY.clear(); centerZ.clear();
+	extentX.clear(); extentY.clear(); extentZ.clear();
+	radius.clear();
+}
+
+// --------------------------------------------------------
+// Adds an axis-aligned box (center + half extents).  The
+// bounding sphere is the one that encloses the box.
+// --------------------------------------------------------
+int FrustumCuller::Add(const XMFLOAT3& center, const XMFLOAT3& extents)
+{
+	// Padding from an earlier cull has to go before adding more
+	centerX.resize(count); centerY.resize(count); centerZ.resize(count);
+	extentX.resize(count); extentY.resize(count); extentZ.resize(count);
+	radius.resize(count);
+
+	centerX.push_back(center.x);
+	centerY.push_back(center.y);
+	centerZ.push_back(center.z);
+	extentX.push_back(extents.x);
+	extentY.push_back(extents.y);
+	extentZ.push_back(extents.z);
+	radius.push_back(sqrtf(extents.x * extents.x + extents.y * extents.y + extents.z * extents.z));
+	return count++;
+}
+
+// --------------------------------------------------------
+// Pads the arrays to a multiple of the batch width with
+// objects that can never be visible
+// --------------------------------------------------------
+void FrustumCuller::PadToBatch()
+{
+	while (centerX.size() % CULL_BATCH != 0)
+	{
+		centerX.push_back(FarAway); centerY.push_back(FarAway); centerZ.push_back(FarAway);
+		extentX.push_back(0); extentY.push_back(0); extentZ.push_back(0);
+		radius.push_back(0);
+	}
+}
+
+// --------------------------------------------------------
+// Reference version - one object and one plane at a time
+// --------------------------------------------------------
+int FrustumCuller::CullScalar(const XMFLOAT4 planes[6], std::vector<int>& visible)
+{
+	visible.clear();
+	for (int i = 0; i < count; i++)
+	{
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; p++)
+		{
+			// Same order of operations as the SIMD versions, so both agree exactly
+			float dist =
+				(planes[p].x * centerX[i] + planes[p].y * centerY[i]) +
+				(planes[p].z * centerZ[i] + planes[p].w);
+
+			// Closest of the two bounding volumes along the plane normal
+			float boxRadius =
+				fabsf(planes[p].x) * extentX[i] +
+				fabsf(planes[p].y) * extentY[i] +
+				fabsf(planes[p].z) * extentZ[i];
+			float r = fminf(boxRadius, radius[i]);
+
+			inside = dist >= -r;
+		}
+
+		if (inside)
+			visible.push_back(i);
+	}
+	return (int)visible.size();
+}
+
+#if defined(__AVX__)
+
+// --------------------------------------------------------
+// AVX version - eight objects per iteration
+// --------------------------------------------------------
+int FrustumCuller::Cull(const XMFLOAT4 planes[6], std::vector<int>& visible)
+{
+	visible.clear();
+	if (count == 0) return 0;
+	PadToBatch();
+
+	__m256 signMask = _mm256_set1_ps(-0.0f);
+	for (int i = 0; i < count; i += 8)
+	{
+		__m256 cx = _mm256_loadu_ps(&centerX[i]);
+		__m256 cy = _mm256_loadu_ps(&centerY[i]);
+		__m256 cz = _mm256_loadu_ps(&centerZ[i]);
+		__m256 ex = _mm256_loadu_ps(&extentX[i]);
+		__m256 ey = _mm256_loadu_ps(&extentY[i]);
+		__m256 ez = _mm256_loadu_ps(&extentZ[i]);
+		__m256 rad = _mm256_loadu_ps(&radius[i]);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m256 nx = _mm256_set1_ps(planes[p].x);
+			__m256 ny = _mm256_set1_ps(planes[p].y);
+			__m256 nz = _mm256_set1_ps(planes[p].z);
+
+			__m256 dist = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(nx, cx), _mm256_mul_ps(ny, cy)),
+				_mm256_add_ps(_mm256_mul_ps(nz, cz), _mm256_set1_ps(planes[p].w)));
+
+			__m256 boxRadius = _mm256_add_ps(
+				_mm256_add_ps(
+					_mm256_mul_ps(_mm256_andnot_ps(signMask, nx), ex),
+					_mm256_mul_ps(_mm256_andnot_ps(signMask, ny), ey)),
+				_mm256_mul_ps(_mm256_andnot_ps(signMask, nz), ez));
+			__m256 r = _mm256_min_ps(boxRadius, rad);
+
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, _mm256_xor_ps(r, signMask), _CMP_GE_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+		while (mask)
+		{
+			int lane = 0;
+			while (!(mask & (1 << lane))) lane++;
+			mask &= mask - 1;
+			if (i + lane < count)
+				visible.push_back(i + lane);
+		}
+	}
+	return (int)visible.size();
+}
+
+#else
+
+// --------------------------------------------------------
+// SSE version - four objects per iteration
+// --------------------------------------------------------
+int FrustumCuller::Cull(const XMFLOAT4 planes[6], std::vector<int>& visible)
+{
+	visible.clear();
+	if (count == 0) return 0;
+	PadToBatch();
+
+	__m128 signMask = _mm_set1_ps(-0.0f);
+	__m128 zero = _mm_setzero_ps();
+	for (int i = 0; i < count; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(&centerX[i]);
+		__m128 cy = _mm_loadu_ps(&centerY[i]);
+		__m128 cz = _mm_loadu_ps(&centerZ[i]);
+		__m128 ex = _mm_loadu_ps(&extentX[i]);
+		__m128 ey = _mm_loadu_ps(&extentY[i]);
+		__m128 ez = _mm_loadu_ps(&extentZ[i]);
+		__m128 rad = _mm_loadu_ps(&radius[i]);
+
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 nx = _mm_set1_ps(planes[p].x);
+			__m128 ny = _mm_set1_ps(planes[p].y);
+			__m128 nz = _mm_set1_ps(planes[p].z);
+
+			__m128 dist = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+				_mm_add_ps(_mm_mul_ps(nz, cz), _mm_set1_ps(planes[p].w)));
+
+			__m128 boxRadius = _mm_add_ps(
+				_mm_add_ps(
+					_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex),
+					_mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)),
+				_mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+			__m128 r = _mm_min_ps(boxRadius, rad);
+
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, _mm_xor_ps(r, signMask)));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if ((mask & (1 << lane)) && i + lane < count)
+				visible.push_back(i + lane);
+		}
+	}
+	return (int)visible.size();
+}
+
+#endif
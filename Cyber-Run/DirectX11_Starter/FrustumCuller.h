@@ -0,0 +1,47 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// --------------------------------------------------------
+// Batched view-frustum culling.  Bounds are stored as
+// structure-of-arrays (center, box extents and sphere radius)
+// and tested against all six planes several objects at a time:
+// 8 per instruction with AVX, 4 with SSE.
+//
+// An object is rejected if either its bounding sphere or its
+// bounding box is fully outside any plane.
+// --------------------------------------------------------
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+	~FrustumCuller();
+
+	// Number of objects handled per SIMD instruction
+	static int GetBatchWidth();
+
+	// Adding bounds - returns the index used in the visible list.
+	// Reserve() makes room for that many up front.
+	void Reserve(int capacity);
+	void Clear();
+	int Add(const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents);
+	int GetCount() { return count; }
+
+	// Tests every object against the planes (see Camera::GetFrustumPlanes)
+	// and writes the indices of the visible ones into "visible"
+	int Cull(const DirectX::XMFLOAT4 planes[6], std::vector<int>& visible);
+
+	// One object at a time - used as a reference by the benchmark
+	int CullScalar(const DirectX::XMFLOAT4 planes[6], std::vector<int>& visible);
+
+private:
+	int count;
+
+	// Bounds data (structure-of-arrays for SIMD)
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	std::vector<float> radius;
+
+	void PadToBatch();
+};
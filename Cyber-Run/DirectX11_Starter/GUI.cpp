@@ -1,6 +1,7 @@
 #include "GUI.h"
 
 #include "Vertex.h"
+#include "MemoryTracker.h"
 #include "WICTextureLoader.h"
 
 #include <iostream>
@@ -10,8 +11,14 @@ GUI* GUI::instance = nullptr;
 
 ID3D11Device* GUI::device;
 ID3D11DeviceContext* GUI::deviceContext;
+StateCache* GUI::stateCache;
+PipelineCache* GUI::pipelineCache;
 
 SpriteBatch* GUI::spriteBatch;
+ID3D11BlendState* GUI::spriteBlend;
+ID3D11SamplerState* GUI::spriteSampler;
+ID3D11DepthStencilState* GUI::spriteDepth;
+ID3D11RasterizerState* GUI::spriteRaster;
 std::map<std::string, SpriteFont*> GUI::fonts;
 
 std::map<std::string, ID3D11ShaderResourceView*> GUI::images;
@@ -20,14 +27,16 @@ SimpleVertexShader* GUI::pixelVS;
 SimplePixelShader* GUI::pixelPS;
 
 ID3D11SamplerState* GUI::sampler;
+unsigned int GUI::imagePipeline;
 
 Mesh* GUI::mesh;
 
 
 // methods
-void GUI::Create(ID3D11Device *device, ID3D11DeviceContext *deviceContext) {
+void GUI::Create(ID3D11Device *device, ID3D11DeviceContext *deviceContext, StateCache *stateCache, PipelineCache *pipelineCache) {
+	MEMORY_TAG(MemoryTracker::TagGui);
 	if (instance == nullptr) {
-		instance = new GUI(device, deviceContext);
+		instance = new GUI(device, deviceContext, stateCache, pipelineCache);
 	}
 }
 
@@ -39,12 +48,15 @@ void GUI::Destroy() {
 }
 
 
-GUI::GUI(ID3D11Device *device, ID3D11DeviceContext *deviceContext) {
+GUI::GUI(ID3D11Device *device, ID3D11DeviceContext *deviceContext, StateCache *stateCache, PipelineCache *pipelineCache) {
 	this->device = device;
 	this->deviceContext = deviceContext;
+	this->stateCache = stateCache;
+	this->pipelineCache = pipelineCache;
 
 	// fonts
 	spriteBatch = new SpriteBatch(deviceContext);
+	CreateSpriteStates();
 
 	fonts[std::string("courier")] = new SpriteFont(device, L"fonts/courier.spritefont");
 	fonts[std::string("fixedsys")] = new SpriteFont(device, L"fonts/fixedsys.spritefont");
@@ -59,22 +71,73 @@ GUI::~GUI() {
 	for (std::map<std::string, SpriteFont*>::iterator it = fonts.begin(); it != fonts.end(); it++) {
 		delete it->second;
 	}
+	fonts.clear();
 
 	for (std::map<std::string, ID3D11ShaderResourceView*>::iterator it = images.begin(); it != images.end(); it++) {
 		it->second->Release();	
 	}
+	images.clear();
 
+	delete pixelVS;
+	delete pixelPS;
 	delete mesh;
 }
 
 
 // draw text to the screen
 void GUI::BeginStringDraw() {
-	spriteBatch->Begin();
+	spriteBatch->Begin(SpriteSortMode_Deferred, spriteBlend, spriteSampler, spriteDepth, spriteRaster);
+}
+
+// SpriteBatch's default states - premultiplied alpha, linear clamp,
+// no depth and counter-clockwise culling - made by the pipeline
+// cache, so they're shared with anything else that wants them
+void GUI::CreateSpriteStates() {
+	D3D11_BLEND_DESC blendDesc = {};
+	blendDesc.RenderTarget[0].BlendEnable = true;
+	blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_ONE;
+	blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+	blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+	blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+	blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+	blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+	blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+	spriteBlend = pipelineCache->GetBlendState(pipelineCache->AddBlendState(blendDesc));
+
+	D3D11_SAMPLER_DESC samplerDesc = {};
+	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.MaxAnisotropy = D3D11_MAX_MAXANISOTROPY;
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	samplerDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
+	spriteSampler = pipelineCache->GetSamplerState(pipelineCache->AddSamplerState(samplerDesc));
+
+	D3D11_DEPTH_STENCIL_DESC depthDesc = {};
+	depthDesc.DepthEnable = false;
+	depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+	depthDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
+	depthDesc.FrontFace.StencilFailOp = D3D11_STENCIL_OP_KEEP;
+	depthDesc.FrontFace.StencilDepthFailOp = D3D11_STENCIL_OP_KEEP;
+	depthDesc.FrontFace.StencilPassOp = D3D11_STENCIL_OP_KEEP;
+	depthDesc.FrontFace.StencilFunc = D3D11_COMPARISON_ALWAYS;
+	depthDesc.BackFace = depthDesc.FrontFace;
+	spriteDepth = pipelineCache->GetDepthStencilState(pipelineCache->AddDepthStencilState(depthDesc));
+
+	D3D11_RASTERIZER_DESC rastDesc = {};
+	rastDesc.CullMode = D3D11_CULL_BACK;
+	rastDesc.FillMode = D3D11_FILL_SOLID;
+	rastDesc.DepthClipEnable = true;
+	rastDesc.MultisampleEnable = true;
+	spriteRaster = pipelineCache->GetRasterizerState(pipelineCache->AddRasterizerState(rastDesc));
 }
 
 void GUI::EndStringDraw() {
 	spriteBatch->End();
+
+	// SpriteBatch sets its own shaders and states directly
+	stateCache->Invalidate();
 }
 
 void GUI::DrawString(const char *font, int x, int y, const wchar_t *msg) {
@@ -83,6 +146,13 @@ void GUI::DrawString(const char *font, int x, int y, const wchar_t *msg) {
 	sprite->DrawString(spriteBatch, msg, XMFLOAT2(x, y));
 }
 
+// pixels from one line of text to the next
+int GUI::GetLineSpacing(const char *font) {
+	SpriteFont *sprite = fonts[std::string(font)];
+
+	return (int)(sprite->GetLineSpacing() + 0.5f);
+}
+
 
 // draw image to screen
 void GUI::LoadImages() {
@@ -101,7 +171,11 @@ void GUI::LoadImages() {
     samplerDesc.Filter = D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT;
     samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
 
-    device->CreateSamplerState(&samplerDesc, &sampler);
+    sampler = pipelineCache->GetSamplerState(pipelineCache->AddSamplerState(samplerDesc));
+
+	// Images draw with default states, whatever came before
+	PipelineDesc pipeline = { pixelVS, pixelPS, 0, 0, 0 };
+	imagePipeline = pipelineCache->AddPipeline(pipeline);
 
 	// image mesh
 	Vertex verts[] = {
@@ -141,12 +215,13 @@ void GUI::DrawImage(const char *imageName, int x, int y, int w, int h) {
 	XMStoreFloat4x4(&worldMatrix, XMMatrixTranspose(sc * trans));
 
 
-	pixelVS->SetMatrix4x4("world", worldMatrix);
+	pixelVS->SetMatrix4x4("world"_sn, worldMatrix);
 	pixelPS->SetSamplerState("samplerState", sampler);
 	pixelPS->SetShaderResourceView("image", images[std::string(imageName)]);
 
-	pixelVS->SetShader(true);
-	pixelPS->SetShader(true);
+	pipelineCache->Bind(stateCache, imagePipeline);
+	pixelVS->CopyAllBufferData();
+	pixelPS->CopyAllBufferData();
 
-	mesh->Draw(deviceContext, false);
+	mesh->Draw(stateCache);
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <string>
 
 #include "SimpleShader.h"
+#include "PipelineCache.h"
 #include "Mesh.h"
 
 #include <SpriteFont.h>
@@ -11,12 +12,13 @@ using namespace DirectX;
 
 class GUI {
 public:
-	static void Create(ID3D11Device*, ID3D11DeviceContext*);
+	static void Create(ID3D11Device*, ID3D11DeviceContext*, StateCache*, PipelineCache*);
 	static void Destroy();
 
 	static void BeginStringDraw();
 	static void EndStringDraw();
 	static void DrawString(const char*, int, int, const wchar_t*);
+	static int GetLineSpacing(const char*);
 
 	static void DrawImage(const char*, int, int, int, int);
 
@@ -24,7 +26,7 @@ private:
 	// singleton stuff
 	static GUI *instance;
 
-	GUI(ID3D11Device*, ID3D11DeviceContext*);
+	GUI(ID3D11Device*, ID3D11DeviceContext*, StateCache*, PipelineCache*);
 	~GUI();
 	GUI(GUI const&);
 	void operator=(GUI const&);
@@ -32,19 +34,30 @@ private:
 	// device stuff
 	static ID3D11Device *device;
 	static ID3D11DeviceContext *deviceContext;
+	static StateCache *stateCache;
+	static PipelineCache *pipelineCache;
 
 	// font stuff
 	static SpriteBatch *spriteBatch;
+
+	// SpriteBatch's states, from the pipeline cache instead of
+	// its own (same settings as its defaults)
+	static ID3D11BlendState *spriteBlend;
+	static ID3D11SamplerState *spriteSampler;
+	static ID3D11DepthStencilState *spriteDepth;
+	static ID3D11RasterizerState *spriteRaster;
 	static std::map<std::string, SpriteFont*> fonts;
 
 	// image stuff
 	static std::map<std::string, ID3D11ShaderResourceView*> images;
 	static void LoadImages();
+	static void CreateSpriteStates();
 
 	static SimpleVertexShader *pixelVS;
 	static SimplePixelShader *pixelPS;
 
 	static ID3D11SamplerState *sampler;
+	static unsigned int imagePipeline;
 
 	static Mesh *mesh;
 };
\ No newline at end of file
@@ -33,10 +33,25 @@ void GameEntity::UpdateWorldMatrix()
 	XMStoreFloat4x4(&worldMatrix, XMMatrixTranspose(total));
 }
 
-void GameEntity::Draw(ID3D11DeviceContext * deviceContext, XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix)
+// Transforms the mesh's bounding box into a world space box
+void GameEntity::GetWorldBounds(XMFLOAT3& center, XMFLOAT3& extents)
 {
 	UpdateWorldMatrix();
-	material->getVert()->SetMatrix4x4("world", worldMatrix);
-	material->prepareMaterial(viewMatrix, projectionMatrix);
-	mesh->Draw(deviceContext,skyBox);
-}
\ No newline at end of file
+
+	// Stored transposed for HLSL, so flip it back first
+	XMMATRIX world = XMMatrixTranspose(XMLoadFloat4x4(&worldMatrix));
+	XMFLOAT3 localCenter = mesh->GetBoundsCenter();
+	XMFLOAT3 localExtents = mesh->GetBoundsExtents();
+
+	// Each world axis extent is the sum of the absolute
+	// contributions of the rotated and scaled local extents
+	XMVECTOR e = XMLoadFloat3(&localExtents);
+	XMVECTOR worldExtents =
+		XMVectorAbs(world.r[0]) * XMVectorSplatX(e) +
+		XMVectorAbs(world.r[1]) * XMVectorSplatY(e) +
+		XMVectorAbs(world.r[2]) * XMVectorSplatZ(e);
+
+	XMStoreFloat3(&center, XMVector3TransformCoord(XMLoadFloat3(&localCenter), world));
+	XMStoreFloat3(&extents, worldExtents);
+}
+
@@ -22,8 +22,11 @@ public:
 	DirectX::XMFLOAT3 position;
 
 	Mesh* GetMesh() { return mesh; }
+	Material* GetMaterial() { return material; }
+	DirectX::XMFLOAT3 GetScale() { return scale; }
 	DirectX::XMFLOAT4X4* GetWorldMatrix() { return &worldMatrix; }
-	void Draw(ID3D11DeviceContext * deviceContext, XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix);
+	void GetWorldBounds(DirectX::XMFLOAT3& center, DirectX::XMFLOAT3& extents);
+	bool IsSky() { return skyBox; }
 private:
 
 	Mesh* mesh;
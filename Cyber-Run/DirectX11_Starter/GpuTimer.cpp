@@ -0,0 +1,92 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer(ID3D11Device* device, ID3D11DeviceContext* context)
+	: context(context), current(0), recording(false), lastMs(-1.0f), droppedCount(0)
+{
+	D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+	D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+	for (int i = 0; i < FrameCount; i++)
+	{
+		frames[i].Disjoint = 0;
+		frames[i].Start = 0;
+		frames[i].End = 0;
+		frames[i].Pending = false;
+		device->CreateQuery(&disjointDesc, &frames[i].Disjoint);
+		device->CreateQuery(&timestampDesc, &frames[i].Start);
+		device->CreateQuery(&timestampDesc, &frames[i].End);
+	}
+}
+
+GpuTimer::~GpuTimer()
+{
+	for (int i = 0; i < FrameCount; i++)
+	{
+		if (frames[i].Disjoint) frames[i].Disjoint->Release();
+		if (frames[i].Start) frames[i].Start->Release();
+		if (frames[i].End) frames[i].End->Release();
+	}
+}
+
+// --------------------------------------------------------
+// Starts timing into the next free set of queries.  If the GPU
+// is so far behind that it hasn't finished with them, this
+// frame just isn't timed.
+// --------------------------------------------------------
+void GpuTimer::BeginFrame()
+{
+	Frame& frame = frames[current];
+	recording = !frame.Pending && frame.Disjoint && frame.Start && frame.End;
+	if (!recording)
+	{
+		droppedCount++;
+		return;
+	}
+
+	context->Begin(frame.Disjoint);
+	context->End(frame.Start);
+}
+
+bool GpuTimer::EndFrame()
+{
+	if (recording)
+	{
+		Frame& frame = frames[current];
+		context->End(frame.End);
+		context->End(frame.Disjoint);
+		frame.Pending = true;
+		current = (current + 1) % FrameCount;
+	}
+	recording = false;
+
+	return Collect();
+}
+
+// --------------------------------------------------------
+// Reads back finished frames, oldest first, stopping at the
+// first that isn't ready - the ones after it won't be either
+// --------------------------------------------------------
+bool GpuTimer::Collect()
+{
+	bool collected = false;
+	for (int i = 0; i < FrameCount; i++)
+	{
+		Frame& frame = frames[(current + i) % FrameCount];
+		if (!frame.Pending)
+			continue;
+
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+		UINT64 start, end;
+		if (context->GetData(frame.Disjoint, &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+			context->GetData(frame.Start, &start, sizeof(start), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+			context->GetData(frame.End, &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+			break;
+
+		frame.Pending = false;
+		if (!disjoint.Disjoint && disjoint.Frequency > 0 && end >= start)
+		{
+			lastMs = (float)((double)(end - start) * 1000.0 / (double)disjoint.Frequency);
+			collected = true;
+		}
+	}
+	return collected;
+}
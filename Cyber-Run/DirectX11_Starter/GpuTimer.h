@@ -0,0 +1,56 @@
+#pragma once
+
+#include <d3d11.h>
+
+// --------------------------------------------------------
+// Measures how long the GPU spends on each frame, with
+// timestamp queries.
+//
+//   timer->BeginFrame();
+//   ... draw ...
+//   if (timer->EndFrame())
+//       float ms = timer->GetLastMs();
+//
+// Results come back a few frames late, so each frame gets its
+// own set of queries from a small ring, and EndFrame() picks
+// up whichever older frames have finished without waiting on
+// them.  Frames where the GPU's clock wasn't steady (the
+// disjoint query says so) are skipped.
+// --------------------------------------------------------
+class GpuTimer
+{
+public:
+	static const int FrameCount = 4;
+
+	GpuTimer(ID3D11Device* device, ID3D11DeviceContext* context);
+	~GpuTimer();
+
+	void BeginFrame();
+
+	// True if an older frame's time came back
+	bool EndFrame();
+
+	// The newest finished frame's time, or -1 before there is one
+	float GetLastMs() { return lastMs; }
+
+	// Frames skipped because the ring was still busy
+	int GetDroppedCount() { return droppedCount; }
+
+private:
+	struct Frame
+	{
+		ID3D11Query* Disjoint;
+		ID3D11Query* Start;
+		ID3D11Query* End;
+		bool Pending;
+	};
+
+	ID3D11DeviceContext* context;
+	Frame frames[FrameCount];
+	int current;
+	bool recording;
+	float lastMs;
+	int droppedCount;
+
+	bool Collect();
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+// --------------------------------------------------------
+// The game's controls for a single frame.  Filled from the
+// keyboard, or by the AutoPlayer when it is driving.
+// --------------------------------------------------------
+struct InputState
+{
+	bool Left;		// A - change lane on release
+	bool Right;		// D - change lane on release
+	bool Jump;		// W - jump, and stay airborne while held
+	bool Duck;		// S - duck while held
+	bool Restart;	// P - play again after a game over
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// Per-instance data for instanced draws - has to match the
+// INSTANCE_ inputs of InstancedVS.hlsl
+// --------------------------------------------------------
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 World;			// Transposed, like the constant buffer path
+	DirectX::XMFLOAT4X4 WorldViewProj;	// Also transposed
+	DirectX::XMFLOAT3 Tint;				// This group's mix of the bloom colors
+};
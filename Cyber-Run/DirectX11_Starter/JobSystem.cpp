@@ -0,0 +1,390 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <xmmintrin.h>
+
+// Which worker the current thread is - the thread that creates
+// the system is worker 0, and -1 means it isn't a worker
+static thread_local int workerIndex = -1;
+
+// Failed attempts to find work before an idle worker starts sleeping
+static const int SpinsBeforeSleep = 256;
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ WORK STEALING QUEUE -------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+WorkStealingQueue::WorkStealingQueue()
+{
+	top.store(0);
+	bottom.store(0);
+	for (unsigned int i = 0; i < Capacity; i++)
+		jobs[i].store(0, std::memory_order_relaxed);
+}
+
+// --------------------------------------------------------
+// Adds a job at the bottom - only called by the owner
+// Returns false if the queue is full
+// --------------------------------------------------------
+bool WorkStealingQueue::Push(Job* job)
+{
+	int b = bottom.load(std::memory_order_relaxed);
+	int t = top.load(std::memory_order_acquire);
+	if (b - t >= (int)Capacity)
+		return false;
+
+	jobs[b & (Capacity - 1)].store(job, std::memory_order_relaxed);
+
+	// Make sure the job is visible before the new bottom is
+	bottom.store(b + 1, std::memory_order_release);
+	return true;
+}
+
+// --------------------------------------------------------
+// Takes the most recently pushed job - only called by the owner
+// --------------------------------------------------------
+Job* WorkStealingQueue::Pop()
+{
+	int b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int t = top.load(std::memory_order_relaxed);
+
+	// Empty - put bottom back
+	if (t > b)
+	{
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return 0;
+	}
+
+	Job* job = jobs[b & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (t != b)
+	{
+		// More than one job left, so no thief can be racing us for this one
+		return job;
+	}
+
+	// Last job - race any thieves for it
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		job = 0;
+
+	bottom.store(b + 1, std::memory_order_relaxed);
+	return job;
+}
+
+// --------------------------------------------------------
+// Takes the oldest job - called by other workers
+// --------------------------------------------------------
+Job* WorkStealingQueue::Steal()
+{
+	int t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int b = bottom.load(std::memory_order_acquire);
+
+	if (t >= b)
+		return 0;
+
+	Job* job = jobs[t & (Capacity - 1)].load(std::memory_order_relaxed);
+
+	// Someone else (the owner or another thief) got there first
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return 0;
+
+	return job;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ JOB SYSTEM ----------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+// --------------------------------------------------------
+// Creates the workers.  The calling thread becomes worker 0,
+// every other worker gets its own thread.
+// --------------------------------------------------------
+JobSystem::JobSystem(int _workerCount)
+{
+	workerCount = _workerCount;
+	if (workerCount <= 0)
+		workerCount = (int)std::thread::hardware_concurrency();
+	if (workerCount <= 0)
+		workerCount = 1;
+
+	// Workers and jobs are cache line aligned, which operator new
+	// doesn't promise, so they're placed in aligned blocks by hand
+	// (_mm_malloc is there on MSVC, GCC and Clang alike)
+	workers = (Worker*)_mm_malloc(sizeof(Worker) * workerCount, CacheLineSize);
+	if (workers == 0)
+		throw std::bad_alloc();
+	for (int i = 0; i < workerCount; i++)
+	{
+		new (&workers[i]) Worker();
+		workers[i].JobPool = (Job*)_mm_malloc(sizeof(Job) * MaxJobCount, CacheLineSize);
+		if (workers[i].JobPool == 0)
+			throw std::bad_alloc();
+		for (unsigned int j = 0; j < MaxJobCount; j++)
+			new (&workers[i].JobPool[j]) Job();
+		workers[i].AllocatedJobs = 0;
+		workers[i].RandomSeed = 2166136261u ^ (unsigned int)i;
+	}
+
+	workerIndex = 0;
+	running.store(true);
+	for (int i = 1; i < workerCount; i++)
+		threads.push_back(std::thread(&JobSystem::WorkerThread, this, i));
+}
+
+// --------------------------------------------------------
+// Stops and joins the worker threads
+// --------------------------------------------------------
+JobSystem::~JobSystem()
+{
+	running.store(false);
+	for (unsigned int i = 0; i < threads.size(); i++)
+		threads[i].join();
+
+	// Jobs and workers are trivially destructible apart from the queue
+	for (int i = 0; i < workerCount; i++)
+	{
+		_mm_free(workers[i].JobPool);
+		workers[i].~Worker();
+	}
+	_mm_free(workers);
+}
+
+int JobSystem::GetWorkerIndex()
+{
+	return workerIndex;
+}
+
+// --------------------------------------------------------
+// The calling thread's worker.  A thread that isn't one would
+// be sharing worker 0's queue with its owner, unsynchronised.
+// --------------------------------------------------------
+JobSystem::Worker& JobSystem::GetCallingWorker()
+{
+	assert(workerIndex >= 0 && workerIndex < workerCount && "Jobs can only be used from worker threads");
+	return workers[workerIndex];
+}
+
+// --------------------------------------------------------
+// Grabs the next job from the calling worker's ring of jobs.
+// No locking needed since only the owner allocates from it.
+// --------------------------------------------------------
+Job* JobSystem::AllocateJob()
+{
+	Worker& worker = GetCallingWorker();
+	unsigned int index = worker.AllocatedJobs++;
+	return &worker.JobPool[index & (MaxJobCount - 1)];
+}
+
+Job* JobSystem::CreateJob(JobFunction function)
+{
+	return CreateJobAsChild(0, function, 0, 0);
+}
+
+Job* JobSystem::CreateJob(JobFunction function, const void* data, size_t size)
+{
+	return CreateJobAsChild(0, function, data, size);
+}
+
+Job* JobSystem::CreateJobAsChild(Job* parent, JobFunction function)
+{
+	return CreateJobAsChild(parent, function, 0, 0);
+}
+
+// --------------------------------------------------------
+// Creates a job whose parent won't finish until this one has.
+// Up to sizeof(Job::Data) bytes of data are copied into the
+// job - anything bigger has to be passed by pointer.
+// --------------------------------------------------------
+Job* JobSystem::CreateJobAsChild(Job* parent, JobFunction function, const void* data, size_t size)
+{
+	assert(size <= sizeof(Job::Data) && "Job data doesn't fit in the job");
+
+	if (parent)
+		parent->UnfinishedJobs.fetch_add(1);
+
+	Job* job = AllocateJob();
+	job->Function = function;
+	job->Parent = parent;
+	job->UnfinishedJobs.store(1);
+
+	if (data && size > 0 && size <= sizeof(job->Data))
+		memcpy(job->Data, data, size);
+
+	return job;
+}
+
+// --------------------------------------------------------
+// Queues a job on the calling worker.  If the queue is full
+// the job just runs right away.
+// --------------------------------------------------------
+void JobSystem::Run(Job* job)
+{
+	if (!GetCallingWorker().Queue.Push(job))
+		Execute(job);
+}
+
+bool JobSystem::IsFinished(const Job* job)
+{
+	return job->UnfinishedJobs.load() == 0;
+}
+
+// --------------------------------------------------------
+// Keeps running other jobs until the given one is finished,
+// so waiting never leaves a worker idle
+// --------------------------------------------------------
+void JobSystem::Wait(const Job* job)
+{
+	while (!IsFinished(job))
+	{
+		Job* next = GetJob();
+		if (next)
+			Execute(next);
+		else
+			std::this_thread::yield();
+	}
+}
+
+// --------------------------------------------------------
+// Finds work: our own queue first, then steal from a random
+// other worker
+// --------------------------------------------------------
+Job* JobSystem::GetJob()
+{
+	Worker& worker = GetCallingWorker();
+
+	Job* job = worker.Queue.Pop();
+	if (job)
+		return job;
+
+	if (workerCount == 1)
+		return 0;
+
+	// Cheap xorshift to pick who to steal from
+	worker.RandomSeed ^= worker.RandomSeed << 13;
+	worker.RandomSeed ^= worker.RandomSeed >> 17;
+	worker.RandomSeed ^= worker.RandomSeed << 5;
+	int victim = (int)(worker.RandomSeed % (unsigned int)workerCount);
+	if (victim == workerIndex)
+		return 0;
+
+	return workers[victim].Queue.Steal();
+}
+
+void JobSystem::Execute(Job* job)
+{
+	// Jobs without a function just group their children
+	if (job->Function)
+		job->Function(job, job->Data);
+	Finish(job);
+}
+
+// --------------------------------------------------------
+// Marks one unit of a job as done, and passes completion up
+// to the parent once the job and all of its children are done
+// --------------------------------------------------------
+void JobSystem::Finish(Job* job)
+{
+	int unfinished = job->UnfinishedJobs.fetch_sub(1) - 1;
+	if (unfinished == 0 && job->Parent)
+		Finish(job->Parent);
+}
+
+// --------------------------------------------------------
+// Background worker loop
+// --------------------------------------------------------
+void JobSystem::WorkerThread(int index)
+{
+	workerIndex = index;
+
+#ifdef PROFILER_ENABLED
+	char name[32];
+	sprintf_s(name, sizeof(name), "Worker %d", index);
+	PROFILE_THREAD(name);
+#endif
+
+	int idleSpins = 0;
+	while (running.load(std::memory_order_relaxed))
+	{
+		Job* job = GetJob();
+		if (job)
+		{
+			Execute(job);
+			idleSpins = 0;
+		}
+		else if (++idleSpins < SpinsBeforeSleep)
+		{
+			std::this_thread::yield();
+		}
+		else
+		{
+			// Nothing to do for a while - stop burning the core
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ PARALLEL FOR --------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+// Everything a ParallelFor job needs, copied into the job itself
+struct ParallelForData
+{
+	JobSystem* System;
+	ParallelForFunction Function;
+	void* UserData;
+	int Start;
+	int End;
+	int SplitSize;
+};
+
+// --------------------------------------------------------
+// Splits the range in half as children until it's small
+// enough, then does the work
+// --------------------------------------------------------
+static void ParallelForJob(Job* job, const void* rawData)
+{
+	const ParallelForData* data = (const ParallelForData*)rawData;
+	int count = data->End - data->Start;
+
+	if (count > data->SplitSize)
+	{
+		int middle = data->Start + count / 2;
+
+		ParallelForData left = *data;
+		left.End = middle;
+		ParallelForData right = *data;
+		right.Start = middle;
+
+		data->System->Run(data->System->CreateJobAsChild(job, ParallelForJob, &left, sizeof(left)));
+		data->System->Run(data->System->CreateJobAsChild(job, ParallelForJob, &right, sizeof(right)));
+	}
+	else
+	{
+		data->Function(data->Start, data->End, data->UserData);
+	}
+}
+
+void JobSystem::ParallelFor(int count, int splitSize, ParallelForFunction function, void* userData)
+{
+	if (count <= 0)
+		return;
+
+	ParallelForData data;
+	data.System = this;
+	data.Function = function;
+	data.UserData = userData;
+	data.Start = 0;
+	data.End = count;
+	data.SplitSize = splitSize > 0 ? splitSize : 1;
+
+	Job* root = CreateJob(ParallelForJob, &data, sizeof(data));
+	Run(root);
+	Wait(root);
+}
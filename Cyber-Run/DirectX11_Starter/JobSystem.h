@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+struct Job;
+
+// Signature of the function a job runs - "data" points at
+// the bytes that were copied in when the job was created
+typedef void (*JobFunction)(Job* job, const void* data);
+
+// Signature for ParallelFor work - handles [start, end)
+typedef void (*ParallelForFunction)(int start, int end, void* userData);
+
+static const size_t CacheLineSize = 64;
+
+// --------------------------------------------------------
+// A single unit of work.  Exactly one cache line, so workers
+// touching neighbouring jobs don't share lines.  A job isn't
+// finished until all of its children are finished too.
+//
+// Data is 8 byte aligned, so payloads holding pointers and
+// doubles can be read straight out of it.
+// --------------------------------------------------------
+struct alignas(CacheLineSize) Job
+{
+	JobFunction Function;
+	Job* Parent;
+	std::atomic<int> UnfinishedJobs;
+	alignas(8) char Data[40];
+};
+static_assert(sizeof(Job) == CacheLineSize, "Job should be exactly one cache line");
+
+// --------------------------------------------------------
+// Fixed size work-stealing deque (Chase-Lev).  The owning
+// worker pushes and pops at the bottom without locks, other
+// workers steal from the top with a single compare-and-swap.
+// --------------------------------------------------------
+class WorkStealingQueue
+{
+public:
+	static const unsigned int Capacity = 4096;
+
+	WorkStealingQueue();
+
+	// Owner only
+	bool Push(Job* job);
+	Job* Pop();
+
+	// Any thread
+	Job* Steal();
+
+private:
+	std::atomic<int> top;
+	std::atomic<int> bottom;
+	std::atomic<Job*> jobs[Capacity];
+};
+
+// --------------------------------------------------------
+// Engine-wide job scheduler.  One worker per hardware thread,
+// with the thread that creates the system acting as worker 0.
+//
+// Usage:
+//   Job* root = jobs->CreateJob(RootFunction);
+//   for (...) jobs->Run(jobs->CreateJobAsChild(root, Work, &data, sizeof(data)));
+//   jobs->Run(root);
+//   jobs->Wait(root);   // Runs other jobs while waiting
+//
+// Jobs may only be created, run and waited on from worker
+// threads (including the thread that created the system) -
+// other threads have no queue of their own.  Each worker
+// recycles its job memory after MaxJobCount jobs, so a job
+// must be done by the time that many newer jobs have been
+// created.
+// --------------------------------------------------------
+class JobSystem
+{
+public:
+	static const unsigned int MaxJobCount = 4096;
+
+	// A worker count of 0 uses one worker per hardware thread
+	JobSystem(int workerCount = 0);
+	~JobSystem();
+
+	// Creating jobs - data, up to sizeof(Job::Data) bytes, is
+	// copied into the job.  A null function makes an empty job,
+	// useful as a parent to wait on
+	Job* CreateJob(JobFunction function);
+	Job* CreateJob(JobFunction function, const void* data, size_t size);
+	Job* CreateJobAsChild(Job* parent, JobFunction function);
+	Job* CreateJobAsChild(Job* parent, JobFunction function, const void* data, size_t size);
+
+	// Queues a job on the calling worker
+	void Run(Job* job);
+
+	// Helps with other work until the job and its children are done
+	void Wait(const Job* job);
+	bool IsFinished(const Job* job);
+
+	// Splits [0, count) into chunks of at most splitSize and runs
+	// them across the workers, returning once every chunk is done
+	void ParallelFor(int count, int splitSize, ParallelForFunction function, void* userData);
+
+	int GetWorkerCount() { return workerCount; }
+
+	// Index of the calling thread's worker (0 for the thread
+	// that created the system, -1 for threads that aren't workers)
+	static int GetWorkerIndex();
+
+private:
+	// Per-worker state, each starting on its own cache line
+	struct alignas(CacheLineSize) Worker
+	{
+		WorkStealingQueue Queue;
+		Job* JobPool;
+		unsigned int AllocatedJobs;
+		unsigned int RandomSeed;
+	};
+
+	int workerCount;
+	Worker* workers;
+	std::vector<std::thread> threads;
+	std::atomic<bool> running;
+
+	Worker& GetCallingWorker();
+	Job* AllocateJob();
+	Job* GetJob();
+	void Execute(Job* job);
+	void Finish(Job* job);
+	void WorkerThread(int index);
+};
@@ -0,0 +1,276 @@
+#include "LightClusters.h"
+#include "JobSystem.h"
+#include <cmath>
+#include <cstring>
+#include <xmmintrin.h>
+
+using namespace DirectX;
+
+LightClusters::LightClusters(JobSystem* jobSystem)
+	: jobSystem(jobSystem),
+	boundsMinX(ClusterCount), boundsMaxX(ClusterCount), boundsMinY(ClusterCount), boundsMaxY(ClusterCount),
+	sliceNear(CountZ), sliceFar(CountZ),
+	slices(CountZ),
+	ranges(ClusterCount)
+{
+	memset(&projection, 0, sizeof(projection));
+	depthScale = 0;
+	depthBias = 0;
+	lightCount = 0;
+	dropped = 0;
+	simd = true;
+
+	// Every list but the slices' indices has a fixed most, so
+	// binning only allocates while those grow to fit the scene
+	lightX.reserve(MaxLights);
+	lightY.reserve(MaxLights);
+	lightZ.reserve(MaxLights);
+	lightRadius.reserve(MaxLights);
+	for (int z = 0; z < CountZ; z++)
+	{
+		Slice& slice = slices[z];
+		slice.Counts.resize(SliceClusters);
+		slice.Candidates.reserve(MaxLights);
+		slice.X.reserve(MaxLights + 3);
+		slice.Y.reserve(MaxLights + 3);
+		slice.Z.reserve(MaxLights + 3);
+		slice.Radius.reserve(MaxLights + 3);
+	}
+	indices.reserve(MaxIndices);
+	ClusterRange empty = { 0, 0 };
+	ranges.assign(ClusterCount, empty);
+}
+
+LightClusters::~LightClusters()
+{ }
+
+// --------------------------------------------------------
+// Cluster boxes in view space.  A screen tile's sides are
+// planes through the eye, so its box over a slice spans the
+// tile's corners at the slice's near and far depths.
+// --------------------------------------------------------
+void LightClusters::SetProjection(const XMFLOAT4X4& projection)
+{
+	if (memcmp(&projection, &this->projection, sizeof(XMFLOAT4X4)) == 0)
+		return;
+	this->projection = projection;
+
+	// Transposed, so [2][2] is f / (f - n) and [2][3] is -n f / (f - n)
+	float xScale = projection.m[0][0];
+	float yScale = projection.m[1][1];
+	float nearZ = -projection.m[2][3] / projection.m[2][2];
+	float farZ = projection.m[2][3] / (1.0f - projection.m[2][2]);
+
+	float logRange = logf(farZ / nearZ);
+	depthScale = CountZ / logRange;
+	depthBias = -CountZ * logf(nearZ) / logRange;
+	for (int z = 0; z < CountZ; z++)
+	{
+		sliceNear[z] = nearZ * expf(logRange * z / CountZ);
+		sliceFar[z] = nearZ * expf(logRange * (z + 1) / CountZ);
+	}
+
+	for (int z = 0; z < CountZ; z++)
+	{
+		for (int y = 0; y < CountY; y++)
+		{
+			// Row 0 is the top of the screen
+			float ndcTop = 1.0f - 2.0f * y / CountY;
+			float ndcBottom = 1.0f - 2.0f * (y + 1) / CountY;
+			for (int x = 0; x < CountX; x++)
+			{
+				float ndcLeft = -1.0f + 2.0f * x / CountX;
+				float ndcRight = -1.0f + 2.0f * (x + 1) / CountX;
+
+				int cluster = (z * CountY + y) * CountX + x;
+				boundsMinX[cluster] = fminf(ndcLeft * sliceNear[z], ndcLeft * sliceFar[z]) / xScale;
+				boundsMaxX[cluster] = fmaxf(ndcRight * sliceNear[z], ndcRight * sliceFar[z]) / xScale;
+				boundsMinY[cluster] = fminf(ndcBottom * sliceNear[z], ndcBottom * sliceFar[z]) / yScale;
+				boundsMaxY[cluster] = fmaxf(ndcTop * sliceNear[z], ndcTop * sliceFar[z]) / yScale;
+			}
+		}
+	}
+}
+
+int LightClusters::GetCluster(float x, float y, float viewDepth, float screenWidth, float screenHeight) const
+{
+	int cx = (int)(x * CountX / screenWidth);
+	int cy = (int)(y * CountY / screenHeight);
+	int cz = (int)floorf(logf(fmaxf(viewDepth, 0.0001f)) * depthScale + depthBias);
+	cx = cx < 0 ? 0 : (cx >= CountX ? CountX - 1 : cx);
+	cy = cy < 0 ? 0 : (cy >= CountY ? CountY - 1 : cy);
+	cz = cz < 0 ? 0 : (cz >= CountZ ? CountZ - 1 : cz);
+	return (cz * CountY + cy) * CountX + cx;
+}
+
+int LightClusters::GetBusiestCluster()
+{
+	unsigned int most = 0;
+	for (int c = 0; c < ClusterCount; c++)
+		if (ranges[c].Count > most) most = ranges[c].Count;
+	return (int)most;
+}
+
+// --------------------------------------------------------
+// Binning
+// --------------------------------------------------------
+void LightClusters::Bin(const XMFLOAT4X4& view, const ClusterLight* lights, int count)
+{
+	TransformLights(view, lights, count);
+	simd = true;
+	if (jobSystem)
+		jobSystem->ParallelFor(CountZ, 1, BinSlices, this);
+	else
+		BinSlices(0, CountZ, this);
+	Join();
+}
+
+void LightClusters::BinScalar(const XMFLOAT4X4& view, const ClusterLight* lights, int count)
+{
+	TransformLights(view, lights, count);
+	simd = false;
+	BinSlices(0, CountZ, this);
+	Join();
+}
+
+void LightClusters::BinSlices(int start, int end, void* userData)
+{
+	LightClusters* clusters = (LightClusters*)userData;
+	for (int z = start; z < end; z++)
+		clusters->BinSlice(z);
+}
+
+// Row j of a transposed view matrix gives view space coordinate j
+void LightClusters::TransformLights(const XMFLOAT4X4& view, const ClusterLight* lights, int count)
+{
+	lightCount = count < MaxLights ? count : MaxLights;
+	lightX.resize(lightCount);
+	lightY.resize(lightCount);
+	lightZ.resize(lightCount);
+	lightRadius.resize(lightCount);
+	for (int i = 0; i < lightCount; i++)
+	{
+		const XMFLOAT3& p = lights[i].Position;
+		lightX[i] = view.m[0][0] * p.x + view.m[0][1] * p.y + view.m[0][2] * p.z + view.m[0][3];
+		lightY[i] = view.m[1][0] * p.x + view.m[1][1] * p.y + view.m[1][2] * p.z + view.m[1][3];
+		lightZ[i] = view.m[2][0] * p.x + view.m[2][1] * p.y + view.m[2][2] * p.z + view.m[2][3];
+		lightRadius[i] = lights[i].Radius;
+	}
+}
+
+// --------------------------------------------------------
+// One depth slice: gathers the lights that reach its depths,
+// then tests every cluster's box against them - the squared
+// distance from the sphere's center to the box against the
+// squared radius
+// --------------------------------------------------------
+void LightClusters::BinSlice(int z)
+{
+	Slice& slice = slices[z];
+	slice.Candidates.clear();
+	slice.X.clear();
+	slice.Y.clear();
+	slice.Z.clear();
+	slice.Radius.clear();
+	slice.Indices.clear();
+
+	float zNear = sliceNear[z];
+	float zFar = sliceFar[z];
+	for (int i = 0; i < lightCount; i++)
+	{
+		if (lightZ[i] + lightRadius[i] < zNear || lightZ[i] - lightRadius[i] > zFar)
+			continue;
+		slice.Candidates.push_back(i);
+		slice.X.push_back(lightX[i]);
+		slice.Y.push_back(lightY[i]);
+		slice.Z.push_back(lightZ[i]);
+		slice.Radius.push_back(lightRadius[i]);
+	}
+
+	// Padding can't reach anything (its squared radius is 0 and
+	// its distance is huge)
+	int candidateCount = (int)slice.Candidates.size();
+	while (slice.X.size() % 4 != 0)
+	{
+		slice.X.push_back(1e18f);
+		slice.Y.push_back(1e18f);
+		slice.Z.push_back(1e18f);
+		slice.Radius.push_back(0);
+	}
+
+	for (int c = 0; c < SliceClusters; c++)
+	{
+		int cluster = z * SliceClusters + c;
+		unsigned int before = (unsigned int)slice.Indices.size();
+
+		if (simd)
+		{
+			__m128 zero = _mm_setzero_ps();
+			__m128 minX = _mm_set1_ps(boundsMinX[cluster]);
+			__m128 maxX = _mm_set1_ps(boundsMaxX[cluster]);
+			__m128 minY = _mm_set1_ps(boundsMinY[cluster]);
+			__m128 maxY = _mm_set1_ps(boundsMaxY[cluster]);
+			__m128 minZ = _mm_set1_ps(zNear);
+			__m128 maxZ = _mm_set1_ps(zFar);
+			for (int i = 0; i < candidateCount; i += 4)
+			{
+				__m128 x = _mm_loadu_ps(&slice.X[i]);
+				__m128 y = _mm_loadu_ps(&slice.Y[i]);
+				__m128 lz = _mm_loadu_ps(&slice.Z[i]);
+				__m128 r = _mm_loadu_ps(&slice.Radius[i]);
+
+				__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, x), _mm_sub_ps(x, maxX)), zero);
+				__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, y), _mm_sub_ps(y, maxY)), zero);
+				__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, lz), _mm_sub_ps(lz, maxZ)), zero);
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+				int mask = _mm_movemask_ps(_mm_cmple_ps(distance, _mm_mul_ps(r, r)));
+				for (; mask; mask &= mask - 1)
+				{
+					int lane = 0;
+					while (!(mask & (1 << lane))) lane++;
+					slice.Indices.push_back(slice.Candidates[i + lane]);
+				}
+			}
+		}
+		else
+		{
+			for (int i = 0; i < candidateCount; i++)
+			{
+				float dx = fmaxf(fmaxf(boundsMinX[cluster] - slice.X[i], slice.X[i] - boundsMaxX[cluster]), 0.0f);
+				float dy = fmaxf(fmaxf(boundsMinY[cluster] - slice.Y[i], slice.Y[i] - boundsMaxY[cluster]), 0.0f);
+				float dz = fmaxf(fmaxf(zNear - slice.Z[i], slice.Z[i] - zFar), 0.0f);
+				if ((dx * dx + dy * dy) + dz * dz <= slice.Radius[i] * slice.Radius[i])
+					slice.Indices.push_back(slice.Candidates[i]);
+			}
+		}
+
+		slice.Counts[c] = (unsigned int)slice.Indices.size() - before;
+	}
+}
+
+// --------------------------------------------------------
+// Joins the slices' lists into one, in cluster order.  Lists
+// that would go past MaxIndices are cut short.
+// --------------------------------------------------------
+void LightClusters::Join()
+{
+	indices.clear();
+	dropped = 0;
+	for (int z = 0; z < CountZ; z++)
+	{
+		const Slice& slice = slices[z];
+		unsigned int read = 0;
+		for (int c = 0; c < SliceClusters; c++)
+		{
+			ClusterRange& range = ranges[z * SliceClusters + c];
+			unsigned int room = MaxIndices - (unsigned int)indices.size();
+			range.Offset = (unsigned int)indices.size();
+			range.Count = slice.Counts[c] < room ? slice.Counts[c] : room;
+			dropped += slice.Counts[c] - range.Count;
+
+			indices.insert(indices.end(), slice.Indices.begin() + read, slice.Indices.begin() + read + range.Count);
+			read += slice.Counts[c];
+		}
+	}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+class JobSystem;
+
+// --------------------------------------------------------
+// A point light, as PixelShader.hlsl's Lights buffer holds it
+// --------------------------------------------------------
+struct ClusterLight
+{
+	DirectX::XMFLOAT3 Position;		// World space
+	float Radius;					// No light at all past this
+	DirectX::XMFLOAT3 Color;
+	float Intensity;
+};
+
+// Where a cluster's lights are in the index list
+struct ClusterRange
+{
+	unsigned int Offset;
+	unsigned int Count;
+};
+
+// --------------------------------------------------------
+// Clustered light culling.  The view frustum is cut into
+// CountX x CountY screen tiles and CountZ depth slices (spaced
+// exponentially, so near slices are thin), and each cluster
+// gets the list of lights whose spheres touch its box.  The
+// pixel shader works out its cluster from its pixel position
+// and depth, and only loops over that cluster's lights.
+//
+//   clusters->SetProjection(projection);	// When it changes
+//   clusters->Bin(view, lights, count);	// Each frame
+//   ... upload GetRanges() and GetIndices() ...
+//
+// Bin() does a depth slice per job, testing each cluster
+// against four lights at a time with SSE.  BinScalar() does
+// the same one light at a time on the calling thread, and
+// gives exactly the same lists.
+// --------------------------------------------------------
+class LightClusters
+{
+public:
+	static const int CountX = 16;
+	static const int CountY = 9;
+	static const int CountZ = 24;
+	static const int ClusterCount = CountX * CountY * CountZ;
+	static const int MaxLights = 1024;
+	static const int MaxIndices = ClusterCount * 32;
+
+	LightClusters(JobSystem* jobSystem);
+	~LightClusters();
+
+	// Rebuilds the clusters' boxes from a perspective projection
+	// (transposed for HLSL, like Camera's) if it has changed
+	void SetProjection(const DirectX::XMFLOAT4X4& projection);
+
+	// Bins world space lights using a view matrix (also transposed).
+	// Lights past MaxLights are ignored.
+	void Bin(const DirectX::XMFLOAT4X4& view, const ClusterLight* lights, int count);
+	void BinScalar(const DirectX::XMFLOAT4X4& view, const ClusterLight* lights, int count);
+
+	// Results - a range per cluster, by GetCluster(), into one
+	// list of light indices
+	const std::vector<ClusterRange>& GetRanges() const { return ranges; }
+	const std::vector<unsigned int>& GetIndices() const { return indices; }
+	int GetLightCount() { return lightCount; }
+	int GetIndexCount() { return (int)indices.size(); }
+	int GetDroppedCount() { return dropped; }
+	int GetBusiestCluster();
+
+	// The cluster for a pixel at a view space depth, the way
+	// PixelShader.hlsl finds it (clamped to the grid)
+	int GetCluster(float x, float y, float viewDepth, float screenWidth, float screenHeight) const;
+
+	// slice = log(viewDepth) * scale + bias
+	float GetDepthScale() { return depthScale; }
+	float GetDepthBias() { return depthBias; }
+
+private:
+	static const int SliceClusters = CountX * CountY;
+
+	JobSystem* jobSystem;
+	DirectX::XMFLOAT4X4 projection;
+	float depthScale;
+	float depthBias;
+
+	// View space boxes - x and y per cluster, z per slice
+	std::vector<float> boundsMinX, boundsMaxX, boundsMinY, boundsMaxY;
+	std::vector<float> sliceNear, sliceFar;
+
+	// This frame's lights in view space
+	std::vector<float> lightX, lightY, lightZ, lightRadius;
+	int lightCount;
+
+	// Each slice's lists, filled by one job and then joined
+	struct Slice
+	{
+		std::vector<unsigned int> Candidates;	// Lights reaching the slice's depths
+		std::vector<float> X, Y, Z, Radius;		// The candidates, padded to 4
+		std::vector<unsigned int> Counts;		// Per cluster
+		std::vector<unsigned int> Indices;		// Cluster by cluster
+	};
+	std::vector<Slice> slices;
+	bool simd;
+
+	std::vector<ClusterRange> ranges;
+	std::vector<unsigned int> indices;
+	int dropped;
+
+	void TransformLights(const DirectX::XMFLOAT4X4& view, const ClusterLight* lights, int count);
+	void BinSlice(int z);
+	void Join();
+	static void BinSlices(int start, int end, void* userData);
+};
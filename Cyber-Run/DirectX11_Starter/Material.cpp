@@ -2,17 +2,38 @@
 
 
 
-Material::Material(SimpleVertexShader * vS, SimplePixelShader * pS, vector<ID3D11ShaderResourceView*> srv, vector<string> locs, ID3D11SamplerState* _sampler)
+Material::Material(PipelineCache* pipelines, SimpleVertexShader * vS, SimplePixelShader * pS, const vector<ID3D11ShaderResourceView*>& srv, const vector<string>& locs, ID3D11SamplerState* _sampler)
 {
+	pipelineCache = pipelines;
+	rasterizerState = 0;
+	depthStencilState = 0;
+	blendState = 0;
 	vertexShader = vS;
 	pixelShader = pS;
 	srvs = srv;
 	locations = locs;
 	sampler = _sampler;
+	instancedVertexShader = 0;
+	instancedPixelShader = 0;
+
+	compile(stateBlock, vertexShader, pixelShader);
+	compile(instancedBlock, 0, 0);
 }
 
 Material::Material()
 {
+	pipelineCache = 0;
+	rasterizerState = 0;
+	depthStencilState = 0;
+	blendState = 0;
+	vertexShader = 0;
+	pixelShader = 0;
+	sampler = 0;
+	instancedVertexShader = 0;
+	instancedPixelShader = 0;
+
+	compile(stateBlock, 0, 0);
+	compile(instancedBlock, 0, 0);
 }
 
 
@@ -30,7 +51,7 @@ SimplePixelShader * Material::getPix()
 	return pixelShader;
 }
 
-vector<ID3D11ShaderResourceView*> Material::getSRV()
+const vector<ID3D11ShaderResourceView*>& Material::getSRV()
 {
 	return srvs;
 }
@@ -40,20 +61,121 @@ ID3D11SamplerState * Material::getSampler()
 	return sampler;
 }
 
-void Material::prepareMaterial(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix)
+// --------------------------------------------------------
+// Resolves the texture and sampler names against the pixel
+// shader once, so binding never looks anything up by name.
+// Textures the shader doesn't declare are left out.
+// --------------------------------------------------------
+void Material::compile(MaterialStateBlock& block, SimpleVertexShader* vS, SimplePixelShader* pS)
 {
-	vertexShader->SetMatrix4x4("view", viewMatrix);
-	vertexShader->SetMatrix4x4("projection", projectionMatrix);
+	ZeroMemory(&block, sizeof(MaterialStateBlock));
+	block.VertexShader = vS;
+	block.PixelShader = pS;
+	if (pS == 0)
+		return;
+
+	PipelineDesc pipeline = { vS, pS, rasterizerState, depthStencilState, blendState };
+	block.Pipeline = pipelineCache->AddPipeline(pipeline);
+
+	// Find the range of slots first, then fill it
+	unsigned int lastTexture = 0;
+	block.FirstTexture = MaterialStateBlock::MaxSlots;
+	for (unsigned int i = 0; i < srvs.size(); i++)
+	{
+		int slot = pS->GetTextureSlot(locations[i]);
+		if (slot < 0 || slot >= (int)MaterialStateBlock::MaxSlots)
+			continue;
 
-	for (int i = 0; i < srvs.size(); i++)
+		if ((unsigned int)slot < block.FirstTexture) block.FirstTexture = slot;
+		if ((unsigned int)slot > lastTexture) lastTexture = slot;
+	}
+	if (block.FirstTexture < MaterialStateBlock::MaxSlots)
+	{
+		block.TextureCount = lastTexture - block.FirstTexture + 1;
+		for (unsigned int i = 0; i < srvs.size(); i++)
+		{
+			int slot = pS->GetTextureSlot(locations[i]);
+			if (slot >= 0 && slot < (int)MaterialStateBlock::MaxSlots)
+				block.Textures[slot - block.FirstTexture] = srvs[i];
+		}
+	}
+	else
+	{
+		block.FirstTexture = 0;
+	}
+
+	// Same for samplers, which all get the material's sampler
+	if (sampler == 0)
+		return;
+
+	const unordered_map<string, unsigned int>& samplers = pS->GetSamplers();
+	unsigned int lastSampler = 0;
+	block.FirstSampler = MaterialStateBlock::MaxSlots;
+	for (unordered_map<string, unsigned int>::const_iterator it = samplers.begin(); it != samplers.end(); it++)
+	{
+		if (it->second >= MaterialStateBlock::MaxSlots)
+			continue;
+
+		if (it->second < block.FirstSampler) block.FirstSampler = it->second;
+		if (it->second > lastSampler) lastSampler = it->second;
+	}
+	if (block.FirstSampler < MaterialStateBlock::MaxSlots)
+	{
+		block.SamplerCount = lastSampler - block.FirstSampler + 1;
+		for (unordered_map<string, unsigned int>::const_iterator it = samplers.begin(); it != samplers.end(); it++)
+		{
+			if (it->second < MaterialStateBlock::MaxSlots)
+				block.Samplers[it->second - block.FirstSampler] = sampler;
+		}
+	}
+	else
 	{
-		pixelShader->SetShaderResourceView(locations[i], srvs[i]);
+		block.FirstSampler = 0;
 	}
-	
-	pixelShader->SetSamplerState("samplerState", sampler);
+}
 
-	vertexShader->SetShader(true);
-	pixelShader->SetShader(true);
+// Binds the pipeline (shaders and states), textures and sampler.
+// Constant buffer data isn't uploaded here - the caller copies
+// each buffer (per frame, per material, per object) only as often
+// as it actually changes.
+void Material::bind(StateCache* context, const MaterialStateBlock& block)
+{
+	pipelineCache->Bind(context, block.Pipeline);
 
-	vertexShader->CopyAllBufferData();
+	if (block.TextureCount > 0)
+		context->SetShaderResources(StateCache::StagePixel, block.FirstTexture, block.TextureCount, block.Textures);
+	if (block.SamplerCount > 0)
+		context->SetSamplers(StateCache::StagePixel, block.FirstSampler, block.SamplerCount, block.Samplers);
+}
+
+void Material::prepareMaterial(StateCache* context)
+{
+	bind(context, stateBlock);
+}
+
+void Material::setStates(unsigned int rasterizer, unsigned int depthStencil, unsigned int blend)
+{
+	rasterizerState = rasterizer;
+	depthStencilState = depthStencil;
+	blendState = blend;
+	compile(stateBlock, vertexShader, pixelShader);
+	compile(instancedBlock, instancedVertexShader, instancedPixelShader);
+}
+
+void Material::setInstancedShaders(SimpleVertexShader * vS, SimplePixelShader * pS)
+{
+	instancedVertexShader = vS;
+	instancedPixelShader = pS;
+	compile(instancedBlock, vS, pS);
+}
+
+bool Material::isInstanced()
+{
+	return instancedVertexShader != 0 && instancedPixelShader != 0;
+}
+
+// Same as prepareMaterial(), but with the instanced shaders
+void Material::prepareInstanced(StateCache* context)
+{
+	bind(context, instancedBlock);
 }
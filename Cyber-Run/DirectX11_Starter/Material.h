@@ -4,25 +4,75 @@
 #include <vector>
 #include "DirectXGameCore.h"
 #include "SimpleShader.h"
+#include "PipelineCache.h"
 
 using namespace DirectX;
 using namespace std;
 
+// --------------------------------------------------------
+// Everything a material binds, with its texture and sampler
+// names already resolved to slots.  The textures and samplers
+// are flat arrays covering a run of consecutive slots (slots
+// the material doesn't use are null), so each binds in one call.
+// --------------------------------------------------------
+struct MaterialStateBlock
+{
+	static const unsigned int MaxSlots = 16;
+
+	SimpleVertexShader* VertexShader;
+	SimplePixelShader* PixelShader;
+	unsigned int Pipeline;		// Shaders and states, from PipelineCache
+
+	unsigned int FirstTexture;
+	unsigned int TextureCount;
+	ID3D11ShaderResourceView* Textures[MaxSlots];
+
+	unsigned int FirstSampler;
+	unsigned int SamplerCount;
+	ID3D11SamplerState* Samplers[MaxSlots];
+};
+
 class Material
 {
 public:
-	Material(SimpleVertexShader* vS, SimplePixelShader* pS, vector<ID3D11ShaderResourceView*> srv, vector<string> locs, ID3D11SamplerState* sampler);
+	// The sampler is bound to every sampler the pixel shader declares
+	Material(PipelineCache* pipelines, SimpleVertexShader* vS, SimplePixelShader* pS, const vector<ID3D11ShaderResourceView*>& srv, const vector<string>& locs, ID3D11SamplerState* sampler);
 	Material();
 	~Material();
 	SimpleVertexShader* getVert();
 	SimplePixelShader* getPix();
-	vector<ID3D11ShaderResourceView*> getSRV();
+	const vector<ID3D11ShaderResourceView*>& getSRV();
 	ID3D11SamplerState* getSampler();
-	void prepareMaterial(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix);
+	void prepareMaterial(StateCache* context);
+
+	// Rasterizer, depth-stencil and blend state ids from the
+	// PipelineCache - all 0 (D3D's defaults) unless set
+	void setStates(unsigned int rasterizer, unsigned int depthStencil, unsigned int blend);
+
+	// Id of the pipeline prepareMaterial() binds, for sorting
+	unsigned int getPipeline() const { return stateBlock.Pipeline; }
+
+	// Optional shaders for drawing many instances at once (with
+	// per-instance data in a second vertex buffer)
+	void setInstancedShaders(SimpleVertexShader* vS, SimplePixelShader* pS);
+	bool isInstanced();
+	void prepareInstanced(StateCache* context);
 private:
 	SimpleVertexShader* vertexShader;
 	SimplePixelShader* pixelShader;
+	SimpleVertexShader* instancedVertexShader;
+	SimplePixelShader* instancedPixelShader;
 	vector<ID3D11ShaderResourceView*> srvs;
 	vector<string> locations;
 	ID3D11SamplerState* sampler;
-};
\ No newline at end of file
+	PipelineCache* pipelineCache;
+	unsigned int rasterizerState;
+	unsigned int depthStencilState;
+	unsigned int blendState;
+
+	// Baked whenever the shaders or states change
+	MaterialStateBlock stateBlock;
+	MaterialStateBlock instancedBlock;
+	void compile(MaterialStateBlock& block, SimpleVertexShader* vS, SimplePixelShader* pS);
+	void bind(StateCache* context, const MaterialStateBlock& block);
+};
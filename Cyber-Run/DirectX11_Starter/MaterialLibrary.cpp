@@ -0,0 +1,297 @@
+#include "MaterialLibrary.h"
+#include "WICTextureLoader.h"
+#include "DDSTextureLoader.h"
+#include "MemoryTracker.h"
+
+#include <fstream>
+#include <sstream>
+
+MaterialLibrary::MaterialLibrary(ID3D11Device* device, ID3D11DeviceContext* context, PipelineCache* pipelineCache)
+	: device(device), context(context), pipelineCache(pipelineCache)
+{ }
+
+MaterialLibrary::~MaterialLibrary()
+{
+	for (std::unordered_map<std::string, Material*>::iterator it = materials.begin(); it != materials.end(); it++)
+		delete it->second;
+	for (std::unordered_map<std::string, ID3D11ShaderResourceView*>::iterator it = textures.begin(); it != textures.end(); it++)
+		it->second->Release();
+}
+
+void MaterialLibrary::AddVertexShader(const std::string& name, SimpleVertexShader* shader)
+{
+	vertexShaders[name] = shader;
+}
+
+void MaterialLibrary::AddPixelShader(const std::string& name, SimplePixelShader* shader)
+{
+	pixelShaders[name] = shader;
+}
+
+void MaterialLibrary::AddSampler(const std::string& name, ID3D11SamplerState* sampler)
+{
+	samplers[name] = sampler;
+}
+
+Material* MaterialLibrary::Find(const std::string& name)
+{
+	std::unordered_map<std::string, Material*>::iterator it = materials.find(name);
+	return it != materials.end() ? it->second : 0;
+}
+
+// --------------------------------------------------------
+// Shaders a material names - 0, with the error set, if there's
+// no shader by that name.  find() rather than [], so a bad name
+// doesn't leave a null entry behind.
+// --------------------------------------------------------
+SimpleVertexShader* MaterialLibrary::FindVertexShader(const MaterialDesc& desc, const std::string& name)
+{
+	std::unordered_map<std::string, SimpleVertexShader*>::iterator it = vertexShaders.find(name);
+	if (it == vertexShaders.end() || it->second == 0)
+	{
+		error = "Material '" + desc.Name + "' uses unknown vertex shader '" + name + "'";
+		return 0;
+	}
+	return it->second;
+}
+
+SimplePixelShader* MaterialLibrary::FindPixelShader(const MaterialDesc& desc, const std::string& name)
+{
+	std::unordered_map<std::string, SimplePixelShader*>::iterator it = pixelShaders.find(name);
+	if (it == pixelShaders.end() || it->second == 0)
+	{
+		error = "Material '" + desc.Name + "' uses unknown pixel shader '" + name + "'";
+		return 0;
+	}
+	return it->second;
+}
+
+// --------------------------------------------------------
+// Loads a texture the first time it's asked for - DDS files
+// (like cube maps) through the DDS loader, the rest with WIC
+// --------------------------------------------------------
+ID3D11ShaderResourceView* MaterialLibrary::LoadTexture(const std::string& file)
+{
+	std::unordered_map<std::string, ID3D11ShaderResourceView*>::iterator it = textures.find(file);
+	if (it != textures.end())
+		return it->second;
+
+	std::wstring path(file.begin(), file.end());
+	bool dds = file.size() > 4 && _stricmp(file.c_str() + file.size() - 4, ".dds") == 0;
+
+	ID3D11ShaderResourceView* srv = 0;
+	HRESULT hr = dds ?
+		DirectX::CreateDDSTextureFromFile(device, context, path.c_str(), 0, &srv) :
+		DirectX::CreateWICTextureFromFile(device, context, path.c_str(), 0, &srv);
+	if (FAILED(hr))
+		return 0;
+
+	textures[file] = srv;
+	return srv;
+}
+
+// --------------------------------------------------------
+// Turns the named states into PipelineCache ids.  Defaults are
+// left at 0, which is D3D's default state.
+// --------------------------------------------------------
+bool MaterialLibrary::FindStates(const MaterialDesc& desc, unsigned int& rasterizer, unsigned int& depthStencil, unsigned int& blend)
+{
+	rasterizer = depthStencil = blend = 0;
+
+	if (desc.Cull == "front" || desc.Cull == "none")
+	{
+		D3D11_RASTERIZER_DESC rastDesc = {};
+		rastDesc.FillMode = D3D11_FILL_SOLID;
+		rastDesc.CullMode = desc.Cull == "front" ? D3D11_CULL_FRONT : D3D11_CULL_NONE;
+		rastDesc.DepthClipEnable = true;
+		rasterizer = pipelineCache->AddRasterizerState(rastDesc);
+	}
+	else if (!desc.Cull.empty() && desc.Cull != "back")
+	{
+		error = "Material '" + desc.Name + "' has unknown cull mode '" + desc.Cull + "'";
+		return false;
+	}
+
+	if (desc.Depth == "lessEqual" || desc.Depth == "off")
+	{
+		D3D11_DEPTH_STENCIL_DESC depthDesc = {};
+		depthDesc.DepthEnable = desc.Depth != "off";
+		depthDesc.DepthWriteMask = desc.Depth != "off" ? D3D11_DEPTH_WRITE_MASK_ALL : D3D11_DEPTH_WRITE_MASK_ZERO;
+		depthDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
+		depthStencil = pipelineCache->AddDepthStencilState(depthDesc);
+	}
+	else if (!desc.Depth.empty() && desc.Depth != "less")
+	{
+		error = "Material '" + desc.Name + "' has unknown depth mode '" + desc.Depth + "'";
+		return false;
+	}
+
+	if (desc.Blend == "alpha" || desc.Blend == "additive")
+	{
+		D3D11_BLEND_DESC blendDesc = {};
+		D3D11_RENDER_TARGET_BLEND_DESC& target = blendDesc.RenderTarget[0];
+		target.BlendEnable = true;
+		target.SrcBlend = desc.Blend == "alpha" ? D3D11_BLEND_SRC_ALPHA : D3D11_BLEND_ONE;
+		target.DestBlend = desc.Blend == "alpha" ? D3D11_BLEND_INV_SRC_ALPHA : D3D11_BLEND_ONE;
+		target.BlendOp = D3D11_BLEND_OP_ADD;
+		target.SrcBlendAlpha = D3D11_BLEND_ONE;
+		target.DestBlendAlpha = D3D11_BLEND_ZERO;
+		target.BlendOpAlpha = D3D11_BLEND_OP_ADD;
+		target.RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+		blend = pipelineCache->AddBlendState(blendDesc);
+	}
+	else if (!desc.Blend.empty() && desc.Blend != "opaque")
+	{
+		error = "Material '" + desc.Name + "' has unknown blend mode '" + desc.Blend + "'";
+		return false;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Looks up everything the description names, then builds the
+// material (which bakes its state block right away)
+// --------------------------------------------------------
+Material* MaterialLibrary::Create(const MaterialDesc& desc)
+{
+	MEMORY_TAG(MemoryTracker::TagAssets);
+
+	if (materials.find(desc.Name) != materials.end())
+	{
+		error = "Material '" + desc.Name + "' is defined twice";
+		return 0;
+	}
+
+	SimpleVertexShader* vs = FindVertexShader(desc, desc.VertexShader);
+	SimplePixelShader* ps = FindPixelShader(desc, desc.PixelShader);
+	if (vs == 0 || ps == 0)
+		return 0;
+
+	ID3D11SamplerState* sampler = 0;
+	if (!desc.Sampler.empty())
+	{
+		std::unordered_map<std::string, ID3D11SamplerState*>::iterator it = samplers.find(desc.Sampler);
+		if (it == samplers.end())
+		{
+			error = "Material '" + desc.Name + "' uses unknown sampler '" + desc.Sampler + "'";
+			return 0;
+		}
+		sampler = it->second;
+	}
+
+	unsigned int rasterizer, depthStencil, blend;
+	if (!FindStates(desc, rasterizer, depthStencil, blend))
+		return 0;
+
+	// A texture that won't load is left unbound, not fatal
+	std::vector<ID3D11ShaderResourceView*> srvs;
+	for (unsigned int i = 0; i < desc.TextureFiles.size(); i++)
+	{
+		ID3D11ShaderResourceView* srv = LoadTexture(desc.TextureFiles[i]);
+		if (srv == 0)
+			OutputDebugStringA(("Material '" + desc.Name + "' can't load texture '" + desc.TextureFiles[i] + "'\n").c_str());
+		srvs.push_back(srv);
+	}
+
+	Material* material = new Material(pipelineCache, vs, ps, srvs, desc.TextureNames, sampler);
+	material->setStates(rasterizer, depthStencil, blend);
+	if (!desc.InstancedVertexShader.empty())
+	{
+		SimpleVertexShader* instancedVS = FindVertexShader(desc, desc.InstancedVertexShader);
+		SimplePixelShader* instancedPS = FindPixelShader(desc, desc.InstancedPixelShader);
+		if (instancedVS == 0 || instancedPS == 0)
+		{
+			delete material;
+			return 0;
+		}
+		material->setInstancedShaders(instancedVS, instancedPS);
+	}
+
+	materials[desc.Name] = material;
+	return material;
+}
+
+// --------------------------------------------------------
+// Reads the material file one line at a time - each
+// "material" line starts a new description, and the previous
+// one is created when the next begins (or the file ends)
+// --------------------------------------------------------
+bool MaterialLibrary::Load(const std::string& path)
+{
+	MEMORY_TAG(MemoryTracker::TagAssets);
+
+	std::ifstream file(path.c_str());
+	if (!file)
+	{
+		error = "Can't open " + path;
+		return false;
+	}
+
+	MaterialDesc desc;
+	bool inMaterial = false;
+	bool ok = true;
+	int lineNumber = 0;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+
+		// Strip comments
+		size_t hash = line.find('#');
+		if (hash != std::string::npos)
+			line.erase(hash);
+
+		std::istringstream words(line);
+		std::string keyword;
+		if (!(words >> keyword))
+			continue;
+
+		bool read = false;
+		if (keyword == "material")
+		{
+			if (inMaterial && Create(desc) == 0)
+				ok = false;
+
+			desc = MaterialDesc();
+			read = inMaterial = (bool)(words >> desc.Name);
+		}
+		else if (inMaterial)
+		{
+			if (keyword == "vs")
+				read = (bool)(words >> desc.VertexShader);
+			else if (keyword == "ps")
+				read = (bool)(words >> desc.PixelShader);
+			else if (keyword == "instanced")
+				read = (bool)(words >> desc.InstancedVertexShader >> desc.InstancedPixelShader);
+			else if (keyword == "sampler")
+				read = (bool)(words >> desc.Sampler);
+			else if (keyword == "cull")
+				read = (bool)(words >> desc.Cull);
+			else if (keyword == "depth")
+				read = (bool)(words >> desc.Depth);
+			else if (keyword == "blend")
+				read = (bool)(words >> desc.Blend);
+			else if (keyword == "texture")
+			{
+				std::string name, textureFile;
+				read = (bool)(words >> name >> textureFile);
+				desc.TextureNames.push_back(name);
+				desc.TextureFiles.push_back(textureFile);
+			}
+		}
+
+		// Unknown keyword, missing values, or settings before any "material"
+		if (!read)
+		{
+			std::ostringstream message;
+			message << path << "(" << lineNumber << "): can't read \"" << line << "\"";
+			error = message.str();
+			return false;
+		}
+	}
+
+	if (inMaterial && Create(desc) == 0)
+		ok = false;
+	return ok;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Material.h"
+
+// --------------------------------------------------------
+// Everything needed to build a material, by name - shaders
+// and samplers are the names they were added to the library
+// under, textures are file names
+// --------------------------------------------------------
+struct MaterialDesc
+{
+	std::string Name;
+	std::string VertexShader;
+	std::string PixelShader;
+	std::string InstancedVertexShader;	// Optional
+	std::string InstancedPixelShader;	// Optional
+	std::string Sampler;
+	std::string Cull;		// "back" (default), "front" or "none"
+	std::string Depth;		// "less" (default), "lessEqual" or "off"
+	std::string Blend;		// "opaque" (default), "alpha" or "additive"
+	std::vector<std::string> TextureNames;	// Names in the pixel shader
+	std::vector<std::string> TextureFiles;
+};
+
+// --------------------------------------------------------
+// Builds materials from descriptions, either in code or read
+// from a text file like this:
+//
+//   # comment
+//   material main
+//   vs VertexShader
+//   ps PixelShader
+//   instanced InstancedVS InstancedPS
+//   sampler trilinear
+//   texture diffuse grid.jpg
+//   cull front
+//   depth lessEqual
+//   blend alpha
+//
+// Textures are loaded once per file and shared.  The library
+// owns its materials and textures, and its states come from
+// the PipelineCache.
+// --------------------------------------------------------
+class MaterialLibrary
+{
+public:
+	MaterialLibrary(ID3D11Device* device, ID3D11DeviceContext* context, PipelineCache* pipelineCache);
+	~MaterialLibrary();
+
+	// Names materials can refer to
+	void AddVertexShader(const std::string& name, SimpleVertexShader* shader);
+	void AddPixelShader(const std::string& name, SimplePixelShader* shader);
+	void AddSampler(const std::string& name, ID3D11SamplerState* sampler);
+
+	// Returns 0, naming what's missing in GetError, if a shader
+	// or sampler can't be found
+	Material* Create(const MaterialDesc& desc);
+
+	// Creates every material in the file.  Returns false if the file
+	// can't be read or any material in it fails (see GetError).
+	bool Load(const std::string& path);
+
+	// 0 if there's no material by that name
+	Material* Find(const std::string& name);
+
+	const std::string& GetError() { return error; }
+
+private:
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+	PipelineCache* pipelineCache;
+	std::string error;
+
+	std::unordered_map<std::string, SimpleVertexShader*> vertexShaders;
+	std::unordered_map<std::string, SimplePixelShader*> pixelShaders;
+	std::unordered_map<std::string, ID3D11SamplerState*> samplers;
+	std::unordered_map<std::string, ID3D11ShaderResourceView*> textures;
+	std::unordered_map<std::string, Material*> materials;
+
+	SimpleVertexShader* FindVertexShader(const MaterialDesc& desc, const std::string& name);
+	SimplePixelShader* FindPixelShader(const MaterialDesc& desc, const std::string& name);
+	ID3D11ShaderResourceView* LoadTexture(const std::string& file);
+	bool FindStates(const MaterialDesc& desc, unsigned int& rasterizer, unsigned int& depthStencil, unsigned int& blend);
+};
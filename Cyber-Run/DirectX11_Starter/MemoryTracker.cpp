@@ -0,0 +1,224 @@
+#include "MemoryTracker.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+MemoryTracker::Counters MemoryTracker::counters[MemoryTracker::TagCount];
+std::atomic<long long> MemoryTracker::totalPeakBytes;
+std::atomic<long long> MemoryTracker::totalLiveBytes;
+
+// Also zeroed, so threads start out untagged
+static thread_local int threadTag;
+
+// Each block starts with its size and tag.  Sixteen bytes keep
+// the caller's memory as aligned as malloc's.
+static const size_t HeaderSize = 16;
+struct AllocationHeader
+{
+	size_t Size;
+	int Tag;
+};
+static_assert(sizeof(AllocationHeader) <= HeaderSize, "Allocation header doesn't fit");
+
+MemoryTracker::Tag MemoryTracker::SetThreadTag(Tag tag)
+{
+	Tag previous = (Tag)threadTag;
+	threadTag = tag;
+	return previous;
+}
+
+MemoryTracker::Tag MemoryTracker::GetThreadTag()
+{
+	return (Tag)threadTag;
+}
+
+// Raises "peak" to "value" unless another thread got it higher first
+static void RaisePeak(std::atomic<long long>& peak, long long value)
+{
+	long long current = peak.load(std::memory_order_relaxed);
+	while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed))
+	{
+	}
+}
+
+// --------------------------------------------------------
+// Null when it can't be had - including sizes so close to the
+// top of size_t that adding the header would wrap around to a
+// small block, which operator new turns into std::bad_alloc
+// --------------------------------------------------------
+void* MemoryTracker::Allocate(size_t size)
+{
+	if (size > SIZE_MAX - HeaderSize)
+		return 0;
+
+	unsigned char* block = (unsigned char*)malloc(size + HeaderSize);
+	if (block == 0)
+		return 0;
+
+	int tag = threadTag;
+	AllocationHeader* header = (AllocationHeader*)block;
+	header->Size = size;
+	header->Tag = tag;
+
+	Counters& counter = counters[tag];
+	RaisePeak(counter.PeakBytes, counter.LiveBytes.fetch_add(size, std::memory_order_relaxed) + (long long)size);
+	counter.LiveCount.fetch_add(1, std::memory_order_relaxed);
+	counter.TotalCount.fetch_add(1, std::memory_order_relaxed);
+	RaisePeak(totalPeakBytes, totalLiveBytes.fetch_add(size, std::memory_order_relaxed) + (long long)size);
+	return block + HeaderSize;
+}
+
+void MemoryTracker::Free(void* memory)
+{
+	if (memory == 0)
+		return;
+
+	unsigned char* block = (unsigned char*)memory - HeaderSize;
+	AllocationHeader* header = (AllocationHeader*)block;
+
+	Counters& counter = counters[header->Tag];
+	counter.LiveBytes.fetch_sub(header->Size, std::memory_order_relaxed);
+	counter.LiveCount.fetch_sub(1, std::memory_order_relaxed);
+	totalLiveBytes.fetch_sub(header->Size, std::memory_order_relaxed);
+	free(block);
+}
+
+void MemoryTracker::EndFrame()
+{
+	for (int t = 0; t < TagCount; t++)
+	{
+		long long total = counters[t].TotalCount.load(std::memory_order_relaxed);
+		counters[t].FrameCount = total - counters[t].FrameStart;
+		counters[t].FrameStart = total;
+	}
+}
+
+MemoryTagStats MemoryTracker::GetStats(Tag tag)
+{
+	const Counters& counter = counters[tag];
+	MemoryTagStats stats;
+	stats.LiveBytes = counter.LiveBytes.load(std::memory_order_relaxed);
+	stats.LiveCount = counter.LiveCount.load(std::memory_order_relaxed);
+	stats.PeakBytes = counter.PeakBytes.load(std::memory_order_relaxed);
+	stats.TotalCount = counter.TotalCount.load(std::memory_order_relaxed);
+	stats.FrameCount = counter.FrameCount;
+	return stats;
+}
+
+MemoryTagStats MemoryTracker::GetTotals()
+{
+	MemoryTagStats totals = {};
+	for (int t = 0; t < TagCount; t++)
+	{
+		MemoryTagStats stats = GetStats((Tag)t);
+		totals.LiveCount += stats.LiveCount;
+		totals.TotalCount += stats.TotalCount;
+		totals.FrameCount += stats.FrameCount;
+	}
+	totals.LiveBytes = totalLiveBytes.load(std::memory_order_relaxed);
+	totals.PeakBytes = totalPeakBytes.load(std::memory_order_relaxed);
+	return totals;
+}
+
+long long MemoryTracker::GetAllocationCount()
+{
+	long long count = 0;
+	for (int t = 0; t < TagCount; t++)
+		count += counters[t].TotalCount.load(std::memory_order_relaxed);
+	return count;
+}
+
+std::string MemoryTracker::GetLiveReport()
+{
+	std::string report;
+	for (int t = TagUntagged + 1; t < TagCount; t++)
+	{
+		MemoryTagStats stats = GetStats((Tag)t);
+		if (stats.LiveCount == 0)
+			continue;
+
+		char line[128];
+		sprintf_s(line, sizeof(line), "%s: %lld bytes live in %lld blocks\n", GetTagName((Tag)t), stats.LiveBytes, stats.LiveCount);
+		report += line;
+	}
+	return report;
+}
+
+const char* MemoryTracker::GetTagName(Tag tag)
+{
+	switch (tag)
+	{
+	case TagUntagged:	return "Untagged";
+	case TagMesh:		return "Mesh";
+	case TagShader:		return "Shader";
+	case TagGui:		return "GUI";
+	case TagGameplay:	return "Gameplay";
+	case TagAssets:		return "Assets";
+	default:			return "Unknown";
+	}
+}
+
+// --------------------------------------------------------
+// The program's operator new and delete, replaced so every
+// heap block is counted
+// --------------------------------------------------------
+#ifdef MEMORY_TRACKING_ENABLED
+
+void* operator new(size_t size)
+{
+	void* memory = MemoryTracker::Allocate(size);
+	if (memory == 0)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](size_t size)
+{
+	void* memory = MemoryTracker::Allocate(size);
+	if (memory == 0)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return MemoryTracker::Allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return MemoryTracker::Allocate(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	MemoryTracker::Free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	MemoryTracker::Free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	MemoryTracker::Free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	MemoryTracker::Free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	MemoryTracker::Free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	MemoryTracker::Free(memory);
+}
+
+#endif
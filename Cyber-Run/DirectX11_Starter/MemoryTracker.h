@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+// --------------------------------------------------------
+// Heap accounting, by subsystem.  Every operator new and
+// delete in the program goes through MemoryTracker, which
+// counts the block against the tag its thread had when it was
+// made.  A tag holds for the rest of the block it's set in:
+//
+//   void Mesh::Load()
+//   {
+//       MEMORY_TAG(MemoryTracker::TagMesh);
+//       ...
+//   }
+//
+// Tags are per thread, so a job that allocates for a
+// subsystem has to tag itself.  Anything no one tagged counts
+// as TagUntagged.
+//
+// Each tag keeps its live bytes and blocks, its high-water
+// mark, and how many allocations it has made.  EndFrame()
+// turns that last count into allocations per frame.
+//
+// Defining MEMORY_TRACKING_DISABLED leaves operator new alone
+// and compiles MEMORY_TAG away to nothing.
+// --------------------------------------------------------
+#ifndef MEMORY_TRACKING_DISABLED
+#define MEMORY_TRACKING_ENABLED 1
+#endif
+
+#define MEMORY_CONCAT_INNER(a, b) a##b
+#define MEMORY_CONCAT(a, b) MEMORY_CONCAT_INNER(a, b)
+
+#ifdef MEMORY_TRACKING_ENABLED
+#define MEMORY_TAG(tag) MemoryTagScope MEMORY_CONCAT(memoryTagScope, __LINE__)(tag)
+#else
+#define MEMORY_TAG(tag)
+#endif
+
+// One tag's numbers, or every tag's added up
+struct MemoryTagStats
+{
+	long long LiveBytes;
+	long long LiveCount;		// Blocks
+	long long PeakBytes;		// Most LiveBytes has ever been
+	long long TotalCount;		// Allocations ever made
+	long long FrameCount;		// Allocations made during the last frame
+};
+
+class MemoryTracker
+{
+public:
+	enum Tag
+	{
+		TagUntagged,
+		TagMesh,		// Mesh data, and loading it
+		TagShader,		// SimpleShaders and their reflection and local buffers
+		TagGui,			// The HUD's fonts, sprites and images
+		TagGameplay,	// Entities and the simulation's working memory
+		TagAssets,		// Materials and textures
+		TagCount
+	};
+
+	// Sets the tag for the calling thread's allocations,
+	// returning the one it replaces
+	static Tag SetThreadTag(Tag tag);
+	static Tag GetThreadTag();
+
+	// Ends the current frame for the per-frame counts.  Call
+	// once a frame, from one thread.
+	static void EndFrame();
+
+	static MemoryTagStats GetStats(Tag tag);
+	static MemoryTagStats GetTotals();
+
+	// Allocations ever made, by every tag - the difference
+	// across some code is how many it made
+	static long long GetAllocationCount();
+
+	// A line per subsystem tag that still holds memory - for
+	// after everything that should have freed it has gone.
+	// TagUntagged is left out, as statics and the runtime's own
+	// allocations live there.
+	static std::string GetLiveReport();
+
+	static const char* GetTagName(Tag tag);
+
+	// Used by the global operator new and delete
+	static void* Allocate(size_t size);
+	static void Free(void* memory);
+
+private:
+	struct Counters
+	{
+		std::atomic<long long> LiveBytes;
+		std::atomic<long long> LiveCount;
+		std::atomic<long long> PeakBytes;
+		std::atomic<long long> TotalCount;
+		long long FrameStart;	// TotalCount when the frame began
+		long long FrameCount;
+	};
+
+	// Statically zeroed, so they work before anything is constructed
+	static Counters counters[TagCount];
+	static std::atomic<long long> totalPeakBytes;
+	static std::atomic<long long> totalLiveBytes;
+};
+
+// --------------------------------------------------------
+// Sets the thread's tag until the end of the scope
+// --------------------------------------------------------
+class MemoryTagScope
+{
+public:
+	MemoryTagScope(MemoryTracker::Tag tag) : previous(MemoryTracker::SetThreadTag(tag)) { }
+	~MemoryTagScope() { MemoryTracker::SetThreadTag(previous); }
+
+private:
+	MemoryTracker::Tag previous;
+};
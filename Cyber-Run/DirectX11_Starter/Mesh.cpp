@@ -1,4 +1,6 @@
 #include "Mesh.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
 #include <DirectXMath.h>
 #include <vector>
 #include <fstream>
@@ -7,15 +9,20 @@ using namespace DirectX;
 
 Mesh::Mesh(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, ID3D11Device* device)
 {
+	MEMORY_TAG(MemoryTracker::TagMesh);
+
 	CalculateTangents(vertArray, numVerts, indexArray, numIndices);
+	CalculateBounds(vertArray, numVerts);
 	CreateBuffers(vertArray, numVerts, indexArray, numIndices, device);
 }
 
-Mesh::Mesh(char* objFile, ID3D11Device* device,
-	ID3D11RasterizerState* _rasterState, ID3D11DepthStencilState* _depthState)
+Mesh::Mesh(const char* objFile, ID3D11Device* device)
 {
-	rasterState = _rasterState;
-	depthState = _depthState;
+	PROFILE_ZONE("Mesh load");
+	MEMORY_TAG(MemoryTracker::TagMesh);
+
+	boundsCenter = XMFLOAT3(0, 0, 0);
+	boundsExtents = XMFLOAT3(0, 0, 0);
 	// String to hold a single line
 	char chars[512];
 
@@ -147,6 +154,7 @@ Mesh::Mesh(char* objFile, ID3D11Device* device,
 
 		// Create the buffers
 		CalculateTangents(&verts[0], triangleCounter * 3, &indices[0], triangleCounter * 3);
+		CalculateBounds(&verts[0], triangleCounter * 3);
 		CreateBuffers(&verts[0], triangleCounter * 3, &indices[0], triangleCounter * 3, device);
 	}
 }
@@ -154,8 +162,8 @@ Mesh::Mesh(char* objFile, ID3D11Device* device,
 
 Mesh::~Mesh(void)
 {
-	vb->Release(); vb = 0;
-	ib->Release(); ib = 0;
+	if (vb) { vb->Release(); vb = 0; }
+	if (ib) { ib->Release(); ib = 0; }
 }
 
 // Calculates the tangents of the vertices in a mesh
@@ -232,8 +240,45 @@ void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices,
 	}
 }
 
+// Finds the local space bounding box of the vertices
+void Mesh::CalculateBounds(Vertex* verts, int numVerts)
+{
+	if (numVerts == 0)
+	{
+		boundsCenter = XMFLOAT3(0, 0, 0);
+		boundsExtents = XMFLOAT3(0, 0, 0);
+		return;
+	}
+
+	XMVECTOR minPos = XMLoadFloat3(&verts[0].Position);
+	XMVECTOR maxPos = minPos;
+	for (int i = 1; i < numVerts; i++)
+	{
+		XMVECTOR pos = XMLoadFloat3(&verts[i].Position);
+		minPos = XMVectorMin(minPos, pos);
+		maxPos = XMVectorMax(maxPos, pos);
+	}
+
+	XMStoreFloat3(&boundsCenter, (minPos + maxPos) * 0.5f);
+	XMStoreFloat3(&boundsExtents, (maxPos - minPos) * 0.5f);
+}
+
 void Mesh::CreateBuffers(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, ID3D11Device* device)
 {
+	// Save the indices
+	this->numIndices = numIndices;
+	vb = 0;
+	ib = 0;
+
+	// Headless (no device) meshes keep a copy in memory instead,
+	// for the SoftwareRasterizer
+	if (device == 0)
+	{
+		cpuVertices.assign(vertArray, vertArray + numVerts);
+		cpuIndices.assign(indexArray, indexArray + numIndices);
+		return;
+	}
+
 	// Create the vertex buffer
 	D3D11_BUFFER_DESC vbd;
     vbd.Usage					= D3D11_USAGE_IMMUTABLE;
@@ -257,32 +302,25 @@ void Mesh::CreateBuffers(Vertex* vertArray, int numVerts, unsigned int* indexArr
     D3D11_SUBRESOURCE_DATA initialIndexData;
     initialIndexData.pSysMem	= indexArray;
     device->CreateBuffer(&ibd, &initialIndexData, &ib);
-
-	// Save the indices
-	this->numIndices = numIndices;
 }
 
-void Mesh::Draw(ID3D11DeviceContext * deviceContext, bool sky)
+// Only sets the buffers - shaders and states come from the
+// material's pipeline
+void Mesh::Draw(StateCache * context)
 {
 	UINT stride = sizeof(Vertex);
 	UINT offset = 0;
-	if (!sky)
-	{
-		deviceContext->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
-		deviceContext->IASetIndexBuffer(ib, DXGI_FORMAT_R32_UINT, 0);
-		deviceContext->DrawIndexed(numIndices, 0, 0);
-	}
-	else
-	{
-		deviceContext->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
-		deviceContext->IASetIndexBuffer(ib, DXGI_FORMAT_R32_UINT, 0);
-		
-		deviceContext->RSSetState(rasterState);
-		deviceContext->OMSetDepthStencilState(depthState, 0);
-		deviceContext->DrawIndexed(numIndices, 0, 0);
+	context->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
+	context->IASetIndexBuffer(ib, DXGI_FORMAT_R32_UINT, 0);
+	context->GetContext()->DrawIndexed(numIndices, 0, 0);
+}
 
-		// Reset states
-		deviceContext->RSSetState(0);
-		deviceContext->OMSetDepthStencilState(0, 0);
-	}
-}
\ No newline at end of file
+void Mesh::DrawInstanced(StateCache * context, ID3D11Buffer * instances, int firstInstance, int count)
+{
+	ID3D11Buffer* buffers[2] = { vb, instances };
+	UINT strides[2] = { sizeof(Vertex), sizeof(InstanceData) };
+	UINT offsets[2] = { 0, 0 };
+	context->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+	context->IASetIndexBuffer(ib, DXGI_FORMAT_R32_UINT, 0);
+	context->GetContext()->DrawIndexedInstanced(numIndices, count, 0, 0, firstInstance);
+}
@@ -1,8 +1,11 @@
 #pragma once
 
 #include <d3d11.h>
+#include <vector>
 
 #include "Vertex.h"
+#include "InstanceData.h"
+#include "StateCache.h"
 
 struct OBJTriangle
 {
@@ -15,23 +18,40 @@ class Mesh
 {
 public:
 	Mesh(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, ID3D11Device* device);
-	Mesh(char* objFile, ID3D11Device* device, ID3D11RasterizerState* rasterState, ID3D11DepthStencilState* depthState);
+	Mesh(const char* objFile, ID3D11Device* device);
 	~Mesh(void);
 
 	ID3D11Buffer* GetVertexBuffer() { return vb; }
 	ID3D11Buffer* GetIndexBuffer() { return ib; }
 	int GetIndexCount() { return numIndices; }
 
-	void Draw(ID3D11DeviceContext* deviceContext, bool sky);
+	// Local space bounding box (center + half extents)
+	DirectX::XMFLOAT3 GetBoundsCenter() { return boundsCenter; }
+	DirectX::XMFLOAT3 GetBoundsExtents() { return boundsExtents; }
+
+	// Headless meshes only - the vertices and indices the
+	// buffers would hold (0 when the mesh is on the GPU)
+	const Vertex* GetCpuVertices() { return cpuVertices.empty() ? 0 : &cpuVertices[0]; }
+	int GetCpuVertexCount() { return (int)cpuVertices.size(); }
+	const unsigned int* GetCpuIndices() { return cpuIndices.empty() ? 0 : &cpuIndices[0]; }
+
+	void Draw(StateCache* context);
+
+	// Draws "count" copies, reading per-instance data from slot 1
+	// of "instances" starting at "firstInstance"
+	void DrawInstanced(StateCache* context, ID3D11Buffer* instances, int firstInstance, int count);
 private:
 	ID3D11Buffer* vb;
 	ID3D11Buffer* ib;
-	ID3D11RasterizerState* rasterState;
-	ID3D11DepthStencilState* depthState;
 	int numIndices;
+	DirectX::XMFLOAT3 boundsCenter;
+	DirectX::XMFLOAT3 boundsExtents;
+	std::vector<Vertex> cpuVertices;
+	std::vector<unsigned int> cpuIndices;
 	//bool skyBox;
 
 	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+	void CalculateBounds(Vertex* verts, int numVerts);
 	void CreateBuffers(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, ID3D11Device* device);
 };
 
@@ -22,8 +22,13 @@
 // ----------------------------------------------------------------------------
 
 #include <time.h>
+#include <chrono>
+#include <cstring>
 #include "MyDemoGame.h"
 #include "Vertex.h"
+#include "Benchmarks.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
 #include "WICTextureLoader.h"
 #include "DDSTextureLoader.h"
 
@@ -43,8 +48,46 @@ bool DTrigger = false;
 bool ducking = false;
 bool grounded = true;
 
+// Player collision volume around the current lane and track position
+const float PlayerHalfWidth = 0.25f;
+const float PlayerHalfDepth = 0.25f;
+
+// Room for everything alive at once, so play never has to grow
+// the entity lists or the snapshots
+const int EntityCapacity = 32;
+
+// HUD layout - the top bar's height, and how far in from the
+// right edge the profiler and memory columns start
+const int HudTopBarHeight = 55;
+const int HudRightColumnWidth = 280;
+
+// Room for the longest HUD line, and how many profiler zones it lists
+const int HudLineLength = 160;
+const int HudZoneCount = 5;
+
 
 #pragma region Win32 Entry Point (WinMain)
+// --------------------------------------------------------
+// Where -framestats [path] asks for the frame times CSV to go -
+// frames_<date>_<time>.csv in the working dir when no path
+// follows it, or "" without the flag
+// --------------------------------------------------------
+static std::string GetFrameStatsCsv(const char* cmdLine)
+{
+	const char* flag = strstr(cmdLine, "-framestats");
+	if (flag == 0)
+		return "";
+
+	const char* path = flag + strlen("-framestats");
+	while (*path == ' ')
+		path++;
+
+	size_t length = strcspn(path, " ");
+	if (length == 0 || *path == '-')
+		return FrameStats::MakeSessionPath("frames");
+	return std::string(path, length);
+}
+
 // --------------------------------------------------------
 // Win32 Entry Point - Where your program starts
 // --------------------------------------------------------
@@ -56,16 +99,51 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 	_CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
 #endif
 
-	// Create the game object.
-	MyDemoGame game(hInstance);
-	
-	// This is where we'll create the window, initialize DirectX, 
-	// set up geometry and shaders, etc.
-	if( !game.Init() )
-		return 0;
-	
-	// All set to run the game loop
-	return game.Run();
+	// Headless benchmarks run and exit before any window is made
+	if (Benchmarks::IsRequested(cmdLine))
+	{
+		int result = Benchmarks::Run(cmdLine);
+		Profiler::Shutdown();
+		return result;
+	}
+
+	int result = 0;
+	{
+		// Create the game object.
+		MyDemoGame game(hInstance);
+
+		// Optionally overlap simulation and rendering
+		if (strstr(cmdLine, "-pipelined") != 0)
+			game.SetPipelinedLoop(true);
+
+		// Optionally record draws on every core
+		if (strstr(cmdLine, "-deferred") != 0)
+			game.SetParallelSubmission(true);
+
+		// Optionally let the bot play
+		if (strstr(cmdLine, "-autoplay") != 0)
+			game.SetAutoPlay(true);
+
+		// Optionally save every frame's times
+		game.SetFrameStatsCsv(GetFrameStatsCsv(cmdLine));
+
+		// This is where we'll create the window, initialize DirectX, 
+		// set up geometry and shaders, etc.
+		if( !game.Init() )
+			return 0;
+
+		// All set to run the game loop
+		result = game.Run();
+	}
+	Profiler::Shutdown();
+
+#ifdef MEMORY_TRACKING_ENABLED
+	// Whatever a subsystem still holds now that the game is gone leaked
+	std::string leaks = MemoryTracker::GetLiveReport();
+	if (!leaks.empty())
+		OutputDebugStringA(("Memory leaked:\n" + leaks).c_str());
+#endif
+	return result;
 }
 
 #pragma endregion
@@ -90,6 +168,52 @@ MyDemoGame::MyDemoGame(HINSTANCE hInstance)
 	windowHeight = 600;
 
 	camera = 0;
+	visibleCount = 0;
+	culledCount = 0;
+	occludedCount = 0;
+	occlusionMs = 0;
+	materialBinds = 0;
+	parallelSubmission = false;
+	submissionCount = 0;
+	ZeroMemory(&input, sizeof(InputState));
+	autoPlay = false;
+	headless = false;
+	prevTraceKey = false;
+
+	// Nothing is created until Init() (or InitHeadless()), and
+	// headless runs never create most of these
+	vertexShader = 0;
+	pixelShader = 0;
+	instancedVS = 0;
+	instancedPS = 0;
+	instanceBuffer = 0;
+	instanceCapacity = 0;
+	lightClusters = 0;
+	lightBuffer = 0;
+	clusterRangeBuffer = 0;
+	lightIndexBuffer = 0;
+	lightViews[0] = lightViews[1] = lightViews[2] = 0;
+	gpuTimer = 0;
+	dynamicResolution = true;
+	ZeroMemory(&sceneViewport, sizeof(D3D11_VIEWPORT));
+	skyVS = 0;
+	skyPS = 0;
+	ppVS = 0;
+	bloomThresholdPS = 0;
+	bloomBlurPS = 0;
+	bloomCombinePS = 0;
+	sampler = 0;
+	clampSampler = 0;
+
+	// Soft threshold just under white, since the scene is 8 bit
+	bloomSettings.Threshold = 0.8f;
+	bloomSettings.Knee = 0.2f;
+	bloomSettings.Radius = 4;
+	bloomSettings.Sigma = 2.0f;
+	bloomSettings.Intensity = 1.0f;
+	materialLibrary = 0;
+	frameGraph = 0;
+	softwareRasterizer = 0;
 }
 
 // --------------------------------------------------------
@@ -102,32 +226,48 @@ MyDemoGame::~MyDemoGame()
 	// Delete our simple shaders
 	delete vertexShader;
 	delete pixelShader;
+	delete instancedVS;
+	delete instancedPS;
 	delete skyVS;
 	delete skyPS;
 	delete ppVS;
-	delete ppPS;
-
-    // Loop and remove Game Entities
-    for (unsigned int i = 0; i < entities.size(); i++)
-        delete entities[i];
+	delete bloomThresholdPS;
+	delete bloomBlurPS;
+	delete bloomCombinePS;
 
+    // Game entities belong to entityPool, which deletes them
     for (unsigned int i = 0; i < meshes.size(); i++)
         delete meshes[i];
 
     delete camera;
 
-	texture->Release();
-	normalMap->Release();
-	sampler->Release();
-
-	skyTexture->Release();
-	depthState->Release();
-	rasterState->Release();
-
-	//GUI::Destroy();
-
-	ppRTV->Release();
-	ppSRV->Release();
+	// Headless runs make their own placeholder materials
+	if (materialLibrary == 0)
+	{
+		for (unsigned int i = 0; i < materials.size(); i++)
+			delete materials[i];
+	}
+	delete materialLibrary;
+
+	GUI::Destroy();
+
+	delete frameGraph;
+	delete softwareRasterizer;
+	delete lightClusters;
+	delete gpuTimer;
+	ReleaseMacro(instanceBuffer);
+	ReleaseMacro(lightBuffer);
+	ReleaseMacro(clusterRangeBuffer);
+	ReleaseMacro(lightIndexBuffer);
+	for (int i = 0; i < 3; i++)
+		ReleaseMacro(lightViews[i]);
+
+	for (unsigned int i = 0; i < submissionContexts.size(); i++)
+	{
+		delete submissionContexts[i].Cache;
+		ReleaseMacro(submissionContexts[i].CommandList);
+		ReleaseMacro(submissionContexts[i].Context);
+	}
 }
 
 #pragma endregion
@@ -154,41 +294,239 @@ bool MyDemoGame::Init()
 
 	// Tell the input assembler stage of the pipeline what kind of
 	// geometric primitives we'll be using and how to interpret them
-	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	stateCache->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	CreateFrameGraph();
+
+	lightClusters = new LightClusters(jobSystem);
+	CreateLightBuffers();
+
+	gpuTimer = new GpuTimer(device, deviceContext);
+
+	if (parallelSubmission)
+		CreateSubmissionContexts();
 
 	// gui
-	GUI::Create(device, deviceContext);
+	GUI::Create(device, deviceContext, stateCache, pipelineCache);
 
 	// Successfully initialized
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets up only the simulation - no window, device, shaders or
+// textures, and meshes just load their bounds.  Used for soak
+// and throughput runs (see Benchmarks).
+// --------------------------------------------------------
+bool MyDemoGame::InitHeadless()
+{
+	headless = true;
+	jobSystem = new JobSystem();
+	aspectRatio = (float)windowWidth / windowHeight;
+
+	// Nothing gets drawn, but entities need materials to point at
+	materials.push_back(new Material());
+	materials.push_back(new Material());
+
+	CreateGeometry();
+	CreateMatrices();
+
+	lightClusters = new LightClusters(jobSystem);
+	return true;
+}
+
+// --------------------------------------------------------
+// One simulation-only frame, for headless runs
+// --------------------------------------------------------
+void MyDemoGame::StepHeadless(float deltaTime, float totalTime)
+{
+	SampleInput();
+	UpdateScene(deltaTime, totalTime);
+}
+
+// --------------------------------------------------------
+// Culls the snapshot UpdateScene just filled (headless runs
+// don't swap snapshots)
+// --------------------------------------------------------
+void MyDemoGame::CullHeadless()
+{
+	CullScene(snapshots[simulationSnapshot]);
+}
+
+// --------------------------------------------------------
+// Sets up the SoftwareRasterizer at the given size.  The
+// camera's aspect ratio follows, so the frustum matches.
+// --------------------------------------------------------
+bool MyDemoGame::InitSoftwareRendering(int width, int height)
+{
+	if (camera == 0 || width <= 0 || height <= 0)
+		return false;
+
+	windowWidth = width;
+	windowHeight = height;
+	aspectRatio = (float)width / height;
+	camera->UpdateProjectionMatrix(aspectRatio);
+
+	delete softwareRasterizer;
+	softwareRasterizer = new SoftwareRasterizer(jobSystem, width, height);
+
+	// The same files as the main and sky materials, as TGAs
+	// (there's no SunnyCubeMap.tga yet, so the sky's a stand-in)
+	if (!softwareDiffuse.LoadTGA("grid.tga"))
+		softwareDiffuse.CreateGrid(256, 8);
+	if (!softwareNormals.LoadTGA("gridNormals.tga"))
+		softwareNormals.CreateSolid(128, 128, 255, 255);
+	if (!softwareSky.LoadTGA("SunnyCubeMap.tga"))
+		softwareSky.CreateSkyGradient(256, 128);
+
+	softwareMain.Diffuse = &softwareDiffuse;
+	softwareMain.NormalMap = &softwareNormals;
+	softwareSkyMaterial.Diffuse = &softwareSky;
+	softwareSkyMaterial.NormalMap = 0;
+	return true;
+}
+
+// --------------------------------------------------------
+// DrawScene's scene pass on the CPU: the same culling, lights
+// and bloom colors, from the snapshot UpdateScene just filled.
+// Post processing and the HUD are left out.
+// --------------------------------------------------------
+void MyDemoGame::DrawSoftware()
+{
+	PROFILE_ZONE("DrawSoftware");
+
+	if (softwareRasterizer == 0)
+		return;
+
+	// Headless runs don't swap snapshots
+	const RenderSnapshot& frame = snapshots[simulationSnapshot];
+
+	CullScene(frame);
+	BinLights(frame);
+
+	// Cleared like the scene pass
+	const float color[4] = { 0, 0, 0, 0 };
+	softwareRasterizer->BeginFrame(color, GetSceneLights(frame));
+
+	// The sky goes last, like the render queue's sky pass
+	for (int sky = 0; sky < 2; sky++)
+	{
+		SubmitSoftware(frame, visibleEntities, 0, sky != 0);
+		SubmitSoftware(frame, visiblePlatforms, 1, sky != 0);
+		SubmitSoftware(frame, visibleCollectibles, 2, sky != 0);
+		SubmitSoftware(frame, visibleObstacles, 3, sky != 0);
+	}
+	softwareRasterizer->Render();
+}
+
+// --------------------------------------------------------
+// Hands a group's visible items (sky or not) to the rasterizer
+// --------------------------------------------------------
+void MyDemoGame::SubmitSoftware(const RenderSnapshot& frame, const std::vector<const RenderItem*>& visible, int group, bool sky)
+{
+	XMFLOAT3 bloom = GetGroupBloom(frame, group);
+	XMFLOAT4X4 skyViewProj = SoftwareRasterizer::SkyViewProjection(frame.View, frame.Projection);
+
+	for (unsigned int i = 0; i < visible.size(); i++)
+	{
+		const RenderItem* item = visible[i];
+		if (item->Sky != sky)
+			continue;
+
+		SoftwareDraw draw;
+		draw.Vertices = item->ItemMesh->GetCpuVertices();
+		draw.VertexCount = item->ItemMesh->GetCpuVertexCount();
+		draw.Indices = item->ItemMesh->GetCpuIndices();
+		draw.IndexCount = item->ItemMesh->GetIndexCount();
+		draw.World = item->World;
+		draw.WorldViewProj = sky ? skyViewProj : item->WorldViewProj;
+		draw.Material = sky ? &softwareSkyMaterial : &softwareMain;
+		draw.Bloom = bloom;
+		draw.Sky = sky;
+		softwareRasterizer->Submit(draw);
+	}
+}
+
+// --------------------------------------------------------
+// Job for loading a single OBJ file into a mesh
+// --------------------------------------------------------
+struct MeshLoadData
+{
+	const char* File;
+	ID3D11Device* Device;
+	Mesh** Result;
+};
+
+static void LoadMeshJob(Job* job, const void* rawData)
+{
+	const MeshLoadData* data = (const MeshLoadData*)rawData;
+	MEMORY_TAG(MemoryTracker::TagMesh);
+	*data->Result = new Mesh(data->File, data->Device);
+}
+
 // --------------------------------------------------------
 // Creates the geometry we're going to draw - a single triangle for now
 // --------------------------------------------------------
 void MyDemoGame::CreateGeometry()
 {
+	MEMORY_TAG(MemoryTracker::TagGameplay);
+
 	XMFLOAT4 red = XMFLOAT4(1.0f, 0.0f, 0.0f, 1.0f);
 	XMFLOAT4 green = XMFLOAT4(0.0f, 1.0f, 0.0f, 1.0f);
 	XMFLOAT4 blue = XMFLOAT4(0.0f, 0.0f, 1.0f, 1.0f);
 	XMFLOAT4 yellow = XMFLOAT4(1.0f, 1.0f, 0.0f, 1.0f);
 
 
-	Mesh* player1 = new Mesh("helix.obj", device, rasterState, depthState);
-	Mesh* player2 = new Mesh("cycle.obj", device, rasterState, depthState);
-	Mesh* floor = new Mesh("cube.obj", device, rasterState, depthState);
-	Mesh* sphere = new Mesh("sphere.obj", device, rasterState, depthState);
+	// Load every mesh as its own job - OBJ parsing is the slow part
+	// and the device is free threaded, so they can all go at once
+	const char* meshFiles[] = { "helix.obj", "cycle.obj", "cube.obj", "sphere.obj" };
+	Mesh* loadedMeshes[4];
+	Job* loadAll = jobSystem->CreateJob(0);
+	for (int i = 0; i < 4; i++)
+	{
+		MeshLoadData data = { meshFiles[i], device, &loadedMeshes[i] };
+		jobSystem->Run(jobSystem->CreateJobAsChild(loadAll, LoadMeshJob, &data, sizeof(data)));
+	}
+	jobSystem->Run(loadAll);
+	jobSystem->Wait(loadAll);
+
+	Mesh* player1 = loadedMeshes[0];
+	Mesh* player2 = loadedMeshes[1];
+	Mesh* floor = loadedMeshes[2];
+	Mesh* sphere = loadedMeshes[3];
 
 	meshes.push_back(player1);
 	meshes.push_back(player2);
 	meshes.push_back(floor);
 	meshes.push_back(sphere);
 
+	// Everything play needs up front, so it never allocates
+	entityPool.Reserve(EntityCapacity);
+	entities.reserve(EntityCapacity);
+	collectibles.reserve(EntityCapacity);
+	platforms.reserve(EntityCapacity);
+	obstacles.reserve(EntityCapacity);
+	sweepHits.reserve(EntityCapacity);
+	culler.Reserve(EntityCapacity);
+	visibleIndices.reserve(EntityCapacity);
+	visibleEntities.reserve(EntityCapacity);
+	visiblePlatforms.reserve(EntityCapacity);
+	visibleCollectibles.reserve(EntityCapacity);
+	visibleObstacles.reserve(EntityCapacity);
+	for (int i = 0; i < 2; i++)
+	{
+		snapshots[i].Entities.reserve(EntityCapacity);
+		snapshots[i].Platforms.reserve(EntityCapacity);
+		snapshots[i].Collectibles.reserve(EntityCapacity);
+		snapshots[i].Obstacles.reserve(EntityCapacity);
+		snapshots[i].Lights.reserve(LightClusters::MaxLights);
+	}
+
 	// Make some entities
-	GameEntity* person1 = new GameEntity(player1, materials[0], false);
-	GameEntity* person2 = new GameEntity(player2, materials[0], false);
-	GameEntity* ground = new GameEntity(floor, materials[0], false);
-	GameEntity* skyBox = new GameEntity(sphere, materials[1], true);
+	GameEntity* person1 = entityPool.Create(player1, materials[MaterialMain], false);
+	GameEntity* person2 = entityPool.Create(player2, materials[MaterialMain], false);
+	GameEntity* ground = entityPool.Create(floor, materials[MaterialMain], false);
+	GameEntity* skyBox = entityPool.Create(sphere, materials[MaterialSky], true);
 
 	platforms.push_back(ground);
 	entities.push_back(person1);
@@ -197,7 +535,7 @@ void MyDemoGame::CreateGeometry()
 
 	entities[1]->SetScale(.05f, .05f, .05f);
 
-	for (int i = 0; i < platforms.size(); i++)
+	for (size_t i = 0; i < platforms.size(); i++)
 	{
 		platforms[i]->SetPosition(0.0f, -2.0f, 2.5f + (15.0f * totPlatforms));
 		platforms[i]->SetScale(3.0f, 2.0f, 15.0f);
@@ -211,7 +549,7 @@ void MyDemoGame::CreateGeometry()
 
 	for (int i = 0; i < 5; i++)
 	{
-		GameEntity* collectMe = new GameEntity(sphere, materials[0], false);
+		GameEntity* collectMe = entityPool.Create(sphere, materials[MaterialMain], false);
 		collectMe->SetScale(0.1f, 0.1f, 0.1f);
 		int x = rand() % 3;
 		switch (x)
@@ -234,6 +572,56 @@ void MyDemoGame::CreateGeometry()
 	}
 }
 
+// --------------------------------------------------------
+// The game's materials, for when materials.txt is missing
+// any of them - keep the two in step
+// --------------------------------------------------------
+static std::vector<MaterialDesc> DefaultMaterials()
+{
+	std::vector<MaterialDesc> defaults(5);
+
+	MaterialDesc& main = defaults[0];
+	main.Name = "main";
+	main.VertexShader = "VertexShader";
+	main.PixelShader = "PixelShader";
+	main.InstancedVertexShader = "InstancedVS";
+	main.InstancedPixelShader = "InstancedPS";
+	main.Sampler = "trilinear";
+	main.TextureNames = { "diffuse", "normalMap", "skyTexture" };
+	main.TextureFiles = { "grid.jpg", "gridNormals.jpg", "SunnyCubeMap.dds" };
+
+	MaterialDesc& sky = defaults[1];
+	sky.Name = "sky";
+	sky.VertexShader = "SkyVS";
+	sky.PixelShader = "SkyPS";
+	sky.Sampler = "trilinear";
+	sky.Cull = "front";
+	sky.Depth = "lessEqual";
+	sky.TextureNames = { "sky" };
+	sky.TextureFiles = { "SunnyCubeMap.dds" };
+
+	// Post processing sources are bound each frame, not here
+	MaterialDesc& postProcess = defaults[2];
+	postProcess.Name = "postProcess";
+	postProcess.VertexShader = "BlurVS";
+	postProcess.PixelShader = "BloomCombinePS";
+	postProcess.Sampler = "clamp";
+
+	MaterialDesc& bloomThreshold = defaults[3];
+	bloomThreshold.Name = "bloomThreshold";
+	bloomThreshold.VertexShader = "BlurVS";
+	bloomThreshold.PixelShader = "BloomThresholdPS";
+	bloomThreshold.Sampler = "clamp";
+
+	MaterialDesc& bloomBlur = defaults[4];
+	bloomBlur.Name = "bloomBlur";
+	bloomBlur.VertexShader = "BlurVS";
+	bloomBlur.PixelShader = "BloomBlurPS";
+	bloomBlur.Sampler = "clamp";
+
+	return defaults;
+}
+
 // --------------------------------------------------------
 // Loads shaders from compiled shader object (.cso) files
 // - These simple shaders provide helpful methods for sending
@@ -241,11 +629,23 @@ void MyDemoGame::CreateGeometry()
 // --------------------------------------------------------
 void MyDemoGame::LoadShaders()
 {
+	MEMORY_TAG(MemoryTracker::TagShader);
+
 	vertexShader = new SimpleVertexShader(device, deviceContext);
 	vertexShader->LoadShaderFile(L"VertexShader.cso");
+	vertexShader->SetBufferDynamic("perObject");
 
 	pixelShader = new SimplePixelShader(device, deviceContext);
 	pixelShader->LoadShaderFile(L"PixelShader.cso");
+	bloomHandles[0] = pixelShader->GetVariableHandle("bloomAmountX");
+	bloomHandles[1] = pixelShader->GetVariableHandle("bloomAmountY");
+	bloomHandles[2] = pixelShader->GetVariableHandle("bloomAmountZ");
+
+	instancedVS = new SimpleVertexShader(device, deviceContext);
+	instancedVS->LoadShaderFile(L"InstancedVS.cso");
+
+	instancedPS = new SimplePixelShader(device, deviceContext);
+	instancedPS->LoadShaderFile(L"InstancedPS.cso");
 
 	skyVS = new SimpleVertexShader(device, deviceContext);
 	skyVS->LoadShaderFile(L"SkyVS.cso");
@@ -256,15 +656,16 @@ void MyDemoGame::LoadShaders()
 	ppVS = new SimpleVertexShader(device, deviceContext);
 	ppVS->LoadShaderFile(L"BlurVS.cso");
 
-	ppPS = new SimplePixelShader(device, deviceContext);
-	ppPS->LoadShaderFile(L"BlurPS.cso");
+	bloomThresholdPS = new SimplePixelShader(device, deviceContext);
+	bloomThresholdPS->LoadShaderFile(L"BloomThresholdPS.cso");
+
+	bloomBlurPS = new SimplePixelShader(device, deviceContext);
+	bloomBlurPS->LoadShaderFile(L"BloomBlurPS.cso");
 
-	// Set up texture stuff
-	DirectX::CreateWICTextureFromFile(device, deviceContext, L"grid.jpg", 0, &texture);
-	DirectX::CreateWICTextureFromFile(device, deviceContext, L"gridNormals.jpg", 0, &normalMap);
-	DirectX::CreateDDSTextureFromFile(device, deviceContext, L"SunnyCubeMap.dds", 0, &skyTexture);
+	bloomCombinePS = new SimplePixelShader(device, deviceContext);
+	bloomCombinePS->LoadShaderFile(L"BloomCombinePS.cso");
 
-	// Create the sampler
+	// Create the sampler (it belongs to the pipeline cache)
 	D3D11_SAMPLER_DESC samplerDesc;
 	ZeroMemory(&samplerDesc, sizeof(samplerDesc));
 	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
@@ -272,76 +673,51 @@ void MyDemoGame::LoadShaders()
 	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
 	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
 	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
-	device->CreateSamplerState(&samplerDesc, &sampler);
-
-	// Create the sky rasterizer state
-	D3D11_RASTERIZER_DESC rastDesc = {};
-	rastDesc.FillMode = D3D11_FILL_SOLID;
-	rastDesc.CullMode = D3D11_CULL_FRONT;
-	rastDesc.DepthClipEnable = true;
-	device->CreateRasterizerState(&rastDesc, &rasterState);
-
-	// Sky's depth state
-	D3D11_DEPTH_STENCIL_DESC depthDesc = {};
-	depthDesc.DepthEnable = true;
-	depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
-	depthDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
-	device->CreateDepthStencilState(&depthDesc, &depthState);
-
-
-	// Post processing ---------------------------------
-
-	// Create a texture
-	D3D11_TEXTURE2D_DESC tDesc = {};
-	tDesc.Width = windowWidth;
-	tDesc.Height = windowHeight;
-	tDesc.ArraySize = 1;
-	tDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-	tDesc.CPUAccessFlags = 0;
-	tDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	tDesc.MipLevels = 1;
-	tDesc.MiscFlags = 0;
-	tDesc.SampleDesc.Count = 1;
-	tDesc.SampleDesc.Quality = 0;
-	tDesc.Usage = D3D11_USAGE_DEFAULT;
-	ID3D11Texture2D* ppTexture;
-	device->CreateTexture2D(&tDesc, 0, &ppTexture);
-
-	// Make a render target view for rendering into the texture
-	D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
-	rtvDesc.Format = tDesc.Format;
-	rtvDesc.Texture2D.MipSlice = 0;
-	rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-	device->CreateRenderTargetView(ppTexture, &rtvDesc, &ppRTV);
-
-	// Make an SRV 
-	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Format = tDesc.Format;
-	srvDesc.Texture2D.MipLevels = 1;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-	device->CreateShaderResourceView(ppTexture, &srvDesc, &ppSRV);
-
-	// Get rid of ONE of the texture references
-	ppTexture->Release();
-
-	vector<ID3D11ShaderResourceView*> srvs = { texture,normalMap,skyTexture };
-	vector<string> locs = { "diffuse", "normalMap","skyTexture" };
-	Material* mainMat = new Material(vertexShader, pixelShader, srvs, locs, sampler);
-	srvs.clear();
-	locs.clear();
-	srvs.push_back(skyTexture);
-	locs.push_back("sky");
-	Material* skyMat = new Material(skyVS, skyPS, srvs, locs, sampler);
-	srvs.clear();
-	locs.clear();
-	srvs.push_back(0);
-	locs.push_back("pixels");
-	Material* postProcMat = new Material(ppVS, ppPS, srvs, locs, sampler);
-
-	materials.push_back(mainMat);
-	materials.push_back(skyMat);
-	materials.push_back(postProcMat);
+	sampler = pipelineCache->GetSamplerState(pipelineCache->AddSamplerState(samplerDesc));
+
+	// Post processing reads render targets, which shouldn't wrap
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT;
+	clampSampler = pipelineCache->GetSamplerState(pipelineCache->AddSamplerState(samplerDesc));
+
+	// The sky's rasterizer and depth states are part of its
+	// material (see materials.txt)
+
+	// Materials ---------------------------------------
+
+	// Read from materials.txt, with the built in definitions
+	// filling in for any it's missing (or if it can't be read)
+	materialLibrary = new MaterialLibrary(device, deviceContext, pipelineCache);
+	materialLibrary->AddVertexShader("VertexShader", vertexShader);
+	materialLibrary->AddPixelShader("PixelShader", pixelShader);
+	materialLibrary->AddVertexShader("InstancedVS", instancedVS);
+	materialLibrary->AddPixelShader("InstancedPS", instancedPS);
+	materialLibrary->AddVertexShader("SkyVS", skyVS);
+	materialLibrary->AddPixelShader("SkyPS", skyPS);
+	materialLibrary->AddVertexShader("BlurVS", ppVS);
+	materialLibrary->AddPixelShader("BloomThresholdPS", bloomThresholdPS);
+	materialLibrary->AddPixelShader("BloomBlurPS", bloomBlurPS);
+	materialLibrary->AddPixelShader("BloomCombinePS", bloomCombinePS);
+	materialLibrary->AddSampler("trilinear", sampler);
+	materialLibrary->AddSampler("clamp", clampSampler);
+	if (!materialLibrary->Load("materials.txt"))
+		OutputDebugStringA((materialLibrary->GetError() + "\n").c_str());
+
+	std::vector<MaterialDesc> defaults = DefaultMaterials();
+	for (unsigned int i = 0; i < defaults.size(); i++)
+	{
+		if (materialLibrary->Find(defaults[i].Name) == 0 && materialLibrary->Create(defaults[i]) == 0)
+			OutputDebugStringA((materialLibrary->GetError() + "\n").c_str());
+	}
+
+	// In MaterialSlot order
+	materials.push_back(materialLibrary->Find("main"));
+	materials.push_back(materialLibrary->Find("sky"));
+	materials.push_back(materialLibrary->Find("postProcess"));
+	materials.push_back(materialLibrary->Find("bloomThreshold"));
+	materials.push_back(materialLibrary->Find("bloomBlur"));
 }
 
 // --------------------------------------------------------
@@ -355,6 +731,55 @@ void MyDemoGame::CreateMatrices()
 	camera->setSpeed(2.0f);
 }
 
+// --------------------------------------------------------
+// Declares the frame's passes and what they read and write.
+// The scene's color target comes from the graph's pool and
+// follows the window size; the back and depth buffers belong
+// to the base class, so they're imported.
+// --------------------------------------------------------
+void MyDemoGame::CreateFrameGraph()
+{
+	frameGraph = new FrameGraph(device);
+
+	RenderTargetDesc colorDesc = { 0, 0, 1.0f, DXGI_FORMAT_R8G8B8A8_UNORM };
+	RenderTargetDesc bloomDesc = { 0, 0, 0.5f, DXGI_FORMAT_R16G16B16A16_FLOAT };
+	sceneColor = frameGraph->CreateTarget("sceneColor", colorDesc);
+	bloomBright = frameGraph->CreateTarget("bloomBright", bloomDesc);
+	bloomAcross = frameGraph->CreateTarget("bloomAcross", bloomDesc);
+	bloomBlurred = frameGraph->CreateTarget("bloomBlurred", bloomDesc);
+	depthTarget = frameGraph->ImportTarget("depth", 0, 0, depthStencilView);
+	backBuffer = frameGraph->ImportTarget("backBuffer", renderTargetView, 0, 0);
+
+	int scene = frameGraph->AddPass("scene", ScenePass, this);
+	frameGraph->Write(scene, sceneColor);
+	frameGraph->Write(scene, depthTarget);
+
+	// bloomBright is finished with by the time bloomBlurred is
+	// drawn, so the two share a texture
+	int threshold = frameGraph->AddPass("bloomThreshold", BloomThresholdPass, this);
+	frameGraph->Read(threshold, sceneColor);
+	frameGraph->Write(threshold, bloomBright);
+
+	int across = frameGraph->AddPass("bloomAcross", BloomAcrossPass, this);
+	frameGraph->Read(across, bloomBright);
+	frameGraph->Write(across, bloomAcross);
+
+	int down = frameGraph->AddPass("bloomDown", BloomDownPass, this);
+	frameGraph->Read(down, bloomAcross);
+	frameGraph->Write(down, bloomBlurred);
+
+	int post = frameGraph->AddPass("postProcess", PostProcessPass, this);
+	frameGraph->Read(post, sceneColor);
+	frameGraph->Read(post, bloomBlurred);
+	frameGraph->Write(post, backBuffer);
+
+	int hud = frameGraph->AddPass("hud", HudPass, this);
+	frameGraph->Write(hud, backBuffer);
+
+	frameGraph->Resize(windowWidth, windowHeight);
+	OutputDebugStringA(frameGraph->Dump().c_str());
+}
+
 #pragma endregion
 
 #pragma region Window Resizing
@@ -372,19 +797,88 @@ void MyDemoGame::OnResize()
 	{
 		camera->UpdateProjectionMatrix(aspectRatio);
 	}
+
+	// The base class just replaced the back and depth buffers
+	if (frameGraph != 0)
+	{
+		frameGraph->SetImportedTarget(backBuffer, renderTargetView, 0, 0);
+		frameGraph->SetImportedTarget(depthTarget, 0, 0, depthStencilView);
+		frameGraph->Resize(windowWidth, windowHeight);
+		OutputDebugStringA(frameGraph->Dump().c_str());
+
+		// New views can land at old addresses
+		stateCache->Invalidate();
+	}
+
+	// Old frame times say nothing about the new size
+	resolution.Reset();
 }
 #pragma endregion
 
 #pragma region Game
 
+// --------------------------------------------------------
+// Reads the keyboard for this frame.  Always called on the
+// main thread, before UpdateScene.
+//
+// Headless runs never look at the keyboard, so whoever is
+// at the machine can't steer or quit a benchmark - the bot
+// drives, or the controls SetInput() last gave.
+// --------------------------------------------------------
+void MyDemoGame::SampleInput()
+{
+	if (!headless)
+	{
+		// Quit if the escape key is pressed
+		if (GetAsyncKeyState(VK_ESCAPE))
+			Quit();
+
+#ifdef PROFILER_ENABLED
+		// F9 saves the profiler's recent history
+		bool traceKey = (GetAsyncKeyState(VK_F9) & 0x8000) != 0;
+		if (traceKey && !prevTraceKey)
+			Profiler::WriteChromeTrace("profile.json");
+		prevTraceKey = traceKey;
+#endif
+	}
+
+	// Let the bot drive, telling it about everything coming up
+	if (autoPlay)
+	{
+		// Same speed up as the movement in UpdateScene
+		float speed = pData.forces.z * (1 + 0.05f * score);
+		autoPlayer.Begin(XMFLOAT3(pData.position.x, pData.position.y, pData.position.z), speed, grounded, GameOver);
+		for (size_t i = 0; i < obstacles.size(); i++)
+		{
+			XMFLOAT3 scale = obstacles[i]->GetScale();
+			autoPlayer.AddObstacle(obstacles[i]->position, XMFLOAT3(scale.x * 0.5f, scale.y * 0.5f, scale.z * 0.5f));
+		}
+		for (size_t i = 0; i < collectibles.size(); i++)
+		{
+			autoPlayer.AddCollectible(collectibles[i]->position);
+		}
+		input = autoPlayer.Decide();
+		return;
+	}
+
+	if (headless)
+		return;
+
+	input.Left = (GetKeyState('A') & 0x8000) != 0;
+	input.Right = (GetKeyState('D') & 0x8000) != 0;
+	input.Jump = (GetKeyState('W') & 0x8000) != 0;
+	input.Duck = (GetKeyState('S') & 0x8000) != 0;
+	input.Restart = (GetKeyState('P') & 0x8000) != 0;
+}
+
 // --------------------------------------------------------
 // Update your game here - take input, move objects, etc.
 // --------------------------------------------------------
 void MyDemoGame::UpdateScene(float deltaTime, float totalTime)
 {
-	// Quit if the escape key is pressed
-	if (GetAsyncKeyState(VK_ESCAPE))
-		Quit();
+	PROFILE_ZONE("UpdateScene");
+	MEMORY_TAG(MemoryTracker::TagGameplay);
+
 	if (!GameOver) {
 		if (goingUpX) {
 			bloomAmountX += .001f;
@@ -430,20 +924,20 @@ void MyDemoGame::UpdateScene(float deltaTime, float totalTime)
 		entities[1]->SetRotation(-3.14f / 2.0f, 0.0f, -3.14f / 2.0f);
 		entities[1]->UpdateWorldMatrix();
 
-		if (GetKeyState('A') & 0x8000) {
+		if (input.Left) {
 			ATrigger = true;
 		}
-		if (ATrigger && !(GetKeyState('A') & 0x8000)) {
+		if (ATrigger && !input.Left) {
 			pData.position.x = (pData.position.x - .75f);
 			if (pData.position.x <= -.75f) {
 				pData.position.x = -.75f;
 			}
 			ATrigger = false;
 		}
-		if (GetKeyState('D') & 0x8000) {
+		if (input.Right) {
 			DTrigger = true;
 		}
-		if (DTrigger && !(GetKeyState('D') & 0x8000)) {
+		if (DTrigger && !input.Right) {
 			pData.position.x = (pData.position.x + .75f);
 			if (pData.position.x >= .75f) {
 				pData.position.x = .75f;
@@ -451,19 +945,19 @@ void MyDemoGame::UpdateScene(float deltaTime, float totalTime)
 			DTrigger = false;
 		}
 		
-		if ((GetKeyState('W') & 0x8000) && grounded) {
+		if (input.Jump && grounded) {
 			pData.forces.y = 0.4f;
 			grounded = false;
 		}
-		if (GetKeyState('S') & 0x8000) {
+		if (input.Duck) {
 			ducking = true;
 			entities[1]->SetRotation(0, (-3.14f / 2.0f), 0);
 		}
-		if (!grounded && !(GetKeyState('W') & 0x8000) && pData.position.y <= -1.0) {
+		if (!grounded && !input.Jump && pData.position.y <= -1.0) {
 			grounded = true;
 			pData.forces.y = 0.0f;
 		}
-		if (ducking && !(GetKeyState('S') & 0x8000)) {
+		if (ducking && !input.Duck) {
 			ducking = false;
 			entities[1]->SetRotation(0, 0, 0);
 		}
@@ -475,66 +969,18 @@ void MyDemoGame::UpdateScene(float deltaTime, float totalTime)
 
 		for (int i = 0; i < collectibles.size(); i++)
 		{
-			if (collectibles[i]->position.z <= pData.position.z && collectibles[i]->position.z >= (pData.position.z - 1.0f))
-			{
-				if (collectibles[i]->position.x == pData.position.x)
-				{
-					collectibles.erase(collectibles.begin() + i);
-					i--;
-					score++;
-					GameEntity* collectMe = new GameEntity(meshes[3], materials[0], false);
-					collectMe->SetScale(0.1f, 0.1f, 0.1f);
-					int x = rand() % 3;
-					switch (x)
-					{
-					case 0:
-						collectMe->SetPosition(-.75f, -0.5f, 2.0f * totCollects);
-						break;
-					case 1:
-						collectMe->SetPosition(0.0f, -0.5f, 2.0f * totCollects);
-						break;
-					case 2:
-						collectMe->SetPosition(.75f, -0.5f, 2.0f * totCollects);
-						break;
-					default:
-						collectMe->SetPosition(0.0f, -0.5f, 2.0f * totCollects);
-						break;
-					}
-					collectibles.push_back(collectMe);
-					totCollects++;
-				}
-				continue;
-			}
 			if (collectibles[i]->position.z <= (pData.position.z - 1.0f))
 			{
+				entityPool.Destroy(collectibles[i]);
 				collectibles.erase(collectibles.begin() + i);
 				i--;
-				GameEntity* collectMe = new GameEntity(meshes[3], materials[0], false);
-				collectMe->SetScale(0.1f, 0.1f, 0.1f);
-				int x = rand() % 3;
-				switch (x)
-				{
-				case 0:
-					collectMe->SetPosition(-.75f, -0.5f, 2.0f * totCollects);
-					break;
-				case 1:
-					collectMe->SetPosition(0.0f, -0.5f, 2.0f * totCollects);
-					break;
-				case 2:
-					collectMe->SetPosition(.75f, -0.5f, 2.0f * totCollects);
-					break;
-				default:
-					collectMe->SetPosition(0.0f, -0.5f, 2.0f * totCollects);
-					break;
-				}
-				collectibles.push_back(collectMe);
-				totCollects++;
+				SpawnCollectible();
 			}
 		}
 
 		if (platforms[0]->position.z - 2.5 <= pData.position.z && platforms.size() == 1)
 		{
-			platforms.push_back(new GameEntity(meshes[2], materials[0], false));
+			platforms.push_back(entityPool.Create(meshes[2], materials[MaterialMain], false));
 			platforms[1]->SetPosition(0.0f, -2.0f, 2.5f + (15.0f*totPlatforms));
 			platforms[1]->SetScale(3.0f, 2.0f, 15.0f);
 			platforms[1]->UpdateWorldMatrix();
@@ -542,7 +988,7 @@ void MyDemoGame::UpdateScene(float deltaTime, float totalTime)
 			int obstaclePosition = rand() % 2;
 			if (obstacleChance == 0)
 			{
-				GameEntity* obs = new GameEntity(meshes[2], materials[0], false);
+				GameEntity* obs = entityPool.Create(meshes[2], materials[MaterialMain], false);
 				obs->SetScale(3.0f, 0.2f, 0.2f);
 				switch (obstaclePosition)
 				{
@@ -563,19 +1009,9 @@ void MyDemoGame::UpdateScene(float deltaTime, float totalTime)
 
 		for (int i = 0; i < obstacles.size(); i++)
 		{
-			if (obstacles[i]->position.z <= pData.position.z && obstacles[i]->position.z >= (pData.position.z - 0.05f))
-			{
-				if (obstacles[i]->position.y <= 0.0f && obstacles[i]->position.y >= -0.2f && !ducking)
-				{
-					GameOver = true;
-				}
-				if (obstacles[i]->position.y <= -0.8f && obstacles[i]->position.y >= -1.0f && grounded)
-				{
-					GameOver = true;
-				}
-			}
 			if (obstacles[i]->position.z <= (pData.position.z - 1.0f))
 			{
+				entityPool.Destroy(obstacles[i]);
 				obstacles.erase(obstacles.begin() + i);
 				i--;
 			}
@@ -586,11 +1022,16 @@ void MyDemoGame::UpdateScene(float deltaTime, float totalTime)
 		{
 			if (platforms[1]->position.z < pData.position.z)
 			{
+				entityPool.Destroy(platforms[0]);
 				platforms.erase(platforms.begin());
 			}
 		}
 
+		// Remember where this tick's movement starts, so the swept pass
+		// tests everything we travel through and not just where we land
+		float3 startPosition = pData.position;
 		pData.position.add(pData.forces.mult(deltaTime * (1 + 0.05f * score)));
+		SweepCollisions(startPosition);
 
 		// Update the camera
 		camera->Update(deltaTime, pData.position.z - 3);
@@ -603,194 +1044,1122 @@ void MyDemoGame::UpdateScene(float deltaTime, float totalTime)
 		mbstowcs_s(&convertedChars, wcstring, newsizew, orig.c_str(), _TRUNCATE);*/
 	}
 	else {
-		if ((GetKeyState('P') & 0x8000)) {
+		if (input.Restart) {
 			GameOver = false;
 			score = 0;
 			
 		}
 	}
+
+	// Hand everything DrawScene needs over in one piece
+	CaptureSnapshot(snapshots[simulationSnapshot]);
 }
 
 // --------------------------------------------------------
-// Clear the screen, redraw everything, present to the user
+// Copies this frame's drawable state into a snapshot.  After
+// this, DrawScene never has to touch the live game objects.
 // --------------------------------------------------------
-void MyDemoGame::DrawScene(float deltaTime, float totalTime)
+void MyDemoGame::CaptureSnapshot(RenderSnapshot& frame)
 {
-	// Background color (Cornflower Blue in this case) for clearing
-	const float color[4] = {0,0,0,0};// {0.4f, 0.6f, 0.75f, 0.0f};
+	PROFILE_ZONE("CaptureSnapshot");
+
+	frame.View = camera->GetView();
+	frame.Projection = camera->GetProjection();
+	frame.CameraPosition = camera->GetPosition();
+	camera->GetFrustumPlanes(frame.Frustum);
+
+	// Both transposed for HLSL, so this is (view * projection) transposed
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMLoadFloat4x4(&frame.Projection) * XMLoadFloat4x4(&frame.View));
+
+	CaptureGroup(entities, frame.Entities, viewProj);
+	CaptureGroup(platforms, frame.Platforms, viewProj);
+	CaptureGroup(collectibles, frame.Collectibles, viewProj);
+	CaptureGroup(obstacles, frame.Obstacles, viewProj);
+	CaptureLights(frame);
+
+	frame.BloomAmountX = bloomAmountX;
+	frame.BloomAmountY = bloomAmountY;
+	frame.BloomAmountZ = bloomAmountZ;
+	frame.Score = score;
+	frame.GameOver = GameOver;
+}
+
+// --------------------------------------------------------
+// Snapshots one group of entities (reusing the item memory),
+// including each one's final world * view * projection
+// --------------------------------------------------------
+void MyDemoGame::CaptureGroup(std::vector<GameEntity*>& group, std::vector<RenderItem>& items, XMFLOAT4X4 viewProj)
+{
+	XMMATRIX vp = XMLoadFloat4x4(&viewProj);
+
+	items.resize(group.size());
+	for (size_t i = 0; i < group.size(); i++)
+	{
+		RenderItem& item = items[i];
+		group[i]->GetWorldBounds(item.BoundsCenter, item.BoundsExtents);
+		item.World = *group[i]->GetWorldMatrix();
+		XMStoreFloat4x4(&item.WorldViewProj, vp * XMLoadFloat4x4(&item.World));
+		item.ItemMesh = group[i]->GetMesh();
+		item.ItemMaterial = group[i]->GetMaterial();
+		item.Sky = group[i]->IsSky();
+	}
+}
+
+// --------------------------------------------------------
+// Adds a light unless the snapshot already has MaxLights -
+// Lights is reserved for exactly that many, so going past it
+// would reallocate every frame.  The rest are counted instead.
+// --------------------------------------------------------
+static void AddLight(RenderSnapshot& frame, const ClusterLight& light)
+{
+	if (frame.Lights.size() < (size_t)LightClusters::MaxLights)
+		frame.Lights.push_back(light);
+	else
+		frame.DroppedLights++;
+}
+
+// --------------------------------------------------------
+// The level's neon: strips along both top edges of each
+// platform, a glow around each collectible and a red warning
+// around each obstacle
+// --------------------------------------------------------
+void MyDemoGame::CaptureLights(RenderSnapshot& frame)
+{
+	static const XMFLOAT3 palette[4] =
+	{
+		XMFLOAT3(0.0f, 1.0f, 1.0f),
+		XMFLOAT3(1.0f, 0.0f, 1.0f),
+		XMFLOAT3(1.0f, 0.9f, 0.0f),
+		XMFLOAT3(0.2f, 1.0f, 0.2f),
+	};
+
+	frame.Lights.clear();
+	frame.DroppedLights = 0;
+	ClusterLight light;
+
+	// cube.obj is a unit cube, so the top edges are half the scale out
+	for (size_t i = 0; i < platforms.size(); i++)
+	{
+		XMFLOAT3 center = platforms[i]->position;
+		XMFLOAT3 scale = platforms[i]->GetScale();
+		light.Radius = 1.0f;
+		light.Intensity = 0.6f;
+		for (float z = -scale.z * 0.5f; z <= scale.z * 0.5f; z += 0.5f)
+		{
+			for (int side = 0; side < 2; side++)
+			{
+				light.Position = XMFLOAT3(center.x + (side ? scale.x : -scale.x) * 0.5f, center.y + scale.y * 0.5f, center.z + z);
+				light.Color = palette[side];
+				AddLight(frame, light);
+			}
+		}
+	}
+
+	for (size_t i = 0; i < collectibles.size(); i++)
+	{
+		light.Position = collectibles[i]->position;
+		light.Radius = 2.5f;
+		light.Color = palette[i % 4];
+		light.Intensity = 1.0f;
+		AddLight(frame, light);
+	}
+
+	for (size_t i = 0; i < obstacles.size(); i++)
+	{
+		light.Position = obstacles[i]->position;
+		light.Radius = 3.0f;
+		light.Color = XMFLOAT3(1.0f, 0.1f, 0.1f);
+		light.Intensity = 1.0f;
+		AddLight(frame, light);
+	}
+}
+
+// --------------------------------------------------------
+// Continuous collision for this tick's movement.  The player's
+// volume is swept from "start" to the current position, so high
+// speeds can't skip over thin obstacles or collectibles.
+// --------------------------------------------------------
+void MyDemoGame::SweepCollisions(float3 start)
+{
+	PROFILE_ZONE("SweepCollisions");
+
+	// Jumping lifts the bottom of the volume over low bars and
+	// ducking drops the top under high bars
+	CollisionBox playerBox;
+	playerBox.Min = XMFLOAT3(start.x - PlayerHalfWidth, grounded ? -1.0f : -0.79f, start.z - PlayerHalfDepth);
+	playerBox.Max = XMFLOAT3(start.x + PlayerHalfWidth, ducking ? -0.21f : 0.0f, start.z + PlayerHalfDepth);
+
+	// Height is handled by the volume above, so only sweep along the ground
+	XMFLOAT3 movement(pData.position.x - start.x, 0.0f, pData.position.z - start.z);
+
+	// Obstacles (cube.obj is a unit cube)
+	collider.Begin(playerBox, movement);
+	for (size_t i = 0; i < obstacles.size(); i++)
+	{
+		XMFLOAT3 scale = obstacles[i]->GetScale();
+		collider.AddCandidate((int)i, obstacles[i]->position, XMFLOAT3(scale.x * 0.5f, scale.y * 0.5f, scale.z * 0.5f));
+	}
+	if (collider.Sweep(sweepHits) > 0)
+	{
+		GameOver = true;
+	}
+
+	// Collectibles (sphere.obj has a radius of one)
+	collider.Begin(playerBox, movement);
+	for (size_t i = 0; i < collectibles.size(); i++)
+	{
+		collider.AddCandidate((int)i, collectibles[i]->position, collectibles[i]->GetScale());
+	}
+	collider.Sweep(sweepHits);
+
+	// Hits are in index order, so go backwards to keep indices valid while erasing
+	for (int h = (int)sweepHits.size() - 1; h >= 0; h--)
+	{
+		entityPool.Destroy(collectibles[sweepHits[h].Id]);
+		collectibles.erase(collectibles.begin() + sweepHits[h].Id);
+		score++;
+		SpawnCollectible();
+	}
+}
+
+// --------------------------------------------------------
+// Game state for headless runs
+// --------------------------------------------------------
+bool MyDemoGame::IsGameOver()
+{
+	return GameOver;
+}
+
+int MyDemoGame::GetEntityCount()
+{
+	return (int)(entities.size() + platforms.size() + collectibles.size() + obstacles.size());
+}
+
+// --------------------------------------------------------
+// Adds a collectible in a random lane at the end of the track
+// --------------------------------------------------------
+void MyDemoGame::SpawnCollectible()
+{
+	GameEntity* collectMe = entityPool.Create(meshes[3], materials[MaterialMain], false);
+	collectMe->SetScale(0.1f, 0.1f, 0.1f);
+	int x = rand() % 3;
+	switch (x)
+	{
+	case 0:
+		collectMe->SetPosition(-.75f, -0.5f, 2.0f * totCollects);
+		break;
+	case 1:
+		collectMe->SetPosition(0.0f, -0.5f, 2.0f * totCollects);
+		break;
+	case 2:
+		collectMe->SetPosition(.75f, -0.5f, 2.0f * totCollects);
+		break;
+	default:
+		collectMe->SetPosition(0.0f, -0.5f, 2.0f * totCollects);
+		break;
+	}
+	collectibles.push_back(collectMe);
+	totCollects++;
+}
+
+// --------------------------------------------------------
+// Fills the visible lists for a frame: frustum culling first,
+// then the visible platforms and obstacles (solid cube.obj
+// boxes) are drawn into the occlusion buffer, and anything
+// they completely hide is dropped
+// --------------------------------------------------------
+void MyDemoGame::CullScene(const RenderSnapshot& frame)
+{
+	PROFILE_ZONE("CullScene");
+
+	visibleCount = 0;
+	culledCount = 0;
+	occludedCount = 0;
+	CullEntities(frame.Frustum, frame.Entities, visibleEntities);
+	CullEntities(frame.Frustum, frame.Platforms, visiblePlatforms);
+	CullEntities(frame.Frustum, frame.Collectibles, visibleCollectibles);
+	CullEntities(frame.Frustum, frame.Obstacles, visibleObstacles);
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	occlusion.Begin();
+	for (unsigned int i = 0; i < visiblePlatforms.size(); i++)
+		AddOccluder(*visiblePlatforms[i]);
+	for (unsigned int i = 0; i < visibleObstacles.size(); i++)
+		AddOccluder(*visibleObstacles[i]);
+	occlusion.Finish();
+
+	RemoveOccluded(visibleEntities);
+	RemoveOccluded(visiblePlatforms);
+	RemoveOccluded(visibleCollectibles);
+	RemoveOccluded(visibleObstacles);
+	occlusionMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void MyDemoGame::AddOccluder(const RenderItem& item)
+{
+	occlusion.AddOccluder(item.WorldViewProj, item.ItemMesh->GetBoundsCenter(), item.ItemMesh->GetBoundsExtents());
+}
 
-	// Swap to the new render target
-	deviceContext->OMSetRenderTargets(1, &ppRTV, depthStencilView);
-
-	// Clear the render target and depth buffer (erases what's on the screen)
-	//  - Do this ONCE PER FRAME
-	//  - At the beginning of DrawScene (before drawing *anything*)
-	deviceContext->ClearRenderTargetView(ppRTV, color);
-	deviceContext->ClearDepthStencilView(
-		depthStencilView, 
-		D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL,
-		1.0f,
-		0);
-	for (int i = 0; i < entities.size(); i++)
+// --------------------------------------------------------
+// Drops the items the occluders hide from a visible list.  The
+// sky is behind everything, but never hidden by anything.
+// --------------------------------------------------------
+void MyDemoGame::RemoveOccluded(std::vector<const RenderItem*>& visible)
+{
+	unsigned int kept = 0;
+	for (unsigned int i = 0; i < visible.size(); i++)
 	{
-		// Pass in some light data to the pixel shader
-		pixelShader->SetFloat3("DirLightDirection", XMFLOAT3(0, -1, 0));
-		pixelShader->SetFloat4("DirLightColor", XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
+		const RenderItem* item = visible[i];
+		if (item->Sky || occlusion.IsVisible(item->WorldViewProj, item->ItemMesh->GetBoundsCenter(), item->ItemMesh->GetBoundsExtents()))
+			visible[kept++] = item;
+	}
 
-		pixelShader->SetFloat3("PointLightPosition", XMFLOAT3(0, 2, 0));
-		pixelShader->SetFloat4("PointLightColor", XMFLOAT4(0.3f, 0.3f, 1.0f, 0.0f));
-		pixelShader->SetFloat3("CameraPosition", camera->GetPosition());
+	occludedCount += (int)(visible.size() - kept);
+	visibleCount -= (int)(visible.size() - kept);
+	visible.resize(kept);
+}
 
-		pixelShader->SetFloat("pixelWidth", 1.0f / windowWidth);
-		pixelShader->SetFloat("pixelHeight", 1.0f / windowHeight);
-		pixelShader->SetInt("blurAmount", 1.0f);
-		pixelShader->SetFloat("bloomAmountX", bloomAmountX);
-		pixelShader->SetFloat("bloomAmountY", bloomAmountY);
-		pixelShader->SetFloat("bloomAmountZ", bloomAmountZ);
+// --------------------------------------------------------
+// Frustum culls a group of entities, filling "visible" with the
+// ones that should be drawn and updating this frame's counters.
+// The sky surrounds the camera, so it is never culled.
+// --------------------------------------------------------
+void MyDemoGame::CullEntities(const XMFLOAT4 frustum[6], const std::vector<RenderItem>& group, std::vector<const RenderItem*>& visible)
+{
+	culler.Clear();
+	for (size_t i = 0; i < group.size(); i++)
+	{
+		culler.Add(group[i].BoundsCenter, group[i].BoundsExtents);
+	}
+	culler.Cull(frustum, visibleIndices);
+
+	visible.clear();
+	for (size_t i = 0, v = 0; i < group.size(); i++)
+	{
+		bool inView = v < visibleIndices.size() && (size_t)visibleIndices[v] == i;
+		if (inView) v++;
 
-		entities[i]->Draw(deviceContext, camera->GetView(), camera->GetProjection());
+		if (inView || group[i].Sky)
+			visible.push_back(&group[i]);
 	}
-	for (int i = 1; i < entities.size(); i++)
+
+	visibleCount += (int)visible.size();
+	culledCount += (int)(group.size() - visible.size());
+}
+
+// --------------------------------------------------------
+// Sets the bloom colors used by the next group of draws.  This
+// is the only per-material data, so it's uploaded right away.
+// --------------------------------------------------------
+void MyDemoGame::SetGroupBloom(const XMFLOAT3& bloom)
+{
+	pixelShader->SetFloat(bloomHandles[0], bloom.x);
+	pixelShader->SetFloat(bloomHandles[1], bloom.y);
+	pixelShader->SetFloat(bloomHandles[2], bloom.z);
+}
+
+// --------------------------------------------------------
+// Each group (the variant in the render queue) gets its own
+// mix of the bloom colors
+// --------------------------------------------------------
+XMFLOAT3 MyDemoGame::GetGroupBloom(const RenderSnapshot& frame, int group)
+{
+	switch (group)
 	{
-		// Pass in some light data to the pixel shader
-		pixelShader->SetFloat3("DirLightDirection", XMFLOAT3(0, -1, 0));
-		pixelShader->SetFloat4("DirLightColor", XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
+	case 0: return XMFLOAT3(frame.BloomAmountX, frame.BloomAmountY, frame.BloomAmountZ);
+	case 1: return XMFLOAT3(frame.BloomAmountX, frame.BloomAmountZ, frame.BloomAmountY);
+	case 2: return XMFLOAT3(frame.BloomAmountZ, frame.BloomAmountX, frame.BloomAmountY);
+	default: return XMFLOAT3(frame.BloomAmountY, frame.BloomAmountZ, frame.BloomAmountX);
+	}
+}
 
-		pixelShader->SetFloat3("PointLightPosition", XMFLOAT3(0, 2, 0));
-		pixelShader->SetFloat4("PointLightColor", XMFLOAT4(0.3f, 0.3f, 1.0f, 0.0f));
-		pixelShader->SetFloat3("CameraPosition", camera->GetPosition());
+// --------------------------------------------------------
+// Splits the sorted queue into draws.  Neighbouring commands
+// with the same mesh and an instanced material become one
+// instanced draw, with their per-object data gathered into
+// "instances".
+// --------------------------------------------------------
+void MyDemoGame::BuildBatches(const RenderSnapshot& frame)
+{
+	PROFILE_ZONE("BuildBatches");
 
-		pixelShader->SetFloat("pixelWidth", 1.0f / windowWidth);
-		pixelShader->SetFloat("pixelHeight", 1.0f / windowHeight);
-		pixelShader->SetInt("blurAmount", 1.0f);
-		pixelShader->SetFloat("bloomAmountX", bloomAmountX);
-		pixelShader->SetFloat("bloomAmountY", bloomAmountY);
-		pixelShader->SetFloat("bloomAmountZ", bloomAmountZ);
+	drawBatches.clear();
+	instances.clear();
+	for (int i = 0; i < renderQueue.GetCount(); i++)
+	{
+		const RenderQueue::Command& command = renderQueue.GetCommand(i);
+		const RenderItem* item = command.Item;
+		bool instanced = !item->Sky && item->ItemMaterial->isInstanced();
+
+		DrawBatch* last = drawBatches.empty() ? 0 : &drawBatches.back();
+		if (instanced && last && last->Instanced &&
+			last->BatchMesh == item->ItemMesh &&
+			last->BatchMaterial == item->ItemMaterial)
+		{
+			last->Count++;
+		}
+		else
+		{
+			DrawBatch batch;
+			batch.FirstCommand = i;
+			batch.FirstInstance = (int)instances.size();
+			batch.Count = 1;
+			batch.Instanced = instanced;
+			batch.BatchMesh = item->ItemMesh;
+			batch.BatchMaterial = item->ItemMaterial;
+			batch.Constants.Offset = 0;
+			batch.Constants.Size = 0;
+			drawBatches.push_back(batch);
+		}
 
-		entities[i]->Draw(deviceContext, camera->GetView(), camera->GetProjection());
+		if (instanced)
+		{
+			InstanceData instance;
+			instance.World = item->World;
+			instance.WorldViewProj = item->WorldViewProj;
+			instance.Tint = GetGroupBloom(frame, command.Variant);
+			instances.push_back(instance);
+		}
 	}
-	for (int i = 0; i < platforms.size(); i++)
+}
+
+// --------------------------------------------------------
+// Copies this frame's instance data to the GPU in one go,
+// growing the buffer when it is too small
+// --------------------------------------------------------
+void MyDemoGame::UploadInstances()
+{
+	PROFILE_ZONE("UploadInstances");
+
+	if (instances.empty())
+		return;
+
+	if ((int)instances.size() > instanceCapacity)
 	{
-		// Pass in some light data to the pixel shader
-		pixelShader->SetFloat3("DirLightDirection", XMFLOAT3(0, -1, 0));
-		pixelShader->SetFloat4("DirLightColor", XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
+		ReleaseMacro(instanceBuffer);
+		instanceCapacity = instanceCapacity > 0 ? instanceCapacity : 64;
+		while (instanceCapacity < (int)instances.size())
+			instanceCapacity *= 2;
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = instanceCapacity * sizeof(InstanceData);
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		HR(device->CreateBuffer(&desc, 0, &instanceBuffer));
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	HR(deviceContext->Map(instanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+	memcpy(mapped.pData, &instances[0], instances.size() * sizeof(InstanceData));
+	deviceContext->Unmap(instanceBuffer, 0);
+}
 
-		pixelShader->SetFloat3("PointLightPosition", XMFLOAT3(0, 2, 0));
-		pixelShader->SetFloat4("PointLightColor", XMFLOAT4(0.3f, 0.3f, 1.0f, 0.0f));
-		pixelShader->SetFloat3("CameraPosition", camera->GetPosition());
+// --------------------------------------------------------
+// The pixel shader's light data: every light, a range per
+// cluster, and the index list the ranges point into.  All are
+// rewritten each frame, so they're dynamic and full size.
+// --------------------------------------------------------
+void MyDemoGame::CreateLightBuffers()
+{
+	D3D11_BUFFER_DESC desc = {};
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC view = {};
+	view.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+
+	desc.ByteWidth = LightClusters::MaxLights * sizeof(ClusterLight);
+	desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	desc.StructureByteStride = sizeof(ClusterLight);
+	HR(device->CreateBuffer(&desc, 0, &lightBuffer));
+	view.Format = DXGI_FORMAT_UNKNOWN;
+	view.Buffer.NumElements = LightClusters::MaxLights;
+	HR(device->CreateShaderResourceView(lightBuffer, &view, &lightViews[0]));
+
+	desc.ByteWidth = LightClusters::ClusterCount * sizeof(ClusterRange);
+	desc.MiscFlags = 0;
+	desc.StructureByteStride = 0;
+	HR(device->CreateBuffer(&desc, 0, &clusterRangeBuffer));
+	view.Format = DXGI_FORMAT_R32G32_UINT;
+	view.Buffer.NumElements = LightClusters::ClusterCount;
+	HR(device->CreateShaderResourceView(clusterRangeBuffer, &view, &lightViews[1]));
+
+	desc.ByteWidth = LightClusters::MaxIndices * sizeof(unsigned int);
+	HR(device->CreateBuffer(&desc, 0, &lightIndexBuffer));
+	view.Format = DXGI_FORMAT_R32_UINT;
+	view.Buffer.NumElements = LightClusters::MaxIndices;
+	HR(device->CreateShaderResourceView(lightIndexBuffer, &view, &lightViews[2]));
+}
 
-		pixelShader->SetFloat("pixelWidth", 1.0f / windowWidth);
-		pixelShader->SetFloat("pixelHeight", 1.0f / windowHeight);
-		pixelShader->SetInt("blurAmount", 1.0f);
-		pixelShader->SetFloat("bloomAmountX", bloomAmountX);
-		pixelShader->SetFloat("bloomAmountY", bloomAmountZ);
-		pixelShader->SetFloat("bloomAmountZ", bloomAmountY);
+// --------------------------------------------------------
+// Sorts a frame's lights into clusters for its camera
+// --------------------------------------------------------
+void MyDemoGame::BinLights(const RenderSnapshot& frame)
+{
+	PROFILE_ZONE("BinLights");
 
-		platforms[i]->Draw(deviceContext, camera->GetView(), camera->GetProjection());
+	lightClusters->SetProjection(frame.Projection);
+	lightClusters->Bin(frame.View, frame.Lights.empty() ? 0 : &frame.Lights[0], (int)frame.Lights.size());
+}
+
+// --------------------------------------------------------
+// Copies the binned lights to the GPU - only as much of each
+// buffer as this frame uses
+// --------------------------------------------------------
+void MyDemoGame::UploadLights(const RenderSnapshot& frame)
+{
+	PROFILE_ZONE("UploadLights");
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+
+	HR(deviceContext->Map(lightBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+	if (lightClusters->GetLightCount() > 0)
+		memcpy(mapped.pData, &frame.Lights[0], lightClusters->GetLightCount() * sizeof(ClusterLight));
+	deviceContext->Unmap(lightBuffer, 0);
+
+	HR(deviceContext->Map(clusterRangeBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+	memcpy(mapped.pData, &lightClusters->GetRanges()[0], LightClusters::ClusterCount * sizeof(ClusterRange));
+	deviceContext->Unmap(clusterRangeBuffer, 0);
+
+	HR(deviceContext->Map(lightIndexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+	if (lightClusters->GetIndexCount() > 0)
+		memcpy(mapped.pData, &lightClusters->GetIndices()[0], lightClusters->GetIndexCount() * sizeof(unsigned int));
+	deviceContext->Unmap(lightIndexBuffer, 0);
+}
+
+// --------------------------------------------------------
+// The frame's lighting - the one definition of the scene's
+// lights, for both the GPU's perFrame buffer and the
+// SoftwareRasterizer
+// --------------------------------------------------------
+SoftwareLights MyDemoGame::GetSceneLights(const RenderSnapshot& frame)
+{
+	SoftwareLights lights;
+	lights.DirLightDirection = XMFLOAT3(0, -1, 0);
+	lights.DirLightColor = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+	lights.PointLightPosition = XMFLOAT3(0, 2, 0);
+	lights.PointLightColor = XMFLOAT4(0.3f, 0.3f, 1.0f, 0.0f);
+	lights.CameraPosition = frame.CameraPosition;
+	lights.PointLights = frame.Lights.empty() ? 0 : &frame.Lights[0];
+	lights.Clusters = lightClusters;
+
+	// Transposed, so row 2 of the view is the camera's forward
+	lights.CameraForward = XMFLOAT3(frame.View.m[2][0], frame.View.m[2][1], frame.View.m[2][2]);
+	return lights;
+}
+
+// --------------------------------------------------------
+// Fills and uploads a PixelShader.hlsl shader's perFrame buffer.
+// Each compiled variant has its own copy of the buffer, so
+// every one of them needs this.
+// --------------------------------------------------------
+void MyDemoGame::SetFrameConstants(SimplePixelShader* ps, const RenderSnapshot& frame)
+{
+	SoftwareLights lights = GetSceneLights(frame);
+	ps->SetFloat3("DirLightDirection"_sn, lights.DirLightDirection);
+	ps->SetFloat4("DirLightColor"_sn, lights.DirLightColor);
+
+	ps->SetFloat3("PointLightPosition"_sn, lights.PointLightPosition);
+	ps->SetFloat4("PointLightColor"_sn, lights.PointLightColor);
+	ps->SetFloat3("CameraPosition"_sn, lights.CameraPosition);
+
+	ps->SetFloat("pixelWidth"_sn, 1.0f / windowWidth);
+	ps->SetFloat("pixelHeight"_sn, 1.0f / windowHeight);
+	ps->SetInt("blurAmount"_sn, 1.0f);
+
+	ps->SetFloat3("CameraForward"_sn, lights.CameraForward);
+	ps->SetFloat2("ClusterScale"_sn, XMFLOAT2(LightClusters::CountX / sceneViewport.Width, LightClusters::CountY / sceneViewport.Height));
+	ps->SetFloat("ClusterDepthScale"_sn, lightClusters->GetDepthScale());
+	ps->SetFloat("ClusterDepthBias"_sn, lightClusters->GetDepthBias());
+	ps->SetFloat("LodBias"_sn, dynamicResolution ? resolution.GetLodBias() : 0.0f);
+	ps->CopyBufferData("perFrame");
+}
+
+// --------------------------------------------------------
+// Puts every single draw's perObject buffer, and the bloom mix
+// for each group, in the constant ring, and sends them all to
+// the GPU in one go
+// --------------------------------------------------------
+void MyDemoGame::UploadObjectConstants(const RenderSnapshot& frame)
+{
+	PROFILE_ZONE("UploadObjectConstants");
+
+	constantRing->BeginFrame();
+	for (int group = 0; group < 4; group++)
+	{
+		SetGroupBloom(GetGroupBloom(frame, group));
+		bloomConstants[group] = pixelShader->AllocateBufferData("perMaterial", constantRing);
+	}
+
+	for (size_t b = 0; b < drawBatches.size(); b++)
+	{
+		DrawBatch& batch = drawBatches[b];
+		if (batch.Instanced)
+			continue;
+
+		const RenderItem& item = *renderQueue.GetCommand(batch.FirstCommand).Item;
+		SimpleVertexShader* vs = item.ItemMaterial->getVert();
+		vs->SetMatrix4x4("world"_sn, item.World);
+		vs->SetMatrix4x4("worldViewProj"_sn, item.WorldViewProj);
+		batch.Constants = vs->AllocateBufferData("perObject", constantRing);
+	}
+	constantRing->Upload();
+}
+
+// --------------------------------------------------------
+// Draws a snapshotted entity.  Its perObject data is already
+// in the constant ring, and per-frame and per-material data,
+// and the material itself, are already set.
+// --------------------------------------------------------
+void MyDemoGame::DrawItem(StateCache* context, const RenderItem& item, const ConstantAllocation& constants)
+{
+	item.ItemMaterial->getVert()->BindBufferData(context, "perObject", constantRing, constants);
+	item.ItemMesh->Draw(context);
+}
+
+// --------------------------------------------------------
+// Draws a run of batches in key order, only changing state
+// when it differs from the previous draw's.  Only binds - all
+// of the data was uploaded before drawing started.
+// --------------------------------------------------------
+int MyDemoGame::DrawBatches(StateCache* context, int first, int end)
+{
+	const Material* boundMaterial = 0;
+	bool boundInstanced = false;
+	int boundVariant = -1;
+	int binds = 0;
+	for (int b = first; b < end; b++)
+	{
+		const DrawBatch& batch = drawBatches[b];
+		if (batch.BatchMaterial != boundMaterial || batch.Instanced != boundInstanced)
+		{
+			if (batch.Instanced)
+				batch.BatchMaterial->prepareInstanced(context);
+			else
+				batch.BatchMaterial->prepareMaterial(context);
+			boundMaterial = batch.BatchMaterial;
+			boundInstanced = batch.Instanced;
+			binds++;
+
+			// The material put the shader's own perMaterial buffer back
+			boundVariant = -1;
+		}
+
+		if (batch.Instanced)
+		{
+			batch.BatchMesh->DrawInstanced(context, instanceBuffer, batch.FirstInstance, batch.Count);
+			continue;
+		}
+
+		// Single draws with the main pixel shader take the bloom mix
+		// from its perMaterial buffer
+		const RenderQueue::Command& command = renderQueue.GetCommand(batch.FirstCommand);
+		if (command.Variant != boundVariant && batch.BatchMaterial->getPix() == pixelShader)
+		{
+			pixelShader->BindBufferData(context, "perMaterial", constantRing, bloomConstants[command.Variant & 3]);
+			boundVariant = command.Variant;
+		}
+		DrawItem(context, *command.Item, batch.Constants);
+	}
+	return binds;
+}
+
+// --------------------------------------------------------
+// One deferred context per job worker.  Without driver support
+// for command lists the runtime emulates them, which works but
+// may not be any faster than drawing on one thread.
+// --------------------------------------------------------
+void MyDemoGame::CreateSubmissionContexts()
+{
+	D3D11_FEATURE_DATA_THREADING threading = {};
+	device->CheckFeatureSupport(D3D11_FEATURE_THREADING, &threading, sizeof(threading));
+	if (!threading.DriverCommandLists)
+		OutputDebugString(L"Deferred contexts: no driver command lists, the runtime will emulate them\n");
+
+	for (int i = 0; i < jobSystem->GetWorkerCount(); i++)
+	{
+		SubmissionContext submission = {};
+		if (FAILED(device->CreateDeferredContext(0, &submission.Context)))
+			break;
+		submission.Cache = new StateCache(submission.Context);
+		submissionContexts.push_back(submission);
 	}
-	for (int i = 0; i < collectibles.size(); i++)
+}
+
+// --------------------------------------------------------
+// Records one run of batches.  A deferred context starts out
+// (and ends up, after FinishCommandList) with default state,
+// so it needs everything DrawScene set up on the immediate
+// context before drawing.
+// --------------------------------------------------------
+void MyDemoGame::RecordSubmission(int start, int end, void* userData)
+{
+	PROFILE_ZONE("RecordSubmission");
+
+	MyDemoGame* game = (MyDemoGame*)userData;
+	for (int i = start; i < end; i++)
 	{
-		// Pass in some light data to the pixel shader
-		pixelShader->SetFloat3("DirLightDirection", XMFLOAT3(0, -1, 0));
-		pixelShader->SetFloat4("DirLightColor", XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
+		SubmissionContext& submission = game->submissionContexts[i];
+		StateCache* cache = submission.Cache;
+		cache->Invalidate();
+		cache->ResetCounters();
+		ID3D11RenderTargetView* target = game->frameGraph->GetRTV(game->sceneColor);
+		cache->OMSetRenderTargets(1, &target, game->frameGraph->GetDSV(game->depthTarget));
+		cache->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		submission.Context->RSSetViewports(1, &game->sceneViewport);
+		cache->SetShaderResources(StateCache::StagePixel, 3, 3, game->lightViews);
+
+		submission.MaterialBinds = game->DrawBatches(cache, submission.FirstBatch, submission.EndBatch);
+		submission.Context->FinishCommandList(FALSE, &submission.CommandList);
+	}
+}
 
-		pixelShader->SetFloat3("PointLightPosition", XMFLOAT3(0, 2, 0));
-		pixelShader->SetFloat4("PointLightColor", XMFLOAT4(0.3f, 0.3f, 1.0f, 0.0f));
-		pixelShader->SetFloat3("CameraPosition", camera->GetPosition());
+// --------------------------------------------------------
+// Splits the batches into runs, records the runs on the job
+// workers and plays them back in order.  Small frames aren't
+// worth splitting, so each run gets at least a few dozen batches.
+// --------------------------------------------------------
+void MyDemoGame::SubmitParallel()
+{
+	const int minBatchesPerRun = 32;
 
-		pixelShader->SetFloat("pixelWidth", 1.0f / windowWidth);
-		pixelShader->SetFloat("pixelHeight", 1.0f / windowHeight);
-		pixelShader->SetInt("blurAmount", 1.0f);
-		pixelShader->SetFloat("bloomAmountX", bloomAmountZ);
-		pixelShader->SetFloat("bloomAmountY", bloomAmountX);
-		pixelShader->SetFloat("bloomAmountZ", bloomAmountY);
+	int batchCount = (int)drawBatches.size();
+	int runs = batchCount / minBatchesPerRun;
+	if (runs > (int)submissionContexts.size()) runs = (int)submissionContexts.size();
+	if (runs < 1) runs = 1;
 
-		collectibles[i]->Draw(deviceContext, camera->GetView(), camera->GetProjection());
+	for (int i = 0; i < runs; i++)
+	{
+		submissionContexts[i].FirstBatch = batchCount * i / runs;
+		submissionContexts[i].EndBatch = batchCount * (i + 1) / runs;
 	}
-	for (int i = 0; i < obstacles.size(); i++)
+	jobSystem->ParallelFor(runs, 1, RecordSubmission, this);
+
+	materialBinds = 0;
+	for (int i = 0; i < runs; i++)
 	{
-		// Pass in some light data to the pixel shader
-		pixelShader->SetFloat3("DirLightDirection", XMFLOAT3(0, -1, 0));
-		pixelShader->SetFloat4("DirLightColor", XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
+		SubmissionContext& submission = submissionContexts[i];
+		if (submission.CommandList)
+		{
+			deviceContext->ExecuteCommandList(submission.CommandList, FALSE);
+			ReleaseMacro(submission.CommandList);
+		}
+		materialBinds += submission.MaterialBinds;
+	}
+	submissionCount = runs;
+
+	// Executing without restoring leaves the immediate context in
+	// its default state, which the state cache doesn't know about
+	stateCache->Invalidate();
+	stateCache->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	deviceContext->RSSetViewports(1, &sceneViewport);
+}
 
-		pixelShader->SetFloat3("PointLightPosition", XMFLOAT3(0, 2, 0));
-		pixelShader->SetFloat4("PointLightColor", XMFLOAT4(0.3f, 0.3f, 1.0f, 0.0f));
-		pixelShader->SetFloat3("CameraPosition", camera->GetPosition());
+// --------------------------------------------------------
+// Adds a group's visible items to the render queue.  The sky
+// is always at the far plane, so it goes last where the depth
+// test can reject most of it.
+// --------------------------------------------------------
+void MyDemoGame::SubmitGroup(const RenderSnapshot& frame, const std::vector<const RenderItem*>& visible, int variant)
+{
+	for (size_t i = 0; i < visible.size(); i++)
+	{
+		const RenderItem* item = visible[i];
+		if (item->Sky)
+			renderQueue.Submit(RenderQueue::PassSky, item, variant, 0.0f);
+		else
+			renderQueue.Submit(RenderQueue::PassOpaque, item, variant, RenderQueue::ViewDepth(frame.View, item->BoundsCenter));
+	}
+}
 
-		pixelShader->SetFloat("pixelWidth", 1.0f / windowWidth);
-		pixelShader->SetFloat("pixelHeight", 1.0f / windowHeight);
-		pixelShader->SetInt("blurAmount", 1.0f);
-		pixelShader->SetFloat("bloomAmountX", bloomAmountY);
-		pixelShader->SetFloat("bloomAmountY", bloomAmountZ);
-		pixelShader->SetFloat("bloomAmountZ", bloomAmountX);
+// --------------------------------------------------------
+// Prepares the frame's draws, runs the frame graph's passes,
+// and presents to the user
+// --------------------------------------------------------
+void MyDemoGame::DrawScene(float deltaTime, float totalTime)
+{
+	PROFILE_ZONE("DrawScene");
+
+	// Count this frame's state changes from here on
+	stateCache->ResetCounters();
+
+	// Count constant buffer traffic for this frame
+	ISimpleShader::ResetUploadCounters();
+
+	// The scene is drawn into the top left of its target, at the
+	// governor's scale, and the post process pass scales it up
+	gpuTimer->BeginFrame();
+	sceneViewport = viewport;
+	sceneViewport.Width = (float)(dynamicResolution ? resolution.ScaleSize(windowWidth) : windowWidth);
+	sceneViewport.Height = (float)(dynamicResolution ? resolution.ScaleSize(windowHeight) : windowHeight);
+
+	// Only read game state through the snapshot - with the pipelined
+	// loop, UpdateScene is changing the live objects right now
+	const RenderSnapshot& frame = snapshots[renderSnapshot];
+
+	// Only draw what the camera can actually see
+	CullScene(frame);
+
+	// Only light pixels with the neon that reaches them
+	BinLights(frame);
+	UploadLights(frame);
+
+	// Per-frame data - uploaded once and shared by every draw, for
+	// both of the pixel shaders built from PixelShader.hlsl
+	SetFrameConstants(pixelShader, frame);
+	SetFrameConstants(instancedPS, frame);
+
+	skyVS->SetMatrix4x4("view"_sn, frame.View);
+	skyVS->SetMatrix4x4("projection"_sn, frame.Projection);
+	skyVS->CopyBufferData("perFrame");
+
+	// Queue up everything visible.  The variant is the group, which
+	// picks that group's mix of the bloom colors below.
+	renderQueue.Clear();
+	SubmitGroup(frame, visibleEntities, 0);
+	SubmitGroup(frame, visiblePlatforms, 1);
+	SubmitGroup(frame, visibleCollectibles, 2);
+	SubmitGroup(frame, visibleObstacles, 3);
+	renderQueue.Sort();
+
+	// Gather instances and send them to the GPU before drawing
+	BuildBatches(frame);
+	UploadInstances();
+	UploadObjectConstants(frame);
+
+	// Scene, post processing, HUD
+	frameGraph->Execute();
+
+	// The GPU's time once it comes back, or else the whole frame's
+	if (gpuTimer->EndFrame())
+		resolution.AddFrame(deltaTime * 1000.0f, gpuTimer->GetLastMs());
+	else if (gpuTimer->GetLastMs() < 0)
+		resolution.AddFrame(deltaTime * 1000.0f, -1.0f);
 
-		obstacles[i]->Draw(deviceContext, camera->GetView(), camera->GetProjection());
+	// Present the buffer
+	//  - Puts the image we're drawing into the window so the user can see it
+	//  - Do this exactly ONCE PER FRAME
+	//  - Always at the very end of the frame
+	frameStats->EndStage(FrameStats::StageSubmit);
+	frameStats->BeginStage(FrameStats::StagePresent);
+	{
+		PROFILE_ZONE("Present");
+		HR(swapChain->Present(0, 0));
 	}
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
+	frameStats->EndStage(FrameStats::StagePresent);
+}
 
-	
+// --------------------------------------------------------
+// Draws the queued batches into the scene color target
+// --------------------------------------------------------
+void MyDemoGame::ScenePass(FrameGraph& graph, void* userData)
+{
+	MyDemoGame* game = (MyDemoGame*)userData;
 
-	//POST-PROCESSING
-	// Done with "regular" rendering - swap to post process
-	deviceContext->OMSetRenderTargets(1, &renderTargetView, 0);
-	deviceContext->ClearRenderTargetView(renderTargetView, color);
+	// Background color (Cornflower Blue in this case) for clearing
+	const float color[4] = {0,0,0,0};// {0.4f, 0.6f, 0.75f, 0.0f};
 
+	ID3D11RenderTargetView* target = graph.GetRTV(game->sceneColor);
+	ID3D11DepthStencilView* depth = graph.GetDSV(game->depthTarget);
+	game->stateCache->OMSetRenderTargets(1, &target, depth);
+	game->deviceContext->RSSetViewports(1, &game->sceneViewport);
+	game->deviceContext->ClearRenderTargetView(target, color);
+	game->deviceContext->ClearDepthStencilView(depth, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
 
-	// Draw the post process
-	ppVS->SetShader();
+	// Materials only bind t0-t2, so the lights stay put
+	game->stateCache->SetShaderResources(StateCache::StagePixel, 3, 3, game->lightViews);
 
+	// Draw in key order, on the job workers if there's more than one
+	if (game->submissionContexts.size() > 1)
+	{
+		game->SubmitParallel();
+	}
+	else
+	{
+		game->materialBinds = game->DrawBatches(game->stateCache, 0, (int)game->drawBatches.size());
+		game->submissionCount = 0;
+	}
+}
+
+// --------------------------------------------------------
+// Starts a fullscreen triangle into a target of the given size
+// --------------------------------------------------------
+void MyDemoGame::BeginFullscreen(MaterialSlot material, ID3D11RenderTargetView* target, unsigned int width, unsigned int height)
+{
+	stateCache->OMSetRenderTargets(1, &target, 0);
 
-	ppPS->SetInt("blurAmount", 1.5f);
-	ppPS->SetFloat("pixelWidth", 1.0f / windowWidth);
-	ppPS->SetFloat("pixelHeight", 1.0f / windowHeight);
-	ppPS->SetShaderResourceView("pixels", ppSRV);
-	ppPS->SetSamplerState("trilinear", sampler);
-	ppPS->SetShader();
+	D3D11_VIEWPORT fullscreen = {};
+	fullscreen.Width = (float)width;
+	fullscreen.Height = (float)height;
+	fullscreen.MaxDepth = 1.0f;
+	deviceContext->RSSetViewports(1, &fullscreen);
 
-	
+	// Its pipeline has the default states, since the sky may have
+	// been the last thing drawn
+	materials[material]->prepareMaterial(stateCache);
+}
 
+// --------------------------------------------------------
+// Draws the triangle set up by BeginFullscreen, then unbinds
+// its sources - the next pass may draw into the same texture
+// --------------------------------------------------------
+void MyDemoGame::EndFullscreen()
+{
 	// Turn off existing vert/index buffers
+	UINT stride = sizeof(Vertex);
+	UINT offset = 0;
 	ID3D11Buffer* nothing = 0;
-	deviceContext->IASetVertexBuffers(0, 1, &nothing, &stride, &offset);
-	deviceContext->IASetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
+	stateCache->IASetVertexBuffers(0, 1, &nothing, &stride, &offset);
+	stateCache->IASetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
 
 	// Finally - DRAW!
 	deviceContext->Draw(3, 0);
 
+	ID3D11ShaderResourceView* none[2] = { 0, 0 };
+	stateCache->SetShaderResources(StateCache::StagePixel, 0, 2, none);
+}
+
+// --------------------------------------------------------
+// Keeps the scene's brightest parts, at half size
+// --------------------------------------------------------
+void MyDemoGame::BloomThresholdPass(FrameGraph& graph, void* userData)
+{
+	MyDemoGame* game = (MyDemoGame*)userData;
+
+	unsigned int width, height;
+	graph.GetSize(game->bloomBright, width, height);
+	game->BeginFullscreen(MaterialBloomThreshold, graph.GetRTV(game->bloomBright), width, height);
+
+	SimplePixelShader* ps = game->bloomThresholdPS;
+	ps->SetFloat("threshold"_sn, game->bloomSettings.Threshold);
+	ps->SetFloat("knee"_sn, game->bloomSettings.Knee);
+	game->SetSceneUV(ps, graph);
+	ps->SetShaderResourceView("pixels", graph.GetSRV(game->sceneColor));
+	ps->CopyAllBufferData();
+
+	game->EndFullscreen();
+}
+
+// --------------------------------------------------------
+// Where the scene pass drew in sceneColor, for the passes that
+// read it - stopping half a texel in, so bilinear filtering
+// never picks up the undrawn part
+// --------------------------------------------------------
+void MyDemoGame::SetSceneUV(SimplePixelShader* ps, FrameGraph& graph)
+{
+	unsigned int width, height;
+	graph.GetSize(sceneColor, width, height);
+	ps->SetFloat2("sceneUVScale"_sn, XMFLOAT2(sceneViewport.Width / width, sceneViewport.Height / height));
+	ps->SetFloat2("sceneUVMax"_sn, XMFLOAT2((sceneViewport.Width - 0.5f) / width, (sceneViewport.Height - 0.5f) / height));
+}
+
+// --------------------------------------------------------
+// One direction of the separable blur
+// --------------------------------------------------------
+void MyDemoGame::DrawBloomBlur(FrameGraph& graph, int source, int dest, bool horizontal)
+{
+	unsigned int width, height;
+	graph.GetSize(dest, width, height);
+	BeginFullscreen(MaterialBloomBlur, graph.GetRTV(dest), width, height);
+
+	float weights[BloomFilter::MaxRadius + 1];
+	BloomFilter::GaussianWeights(bloomSettings.Radius, bloomSettings.Sigma, weights);
+	int radius = bloomSettings.Radius < BloomFilter::MaxRadius ? bloomSettings.Radius : BloomFilter::MaxRadius;
+
+	XMFLOAT2 texelStep = horizontal ? XMFLOAT2(1.0f / width, 0.0f) : XMFLOAT2(0.0f, 1.0f / height);
+	bloomBlurPS->SetFloat2("texelStep"_sn, texelStep);
+	bloomBlurPS->SetInt("radius"_sn, radius);
+	bloomBlurPS->SetData("weights"_sn, weights, sizeof(weights));
+	bloomBlurPS->SetShaderResourceView("pixels", graph.GetSRV(source));
+	bloomBlurPS->CopyAllBufferData();
+
+	EndFullscreen();
+}
+
+void MyDemoGame::BloomAcrossPass(FrameGraph& graph, void* userData)
+{
+	MyDemoGame* game = (MyDemoGame*)userData;
+	game->DrawBloomBlur(graph, game->bloomBright, game->bloomAcross, true);
+}
+
+void MyDemoGame::BloomDownPass(FrameGraph& graph, void* userData)
+{
+	MyDemoGame* game = (MyDemoGame*)userData;
+	game->DrawBloomBlur(graph, game->bloomAcross, game->bloomBlurred, false);
+}
+
+// --------------------------------------------------------
+// Adds the blurred bloom to the scene, into the back buffer
+// --------------------------------------------------------
+void MyDemoGame::PostProcessPass(FrameGraph& graph, void* userData)
+{
+	MyDemoGame* game = (MyDemoGame*)userData;
+	const float color[4] = {0,0,0,0};
+
+	ID3D11RenderTargetView* target = graph.GetRTV(game->backBuffer);
+	game->BeginFullscreen(MaterialPostProcess, target, game->windowWidth, game->windowHeight);
+	game->deviceContext->ClearRenderTargetView(target, color);
+
+	SimplePixelShader* ps = game->bloomCombinePS;
+	ps->SetFloat("intensity"_sn, game->bloomSettings.Intensity);
+	game->SetSceneUV(ps, graph);
+	ps->SetShaderResourceView("pixels", graph.GetSRV(game->sceneColor));
+	ps->SetShaderResourceView("bloom", graph.GetSRV(game->bloomBlurred));
+	ps->CopyAllBufferData();
+
+	game->EndFullscreen();
+}
+
+// --------------------------------------------------------
+// Draws the HUD over the back buffer
+// --------------------------------------------------------
+void MyDemoGame::HudPass(FrameGraph& graph, void* userData)
+{
+	MyDemoGame* game = (MyDemoGame*)userData;
+	const RenderSnapshot& frame = game->snapshots[game->renderSnapshot];
+	ConstantRing* constantRing = game->constantRing;
+	StateCache* stateCache = game->stateCache;
 
 	// HUD IMAGES
-	GUI::DrawImage("topbar", 0, 0, 1000, 55);
+	GUI::DrawImage("topbar", 0, 0, 1000, HudTopBarHeight);
 
 	// TEXT - Has to come after draw
-	if (GameOver) {
+	if (frame.GameOver) {
+		// Two lines apart, around the middle of the window
+		int lineHeight = GUI::GetLineSpacing("fixedsys");
+		int messageX = game->windowWidth * 3 / 8;
+		int messageY = game->windowHeight / 2 - lineHeight * 2;
 		GUI::BeginStringDraw();
-		GUI::DrawString("fixedsys", 300, 250, L"Game Over");
-		GUI::DrawString("fixedsys", 300, 300, L"Press 'P' To Play Again");
+		GUI::DrawString("fixedsys", messageX, messageY, L"Game Over");
+		GUI::DrawString("fixedsys", messageX, messageY + lineHeight * 2, L"Press 'P' To Play Again");
 		GUI::EndStringDraw();
 	}
 	else {
-		std::wstring string_score = std::to_wstring(score);
-		while (string_score.size() < 8) string_score = L"0" + string_score;
-
-		GUI::BeginStringDraw();
-		GUI::DrawString("fixedsys", 0, 0, (L"Score: " + string_score).c_str());
-		GUI::EndStringDraw();
-	}
+		// Rows are a line of the font apart.  The stats stack up
+		// from the bottom of the window and the right column runs
+		// down from the top bar, so both follow the window's size.
+		int lineHeight = GUI::GetLineSpacing("fixedsys");
+		int statLines = 10;
+#ifdef MEMORY_TRACKING_ENABLED
+		statLines++;
+#endif
+		int statsY = game->windowHeight - statLines * lineHeight;
+		int rightX = game->windowWidth - HudRightColumnWidth;
+		int rightY = HudTopBarHeight + lineHeight / 4;
 
-	
+		// Each line is formatted here and drawn straight away (the
+		// sprite font copies out its glyphs), so the HUD never
+		// allocates
+		wchar_t text[HudLineLength];
+		int length;
 
-	// Unbind the SRV so the underlying texture isn't bound for
-	// both input and output at the start of next frame
-	ppPS->SetShaderResourceView("pixels", 0);
+		GUI::BeginStringDraw();
+		swprintf_s(text, HudLineLength, L"Score: %08d", frame.Score);
+		GUI::DrawString("fixedsys", 0, 0, text);
+
+#ifdef MEMORY_TRACKING_ENABLED
+		// The heap - everything above the other stats, then each
+		// subsystem in the right column
+		MemoryTagStats memory = MemoryTracker::GetTotals();
+		swprintf_s(text, HudLineLength, L"Heap: %lld KB in %lld blocks  Peak: %lld KB  Allocations last frame: %lld",
+			memory.LiveBytes / 1024, memory.LiveCount, memory.PeakBytes / 1024, memory.FrameCount);
+		GUI::DrawString("fixedsys", 0, statsY, text);
+		statsY += lineHeight;
+#endif
 
-	
+		// Over the frame stats' window, so hitches show up as p99 and max
+		FrameStageStats frameTimes = game->frameStats->GetWindowStats(FrameStats::StageFrame);
+		swprintf_s(text, HudLineLength, L"Frame ms  p50: %.2f  p95: %.2f  p99: %.2f  max: %.2f",
+			frameTimes.P50, frameTimes.P95, frameTimes.P99, frameTimes.Max);
+		GUI::DrawString("fixedsys", 0, statsY + 0 * lineHeight, text);
+
+		swprintf_s(text, HudLineLength, L"p99 ms  Update: %.2f  Submit: %.2f  Present: %.2f",
+			game->frameStats->GetWindowStats(FrameStats::StageUpdate).P99,
+			game->frameStats->GetWindowStats(FrameStats::StageSubmit).P99,
+			game->frameStats->GetWindowStats(FrameStats::StagePresent).P99);
+		GUI::DrawString("fixedsys", 0, statsY + 1 * lineHeight, text);
+
+		length = swprintf_s(text, HudLineLength, L"Render scale: %d%% (%dx%d)  GPU: ",
+			(int)(game->sceneViewport.Width * 100 / game->windowWidth), (int)game->sceneViewport.Width, (int)game->sceneViewport.Height);
+		if (game->gpuTimer->GetLastMs() < 0)
+			length += swprintf_s(text + length, HudLineLength - length, L"-");
+		else
+			length += swprintf_s(text + length, HudLineLength - length, L"%d us", (int)(game->gpuTimer->GetLastMs() * 1000.0f));
+		swprintf_s(text + length, HudLineLength - length, L"  LOD bias: %.2f%s",
+			game->dynamicResolution ? game->resolution.GetLodBias() : 0.0f, game->dynamicResolution ? L"" : L"  (off)");
+		GUI::DrawString("fixedsys", 0, statsY + 2 * lineHeight, text);
+
+		length = swprintf_s(text, HudLineLength, L"Lights: %d", game->lightClusters->GetLightCount());
+		if (frame.DroppedLights > 0)
+			length += swprintf_s(text + length, HudLineLength - length, L" (%d over the limit)", frame.DroppedLights);
+		length += swprintf_s(text + length, HudLineLength - length, L"  Indices: %d  Busiest cluster: %d",
+			game->lightClusters->GetIndexCount(), game->lightClusters->GetBusiestCluster());
+		if (game->lightClusters->GetDroppedCount() > 0)
+			swprintf_s(text + length, HudLineLength - length, L"  Dropped: %d", game->lightClusters->GetDroppedCount());
+		GUI::DrawString("fixedsys", 0, statsY + 3 * lineHeight, text);
+
+		swprintf_s(text, HudLineLength, L"Targets: %d  %llu KB  Bloom samples/pixel: %.1f",
+			graph.GetTextureCount(), graph.GetMemoryBytes() / 1024, BloomFilter::ChainSamplesPerPixel(game->bloomSettings));
+		GUI::DrawString("fixedsys", 0, statsY + 4 * lineHeight, text);
+
+		swprintf_s(text, HudLineLength, L"CB ring: %u/%u KB  Wraps: %u%s",
+			constantRing->GetFrameBytes() / 1024, constantRing->GetCapacity() / 1024, constantRing->GetWrapCount(),
+			constantRing->HasOffsets() ? L"" : L"  (no offsets)");
+		GUI::DrawString("fixedsys", 0, statsY + 5 * lineHeight, text);
+
+		// Deferred contexts' calls count too
+		int issuedCalls = stateCache->GetIssuedCount();
+		int filteredCalls = stateCache->GetFilteredCount();
+		for (int i = 0; i < game->submissionCount; i++)
+		{
+			issuedCalls += game->submissionContexts[i].Cache->GetIssuedCount();
+			filteredCalls += game->submissionContexts[i].Cache->GetFilteredCount();
+		}
+		length = swprintf_s(text, HudLineLength, L"State calls: %d  Filtered: %d", issuedCalls, filteredCalls);
+		if (game->submissionCount > 0)
+			swprintf_s(text + length, HudLineLength - length, L"  Command lists: %d", game->submissionCount);
+		GUI::DrawString("fixedsys", 0, statsY + 6 * lineHeight, text);
+
+		swprintf_s(text, HudLineLength, L"Draws: %d  Objects: %d  Material binds: %d",
+			(int)game->drawBatches.size(), game->renderQueue.GetCount(), game->materialBinds);
+		GUI::DrawString("fixedsys", 0, statsY + 7 * lineHeight, text);
+
+		swprintf_s(text, HudLineLength, L"CB uploads a frame: %u  Bytes: %u  Skipped: %u",
+			ISimpleShader::GetUploadCount(), ISimpleShader::GetUploadedBytes(), ISimpleShader::GetSkippedCount());
+		GUI::DrawString("fixedsys", 0, statsY + 8 * lineHeight, text);
+
+		swprintf_s(text, HudLineLength, L"Visible: %d  Culled: %d  Occluded: %d (%d us)",
+			game->visibleCount, game->culledCount, game->occludedCount, (int)(game->occlusionMs * 1000.0));
+		GUI::DrawString("fixedsys", 0, statsY + 9 * lineHeight, text);
+
+#ifdef PROFILER_ENABLED
+		// The profiler's slowest zones, down the right side
+		ProfileZoneStats zones[HudZoneCount];
+		int zoneCount = Profiler::GetTopZones(zones, HudZoneCount);
+		for (int i = 0; i < zoneCount; i++)
+		{
+			swprintf_s(text, HudLineLength, L"%.40hs  %.3f ms  x%d", zones[i].Name, zones[i].Ms, (int)(zones[i].Calls + 0.5));
+			GUI::DrawString("fixedsys", rightX, rightY, text);
+			rightY += lineHeight;
+		}
+		rightY += lineHeight / 2;
+#endif
 
-	// Present the buffer
-	//  - Puts the image we're drawing into the window so the user can see it
-	//  - Do this exactly ONCE PER FRAME
-	//  - Always at the very end of the frame
-	HR(swapChain->Present(0, 0));
+#ifdef MEMORY_TRACKING_ENABLED
+		for (int t = 0; t < MemoryTracker::TagCount; t++)
+		{
+			MemoryTagStats tag = MemoryTracker::GetStats((MemoryTracker::Tag)t);
+			swprintf_s(text, HudLineLength, L"%hs  %lld KB  peak %lld KB  x%lld", MemoryTracker::GetTagName((MemoryTracker::Tag)t),
+				tag.LiveBytes / 1024, tag.PeakBytes / 1024, tag.FrameCount);
+			GUI::DrawString("fixedsys", rightX, rightY, text);
+			rightY += lineHeight;
+		}
+#endif
+		GUI::EndStringDraw();
+	}
 }
 
 #pragma endregion
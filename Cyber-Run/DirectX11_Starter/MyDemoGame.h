@@ -7,8 +7,22 @@
 #include "Mesh.h"
 #include "Camera.h"
 #include "GameEntity.h"
+#include "EntityPool.h"
+#include "MaterialLibrary.h"
+#include "SweptCollider.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "LightClusters.h"
+#include "RenderSnapshot.h"
+#include "AutoPlayer.h"
+#include "RenderQueue.h"
 
 #include "GUI.h"
+#include "FrameGraph.h"
+#include "BloomFilter.h"
+#include "SoftwareRasterizer.h"
+#include "DynamicResolution.h"
+#include "GpuTimer.h"
 
 #include <vector>
 
@@ -31,6 +45,7 @@ public:
 	// Overrides for base level methods
 	bool Init();
 	void OnResize();
+	void SampleInput();
 	void UpdateScene(float deltaTime, float totalTime);
 	void DrawScene(float deltaTime, float totalTime);
 
@@ -39,17 +54,71 @@ public:
 	void OnMouseUp(WPARAM btnState, int x, int y);
 	void OnMouseMove(WPARAM btnState, int x, int y);
 
+	// Records draws on deferred contexts across the job workers
+	// instead of all on the immediate context.  Set before Init().
+	void SetParallelSubmission(bool enabled) { parallelSubmission = enabled; }
+
+	// Draws the scene smaller when frames take too long, and
+	// scales it up in post processing (see DynamicResolution).
+	// On by default.
+	void SetDynamicResolution(bool enabled) { dynamicResolution = enabled; resolution.Reset(); }
+	void SetDynamicResolution(const DynamicResolutionSettings& settings) { dynamicResolution = true; resolution.SetSettings(settings); }
+
+	// Lets the AutoPlayer drive instead of the keyboard
+	void SetAutoPlay(bool enabled) { autoPlay = enabled; autoPlayer.Reset(); }
+
+	// Scripted controls for headless runs without the bot - they
+	// hold until the next call
+	void SetInput(const InputState& controls) { input = controls; }
+
+	// Simulation without a window or device, for soak runs
+	bool InitHeadless();
+	void StepHeadless(float deltaTime, float totalTime);
+	int GetScore() { return score; }
+	float GetDistance() { return pData.position.z; }
+	bool IsGameOver();
+	int GetEntityCount();
+	int GetEntityPoolCapacity() { return entityPool.GetCapacity(); }
+
+	// Culls the latest simulated frame without drawing it, for
+	// headless runs
+	void CullHeadless();
+	int GetVisibleCount() { return visibleCount; }
+	int GetCulledCount() { return culledCount; }
+	int GetOccludedCount() { return occludedCount; }
+	double GetOcclusionMs() { return occlusionMs; }
+	LightClusters* GetLightClusters() { return lightClusters; }
+
+	// Draws the latest simulated frame on the CPU, for headless
+	// runs - call after InitHeadless()
+	bool InitSoftwareRendering(int width, int height);
+	void DrawSoftware();
+	SoftwareRasterizer* GetSoftwareRasterizer() { return softwareRasterizer; }
+
 private:
     // Input and mesh swapping
     bool prevSpaceBar;
+	bool prevTraceKey;		// F9 writes profile.json
+
+	// Where each material is in "materials" - headless runs only
+	// have the first two
+	enum MaterialSlot
+	{
+		MaterialMain,
+		MaterialSky,
+		MaterialPostProcess,
+		MaterialBloomThreshold,
+		MaterialBloomBlur
+	};
 
     // Keep track of "stuff"
     std::vector<Mesh*> meshes;
-	std::vector<Material*> materials;
+	std::vector<Material*> materials;	// Owned by materialLibrary, if there is one
     std::vector<GameEntity*> entities;
 	std::vector<GameEntity*> collectibles;
 	std::vector<GameEntity*> platforms;
 	std::vector<GameEntity*> obstacles;
+	EntityPool entityPool;				// Owns every entity in the lists above
 
 	struct float3 {
 		float x, y, z;
@@ -83,29 +152,182 @@ private:
 	void LoadShaders();
 	void CreateMatrices();
 
+	// Gameplay helpers
+	void SweepCollisions(float3 start);
+	void SpawnCollectible();
+
+	// Continuous collision against obstacles and collectibles
+	SweptCollider collider;
+	std::vector<SweptHit> sweepHits;
+
+	// Controls for this frame, read on the main thread by SampleInput()
+	// so that UpdateScene can run on a worker
+	InputState input;
+	AutoPlayer autoPlayer;
+	bool autoPlay;
+	bool headless;			// Set by InitHeadless - no keyboard
+
+	// What gets drawn - UpdateScene fills snapshots[simulationSnapshot]
+	// and DrawScene reads snapshots[renderSnapshot]
+	RenderSnapshot snapshots[2];
+	void CaptureSnapshot(RenderSnapshot& frame);
+	void CaptureGroup(std::vector<GameEntity*>& group, std::vector<RenderItem>& items, DirectX::XMFLOAT4X4 viewProj);
+	void SetGroupBloom(const DirectX::XMFLOAT3& bloom);
+	DirectX::XMFLOAT3 GetGroupBloom(const RenderSnapshot& frame, int group);
+	void DrawItem(StateCache* context, const RenderItem& item, const ConstantAllocation& constants);
+
+	// Sorted draws for this frame, and how often the material changed
+	RenderQueue renderQueue;
+	void SubmitGroup(const RenderSnapshot& frame, const std::vector<const RenderItem*>& visible, int variant);
+	int materialBinds;
+
+	// Instancing - runs of the sorted queue that share a mesh and
+	// material are drawn at once, with per-object data in one
+	// dynamic vertex buffer filled each frame
+	struct DrawBatch
+	{
+		int FirstCommand;
+		int FirstInstance;
+		int Count;
+		bool Instanced;
+		Mesh* BatchMesh;
+		Material* BatchMaterial;
+		ConstantAllocation Constants;	// Single draws' perObject data
+	};
+	std::vector<DrawBatch> drawBatches;
+	std::vector<InstanceData> instances;
+	ID3D11Buffer* instanceBuffer;
+	int instanceCapacity;
+	void BuildBatches(const RenderSnapshot& frame);
+	void UploadInstances();
+
+	// Every single draw's perObject data and each group's bloom mix,
+	// copied into the constant ring before any drawing starts, so
+	// drawing never writes shader data and can run on any thread
+	ConstantAllocation bloomConstants[4];
+	void UploadObjectConstants(const RenderSnapshot& frame);
+
+	// Draws batches [first, end) through one context, returning how
+	// many times the material changed
+	int DrawBatches(StateCache* context, int first, int end);
+
+	// Parallel submission - the batches are split into runs in queue
+	// order, each run is recorded into its own deferred context by a
+	// job, and the command lists are played back in the same order
+	struct SubmissionContext
+	{
+		ID3D11DeviceContext* Context;
+		StateCache* Cache;
+		ID3D11CommandList* CommandList;
+		int FirstBatch;
+		int EndBatch;
+		int MaterialBinds;
+	};
+	bool parallelSubmission;
+	std::vector<SubmissionContext> submissionContexts;
+	int submissionCount;
+	void CreateSubmissionContexts();
+	void SubmitParallel();
+	static void RecordSubmission(int start, int end, void* userData);
+
+	// View frustum culling - per-frame visible lists and counters
+	void CullEntities(const DirectX::XMFLOAT4 frustum[6], const std::vector<RenderItem>& group, std::vector<const RenderItem*>& visible);
+	FrustumCuller culler;
+	std::vector<int> visibleIndices;
+	std::vector<const RenderItem*> visibleEntities;
+	std::vector<const RenderItem*> visiblePlatforms;
+	std::vector<const RenderItem*> visibleCollectibles;
+	std::vector<const RenderItem*> visibleObstacles;
+	int visibleCount;
+	int culledCount;
+
+	// Occlusion culling - the platforms and obstacles hide what's
+	// behind them (see OcclusionCuller)
+	void CullScene(const RenderSnapshot& frame);
+	void AddOccluder(const RenderItem& item);
+	void RemoveOccluded(std::vector<const RenderItem*>& visible);
+	OcclusionCuller occlusion;
+	int occludedCount;
+	double occlusionMs;
+
+	// Neon point lights - gathered from the level into each
+	// snapshot, binned into clusters each frame, and read by the
+	// pixel shader from t3-t5 (see LightClusters)
+	void CaptureLights(RenderSnapshot& frame);
+	void CreateLightBuffers();
+	void BinLights(const RenderSnapshot& frame);
+	void UploadLights(const RenderSnapshot& frame);
+	SoftwareLights GetSceneLights(const RenderSnapshot& frame);
+	void SetFrameConstants(SimplePixelShader* ps, const RenderSnapshot& frame);
+	LightClusters* lightClusters;
+	ID3D11Buffer* lightBuffer;
+	ID3D11Buffer* clusterRangeBuffer;
+	ID3D11Buffer* lightIndexBuffer;
+	ID3D11ShaderResourceView* lightViews[3];
+
+	// Dynamic resolution - the governor picks the scene pass's
+	// viewport from the GPU's frame times
+	bool dynamicResolution;
+	DynamicResolution resolution;
+	GpuTimer* gpuTimer;
+	D3D11_VIEWPORT sceneViewport;
+	void SetSceneUV(SimplePixelShader* ps, FrameGraph& graph);
+
 	// Wrappers for DirectX shaders to provide simplified functionality
 	SimpleVertexShader* vertexShader;
 	SimplePixelShader* pixelShader;
+	SimpleShaderHandle bloomHandles[3];
+	SimpleVertexShader* instancedVS;
+	SimplePixelShader* instancedPS;
 
 	// Sky stuff
 	SimpleVertexShader* skyVS;
 	SimplePixelShader* skyPS;
-	ID3D11ShaderResourceView*	skyTexture;
-	ID3D11RasterizerState*		rasterState;
-	ID3D11DepthStencilState*	depthState;
 
-	// Post process stuff
-	ID3D11RenderTargetView* ppRTV;
-	ID3D11ShaderResourceView* ppSRV;
+	// Post process stuff - a fullscreen triangle, and the bloom
+	// chain's passes (see BloomFilter for the CPU version)
 	SimpleVertexShader* ppVS;
-	SimplePixelShader* ppPS;
+	SimplePixelShader* bloomThresholdPS;
+	SimplePixelShader* bloomBlurPS;
+	SimplePixelShader* bloomCombinePS;
+	ID3D11SamplerState* clampSampler;	// Owned by the pipeline cache
+	BloomSettings bloomSettings;
+
+	// The frame as passes - the scene draws into sceneColor (from
+	// the graph's pool), bloom is extracted and blurred at half
+	// size, combined with the scene into the back buffer, and the
+	// HUD goes on top
+	FrameGraph* frameGraph;
+	int sceneColor;
+	int bloomBright;
+	int bloomAcross;
+	int bloomBlurred;
+	int depthTarget;
+	int backBuffer;
+	void CreateFrameGraph();
+	void BeginFullscreen(MaterialSlot material, ID3D11RenderTargetView* target, unsigned int width, unsigned int height);
+	void EndFullscreen();
+	void DrawBloomBlur(FrameGraph& graph, int source, int dest, bool horizontal);
+	static void ScenePass(FrameGraph& graph, void* userData);
+	static void BloomThresholdPass(FrameGraph& graph, void* userData);
+	static void BloomAcrossPass(FrameGraph& graph, void* userData);
+	static void BloomDownPass(FrameGraph& graph, void* userData);
+	static void PostProcessPass(FrameGraph& graph, void* userData);
+	static void HudPass(FrameGraph& graph, void* userData);
 
+	// Software rendering - the main and sky materials' textures
+	// as TGAs, or stand-ins when those can't be read
+	SoftwareRasterizer* softwareRasterizer;
+	SoftwareTexture softwareDiffuse;
+	SoftwareTexture softwareNormals;
+	SoftwareTexture softwareSky;
+	SoftwareMaterial softwareMain;
+	SoftwareMaterial softwareSkyMaterial;
+	void SubmitSoftware(const RenderSnapshot& frame, const std::vector<const RenderItem*>& visible, int group, bool sky);
 
-    // Texture stuff
-    ID3D11ShaderResourceView* texture;
-	ID3D11ShaderResourceView* playertexture;
-	ID3D11ShaderResourceView* normalMap;
-    ID3D11SamplerState* sampler;
+    // Materials and the textures they use, from materials.txt
+    MaterialLibrary* materialLibrary;
+    ID3D11SamplerState* sampler;	// Owned by the pipeline cache
 
 	// Basic debug camera
 	Camera* camera;
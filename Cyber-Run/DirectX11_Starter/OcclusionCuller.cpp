@@ -0,0 +1,435 @@
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <cmath>
+#include <xmmintrin.h>
+
+using namespace DirectX;
+
+// The box's 12 triangles, by corner (bit 0 is +x, 1 is +y, 2 is +z).
+// Both sides are drawn, so winding doesn't matter.
+static const int BoxTriangles[12][3] =
+{
+	{ 0, 2, 6 }, { 0, 6, 4 },	// -x
+	{ 1, 3, 7 }, { 1, 7, 5 },	// +x
+	{ 0, 1, 5 }, { 0, 5, 4 },	// -y
+	{ 2, 3, 7 }, { 2, 7, 6 },	// +y
+	{ 0, 1, 3 }, { 0, 3, 2 },	// -z
+	{ 4, 5, 7 }, { 4, 7, 6 },	// +z
+};
+
+// Clip space to the depth buffer's pixels, false if it's at
+// or behind the eye
+static bool ToScreen(const float* v, float& x, float& y)
+{
+	if (v[3] <= 0.000001f)
+		return false;
+	float invW = 1.0f / v[3];
+	x = (v[0] * invW * 0.5f + 0.5f) * OcclusionCuller::Width;
+	y = (0.5f - v[1] * invW * 0.5f) * OcclusionCuller::Height;
+	return true;
+}
+
+// Orders screen points left to right, then top to bottom
+struct OutlinePoint
+{
+	float X, Y;
+	bool operator<(const OutlinePoint& other) const { return X < other.X || (X == other.X && Y < other.Y); }
+};
+
+static float Cross(const OutlinePoint& o, const OutlinePoint& a, const OutlinePoint& b)
+{
+	return (a.X - o.X) * (b.Y - o.Y) - (a.Y - o.Y) * (b.X - o.X);
+}
+
+OcclusionCuller::OcclusionCuller()
+	: depth(Width * Height, 1.0f), tileMax(TilesX * TilesY, 1.0f)
+{
+	outlineCount = 0;
+	occluderCount = 0;
+	triangleCount = 0;
+	testCount = 0;
+	occludedCount = 0;
+}
+
+OcclusionCuller::~OcclusionCuller()
+{ }
+
+void OcclusionCuller::Begin()
+{
+	depth.assign(depth.size(), 1.0f);
+	tileMax.assign(tileMax.size(), 1.0f);
+	occluderCount = 0;
+	triangleCount = 0;
+	testCount = 0;
+	occludedCount = 0;
+}
+
+// --------------------------------------------------------
+// Clip space corners of a box.  Row j of a transposed matrix
+// is column j of the original, so each coordinate is a dot
+// product with a row.
+// --------------------------------------------------------
+void OcclusionCuller::TransformBox(const XMFLOAT4X4& m, const XMFLOAT3& center, const XMFLOAT3& extents, float corners[8][4])
+{
+	for (int i = 0; i < 8; i++)
+	{
+		float x = center.x + ((i & 1) ? extents.x : -extents.x);
+		float y = center.y + ((i & 2) ? extents.y : -extents.y);
+		float z = center.z + ((i & 4) ? extents.z : -extents.z);
+		for (int j = 0; j < 4; j++)
+			corners[i][j] = m.m[j][0] * x + m.m[j][1] * y + m.m[j][2] * z + m.m[j][3];
+	}
+}
+
+// --------------------------------------------------------
+// Draws a box's triangles, clipping the ones that cross the
+// near plane (z = 0).  Boxes entirely off one side of the
+// view are skipped.
+//
+// Where the box's faces meet inside its outline, pixels are
+// drawn if their centers are covered, so the faces leave no
+// gaps between them.  Only the outline - the convex hull of
+// everything drawn - has to cover a pixel completely.
+// --------------------------------------------------------
+void OcclusionCuller::AddOccluder(const XMFLOAT4X4& worldViewProj, const XMFLOAT3& center, const XMFLOAT3& extents)
+{
+	float corners[8][4];
+	TransformBox(worldViewProj, center, extents, corners);
+
+	int outside = 0x1f;
+	for (int i = 0; i < 8; i++)
+	{
+		const float* p = corners[i];
+		int code = 0;
+		if (p[0] < -p[3]) code |= 1;
+		if (p[0] > p[3]) code |= 2;
+		if (p[1] < -p[3]) code |= 4;
+		if (p[1] > p[3]) code |= 8;
+		if (p[2] < 0) code |= 16;
+		outside &= code;
+	}
+	if (outside)
+		return;
+	occluderCount++;
+
+	// Each triangle leaves a triangle, a quad or nothing
+	float clipped[12][4][4];
+	int counts[12];
+	float points[12 * 4][2];
+	int pointCount = 0;
+	for (int t = 0; t < 12; t++)
+	{
+		const float* v[3] = { corners[BoxTriangles[t][0]], corners[BoxTriangles[t][1]], corners[BoxTriangles[t][2]] };
+		int count = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			const float* a = v[k];
+			const float* b = v[(k + 1) % 3];
+			if (a[2] >= 0)
+			{
+				for (int c = 0; c < 4; c++)
+					clipped[t][count][c] = a[c];
+				count++;
+			}
+			if ((a[2] >= 0) != (b[2] >= 0))
+			{
+				float s = a[2] / (a[2] - b[2]);
+				for (int c = 0; c < 4; c++)
+					clipped[t][count][c] = a[c] + (b[c] - a[c]) * s;
+				count++;
+			}
+		}
+		counts[t] = count;
+
+		for (int k = 0; k < count; k++)
+		{
+			if (ToScreen(clipped[t][k], points[pointCount][0], points[pointCount][1]))
+				pointCount++;
+		}
+	}
+
+	BuildOutline(points, pointCount);
+	if (outlineCount < 3)
+		return;
+
+	for (int t = 0; t < 12; t++)
+	{
+		for (int k = 1; k + 1 < counts[t]; k++)
+			DrawTriangle(clipped[t][0], clipped[t][k], clipped[t][k + 1]);
+	}
+}
+
+// --------------------------------------------------------
+// The convex hull of the points (Andrew's monotone chain), as
+// edge functions that are positive inside.  Each edge is moved
+// in until it only passes pixels whose every corner is inside:
+// over a pixel, A x + B y + C is lowest at the corner half a
+// pixel from the center in each direction, so subtracting
+// (|A| + |B|) / 2 tests that corner at the pixel's center.
+// --------------------------------------------------------
+void OcclusionCuller::BuildOutline(const float points[][2], int count)
+{
+	outlineCount = 0;
+	if (count < 3)
+		return;
+
+	OutlinePoint sorted[12 * 4];
+	for (int i = 0; i < count; i++)
+	{
+		sorted[i].X = points[i][0];
+		sorted[i].Y = points[i][1];
+	}
+	std::sort(sorted, sorted + count);
+
+	// Lower then upper chain, dropping points that don't turn
+	OutlinePoint hull[12 * 4 + 1];
+	int size = 0;
+	for (int i = 0; i < count; i++)
+	{
+		while (size >= 2 && Cross(hull[size - 2], hull[size - 1], sorted[i]) <= 0)
+			size--;
+		hull[size++] = sorted[i];
+	}
+	int lower = size + 1;
+	for (int i = count - 2; i >= 0; i--)
+	{
+		while (size >= lower && Cross(hull[size - 2], hull[size - 1], sorted[i]) <= 0)
+			size--;
+		hull[size++] = sorted[i];
+	}
+	size--;		// The last point is the first again
+	if (size < 3 || size > MaxOutlineEdges)
+		return;
+
+	// Facing the centroid, whichever way round the hull came out
+	float centerX = 0, centerY = 0;
+	for (int i = 0; i < size; i++)
+	{
+		centerX += hull[i].X / size;
+		centerY += hull[i].Y / size;
+	}
+	for (int i = 0; i < size; i++)
+	{
+		const OutlinePoint& a = hull[i];
+		const OutlinePoint& b = hull[(i + 1) % size];
+		float A = a.Y - b.Y;
+		float B = b.X - a.X;
+		float C = -(A * a.X + B * a.Y);
+		if (A * centerX + B * centerY + C < 0)
+		{
+			A = -A;
+			B = -B;
+			C = -C;
+		}
+		outlineA[i] = A;
+		outlineB[i] = B;
+		outlineC[i] = C - 0.5f * (fabsf(A) + fabsf(B));
+	}
+	outlineCount = size;
+}
+
+// --------------------------------------------------------
+// Keeps the nearer depth wherever a pixel's center is inside
+// the triangle and the whole pixel is inside the occluder's
+// outline, four pixels at a time
+// --------------------------------------------------------
+void OcclusionCuller::DrawTriangle(const float* v0, const float* v1, const float* v2)
+{
+	const float* v[3] = { v0, v1, v2 };
+	float sx[3], sy[3], sz[3];
+	for (int k = 0; k < 3; k++)
+	{
+		if (!ToScreen(v[k], sx[k], sy[k]))
+			return;
+		sz[k] = v[k][2] / v[k][3];
+	}
+
+	float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sy[1] - sy[0]) * (sx[2] - sx[0]);
+	if (area == 0)
+		return;
+
+	// Either facing - keep the area positive
+	int order[3] = { 0, 1, 2 };
+	if (area < 0)
+	{
+		order[1] = 2;
+		order[2] = 1;
+		area = -area;
+	}
+
+	float minX = fminf(sx[0], fminf(sx[1], sx[2]));
+	float maxX = fmaxf(sx[0], fmaxf(sx[1], sx[2]));
+	float minY = fminf(sy[0], fminf(sy[1], sy[2]));
+	float maxY = fmaxf(sy[0], fmaxf(sy[1], sy[2]));
+	int x0 = minX > 0 ? (int)minX : 0;
+	int y0 = minY > 0 ? (int)minY : 0;
+	int x1 = maxX < Width - 1 ? (int)maxX : Width - 1;
+	int y1 = maxY < Height - 1 ? (int)maxY : Height - 1;
+	if (x0 > x1 || y0 > y1)
+		return;
+	triangleCount++;
+
+	// Edge k runs between the other two vertices, and depth is
+	// a plane made from the three edges
+	__m128 edgeA[3], edgeB[3], edgeC[3];
+	float planeA = 0, planeB = 0, planeC = 0;
+	for (int k = 0; k < 3; k++)
+	{
+		int a = order[(k + 1) % 3];
+		int b = order[(k + 2) % 3];
+		float A = sy[a] - sy[b];
+		float B = sx[b] - sx[a];
+		float C = -(A * sx[a] + B * sy[a]);
+		edgeA[k] = _mm_set1_ps(A);
+		edgeB[k] = _mm_set1_ps(B);
+		edgeC[k] = _mm_set1_ps(C);
+
+		float z = sz[order[k]] / area;
+		planeA += A * z;
+		planeB += B * z;
+		planeC += C * z;
+	}
+	__m128 depthA = _mm_set1_ps(planeA);
+	__m128 depthB = _mm_set1_ps(planeB);
+	__m128 depthC = _mm_set1_ps(planeC);
+
+	__m128 insetA[MaxOutlineEdges], insetB[MaxOutlineEdges], insetC[MaxOutlineEdges];
+	for (int k = 0; k < outlineCount; k++)
+	{
+		insetA[k] = _mm_set1_ps(outlineA[k]);
+		insetB[k] = _mm_set1_ps(outlineB[k]);
+		insetC[k] = _mm_set1_ps(outlineC[k]);
+	}
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 centers = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	for (int y = y0; y <= y1; y++)
+	{
+		__m128 py = _mm_set1_ps(y + 0.5f);
+		float* row = &depth[y * Width];
+
+		// Width is a multiple of 4, so the last group fits
+		for (int x = x0 & ~3; x <= x1; x += 4)
+		{
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)x), centers);
+			__m128 inside = _mm_cmpeq_ps(zero, zero);
+			for (int k = 0; k < 3; k++)
+			{
+				__m128 e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edgeA[k], px), _mm_mul_ps(edgeB[k], py)), edgeC[k]);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(e, zero));
+			}
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+			for (int k = 0; k < outlineCount; k++)
+			{
+				__m128 e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(insetA[k], px), _mm_mul_ps(insetB[k], py)), insetC[k]);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(e, zero));
+			}
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+
+			__m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(depthA, px), _mm_mul_ps(depthB, py)), depthC);
+			z = _mm_min_ps(_mm_max_ps(z, zero), one);
+			__m128 old = _mm_loadu_ps(row + x);
+			__m128 nearer = _mm_min_ps(old, z);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+		}
+	}
+}
+
+// --------------------------------------------------------
+// The farthest depth in each tile
+// --------------------------------------------------------
+void OcclusionCuller::Finish()
+{
+	for (int ty = 0; ty < TilesY; ty++)
+	{
+		for (int tx = 0; tx < TilesX; tx++)
+		{
+			__m128 farthest = _mm_setzero_ps();
+			for (int y = ty * TileSize; y < (ty + 1) * TileSize; y++)
+			{
+				const float* row = &depth[y * Width + tx * TileSize];
+				for (int x = 0; x < TileSize; x += 4)
+					farthest = _mm_max_ps(farthest, _mm_loadu_ps(row + x));
+			}
+
+			float lanes[4];
+			_mm_storeu_ps(lanes, farthest);
+			tileMax[ty * TilesX + tx] = fmaxf(fmaxf(lanes[0], lanes[1]), fmaxf(lanes[2], lanes[3]));
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Compares the box's nearest depth with every pixel its screen
+// rectangle touches.  Anything crossing the near plane is
+// visible, since its rectangle can't be trusted.
+// --------------------------------------------------------
+bool OcclusionCuller::IsVisible(const XMFLOAT4X4& worldViewProj, const XMFLOAT3& center, const XMFLOAT3& extents)
+{
+	testCount++;
+
+	float corners[8][4];
+	TransformBox(worldViewProj, center, extents, corners);
+
+	float minX = 1e30f, maxX = -1e30f, minY = 1e30f, maxY = -1e30f, minZ = 1.0f;
+	for (int i = 0; i < 8; i++)
+	{
+		const float* p = corners[i];
+		if (p[2] < 0 || p[3] <= 0.000001f)
+			return true;
+
+		float invW = 1.0f / p[3];
+		float sx = (p[0] * invW * 0.5f + 0.5f) * Width;
+		float sy = (0.5f - p[1] * invW * 0.5f) * Height;
+		minX = fminf(minX, sx);
+		maxX = fmaxf(maxX, sx);
+		minY = fminf(minY, sy);
+		maxY = fmaxf(maxY, sy);
+		minZ = fminf(minZ, p[2] * invW);
+	}
+
+	// Only the part on screen can be seen
+	int x0 = minX > 0 ? (int)minX : 0;
+	int y0 = minY > 0 ? (int)minY : 0;
+	int x1 = maxX < Width - 1 ? (int)maxX : Width - 1;
+	int y1 = maxY < Height - 1 ? (int)maxY : Height - 1;
+	if (x0 > x1 || y0 > y1)
+		return true;
+	__m128 nearest = _mm_set1_ps(minZ);
+
+	for (int ty = y0 / TileSize; ty <= y1 / TileSize; ty++)
+	{
+		for (int tx = x0 / TileSize; tx <= x1 / TileSize; tx++)
+		{
+			// The whole tile is in front
+			if (tileMax[ty * TilesX + tx] < minZ)
+				continue;
+
+			// Otherwise look for a pixel that isn't
+			int left = tx * TileSize > x0 ? tx * TileSize : x0;
+			int right = (tx + 1) * TileSize - 1 < x1 ? (tx + 1) * TileSize - 1 : x1;
+			int top = ty * TileSize > y0 ? ty * TileSize : y0;
+			int bottom = (ty + 1) * TileSize - 1 < y1 ? (ty + 1) * TileSize - 1 : y1;
+			for (int y = top; y <= bottom; y++)
+			{
+				const float* row = &depth[y * Width];
+				for (int x = left & ~3; x <= right; x += 4)
+				{
+					int lanes = 0xf;
+					if (x < left) lanes &= 0xf << (left - x);
+					if (x + 3 > right) lanes &= 0xf >> (x + 3 - right);
+
+					int uncovered = _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), nearest));
+					if (uncovered & lanes)
+						return true;
+				}
+			}
+		}
+	}
+
+	occludedCount++;
+	return false;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// --------------------------------------------------------
+// Software occlusion culling against a small CPU depth buffer.
+//
+// Each frame, big solid boxes (the platforms and obstacles) are
+// rasterized into a Width x Height depth buffer, four pixels at
+// a time with SSE, keeping the nearest depth.  Occluders are
+// conservative: a pixel is only written if the box's outline
+// covers all of it, so nothing peeking out past an edge is
+// hidden.  Finish() then records the farthest depth in each
+// TileSize square tile - a one level hierarchical Z.  An object is hidden when every
+// pixel under its screen rectangle is nearer than the nearest
+// corner of its box: whole tiles are checked against their
+// farthest depth first, and only tiles that can't decide it
+// are checked pixel by pixel.
+//
+// Boxes are given in their own space with a world * view *
+// projection (transposed for HLSL, like RenderItem's), so
+// rotated boxes stay tight.  Anything crossing the near plane
+// is treated as visible.
+// --------------------------------------------------------
+class OcclusionCuller
+{
+public:
+	static const int Width = 256;
+	static const int Height = 128;
+	static const int TileSize = 8;
+
+	OcclusionCuller();
+	~OcclusionCuller();
+
+	// Clears the depth buffer for a new frame
+	void Begin();
+
+	// Draws a box that's solid all the way to its bounds
+	void AddOccluder(const DirectX::XMFLOAT4X4& worldViewProj, const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents);
+
+	// Builds the tiles' farthest depths - call after the last
+	// occluder, before testing anything
+	void Finish();
+
+	// False if the box is completely behind the occluders
+	bool IsVisible(const DirectX::XMFLOAT4X4& worldViewProj, const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents);
+
+	// This frame so far
+	int GetOccluderCount() { return occluderCount; }
+	int GetTriangleCount() { return triangleCount; }
+	int GetTestCount() { return testCount; }
+	int GetOccludedCount() { return occludedCount; }
+
+	// Row by row from the top, 0 (near) to 1 (far)
+	const float* GetDepth() { return &depth[0]; }
+
+private:
+	static const int TilesX = Width / TileSize;
+	static const int TilesY = Height / TileSize;
+
+	std::vector<float> depth;
+	std::vector<float> tileMax;
+
+	// The outline of the box being drawn, each edge pulled in
+	// by half a pixel's worth so only fully covered pixels pass
+	static const int MaxOutlineEdges = 16;
+	int outlineCount;
+	float outlineA[MaxOutlineEdges];
+	float outlineB[MaxOutlineEdges];
+	float outlineC[MaxOutlineEdges];
+
+	int occluderCount;
+	int triangleCount;
+	int testCount;
+	int occludedCount;
+
+	void TransformBox(const DirectX::XMFLOAT4X4& worldViewProj, const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents, float corners[8][4]);
+	void BuildOutline(const float points[][2], int count);
+	void DrawTriangle(const float* v0, const float* v1, const float* v2);
+};
@@ -0,0 +1,208 @@
+#include "PipelineCache.h"
+#include <cstring>
+
+// FNV-1a over a description's bytes
+static unsigned int HashBytes(const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	unsigned int hash = 2166136261u;
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ bytes[i]) * 16777619u;
+	return hash;
+}
+
+// --------------------------------------------------------
+// The depth-stencil and blend descriptions have padding after
+// their UINT8 fields, which can hold anything.  These copy the
+// fields into zeroed descriptions so equal states hash (and
+// compare) equal.  The other two have no padding.
+// --------------------------------------------------------
+static D3D11_DEPTH_STENCIL_DESC Normalize(const D3D11_DEPTH_STENCIL_DESC& desc)
+{
+	D3D11_DEPTH_STENCIL_DESC clean;
+	memset(&clean, 0, sizeof(clean));
+	clean.DepthEnable = desc.DepthEnable;
+	clean.DepthWriteMask = desc.DepthWriteMask;
+	clean.DepthFunc = desc.DepthFunc;
+	clean.StencilEnable = desc.StencilEnable;
+	clean.StencilReadMask = desc.StencilReadMask;
+	clean.StencilWriteMask = desc.StencilWriteMask;
+	clean.FrontFace = desc.FrontFace;
+	clean.BackFace = desc.BackFace;
+	return clean;
+}
+
+static D3D11_BLEND_DESC Normalize(const D3D11_BLEND_DESC& desc)
+{
+	D3D11_BLEND_DESC clean;
+	memset(&clean, 0, sizeof(clean));
+	clean.AlphaToCoverageEnable = desc.AlphaToCoverageEnable;
+	clean.IndependentBlendEnable = desc.IndependentBlendEnable;
+	for (int i = 0; i < 8; i++)
+	{
+		clean.RenderTarget[i].BlendEnable = desc.RenderTarget[i].BlendEnable;
+		clean.RenderTarget[i].SrcBlend = desc.RenderTarget[i].SrcBlend;
+		clean.RenderTarget[i].DestBlend = desc.RenderTarget[i].DestBlend;
+		clean.RenderTarget[i].BlendOp = desc.RenderTarget[i].BlendOp;
+		clean.RenderTarget[i].SrcBlendAlpha = desc.RenderTarget[i].SrcBlendAlpha;
+		clean.RenderTarget[i].DestBlendAlpha = desc.RenderTarget[i].DestBlendAlpha;
+		clean.RenderTarget[i].BlendOpAlpha = desc.RenderTarget[i].BlendOpAlpha;
+		clean.RenderTarget[i].RenderTargetWriteMask = desc.RenderTarget[i].RenderTargetWriteMask;
+	}
+	return clean;
+}
+
+// --------------------------------------------------------
+// State tables
+// --------------------------------------------------------
+template <typename Desc, typename State>
+unsigned int PipelineCache::StateTable<Desc, State>::Find(const Desc& desc, unsigned int hash)
+{
+	typedef std::unordered_multimap<unsigned int, unsigned int>::iterator Iterator;
+	std::pair<Iterator, Iterator> matches = ByHash.equal_range(hash);
+	for (Iterator it = matches.first; it != matches.second; it++)
+	{
+		if (memcmp(&Descs[it->second], &desc, sizeof(Desc)) == 0)
+			return it->second + 1;
+	}
+	return 0;
+}
+
+template <typename Desc, typename State>
+unsigned int PipelineCache::StateTable<Desc, State>::Add(const Desc& desc, unsigned int hash, State* state)
+{
+	Descs.push_back(desc);
+	States.push_back(state);
+	ByHash.insert(std::make_pair(hash, (unsigned int)States.size() - 1));
+	return (unsigned int)States.size();
+}
+
+template <typename Desc, typename State>
+void PipelineCache::StateTable<Desc, State>::Release()
+{
+	for (unsigned int i = 0; i < States.size(); i++)
+		if (States[i]) States[i]->Release();
+	Descs.clear();
+	States.clear();
+	ByHash.clear();
+}
+
+PipelineCache::PipelineCache(ID3D11Device* device)
+	: device(device)
+{ }
+
+PipelineCache::~PipelineCache()
+{
+	rasterizerStates.Release();
+	depthStencilStates.Release();
+	blendStates.Release();
+	samplerStates.Release();
+}
+
+// --------------------------------------------------------
+// Each of these returns the id of an identical description if
+// there is one, and only creates a state object otherwise.
+// A description D3D refuses still gets an id, for a null state.
+// --------------------------------------------------------
+unsigned int PipelineCache::AddRasterizerState(const D3D11_RASTERIZER_DESC& desc)
+{
+	unsigned int hash = HashBytes(&desc, sizeof(desc));
+	unsigned int id = rasterizerStates.Find(desc, hash);
+	if (id != 0)
+		return id;
+
+	ID3D11RasterizerState* state = 0;
+	device->CreateRasterizerState(&desc, &state);
+	return rasterizerStates.Add(desc, hash, state);
+}
+
+unsigned int PipelineCache::AddDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& desc)
+{
+	D3D11_DEPTH_STENCIL_DESC clean = Normalize(desc);
+	unsigned int hash = HashBytes(&clean, sizeof(clean));
+	unsigned int id = depthStencilStates.Find(clean, hash);
+	if (id != 0)
+		return id;
+
+	ID3D11DepthStencilState* state = 0;
+	device->CreateDepthStencilState(&clean, &state);
+	return depthStencilStates.Add(clean, hash, state);
+}
+
+unsigned int PipelineCache::AddBlendState(const D3D11_BLEND_DESC& desc)
+{
+	D3D11_BLEND_DESC clean = Normalize(desc);
+	unsigned int hash = HashBytes(&clean, sizeof(clean));
+	unsigned int id = blendStates.Find(clean, hash);
+	if (id != 0)
+		return id;
+
+	ID3D11BlendState* state = 0;
+	device->CreateBlendState(&clean, &state);
+	return blendStates.Add(clean, hash, state);
+}
+
+unsigned int PipelineCache::AddSamplerState(const D3D11_SAMPLER_DESC& desc)
+{
+	unsigned int hash = HashBytes(&desc, sizeof(desc));
+	unsigned int id = samplerStates.Find(desc, hash);
+	if (id != 0)
+		return id;
+
+	ID3D11SamplerState* state = 0;
+	device->CreateSamplerState(&desc, &state);
+	return samplerStates.Add(desc, hash, state);
+}
+
+// --------------------------------------------------------
+// Pipelines
+// --------------------------------------------------------
+unsigned int PipelineCache::FindShaderId(const void* shader)
+{
+	if (shader == 0)
+		return 0;
+
+	for (unsigned int i = 0; i < shaderIds.size(); i++)
+		if (shaderIds[i] == shader)
+			return i + 1;
+
+	shaderIds.push_back(shader);
+	return (unsigned int)shaderIds.size();
+}
+
+// --------------------------------------------------------
+// Packs the shader and state ids into one key:
+//
+//   vertex (14) | pixel (14) | raster (12) | depth (12) | blend (12)
+// --------------------------------------------------------
+unsigned int PipelineCache::AddPipeline(const PipelineDesc& desc)
+{
+	unsigned long long key =
+		((unsigned long long)(FindShaderId(desc.VertexShader) & 0x3FFF) << 50) |
+		((unsigned long long)(FindShaderId(desc.PixelShader) & 0x3FFF) << 36) |
+		((unsigned long long)(desc.RasterizerState & 0xFFF) << 24) |
+		((unsigned long long)(desc.DepthStencilState & 0xFFF) << 12) |
+		((unsigned long long)(desc.BlendState & 0xFFF));
+
+	std::unordered_map<unsigned long long, unsigned int>::iterator it = pipelineIds.find(key);
+	if (it != pipelineIds.end())
+		return it->second;
+
+	pipelines.push_back(desc);
+	unsigned int id = (unsigned int)pipelines.size();
+	pipelineIds.insert(std::make_pair(key, id));
+	return id;
+}
+
+void PipelineCache::Bind(StateCache* context, unsigned int pipeline)
+{
+	if (pipeline == 0)
+		return;
+
+	const PipelineDesc& desc = GetPipeline(pipeline);
+	if (desc.VertexShader) desc.VertexShader->BindShader(context);
+	if (desc.PixelShader) desc.PixelShader->BindShader(context);
+	context->RSSetState(GetRasterizerState(desc.RasterizerState));
+	context->OMSetDepthStencilState(GetDepthStencilState(desc.DepthStencilState), 0);
+	context->OMSetBlendState(GetBlendState(desc.BlendState));
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <d3d11.h>
+#include <unordered_map>
+#include <vector>
+
+#include "SimpleShader.h"
+#include "StateCache.h"
+
+// --------------------------------------------------------
+// A whole pipeline: shaders (the input layout comes with the
+// vertex shader) plus state ids from PipelineCache.  State id
+// 0 means D3D's default state.
+// --------------------------------------------------------
+struct PipelineDesc
+{
+	SimpleVertexShader* VertexShader;
+	SimplePixelShader* PixelShader;
+	unsigned int RasterizerState;
+	unsigned int DepthStencilState;
+	unsigned int BlendState;
+};
+
+// --------------------------------------------------------
+// Owns every rasterizer, depth-stencil, blend and sampler
+// state, so nothing creates its own.  Each description is
+// hashed, and the same description always gets the same
+// (shared, immutable) state object and small integer id.
+//
+// Pipelines are numbered the same way, so sorting and
+// batching can compare whole pipelines as integers.
+// --------------------------------------------------------
+class PipelineCache
+{
+public:
+	PipelineCache(ID3D11Device* device);
+	~PipelineCache();
+
+	// Ids for state descriptions - created the first time they're seen
+	unsigned int AddRasterizerState(const D3D11_RASTERIZER_DESC& desc);
+	unsigned int AddDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& desc);
+	unsigned int AddBlendState(const D3D11_BLEND_DESC& desc);
+	unsigned int AddSamplerState(const D3D11_SAMPLER_DESC& desc);
+
+	// The state objects behind the ids (0 gives null, the default).
+	// They belong to the cache - don't Release them.
+	ID3D11RasterizerState* GetRasterizerState(unsigned int id) { return rasterizerStates.Get(id); }
+	ID3D11DepthStencilState* GetDepthStencilState(unsigned int id) { return depthStencilStates.Get(id); }
+	ID3D11BlendState* GetBlendState(unsigned int id) { return blendStates.Get(id); }
+	ID3D11SamplerState* GetSamplerState(unsigned int id) { return samplerStates.Get(id); }
+
+	// Pipelines are numbered from 1, so 0 can mean "none"
+	unsigned int AddPipeline(const PipelineDesc& desc);
+	const PipelineDesc& GetPipeline(unsigned int id) { return pipelines[id - 1]; }
+	int GetPipelineCount() { return (int)pipelines.size(); }
+
+	// Sets the shaders (not their data) and states
+	void Bind(StateCache* context, unsigned int pipeline);
+
+private:
+	ID3D11Device* device;
+
+	// Descriptions and objects of one kind of state, with the
+	// descriptions indexed by hash.  Ids are index + 1.
+	template <typename Desc, typename State>
+	struct StateTable
+	{
+		std::vector<Desc> Descs;
+		std::vector<State*> States;
+		std::unordered_multimap<unsigned int, unsigned int> ByHash;
+
+		State* Get(unsigned int id) { return id > 0 && id <= States.size() ? States[id - 1] : 0; }
+		unsigned int Find(const Desc& desc, unsigned int hash);
+		unsigned int Add(const Desc& desc, unsigned int hash, State* state);
+		void Release();
+	};
+	StateTable<D3D11_RASTERIZER_DESC, ID3D11RasterizerState> rasterizerStates;
+	StateTable<D3D11_DEPTH_STENCIL_DESC, ID3D11DepthStencilState> depthStencilStates;
+	StateTable<D3D11_BLEND_DESC, ID3D11BlendState> blendStates;
+	StateTable<D3D11_SAMPLER_DESC, ID3D11SamplerState> samplerStates;
+
+	// Pipelines, looked up by their packed ids
+	std::vector<PipelineDesc> pipelines;
+	std::unordered_map<unsigned long long, unsigned int> pipelineIds;
+	std::vector<const void*> shaderIds;
+	unsigned int FindShaderId(const void* shader);
+};
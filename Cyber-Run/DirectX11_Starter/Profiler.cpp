@@ -0,0 +1,263 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+std::atomic<Profiler::ThreadBuffer*> Profiler::buffers[Profiler::MaxThreads];
+std::atomic<int> Profiler::bufferCount(0);
+std::atomic<int> Profiler::generation(0);
+std::atomic<int> Profiler::dropped(0);
+std::vector<Profiler::ZoneTotal> Profiler::totals;
+std::vector<ProfileZoneStats> Profiler::published;
+int Profiler::frameCount = 0;
+
+// Each thread's ring, and which Shutdown() it was made after
+static thread_local Profiler::ThreadBuffer* localBuffer = 0;
+static thread_local int localGeneration = -1;
+
+// Where the tick rate is measured from
+typedef std::chrono::steady_clock ProfileClock;
+static const ProfileClock::time_point startTime = ProfileClock::now();
+static const unsigned long long startTicks = Profiler::Now();
+
+// --------------------------------------------------------
+// The calling thread's ring, made the first time it records
+// --------------------------------------------------------
+Profiler::ThreadBuffer* Profiler::GetThreadBuffer()
+{
+	int current = generation.load(std::memory_order_acquire);
+	if (localGeneration == current)
+		return localBuffer;
+
+	localGeneration = current;
+	localBuffer = 0;
+	int index = bufferCount.fetch_add(1);
+	if (index >= MaxThreads)
+	{
+		dropped++;
+		return 0;
+	}
+
+	ThreadBuffer* buffer = new ThreadBuffer();
+	buffer->Written.store(0, std::memory_order_relaxed);
+	buffer->Collected = 0;
+	buffer->Depth = 0;
+	sprintf_s(buffer->Name, sizeof(buffer->Name), "Thread %d", index);
+	buffers[index].store(buffer, std::memory_order_release);
+	localBuffer = buffer;
+	return buffer;
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	ThreadBuffer* buffer = GetThreadBuffer();
+	if (buffer)
+		strncpy_s(buffer->Name, sizeof(buffer->Name), name, _TRUNCATE);
+}
+
+// --------------------------------------------------------
+// Ticks against the steady clock over everything since
+// startup - waiting a little first if that's too short to
+// trust
+// --------------------------------------------------------
+double Profiler::TicksPerMicrosecond()
+{
+	const double minimumUs = 20000.0;
+	double elapsedUs = std::chrono::duration<double, std::micro>(ProfileClock::now() - startTime).count();
+	if (elapsedUs < minimumUs)
+		std::this_thread::sleep_for(std::chrono::microseconds((long long)(minimumUs - elapsedUs)));
+
+	unsigned long long ticks = Now() - startTicks;
+	elapsedUs = std::chrono::duration<double, std::micro>(ProfileClock::now() - startTime).count();
+	return ticks / elapsedUs;
+}
+
+// --------------------------------------------------------
+// Copies event e out of a ring its thread may still be
+// recording into.  Once the thread has moved on to event
+// e + EventsPerThread, the slot can hold half of each, so
+// Written is read again after the copy - the seqlock check -
+// and the copy is dropped if the thread had got that far.
+// Each thread writes a slot only after its Written store for
+// the event before, and x86 keeps stores in order.
+// --------------------------------------------------------
+static bool ReadEvent(const Profiler::ThreadBuffer* buffer, unsigned int e, ProfileEvent& event)
+{
+	event = buffer->Events[e & (Profiler::EventsPerThread - 1)];
+	std::atomic_thread_fence(std::memory_order_acquire);
+	unsigned int written = buffer->Written.load(std::memory_order_relaxed);
+	return written - e < (unsigned int)Profiler::EventsPerThread;
+}
+
+// --------------------------------------------------------
+// Adds up every zone finished since the last call.  A thread
+// that finished more than a whole ring's worth has lost the
+// oldest ones, as have any it overwrote while they were read.
+// --------------------------------------------------------
+void Profiler::EndFrame()
+{
+	int count = bufferCount.load(std::memory_order_acquire);
+	if (count > MaxThreads) count = MaxThreads;
+	for (int t = 0; t < count; t++)
+	{
+		ThreadBuffer* buffer = buffers[t].load(std::memory_order_acquire);
+		if (buffer == 0)
+			continue;
+
+		unsigned int written = buffer->Written.load(std::memory_order_acquire);
+		unsigned int from = buffer->Collected;
+		if (written - from > (unsigned int)EventsPerThread)
+			from = written - EventsPerThread;
+
+		for (unsigned int e = from; e != written; e++)
+		{
+			ProfileEvent event;
+			if (!ReadEvent(buffer, e, event))
+				continue;
+			unsigned int z = 0;
+			while (z < totals.size() && totals[z].Name != event.Name)
+				z++;
+			if (z == totals.size())
+			{
+				ZoneTotal total = { event.Name, 0, 0 };
+				totals.push_back(total);
+			}
+			totals[z].Ticks += event.End - event.Start;
+			totals[z].Calls++;
+		}
+		buffer->Collected = written;
+	}
+
+	if (++frameCount < StatsFrames)
+		return;
+
+	double ticksPerMs = TicksPerMicrosecond() * 1000.0;
+	published.resize(totals.size());
+	for (unsigned int z = 0; z < totals.size(); z++)
+	{
+		published[z].Name = totals[z].Name;
+		published[z].Ms = totals[z].Ticks / ticksPerMs / frameCount;
+		published[z].Calls = (double)totals[z].Calls / frameCount;
+	}
+	totals.clear();
+	frameCount = 0;
+}
+
+static bool LongerZone(const ProfileZoneStats& a, const ProfileZoneStats& b)
+{
+	return a.Ms > b.Ms;
+}
+
+void Profiler::GetTopZones(std::vector<ProfileZoneStats>& zones, int count)
+{
+	zones = published;
+	std::sort(zones.begin(), zones.end(), LongerZone);
+	if ((int)zones.size() > count)
+		zones.resize(count);
+}
+
+// Keeps the longest so far in order, inserting each zone where
+// it belongs
+int Profiler::GetTopZones(ProfileZoneStats* zones, int count)
+{
+	int filled = 0;
+	for (unsigned int z = 0; z < published.size(); z++)
+	{
+		int at = filled;
+		while (at > 0 && LongerZone(published[z], zones[at - 1]))
+			at--;
+		if (at >= count)
+			continue;
+
+		int last = filled < count ? filled : count - 1;
+		for (int i = last; i > at; i--)
+			zones[i] = zones[i - 1];
+		zones[at] = published[z];
+		if (filled < count)
+			filled++;
+	}
+	return filled;
+}
+
+// Zone names are code, but function names could hold anything
+static void WriteJsonString(std::ofstream& file, const char* text)
+{
+	file << '"';
+	for (const char* c = text; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+			file << '\\' << *c;
+		else if ((unsigned char)*c >= 0x20)
+			file << *c;
+	}
+	file << '"';
+}
+
+// --------------------------------------------------------
+// Complete ("X") events in microseconds since startup, one
+// track per thread.  Threads can keep recording while this
+// runs; events they overwrite before they're read are left
+// out (see ReadEvent).
+// --------------------------------------------------------
+bool Profiler::WriteChromeTrace(const std::string& path)
+{
+	std::ofstream file(path.c_str());
+	if (!file.is_open())
+		return false;
+
+	double ticksPerUs = TicksPerMicrosecond();
+	file.setf(std::ios::fixed);
+	file.precision(3);
+	file << "{\"traceEvents\":[\n";
+
+	bool first = true;
+	int count = bufferCount.load(std::memory_order_acquire);
+	if (count > MaxThreads) count = MaxThreads;
+	for (int t = 0; t < count; t++)
+	{
+		ThreadBuffer* buffer = buffers[t].load(std::memory_order_acquire);
+		if (buffer == 0)
+			continue;
+
+		file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t << ",\"args\":{\"name\":";
+		WriteJsonString(file, buffer->Name);
+		file << "}}";
+		first = false;
+
+		unsigned int written = buffer->Written.load(std::memory_order_acquire);
+		unsigned int from = written > (unsigned int)EventsPerThread ? written - EventsPerThread : 0;
+		for (unsigned int e = from; e != written; e++)
+		{
+			ProfileEvent event;
+			if (!ReadEvent(buffer, e, event))
+				continue;
+			file << ",\n{\"name\":";
+			WriteJsonString(file, event.Name);
+			file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << t <<
+				",\"ts\":" << (event.Start - startTicks) / ticksPerUs <<
+				",\"dur\":" << (event.End - event.Start) / ticksPerUs << "}";
+		}
+	}
+
+	file << "\n]}\n";
+	return file.good();
+}
+
+void Profiler::Shutdown()
+{
+	int count = bufferCount.load();
+	if (count > MaxThreads) count = MaxThreads;
+	for (int t = 0; t < count; t++)
+	{
+		delete buffers[t].load();
+		buffers[t].store(0);
+	}
+	bufferCount.store(0);
+	generation++;
+	totals.clear();
+	published.clear();
+	frameCount = 0;
+}
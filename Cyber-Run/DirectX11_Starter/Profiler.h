@@ -0,0 +1,177 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+// --------------------------------------------------------
+// Scoped CPU profiling.  A zone times the rest of the block
+// it's declared in:
+//
+//   void Thing()
+//   {
+//       PROFILE_ZONE("Thing");
+//       ...
+//   }
+//
+// Each thread writes its zones into its own ring of events, so
+// recording takes no locks - just two timestamp reads (rdtsc)
+// and a few stores.  Zone names must be string literals, or
+// strings that outlive the profiler.
+//
+// Once a frame, Profiler::EndFrame() adds up the zones every
+// thread finished since the last call, for the overlay's top
+// zones.  Profiler::WriteChromeTrace() saves what the rings
+// still hold as Chrome trace JSON (chrome://tracing or
+// ui.perfetto.dev).  Neither stops the threads: an event a
+// thread overwrites while it's being read is left out rather
+// than reported torn.
+//
+// Defining PROFILER_DISABLED compiles every PROFILE_ macro
+// away to nothing.
+// --------------------------------------------------------
+#ifndef PROFILER_DISABLED
+#define PROFILER_ENABLED 1
+#endif
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef PROFILER_ENABLED
+#define PROFILE_ZONE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+#define PROFILE_THREAD(name) Profiler::SetThreadName(name)
+#define PROFILE_END_FRAME() Profiler::EndFrame()
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_THREAD(name)
+#define PROFILE_END_FRAME()
+#endif
+
+// One finished zone
+struct ProfileEvent
+{
+	const char* Name;
+	unsigned long long Start;	// Ticks
+	unsigned long long End;
+	int Depth;					// Zones open around it on its thread
+};
+
+// A zone's totals over recent frames, per frame
+struct ProfileZoneStats
+{
+	const char* Name;
+	double Ms;		// Inclusive, summed over every thread
+	double Calls;
+};
+
+class Profiler
+{
+public:
+	static const int MaxThreads = 64;
+	static const int EventsPerThread = 16384;	// Power of two
+	static const int StatsFrames = 30;			// Frames per overlay update
+
+	// Names the calling thread in traces
+	static void SetThreadName(const char* name);
+
+	// Collects every thread's zones since the last call.  Call
+	// once a frame, from one thread.
+	static void EndFrame();
+
+	// The zones that took longest, averaged over the last
+	// StatsFrames frames
+	static void GetTopZones(std::vector<ProfileZoneStats>& zones, int count);
+
+	// The same into a caller's array, without allocating -
+	// returns how many were filled
+	static int GetTopZones(ProfileZoneStats* zones, int count);
+
+	// Saves every ring's events - false if the file can't be written
+	static bool WriteChromeTrace(const std::string& path);
+
+	// Frees the threads' rings.  Nothing may be recording.
+	static void Shutdown();
+
+	// Timestamps, and how many there are per microsecond
+	static unsigned long long Now() { return __rdtsc(); }
+	static double TicksPerMicrosecond();
+
+	// Zones lost because more than MaxThreads threads recorded
+	static int GetDroppedCount() { return dropped; }
+
+	// Used by ProfileScope
+	struct ThreadBuffer
+	{
+		std::atomic<unsigned int> Written;	// Total ever, so the ring position is Written % EventsPerThread
+		unsigned int Collected;				// Up to where EndFrame() has counted
+		int Depth;
+		char Name[32];
+		ProfileEvent Events[EventsPerThread];
+	};
+	static ThreadBuffer* GetThreadBuffer();
+
+private:
+	static std::atomic<ThreadBuffer*> buffers[MaxThreads];
+	static std::atomic<int> bufferCount;
+	static std::atomic<int> generation;		// Bumped by Shutdown(), so threads register again
+	static std::atomic<int> dropped;
+
+	struct ZoneTotal
+	{
+		const char* Name;
+		unsigned long long Ticks;
+		int Calls;
+	};
+	static std::vector<ZoneTotal> totals;
+	static std::vector<ProfileZoneStats> published;
+	static int frameCount;
+};
+
+// --------------------------------------------------------
+// Records one zone, from construction to destruction
+// --------------------------------------------------------
+class ProfileScope
+{
+public:
+	ProfileScope(const char* name)
+	{
+		buffer = Profiler::GetThreadBuffer();
+		if (buffer == 0)
+			return;
+		this->name = name;
+		depth = buffer->Depth++;
+		start = Profiler::Now();
+	}
+
+	~ProfileScope()
+	{
+		if (buffer == 0)
+			return;
+		unsigned long long end = Profiler::Now();
+		buffer->Depth--;
+
+		// Only this thread writes, so a plain read is enough; the
+		// release store publishes the event to readers
+		unsigned int written = buffer->Written.load(std::memory_order_relaxed);
+		ProfileEvent& event = buffer->Events[written & (Profiler::EventsPerThread - 1)];
+		event.Name = name;
+		event.Start = start;
+		event.End = end;
+		event.Depth = depth;
+		buffer->Written.store(written + 1, std::memory_order_release);
+	}
+
+private:
+	Profiler::ThreadBuffer* buffer;
+	const char* name;
+	unsigned long long start;
+	int depth;
+};
@@ -0,0 +1,174 @@
+#include "RenderQueue.h"
+#include <cstring>
+
+using namespace DirectX;
+
+// Key layout - widths and positions of each field
+static const int PassBits = 4;
+static const int PipelineBits = 8;
+static const int MaterialBits = 10;
+static const int MeshBits = 10;
+static const int DepthBits = 32;
+
+static const int MeshShift = DepthBits;
+static const int MaterialShift = MeshShift + MeshBits;
+static const int PipelineShift = MaterialShift + MaterialBits;
+static const int PassShift = PipelineShift + PipelineBits;
+
+// Packs a field, clamping ids that don't fit.  Running out of ids
+// only affects the draw order, never what gets drawn.
+static inline unsigned long long PackField(unsigned int value, int bits, int shift)
+{
+	unsigned int maxValue = (1u << bits) - 1;
+	if (value > maxValue) value = maxValue;
+	return (unsigned long long)value << shift;
+}
+
+RenderQueue::RenderQueue()
+{ }
+
+RenderQueue::~RenderQueue()
+{ }
+
+// --------------------------------------------------------
+// Empties the queue.  Ids (and memory) are kept, so keys
+// stay stable from frame to frame and nothing reallocates.
+// --------------------------------------------------------
+void RenderQueue::Clear()
+{
+	commands.clear();
+}
+
+// --------------------------------------------------------
+// Adds a draw.  Depth is the view space distance used for
+// front-to-back ordering (see ViewDepth).
+// --------------------------------------------------------
+void RenderQueue::Submit(Pass pass, const RenderItem* item, int variant, float depth)
+{
+	// Non-negative floats sort the same as their bit patterns
+	if (!(depth > 0.0f)) depth = 0.0f;
+	unsigned int depthBits;
+	memcpy(&depthBits, &depth, sizeof(depthBits));
+
+	Command command;
+	command.Key =
+		PackField(pass, PassBits, PassShift) |
+		PackField(item->ItemMaterial->getPipeline(), PipelineBits, PipelineShift) |
+		PackField(FindMaterialId(item->ItemMaterial), MaterialBits, MaterialShift) |
+		PackField(FindMeshId(item->ItemMesh), MeshBits, MeshShift) |
+		depthBits;
+	command.Item = item;
+	command.Variant = variant;
+	commands.push_back(command);
+}
+
+void RenderQueue::Sort()
+{
+	RadixSort();
+	RemoveDuplicates();
+}
+
+// --------------------------------------------------------
+// Distance along the camera's forward axis.  The view matrix
+// is stored transposed, so its third row is view's z column.
+// --------------------------------------------------------
+float RenderQueue::ViewDepth(const XMFLOAT4X4& view, const XMFLOAT3& point)
+{
+	return view._31 * point.x + view._32 * point.y + view._33 * point.z + view._34;
+}
+
+// --------------------------------------------------------
+// Id lookups.  There are only a handful of each, so a linear
+// search beats hashing.
+// --------------------------------------------------------
+unsigned int RenderQueue::FindMaterialId(const void* material)
+{
+	for (unsigned int i = 0; i < materialIds.size(); i++)
+		if (materialIds[i] == material)
+			return i;
+
+	materialIds.push_back(material);
+	return (unsigned int)materialIds.size() - 1;
+}
+
+unsigned int RenderQueue::FindMeshId(const void* mesh)
+{
+	for (unsigned int i = 0; i < meshIds.size(); i++)
+		if (meshIds[i] == mesh)
+			return i;
+
+	meshIds.push_back(mesh);
+	return (unsigned int)meshIds.size() - 1;
+}
+
+// --------------------------------------------------------
+// Least significant digit radix sort, 8 bits per pass.  It's
+// stable, so equal keys keep their submission order.  Passes
+// where every key has the same digit (common for the upper
+// fields) are skipped.
+// --------------------------------------------------------
+void RenderQueue::RadixSort()
+{
+	unsigned int count = (unsigned int)commands.size();
+	if (count < 2)
+		return;
+
+	scratch.resize(count);
+	Command* source = &commands[0];
+	Command* dest = &scratch[0];
+
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		unsigned int histogram[256] = {};
+		for (unsigned int i = 0; i < count; i++)
+			histogram[(source[i].Key >> shift) & 0xFF]++;
+
+		// Nothing to do if every key lands in the same bucket
+		if (histogram[(source[0].Key >> shift) & 0xFF] == count)
+			continue;
+
+		// Turn counts into starting offsets
+		unsigned int offset = 0;
+		for (int b = 0; b < 256; b++)
+		{
+			unsigned int bucketCount = histogram[b];
+			histogram[b] = offset;
+			offset += bucketCount;
+		}
+
+		for (unsigned int i = 0; i < count; i++)
+			dest[histogram[(source[i].Key >> shift) & 0xFF]++] = source[i];
+
+		Command* swap = source;
+		source = dest;
+		dest = swap;
+	}
+
+	// Make sure the result ends up in "commands"
+	if (source != &commands[0])
+		commands.swap(scratch);
+}
+
+// --------------------------------------------------------
+// Drops repeat submissions of the same item.  Duplicates have
+// the same key, so they are always in the same run of equal
+// keys after sorting.
+// --------------------------------------------------------
+void RenderQueue::RemoveDuplicates()
+{
+	unsigned int kept = 0;
+	unsigned int runStart = 0;
+	for (unsigned int i = 0; i < commands.size(); i++)
+	{
+		if (kept > 0 && commands[kept - 1].Key != commands[i].Key)
+			runStart = kept;
+
+		bool duplicate = false;
+		for (unsigned int j = runStart; j < kept && !duplicate; j++)
+			duplicate = commands[j].Item == commands[i].Item;
+
+		if (!duplicate)
+			commands[kept++] = commands[i];
+	}
+	commands.resize(kept);
+}
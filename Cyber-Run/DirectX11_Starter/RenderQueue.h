@@ -0,0 +1,70 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "RenderSnapshot.h"
+
+// --------------------------------------------------------
+// Collects a frame's draws and orders them by a packed 64-bit
+// key, most significant field first:
+//
+//   pass (4) | pipeline (8) | material (10) | mesh (10) | depth (32)
+//
+// so draws sharing state end up next to each other, opaque
+// geometry goes front-to-back within each state, and the sky
+// pass comes after everything else.  Keys are sorted with an
+// LSD radix sort, and an item submitted more than once with
+// the same key is only drawn once.
+//
+// The pipeline field is the material's PipelineCache id, so
+// whole pipelines are compared as one integer.
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	enum Pass
+	{
+		PassOpaque = 0,
+		PassSky = 1
+	};
+
+	// One submitted draw.  Variant picks between per-material data
+	// sets that share a Material (the bloom colors of each group).
+	// It isn't part of the key, so instances of a mesh can be drawn
+	// together whatever group they are in.
+	struct Command
+	{
+		unsigned long long Key;
+		const RenderItem* Item;
+		int Variant;
+	};
+
+	RenderQueue();
+	~RenderQueue();
+
+	void Clear();
+	void Submit(Pass pass, const RenderItem* item, int variant, float depth);
+
+	// Sorts by key and drops duplicates - call before drawing
+	void Sort();
+
+	int GetCount() { return (int)commands.size(); }
+	const Command& GetCommand(int index) { return commands[index]; }
+
+	// View space depth of a point, for front-to-back ordering
+	static float ViewDepth(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT3& point);
+
+private:
+	std::vector<Command> commands;
+	std::vector<Command> scratch;
+
+	// Small ids for the pointers packed into keys
+	std::vector<const void*> materialIds;
+	std::vector<const void*> meshIds;
+
+	unsigned int FindMaterialId(const void* material);
+	unsigned int FindMeshId(const void* mesh);
+
+	void RadixSort();
+	void RemoveDuplicates();
+};
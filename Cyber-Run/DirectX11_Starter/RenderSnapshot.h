@@ -0,0 +1,54 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Mesh.h"
+#include "Material.h"
+#include "LightClusters.h"
+
+// --------------------------------------------------------
+// A single thing to draw, copied out of a GameEntity at the
+// end of a simulation step
+// --------------------------------------------------------
+struct RenderItem
+{
+	Mesh* ItemMesh;
+	Material* ItemMaterial;
+	DirectX::XMFLOAT4X4 World;			// Transposed for HLSL, like GameEntity's
+	DirectX::XMFLOAT4X4 WorldViewProj;	// Also transposed
+	DirectX::XMFLOAT3 BoundsCenter;		// World space box for culling
+	DirectX::XMFLOAT3 BoundsExtents;
+	bool Sky;
+};
+
+// --------------------------------------------------------
+// Everything DrawScene needs from one simulated frame.  The
+// game keeps two of these: UpdateScene fills one while
+// DrawScene reads the other, so with the pipelined loop both
+// can run at the same time without any locking.
+// --------------------------------------------------------
+struct RenderSnapshot
+{
+	std::vector<RenderItem> Entities;
+	std::vector<RenderItem> Platforms;
+	std::vector<RenderItem> Collectibles;
+	std::vector<RenderItem> Obstacles;
+
+	// Neon point lights, in world space, and how many more the
+	// level had past LightClusters::MaxLights
+	std::vector<ClusterLight> Lights;
+	int DroppedLights;
+
+	// Camera
+	DirectX::XMFLOAT4X4 View;
+	DirectX::XMFLOAT4X4 Projection;
+	DirectX::XMFLOAT3 CameraPosition;
+	DirectX::XMFLOAT4 Frustum[6];
+
+	// Game state shown on screen
+	float BloomAmountX;
+	float BloomAmountY;
+	float BloomAmountZ;
+	int Score;
+	bool GameOver;
+};
@@ -0,0 +1,117 @@
+#include "RenderTargetPool.h"
+
+// Bytes per pixel of the formats a render target is likely to use
+static unsigned int BytesPerPixel(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_FLOAT: return 16;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT: return 8;
+	case DXGI_FORMAT_R32G32_FLOAT: return 8;
+	case DXGI_FORMAT_R8_UNORM: return 1;
+	case DXGI_FORMAT_R16_FLOAT: return 2;
+	case DXGI_FORMAT_R8G8_UNORM: return 2;
+	default: return 4;
+	}
+}
+
+RenderTargetPool::RenderTargetPool(ID3D11Device* device)
+	: device(device), screenWidth(1), screenHeight(1)
+{ }
+
+RenderTargetPool::~RenderTargetPool()
+{
+	Clear();
+}
+
+void RenderTargetPool::SetScreenSize(unsigned int width, unsigned int height)
+{
+	Clear();
+	screenWidth = width > 0 ? width : 1;
+	screenHeight = height > 0 ? height : 1;
+}
+
+unsigned long long RenderTargetPool::Key(unsigned int width, unsigned int height, DXGI_FORMAT format)
+{
+	return ((unsigned long long)width << 40) | ((unsigned long long)height << 16) | (unsigned long long)format;
+}
+
+void RenderTargetPool::GetSize(const RenderTargetDesc& desc, unsigned int& width, unsigned int& height)
+{
+	width = desc.Width > 0 ? desc.Width : (unsigned int)(screenWidth * desc.Scale);
+	height = desc.Height > 0 ? desc.Height : (unsigned int)(screenHeight * desc.Scale);
+	if (width == 0) width = 1;
+	if (height == 0) height = 1;
+}
+
+RenderTarget* RenderTargetPool::Acquire(const RenderTargetDesc& desc)
+{
+	unsigned int width, height;
+	GetSize(desc, width, height);
+
+	unsigned long long key = Key(width, height, desc.Format);
+	std::unordered_multimap<unsigned long long, RenderTarget*>::iterator it = freeTargets.find(key);
+	if (it != freeTargets.end())
+	{
+		RenderTarget* target = it->second;
+		freeTargets.erase(it);
+		return target;
+	}
+
+	D3D11_TEXTURE2D_DESC tDesc = {};
+	tDesc.Width = width;
+	tDesc.Height = height;
+	tDesc.ArraySize = 1;
+	tDesc.MipLevels = 1;
+	tDesc.Format = desc.Format;
+	tDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	tDesc.SampleDesc.Count = 1;
+	tDesc.Usage = D3D11_USAGE_DEFAULT;
+
+	RenderTarget* target = new RenderTarget();
+	target->Width = width;
+	target->Height = height;
+	target->Format = desc.Format;
+	target->Index = (int)targets.size();
+	if (FAILED(device->CreateTexture2D(&tDesc, 0, &target->Texture)) ||
+		FAILED(device->CreateRenderTargetView(target->Texture, 0, &target->RTV)) ||
+		FAILED(device->CreateShaderResourceView(target->Texture, 0, &target->SRV)))
+	{
+		if (target->SRV) target->SRV->Release();
+		if (target->RTV) target->RTV->Release();
+		if (target->Texture) target->Texture->Release();
+		delete target;
+		return 0;
+	}
+
+	targets.push_back(target);
+	return target;
+}
+
+void RenderTargetPool::Release(RenderTarget* target)
+{
+	if (target == 0)
+		return;
+	freeTargets.insert(std::make_pair(Key(target->Width, target->Height, target->Format), target));
+}
+
+void RenderTargetPool::Clear()
+{
+	for (unsigned int i = 0; i < targets.size(); i++)
+	{
+		targets[i]->SRV->Release();
+		targets[i]->RTV->Release();
+		targets[i]->Texture->Release();
+		delete targets[i];
+	}
+	targets.clear();
+	freeTargets.clear();
+}
+
+unsigned long long RenderTargetPool::GetMemoryBytes()
+{
+	unsigned long long bytes = 0;
+	for (unsigned int i = 0; i < targets.size(); i++)
+		bytes += (unsigned long long)targets[i]->Width * targets[i]->Height * BytesPerPixel(targets[i]->Format);
+	return bytes;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <d3d11.h>
+#include <unordered_map>
+#include <vector>
+
+// --------------------------------------------------------
+// What a render target needs to be.  A zero width or height
+// follows the screen instead, times Scale (so 0.5 is a half
+// resolution target).
+// --------------------------------------------------------
+struct RenderTargetDesc
+{
+	unsigned int Width;
+	unsigned int Height;
+	float Scale;
+	DXGI_FORMAT Format;
+};
+
+// --------------------------------------------------------
+// A texture that can be drawn into and then read
+// --------------------------------------------------------
+struct RenderTarget
+{
+	ID3D11Texture2D* Texture;
+	ID3D11RenderTargetView* RTV;
+	ID3D11ShaderResourceView* SRV;
+	unsigned int Width;
+	unsigned int Height;
+	DXGI_FORMAT Format;
+	int Index;		// Order the pool created it in
+};
+
+// --------------------------------------------------------
+// Hands out render targets by description, reusing released
+// ones with the same size and format before creating any.
+// Changing the screen size destroys everything, since targets
+// that follow the screen would be the wrong size.
+// --------------------------------------------------------
+class RenderTargetPool
+{
+public:
+	RenderTargetPool(ID3D11Device* device);
+	~RenderTargetPool();
+
+	void SetScreenSize(unsigned int width, unsigned int height);
+
+	// 0 if D3D couldn't create one
+	RenderTarget* Acquire(const RenderTargetDesc& desc);
+	void Release(RenderTarget* target);
+
+	// Destroys every target, acquired or not
+	void Clear();
+
+	// The size a description works out to right now
+	void GetSize(const RenderTargetDesc& desc, unsigned int& width, unsigned int& height);
+
+	int GetTargetCount() { return (int)targets.size(); }
+	unsigned long long GetMemoryBytes();
+
+private:
+	ID3D11Device* device;
+	unsigned int screenWidth;
+	unsigned int screenHeight;
+
+	std::vector<RenderTarget*> targets;
+	std::unordered_multimap<unsigned long long, RenderTarget*> freeTargets;
+
+	static unsigned long long Key(unsigned int width, unsigned int height, DXGI_FORMAT format);
+};
@@ -0,0 +1,38 @@
+
+// One direction of a separable Gaussian - run across, then down,
+// for 2(2r+1) samples instead of (2r+1)^2
+cbuffer Data : register(b0)
+{
+	float2 texelStep;		// One texel across or down
+	int radius;
+	float4 weights[3];		// Center first, then each step out
+}
+
+
+// Defines the input to this pixel shader
+// - Should match the output of our corresponding vertex shader
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float2 uv           : TEXCOORD0;
+};
+
+// Textures and such
+Texture2D pixels		: register(t0);
+SamplerState clampLinear	: register(s0);
+
+
+// Entry point for this pixel shader
+float4 main(VertexToPixel input) : SV_TARGET
+{
+	float4 total = pixels.Sample(clampLinear, input.uv) * weights[0].x;
+
+	for (int i = 1; i <= radius; i++)
+	{
+		float weight = weights[i / 4][i % 4];
+		float2 offset = texelStep * i;
+		total += (pixels.Sample(clampLinear, input.uv - offset) + pixels.Sample(clampLinear, input.uv + offset)) * weight;
+	}
+
+	return total;
+}
@@ -0,0 +1,32 @@
+
+cbuffer Data : register(b0)
+{
+	float intensity;
+	float2 sceneUVScale;	// The part of the scene drawn at the render scale
+	float2 sceneUVMax;		// Half a texel in from that part's edge
+}
+
+
+// Defines the input to this pixel shader
+// - Should match the output of our corresponding vertex shader
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float2 uv           : TEXCOORD0;
+};
+
+// Textures and such
+Texture2D pixels		: register(t0);
+Texture2D bloom			: register(t1);
+SamplerState clampLinear	: register(s0);
+
+
+// Entry point for this pixel shader
+float4 main(VertexToPixel input) : SV_TARGET
+{
+	// The scene may be drawn smaller and the bloom is half size,
+	// so the sampler filters both back up
+	float3 scene = pixels.Sample(clampLinear, min(input.uv * sceneUVScale, sceneUVMax)).rgb;
+	float3 glow = bloom.Sample(clampLinear, input.uv).rgb;
+	return float4(scene + glow * intensity, 1);
+}
@@ -0,0 +1,39 @@
+
+// Drawn at half resolution, so one bilinear sample of the scene
+// averages the four pixels under each output pixel
+cbuffer Data : register(b0)
+{
+	float threshold;
+	float knee;
+	float2 sceneUVScale;	// The part of the scene drawn at the render scale
+	float2 sceneUVMax;		// Half a texel in from that part's edge
+}
+
+
+// Defines the input to this pixel shader
+// - Should match the output of our corresponding vertex shader
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float2 uv           : TEXCOORD0;
+};
+
+// Textures and such
+Texture2D pixels		: register(t0);
+SamplerState clampLinear	: register(s0);
+
+
+// Entry point for this pixel shader
+float4 main(VertexToPixel input) : SV_TARGET
+{
+	float4 color = pixels.Sample(clampLinear, min(input.uv * sceneUVScale, sceneUVMax));
+
+	// Fade in over [threshold - knee, threshold + knee] rather
+	// than switching on, so bright edges don't flicker
+	float brightness = max(color.r, max(color.g, color.b));
+	float soft = clamp(brightness - threshold + knee, 0, 2 * knee);
+	soft = soft * soft / (4 * knee + 0.00001f);
+	float contribution = max(soft, brightness - threshold) / max(brightness, 0.00001f);
+
+	return color * contribution;
+}
@@ -0,0 +1,5 @@
+
+// PixelShader.hlsl for InstancedVS - the bloom mix comes in with
+// each instance instead of from the perMaterial buffer
+#define INSTANCED
+#include "PixelShader.hlsl"
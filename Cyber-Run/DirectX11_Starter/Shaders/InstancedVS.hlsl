@@ -0,0 +1,55 @@
+
+// Same as VertexShader.hlsl, but everything per-object comes in
+// with each instance, so a whole batch is a single draw.
+//
+// The matrices are the same transposed ones the constant buffer
+// path uses.  Here they are read row by row (row_major) instead of
+// column by column, so they are applied with the matrix on the left.
+
+// Describes individual vertex data
+struct VertexShaderInput
+{
+    float3 position		: POSITION;
+    float2 uv			: TEXCOORD;
+    float3 normal		: NORMAL;
+	float3 tangent		: TANGENT;
+
+	// Per-instance data
+	row_major float4x4 world			: INSTANCE_WORLD;
+	row_major float4x4 worldViewProj	: INSTANCE_WVP;
+	float3 tint				: INSTANCE_TINT;
+};
+
+// Defines the output data of our vertex shader
+struct VertexToPixel
+{
+    float4 position		: SV_POSITION;
+    float3 normal       : NORMAL;
+	float3 tangent		: TANGENT;
+    float3 worldPos     : TEXCOORD0;
+    float2 uv           : TEXCOORD1;
+	float3 tint			: TINT;
+};
+
+// The entry point for our vertex shader
+VertexToPixel main(VertexShaderInput input)
+{
+    // Set up output
+    VertexToPixel output;
+
+    // Calculate output position
+    output.position = mul(input.worldViewProj, float4(input.position, 1.0f));
+
+    // Take into account rotation (but not translation)
+	output.normal = mul((float3x3)input.world, input.normal);
+	output.tangent = mul((float3x3)input.world, input.tangent);
+
+    // The world space position of the vertex
+    output.worldPos = mul(input.world, float4(input.position, 1)).xyz;
+
+    // Just pass through
+    output.uv = input.uv;
+	output.tint = input.tint;
+
+    return output;
+}
@@ -1,5 +1,6 @@
 
-cbuffer LightData : register(b0)
+// Per-frame data, uploaded once per frame
+cbuffer perFrame : register(b0)
 {
 	// Direction light stuff
 	float4 DirLightColor;
@@ -15,6 +16,21 @@ cbuffer LightData : register(b0)
 	float pixelWidth;
 	float pixelHeight;
 	float blurAmount;
+
+	// Finding this pixel's light cluster
+	float3 CameraForward;
+	float2 ClusterScale;		// Clusters per pixel
+	float ClusterDepthScale;	// Slice = log(depth) * scale + bias
+	float ClusterDepthBias;
+
+	// Mip bias for the render scale, so textures stay as sharp
+	// as at full resolution
+	float LodBias;
+}
+
+// Per-material data, uploaded when switching between groups of draws
+cbuffer perMaterial : register(b1)
+{
 	float bloomAmountX;
 	float bloomAmountY;
 	float bloomAmountZ;
@@ -30,6 +46,9 @@ struct VertexToPixel
 	float3 tangent		: TANGENT;
 	float3 worldPos     : TEXCOORD0;
 	float2 uv           : TEXCOORD1;
+#ifdef INSTANCED
+	float3 tint			: TINT;
+#endif
 };
 
 // Textures and such
@@ -39,6 +58,25 @@ TextureCube skyTexture	: register(t2);
 SamplerState trilinear	: register(s0);
 Texture2D pixels		: register(t0);
 
+// Clustered point lights, from LightClusters - each cluster has
+// a range of LightIndices, which pick out Lights.  The counts
+// match LightClusters::CountX, CountY and CountZ.
+#define CLUSTER_COUNT_X 16
+#define CLUSTER_COUNT_Y 9
+#define CLUSTER_COUNT_Z 24
+
+struct ClusterLight
+{
+	float3 Position;
+	float Radius;
+	float3 Color;
+	float Intensity;
+};
+
+StructuredBuffer<ClusterLight> Lights	: register(t3);
+Buffer<uint2> ClusterRanges				: register(t4);
+Buffer<uint> LightIndices				: register(t5);
+
 
 // Entry point for this pixel shader
 float4 main(VertexToPixel input) : SV_TARGET
@@ -48,7 +86,7 @@ float4 main(VertexToPixel input) : SV_TARGET
 	input.tangent = normalize(input.tangent);
 
 	// Handle normal mapping -----------------------------------
-	float3 normalFromMap = normalMap.Sample(trilinear, input.uv).rgb;
+	float3 normalFromMap = normalMap.SampleBias(trilinear, input.uv, LodBias).rgb;
 	
 	// Unpack the normal
 	normalFromMap = normalFromMap * 2 - 1;
@@ -85,7 +123,7 @@ float4 main(VertexToPixel input) : SV_TARGET
 	float spec = pow(max(dot(refl, dirToCamera), 0), 64.0f);
 
 	// Grab the diffuse color
-	float4 diffuseColor = diffuse.Sample(trilinear, input.uv);
+	float4 diffuseColor = diffuse.SampleBias(trilinear, input.uv, LodBias);
 
 	// Get the reflection color
 	float4 reflectionColor = skyTexture.Sample(
@@ -95,10 +133,31 @@ float4 main(VertexToPixel input) : SV_TARGET
 	// Combine lights
 	float4 surfaceColor = (PointLightColor * pointNdotL * diffuseColor)* (PointLightColor.w*10.0f) + (DirLightColor * dirNdotL * diffuseColor)* (DirLightColor.w*10.0f) + float4(spec.xxx, 1);
 
+	// Neon point lights - only the ones that reach this pixel's cluster
+	float viewDepth = max(dot(input.worldPos - CameraPosition, CameraForward), 0.0001f);
+	int3 cluster = int3(input.position.xy * ClusterScale, floor(log(viewDepth) * ClusterDepthScale + ClusterDepthBias));
+	cluster = clamp(cluster, int3(0, 0, 0), int3(CLUSTER_COUNT_X - 1, CLUSTER_COUNT_Y - 1, CLUSTER_COUNT_Z - 1));
+	uint2 range = ClusterRanges[(cluster.z * CLUSTER_COUNT_Y + cluster.y) * CLUSTER_COUNT_X + cluster.x];
+	for (uint i = 0; i < range.y; i++)
+	{
+		ClusterLight light = Lights[LightIndices[range.x + i]];
+		float3 toLight = light.Position - input.worldPos;
+		float distance = length(toLight);
+		float falloff = saturate(1 - distance / light.Radius);
+		float NdotL = saturate(dot(input.normal, toLight / max(distance, 0.0001f)));
+		surfaceColor.rgb += light.Color * (light.Intensity * falloff * falloff * NdotL) * diffuseColor.rgb;
+	}
+
+#ifdef INSTANCED
+	float3 bloomAmount = input.tint;
+#else
+	float3 bloomAmount = float3(bloomAmountX, bloomAmountY, bloomAmountZ);
+#endif
+
 	if (surfaceColor.x + surfaceColor.y + surfaceColor.z > 1.5f) {
-		surfaceColor = float4(surfaceColor.x + bloomAmountX,
-			surfaceColor.y + bloomAmountY,
-			surfaceColor.z + bloomAmountZ,
+		surfaceColor = float4(surfaceColor.x + bloomAmount.x,
+			surfaceColor.y + bloomAmount.y,
+			surfaceColor.z + bloomAmount.z,
 			0);
 	}
 
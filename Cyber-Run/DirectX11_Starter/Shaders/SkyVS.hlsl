@@ -1,6 +1,6 @@
 
-// Constant buffer for C++ data being passed in
-cbuffer externalData : register(b0)
+// Per-frame data, uploaded once per frame
+cbuffer perFrame : register(b0)
 {
     matrix view;
     matrix projection;
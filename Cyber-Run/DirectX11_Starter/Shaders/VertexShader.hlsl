@@ -1,10 +1,10 @@
 
-// Constant buffer for C++ data being passed in
-cbuffer externalData : register(b0)
+// Per-object data, uploaded for every draw.  World * view *
+// projection is multiplied once on the CPU, not per vertex.
+cbuffer perObject : register(b0)
 {
     matrix world;
-    matrix view;
-    matrix projection;
+    matrix worldViewProj;
 };
 
 // Describes individual vertex data
@@ -33,7 +33,6 @@ VertexToPixel main(VertexShaderInput input)
     VertexToPixel output;
 
     // Calculate output position
-    matrix worldViewProj = mul(mul(world, view), projection);
     output.position = mul(float4(input.position, 1.0f), worldViewProj);
 
     // Take into account rotation (but not translation)
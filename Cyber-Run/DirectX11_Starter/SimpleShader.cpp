@@ -1,4 +1,22 @@
 #include "SimpleShader.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+
+#include <mutex>
+
+unsigned int ISimpleShader::uploadedBytes = 0;
+unsigned int ISimpleShader::uploadCount = 0;
+unsigned int ISimpleShader::skippedCount = 0;
+StateCache* ISimpleShader::stateCache = 0;
+
+// Compiled code and reflection for each shader file loaded so far
+struct CachedShaderFile
+{
+	ID3DBlob* Blob;
+	DxbcReflection Reflection;
+};
+static std::unordered_map<std::wstring, CachedShaderFile> shaderFileCache;
+static std::mutex shaderFileCacheMutex;
 
 ///////////////////////////////////////////////////////////////////////////////
 // ------ BASE SIMPLE SHADER --------------------------------------------------
@@ -42,6 +60,7 @@ void ISimpleShader::CleanUp()
 	constantBufferCount = 0;
 
 	// Clean up tables
+	hashTable.clear();
 	varTable.clear();
 	cbTable.clear();
 	samplerTable.clear();
@@ -49,9 +68,13 @@ void ISimpleShader::CleanUp()
 }
 
 // --------------------------------------------------------
-// Loads the specified shader and builds the variable table using shader
-// reflection.  This must be a separate step from the constructor since
-// we can't invoke derived class overrides in the base class constructor.
+// Loads the specified shader and builds the variable table from
+// its reflection data.  This must be a separate step from the
+// constructor since we can't invoke derived class overrides in
+// the base class constructor.
+//
+// The reflection comes from DxbcReader rather than D3DReflect,
+// and both it and the compiled code are cached per file.
 //
 // shaderFile - A "wide string" specifying the compiled shader to load
 // 
@@ -59,57 +82,68 @@ void ISimpleShader::CleanUp()
 // --------------------------------------------------------
 bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 {
-	// Load the shader to a blob and ensure it worked
+	MEMORY_TAG(MemoryTracker::TagShader);
+
+	// Reuse the file if we've seen it before, otherwise load
+	// it to a blob and parse its reflection data
 	ID3DBlob* shaderBlob = 0;
-	HRESULT hr = D3DReadFileToBlob(shaderFile, &shaderBlob);
-	if (hr != S_OK)
+	const DxbcReflection* reflection = 0;
 	{
-		return false;
+		std::lock_guard<std::mutex> lock(shaderFileCacheMutex);
+		std::unordered_map<std::wstring, CachedShaderFile>::iterator cached = shaderFileCache.find(shaderFile);
+		if (cached == shaderFileCache.end())
+		{
+			HRESULT hr = D3DReadFileToBlob(shaderFile, &shaderBlob);
+			if (hr != S_OK)
+			{
+				return false;
+			}
+
+			DxbcReader reader;
+			if (!reader.Parse(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize()))
+			{
+				OutputDebugStringA(("SimpleShader: " + reader.GetError() + "\n").c_str());
+				shaderBlob->Release();
+				return false;
+			}
+
+			CachedShaderFile file;
+			file.Blob = shaderBlob;
+			file.Reflection = reader.GetReflection();
+			cached = shaderFileCache.insert(std::make_pair(std::wstring(shaderFile), file)).first;
+		}
+
+		// Map nodes don't move, so these stay put until the cache is cleared
+		shaderBlob = cached->second.Blob;
+		reflection = &cached->second.Reflection;
 	}
 
 	// Create the shader - Calls an overloaded version of this abstract
 	// method in the appropriate child class
-	shaderValid = CreateShader(shaderBlob);
+	shaderValid = CreateShader(shaderBlob, *reflection);
 	if (!shaderValid)
 	{
-		shaderBlob->Release();
 		return false;
 	}
 
-	// Set up shader reflection to get information about
-	// this shader and its variables,  buffers, etc.
-	ID3D11ShaderReflection* refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)&refl);
-	
-	// Get the description of the shader
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
 	// Create an array of constant buffers
-	constantBufferCount = shaderDesc.ConstantBuffers;
+	constantBufferCount = (unsigned int)reflection->ConstantBuffers.size();
 	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
 	
 	// Handle bound resources (like shaders and samplers)
-	unsigned int resourceCount = shaderDesc.BoundResources;
-	for (unsigned int r = 0; r < resourceCount; r++)
+	for (size_t r = 0; r < reflection->Bindings.size(); r++)
 	{
-		// Get this resource's description
-		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
-		refl->GetResourceBindingDesc(r, &resourceDesc);
+		const DxbcBinding& binding = reflection->Bindings[r];
 
 		// Check the type
-		switch (resourceDesc.Type)
+		switch (binding.Type)
 		{
 		case D3D_SIT_TEXTURE: // A texture resource
-			textureTable.insert(std::pair<std::string, unsigned int>(resourceDesc.Name, resourceDesc.BindPoint));
+			textureTable.insert(std::pair<std::string, unsigned int>(binding.Name, binding.BindPoint));
 			break;
 
 		case D3D_SIT_SAMPLER: // A sampler resource
-			samplerTable.insert(std::pair<std::string, unsigned int>(resourceDesc.Name, resourceDesc.BindPoint));
+			samplerTable.insert(std::pair<std::string, unsigned int>(binding.Name, binding.BindPoint));
 			break;
 		}
 	}
@@ -118,20 +152,15 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 	for (unsigned int b = 0; b < constantBufferCount; b++)
 	{
 		// Get this buffer
-		ID3D11ShaderReflectionConstantBuffer* cb =
-			refl->GetConstantBufferByIndex(b);
-		
-		// Get the description of this buffer
-		D3D11_SHADER_BUFFER_DESC bufferDesc;
-		cb->GetDesc(&bufferDesc);
-
-		// Get the description of the resource binding, so
-		// we know exactly how it's bound in the shader
-		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
-		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
+		const DxbcConstantBuffer& bufferDesc = reflection->ConstantBuffers[b];
+
+		// Get the resource binding, so we know exactly
+		// how it's bound in the shader
+		const DxbcBinding* binding = reflection->FindBinding(bufferDesc.Name);
 		
 		// Set up the buffer and put its pointer in the table
-		constantBuffers[b].BindIndex = bindDesc.BindPoint;
+		constantBuffers[b].BindIndex = binding ? binding->BindPoint : 0;
+		constantBuffers[b].Size = bufferDesc.Size;
 		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferDesc.Name, &constantBuffers[b]));
 
 		// Create this constant buffer
@@ -144,41 +173,57 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		newBuffDesc.StructureByteStride = 0;
 		device->CreateBuffer(&newBuffDesc, 0, &constantBuffers[b].ConstantBuffer);
 
-		// Set up the data buffer for this constant buffer
+		// Set up the data buffer for this constant buffer.  The GPU
+		// side starts out undefined, so all of it needs uploading.
 		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
 		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
+		constantBuffers[b].Dynamic = false;
+		constantBuffers[b].DirtyStart = 0;
+		constantBuffers[b].DirtyEnd = bufferDesc.Size;
 
 		// Loop through all variables in this buffer
-		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		for (size_t v = 0; v < bufferDesc.Variables.size(); v++)
 		{
-			// Get this variable
-			ID3D11ShaderReflectionVariable* var =
-				cb->GetVariableByIndex(v);
-			
-			// Get the description of the variable
-			D3D11_SHADER_VARIABLE_DESC varDesc;
-			var->GetDesc(&varDesc);
+			const DxbcVariable& varDesc = bufferDesc.Variables[v];
 
 			// Create the variable struct
 			SimpleShaderVariable varStruct;
 			varStruct.ConstantBufferIndex = b;
-			varStruct.ByteOffset = varDesc.StartOffset;
+			varStruct.ByteOffset = varDesc.Offset;
 			varStruct.Size = varDesc.Size;
-			
-			// Get a string version
-			std::string varName(varDesc.Name);
 
 			// Add this variable to the table
-			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varName, varStruct));
+			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varDesc.Name, varStruct));
 		}
 	}
 
+	// Index the variables by hash too, for "name"_sn lookups.  If two
+	// names ever share a hash, the second is found by the fallback.
+	for (std::unordered_map<std::string, SimpleShaderVariable>::iterator it = varTable.begin(); it != varTable.end(); it++)
+	{
+		hashTable.insert(std::make_pair(SimpleShaderHash(it->first.c_str()), &(*it)));
+	}
+
 	// All set
-	refl->Release();
-	shaderBlob->Release();
 	return true;
 }
 
+// --------------------------------------------------------
+// Releases every cached shader file.  Shaders that are already
+// loaded keep working - they don't hold on to the cache.
+// --------------------------------------------------------
+void ISimpleShader::ClearShaderFileCache()
+{
+	std::lock_guard<std::mutex> lock(shaderFileCacheMutex);
+	for (std::unordered_map<std::wstring, CachedShaderFile>::iterator it = shaderFileCache.begin(); it != shaderFileCache.end(); it++)
+	{
+		it->second.Blob->Release();
+	}
+
+	// Swapped out rather than cleared, so the buckets go too
+	std::unordered_map<std::wstring, CachedShaderFile>().swap(shaderFileCache);
+}
+
 // --------------------------------------------------------
 // Helper for looking up a variable by name and also
 // verifying that it is the requested size
@@ -271,7 +316,18 @@ void ISimpleShader::SetShader(bool copyData)
 	if (copyData) CopyAllBufferData();
 
 	// Set the shader and any relevant constant buffers
-	SetShaderAndCB();
+	SetShaderAndCB(stateCache);
+}
+
+// --------------------------------------------------------
+// Sets the shader and its constant buffers through a given
+// cache (like one recording on a deferred context) - no data
+// is copied, so it's safe from more than one thread at once
+// --------------------------------------------------------
+void ISimpleShader::BindShader(StateCache* cache)
+{
+	if (!shaderValid) return;
+	SetShaderAndCB(cache);
 }
 
 // --------------------------------------------------------
@@ -283,6 +339,8 @@ void ISimpleShader::SetShader(bool copyData)
 // --------------------------------------------------------
 void ISimpleShader::CopyBufferData(std::string bufferName)
 {
+	PROFILE_ZONE("Shader upload");
+
 	// Ensure the shader is valid
 	if (!shaderValid) return;
 
@@ -290,10 +348,8 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
 	if (!cb) return;
 
-	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	// Copy the data (if it changed) and get out
+	UploadBuffer(*cb);
 }
 
 // --------------------------------------------------------
@@ -303,17 +359,130 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 // --------------------------------------------------------
 void ISimpleShader::CopyAllBufferData()
 {
+	PROFILE_ZONE("Shader upload");
+
 	// Ensure the shader is valid
 	if (!shaderValid) return;
 
-	// Loop through the constant buffers and copy all data
+	// Loop through the constant buffers and copy any that changed
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Copy the entire local data buffer
+		UploadBuffer(constantBuffers[i]);
+	}
+}
+
+// --------------------------------------------------------
+// Uploads a buffer if anything in it changed since last time.
+//
+// D3D 11.0 can't update part of a constant buffer (and DISCARD
+// throws the old contents away), so the whole buffer is sent -
+// the dirty range only tells us whether to send it at all.
+// --------------------------------------------------------
+void ISimpleShader::UploadBuffer(SimpleConstantBuffer& cb)
+{
+	if (cb.DirtyEnd <= cb.DirtyStart)
+	{
+		skippedCount++;
+		return;
+	}
+
+	if (cb.Dynamic)
+	{
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (FAILED(deviceContext->Map(cb.ConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+			return;
+		memcpy(mapped.pData, cb.LocalDataBuffer, cb.Size);
+		deviceContext->Unmap(cb.ConstantBuffer, 0);
+	}
+	else
+	{
 		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer, 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
+			cb.ConstantBuffer, 0, 0,
+			cb.LocalDataBuffer, 0, 0);
 	}
+
+	uploadedBytes += cb.Size;
+	uploadCount++;
+	cb.DirtyStart = cb.Size;
+	cb.DirtyEnd = 0;
+}
+
+// --------------------------------------------------------
+// Recreates a constant buffer as DYNAMIC, so it's uploaded with
+// Map(WRITE_DISCARD).  That suits per-draw data better than
+// UpdateSubresource, which may have to copy it twice.
+//
+// Returns true if the buffer exists
+// --------------------------------------------------------
+bool ISimpleShader::SetBufferDynamic(std::string bufferName)
+{
+	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
+	if (!cb) return false;
+	if (cb->Dynamic) return true;
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.ByteWidth = cb->Size;
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+	ID3D11Buffer* buffer = 0;
+	if (FAILED(device->CreateBuffer(&desc, 0, &buffer)))
+		return false;
+
+	cb->ConstantBuffer->Release();
+	cb->ConstantBuffer = buffer;
+	cb->Dynamic = true;
+	cb->DirtyStart = 0;
+	cb->DirtyEnd = cb->Size;
+	return true;
+}
+
+// --------------------------------------------------------
+// Copies a buffer's local data into the ring.  The buffer's
+// dirty range is left alone - its own GPU copy is still as
+// out of date as it was.
+// --------------------------------------------------------
+ConstantAllocation ISimpleShader::AllocateBufferData(std::string bufferName, ConstantRing* ring)
+{
+	PROFILE_ZONE("Shader allocate");
+
+	ConstantAllocation allocation = { 0, 0 };
+	if (!shaderValid) return allocation;
+
+	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
+	if (!cb) return allocation;
+
+	return ring->Allocate(cb->LocalDataBuffer, cb->Size);
+}
+
+// --------------------------------------------------------
+// Binds a ring allocation to the buffer's slot
+// --------------------------------------------------------
+void ISimpleShader::BindBufferData(StateCache* context, std::string bufferName, ConstantRing* ring, const ConstantAllocation& allocation)
+{
+	if (!shaderValid) return;
+
+	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
+	if (!cb) return;
+
+	ring->Bind(context, GetStage(), cb->BindIndex, allocation);
+}
+
+// --------------------------------------------------------
+// Copies data into a local buffer, growing its dirty range
+// only if the bytes are actually different
+// --------------------------------------------------------
+void ISimpleShader::WriteVariable(unsigned int bufferIndex, unsigned int byteOffset, const void* data, unsigned int size)
+{
+	SimpleConstantBuffer& cb = constantBuffers[bufferIndex];
+	unsigned char* destination = cb.LocalDataBuffer + byteOffset;
+	if (memcmp(destination, data, size) == 0)
+		return;
+
+	memcpy(destination, data, size);
+	if (byteOffset < cb.DirtyStart) cb.DirtyStart = byteOffset;
+	if (byteOffset + size > cb.DirtyEnd) cb.DirtyEnd = byteOffset + size;
 }
 
 // --------------------------------------------------------
@@ -334,15 +503,67 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 		return false;
 
 	// Set the data in the local data buffer
-	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
-		data,
-		size);
+	WriteVariable(var->ConstantBufferIndex, var->ByteOffset, data, size);
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a variable by pre-hashed name.  Only the hash is looked
+// up - the string is compared once to rule out collisions.
+// --------------------------------------------------------
+bool ISimpleShader::SetData(SimpleShaderName name, const void* data, unsigned int size)
+{
+	std::unordered_map<unsigned int, const std::pair<const std::string, SimpleShaderVariable>*>::iterator result =
+		hashTable.find(name.Hash);
+	if (result == hashTable.end())
+		return false;
+
+	// A different variable with the same hash - take the slow path
+	if (strcmp(result->second->first.c_str(), name.Text) != 0)
+		return SetData(std::string(name.Text), data, size);
+
+	const SimpleShaderVariable& var = result->second->second;
+	if (var.Size != size)
+		return false;
+
+	WriteVariable(var.ConstantBufferIndex, var.ByteOffset, data, size);
+	return true;
+}
+
+// --------------------------------------------------------
+// Looks a variable up once, for use with the handle setters.
+// The handle is invalid if there's no such variable.
+// --------------------------------------------------------
+SimpleShaderHandle ISimpleShader::GetVariableHandle(std::string name)
+{
+	SimpleShaderHandle handle = { -1, 0, 0 };
+
+	std::unordered_map<std::string, SimpleShaderVariable>::iterator result =
+		varTable.find(name);
+	if (result == varTable.end())
+		return handle;
+
+	handle.ConstantBufferIndex = result->second.ConstantBufferIndex;
+	handle.ByteOffset = result->second.ByteOffset;
+	handle.Size = result->second.Size;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Sets a variable through a handle - no lookup, just a size
+// check and the copy
+// --------------------------------------------------------
+bool ISimpleShader::SetData(const SimpleShaderHandle& handle, const void* data, unsigned int size)
+{
+	if (!handle.IsValid() || handle.Size != size)
+		return false;
+
+	WriteVariable(handle.ConstantBufferIndex, handle.ByteOffset, data, size);
+	return true;
+}
+
 // --------------------------------------------------------
 // Sets INTEGER data
 // --------------------------------------------------------
@@ -457,10 +678,11 @@ void SimpleVertexShader::CleanUp()
 // Creates the DirectX vertex shader
 //
 // shaderBlob - The shader's compiled code
+// reflection - What DxbcReader found in it
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
+bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob, const DxbcReflection& reflection)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -477,39 +699,39 @@ bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
 	if (result != S_OK)
 		return false;
 
-	// Vertex shader was created successfully, so we now use the
-	// shader code to re-reflect and create an input layout that 
-	// matches what the vertex shader expects.  Code adapted from:
+	// Vertex shader was created successfully, so we now use its
+	// input signature to create an input layout that matches
+	// what the vertex shader expects.  Code adapted from:
 	// https://takinginitiative.wordpress.com/2011/12/11/directx-1011-basic-shader-reflection-automatic-input-layout-creation/
 
-	// Reflect shader info
-	ID3D11ShaderReflection* refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)&refl);
-	
-	// Get shader info
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
-	// Read input layout description from shader info
+	// Read input layout description from the input signature
 	std::vector<D3D11_INPUT_ELEMENT_DESC> inputLayoutDesc;
-	for (unsigned int i = 0; i< shaderDesc.InputParameters; i++)
+	for (size_t i = 0; i < reflection.Inputs.size(); i++)
 	{
-		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
-		refl->GetInputParameterDesc(i, &paramDesc);
+		const DxbcSignatureElement& paramDesc = reflection.Inputs[i];
+
+		// System values (SV_VertexID and the like) aren't read from buffers
+		if (paramDesc.SystemValue != D3D_NAME_UNDEFINED)
+			continue;
 
 		// Fill out input element desc
 		D3D11_INPUT_ELEMENT_DESC elementDesc;
-		elementDesc.SemanticName = paramDesc.SemanticName;
+		elementDesc.SemanticName = paramDesc.SemanticName.c_str();
 		elementDesc.SemanticIndex = paramDesc.SemanticIndex;
 		elementDesc.InputSlot = 0;
 		elementDesc.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
 		elementDesc.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 		elementDesc.InstanceDataStepRate = 0;
 
+		// Semantics starting with "INSTANCE_" are per-instance data,
+		// read from a second vertex buffer in slot 1
+		if (strncmp(paramDesc.SemanticName.c_str(), "INSTANCE_", 9) == 0)
+		{
+			elementDesc.InputSlot = 1;
+			elementDesc.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+			elementDesc.InstanceDataStepRate = 1;
+		}
+
 		// Determine DXGI format
 		if (paramDesc.Mask == 1)
 		{
@@ -548,8 +770,7 @@ bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
 		shaderBlob->GetBufferSize(),
 		&inputLayout);
 
-	// All done, clean up
-	refl->Release();
+	// All done
 	return true;
 }
 
@@ -557,22 +778,33 @@ bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
 // Sets the vertex shader, input layout and constant buffers
 // for future DirectX drawing
 // --------------------------------------------------------
-void SimpleVertexShader::SetShaderAndCB()
+void SimpleVertexShader::SetShaderAndCB(StateCache* cache)
 {
 	// Is shader valid?
 	if (!shaderValid) return;
 
 	// Set the shader and input layout
-	deviceContext->IASetInputLayout(inputLayout);
-	deviceContext->VSSetShader(shader, 0, 0);
+	if (cache)
+	{
+		cache->IASetInputLayout(inputLayout);
+		cache->VSSetShader(shader);
+	}
+	else
+	{
+		deviceContext->IASetInputLayout(inputLayout);
+		deviceContext->VSSetShader(shader, 0, 0);
+	}
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		deviceContext->VSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+		if (cache)
+			cache->SetConstantBuffer(StateCache::StageVertex, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer);
+		else
+			deviceContext->VSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				&constantBuffers[i].ConstantBuffer);
 	}
 }
 
@@ -592,7 +824,10 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, ID3D11ShaderRes
 		return false;
 
 	// Set the shader resource view
-	deviceContext->VSSetShaderResources(bindIndex, 1, &srv);
+	if (stateCache)
+		stateCache->SetShaderResource(StateCache::StageVertex, bindIndex, srv);
+	else
+		deviceContext->VSSetShaderResources(bindIndex, 1, &srv);
 
 	// Success
 	return true;
@@ -614,7 +849,10 @@ bool SimpleVertexShader::SetSamplerState(std::string name, ID3D11SamplerState* s
 		return false;
 
 	// Set the shader resource view
-	deviceContext->VSSetSamplers(bindIndex, 1, &samplerState);
+	if (stateCache)
+		stateCache->SetSampler(StateCache::StageVertex, bindIndex, samplerState);
+	else
+		deviceContext->VSSetSamplers(bindIndex, 1, &samplerState);
 
 	// Success
 	return true;
@@ -653,10 +891,11 @@ void SimplePixelShader::CleanUp()
 // Creates the DirectX pixel shader
 //
 // shaderBlob - The shader's compiled code
+// reflection - What DxbcReader found in it
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimplePixelShader::CreateShader(ID3DBlob* shaderBlob)
+bool SimplePixelShader::CreateShader(ID3DBlob* shaderBlob, const DxbcReflection& reflection)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -677,21 +916,27 @@ bool SimplePixelShader::CreateShader(ID3DBlob* shaderBlob)
 // Sets the pixel shader and constant buffers for
 // future DirectX drawing
 // --------------------------------------------------------
-void SimplePixelShader::SetShaderAndCB()
+void SimplePixelShader::SetShaderAndCB(StateCache* cache)
 {
 	// Is shader valid?
 	if (!shaderValid) return;
 	
 	// Set the shader
-	deviceContext->PSSetShader(shader, 0, 0);
+	if (cache)
+		cache->PSSetShader(shader);
+	else
+		deviceContext->PSSetShader(shader, 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		deviceContext->PSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+		if (cache)
+			cache->SetConstantBuffer(StateCache::StagePixel, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer);
+		else
+			deviceContext->PSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				&constantBuffers[i].ConstantBuffer);
 	}
 }
 
@@ -711,7 +956,10 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, ID3D11ShaderReso
 		return false;
 
 	// Set the shader resource view
-	deviceContext->PSSetShaderResources(bindIndex, 1, &srv);
+	if (stateCache)
+		stateCache->SetShaderResource(StateCache::StagePixel, bindIndex, srv);
+	else
+		deviceContext->PSSetShaderResources(bindIndex, 1, &srv);
 
 	// Success
 	return true;
@@ -733,7 +981,10 @@ bool SimplePixelShader::SetSamplerState(std::string name, ID3D11SamplerState* sa
 		return false;
 
 	// Set the shader resource view
-	deviceContext->PSSetSamplers(bindIndex, 1, &samplerState);
+	if (stateCache)
+		stateCache->SetSampler(StateCache::StagePixel, bindIndex, samplerState);
+	else
+		deviceContext->PSSetSamplers(bindIndex, 1, &samplerState);
 
 	// Success
 	return true;
@@ -776,10 +1027,11 @@ void SimpleGeometryShader::CleanUp()
 // Creates the DirectX Geometry shader
 //
 // shaderBlob - The shader's compiled code
+// reflection - What DxbcReader found in it
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleGeometryShader::CreateShader(ID3DBlob* shaderBlob)
+bool SimpleGeometryShader::CreateShader(ID3DBlob* shaderBlob, const DxbcReflection& reflection)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -787,7 +1039,7 @@ bool SimpleGeometryShader::CreateShader(ID3DBlob* shaderBlob)
 
 	// Using stream out?
 	if (useStreamOut)
-		return this->CreateShaderWithStreamOut(shaderBlob);
+		return this->CreateShaderWithStreamOut(shaderBlob, reflection);
 
 	// Create the shader from the blob
 	HRESULT result = device->CreateGeometryShader(
@@ -805,40 +1057,28 @@ bool SimpleGeometryShader::CreateShader(ID3DBlob* shaderBlob)
 // stream output, if possible.
 //
 // shaderBlob - The shader's compiled code
+// reflection - What DxbcReader found in it
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleGeometryShader::CreateShaderWithStreamOut(ID3DBlob* shaderBlob)
+bool SimpleGeometryShader::CreateShaderWithStreamOut(ID3DBlob* shaderBlob, const DxbcReflection& reflection)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
 	this->CleanUp();
 
-	// Reflect shader info
-	ID3D11ShaderReflection* refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)&refl);
-
-	// Get shader info
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
 	// Set up the output signature
 	streamOutVertexSize = 0;
 	std::vector<D3D11_SO_DECLARATION_ENTRY> soDecl;
-	for (unsigned int i = 0; i < shaderDesc.OutputParameters; i++)
+	for (size_t i = 0; i < reflection.Outputs.size(); i++)
 	{
 		// Get the info about this entry
-		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
-		refl->GetOutputParameterDesc(i, &paramDesc);
+		const DxbcSignatureElement& paramDesc = reflection.Outputs[i];
 		
 		// Create the SO Declaration
 		D3D11_SO_DECLARATION_ENTRY entry;
 		entry.SemanticIndex  = paramDesc.SemanticIndex;
-		entry.SemanticName   = paramDesc.SemanticName;
+		entry.SemanticName   = paramDesc.SemanticName.c_str();
 		entry.Stream         = paramDesc.Stream;
 		entry.StartComponent = 0; // Assume starting at 0
 		entry.OutputSlot     = 0; // Assume the first output slot
@@ -919,21 +1159,27 @@ void SimpleGeometryShader::UnbindStreamOutStage(ID3D11DeviceContext* deviceConte
 // Sets the geometry shader and constant buffers for
 // future DirectX drawing
 // --------------------------------------------------------
-void SimpleGeometryShader::SetShaderAndCB()
+void SimpleGeometryShader::SetShaderAndCB(StateCache* cache)
 {
 	// Is shader valid?
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->GSSetShader(shader, 0, 0);
+	if (cache)
+		cache->GSSetShader(shader);
+	else
+		deviceContext->GSSetShader(shader, 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		deviceContext->GSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+		if (cache)
+			cache->SetConstantBuffer(StateCache::StageGeometry, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer);
+		else
+			deviceContext->GSSetConstantBuffers(
+				constantBuffers[i].BindIndex,
+				1,
+				&constantBuffers[i].ConstantBuffer);
 	}
 }
 
@@ -953,7 +1199,10 @@ bool SimpleGeometryShader::SetShaderResourceView(std::string name, ID3D11ShaderR
 		return false;
 
 	// Set the shader resource view
-	deviceContext->GSSetShaderResources(bindIndex, 1, &srv);
+	if (stateCache)
+		stateCache->SetShaderResource(StateCache::StageGeometry, bindIndex, srv);
+	else
+		deviceContext->GSSetShaderResources(bindIndex, 1, &srv);
 
 	// Success
 	return true;
@@ -975,7 +1224,10 @@ bool SimpleGeometryShader::SetSamplerState(std::string name, ID3D11SamplerState*
 		return false;
 
 	// Set the shader resource view
-	deviceContext->GSSetSamplers(bindIndex, 1, &samplerState);
+	if (stateCache)
+		stateCache->SetSampler(StateCache::StageGeometry, bindIndex, samplerState);
+	else
+		deviceContext->GSSetSamplers(bindIndex, 1, &samplerState);
 
 	// Success
 	return true;
@@ -8,6 +8,10 @@
 #include <unordered_map>
 #include <string>
 
+#include "ConstantRing.h"
+#include "DxbcReader.h"
+#include "StateCache.h"
+
 // --------------------------------------------------------
 // Used by simple shaders to store information about
 // specific variables in constant buffers
@@ -19,6 +23,44 @@ struct SimpleShaderVariable
 	unsigned int ConstantBufferIndex;
 };
 
+// --------------------------------------------------------
+// A shader variable looked up ahead of time with
+// GetVariableHandle(), so setting it needs no lookup at all.
+// Handles stay valid until the shader is loaded again.
+// --------------------------------------------------------
+struct SimpleShaderHandle
+{
+	int ConstantBufferIndex;	// -1 if the variable doesn't exist
+	unsigned int ByteOffset;
+	unsigned int Size;
+
+	bool IsValid() const { return ConstantBufferIndex >= 0; }
+};
+
+// --------------------------------------------------------
+// A variable name with its hash worked out at compile time,
+// so setting by name doesn't build a std::string:
+//
+//   vs->SetMatrix4x4("world"_sn, world);
+// --------------------------------------------------------
+struct SimpleShaderName
+{
+	unsigned int Hash;
+	const char* Text;
+};
+
+// FNV-1a, written recursively so it's a C++11 constexpr (and
+// multiplied in 64 bits, so no constant ever overflows)
+constexpr unsigned int SimpleShaderHash(const char* text, unsigned int hash = 2166136261u)
+{
+	return *text ? SimpleShaderHash(text + 1, (unsigned int)((hash ^ (unsigned char)*text) * 16777619ull)) : hash;
+}
+
+constexpr SimpleShaderName operator"" _sn(const char* text, size_t)
+{
+	return SimpleShaderName{ SimpleShaderHash(text), text };
+}
+
 // --------------------------------------------------------
 // Contains information about a specific
 // constant buffer in a shader, as well as
@@ -27,8 +69,18 @@ struct SimpleShaderVariable
 struct SimpleConstantBuffer
 {
 	unsigned int BindIndex;
+	unsigned int Size;
 	ID3D11Buffer* ConstantBuffer;
 	unsigned char* LocalDataBuffer;
+
+	// DYNAMIC buffers are uploaded with Map(WRITE_DISCARD)
+	// instead of UpdateSubresource
+	bool Dynamic;
+
+	// Bytes changed since the last upload - nothing is dirty
+	// when DirtyEnd <= DirtyStart
+	unsigned int DirtyStart;
+	unsigned int DirtyEnd;
 };
 
 // --------------------------------------------------------
@@ -44,6 +96,11 @@ public:
 	// overrides in the base class constructor)
 	bool LoadShaderFile(LPCWSTR shaderFile);
 
+	// Compiled shaders are read and reflected once per file, and
+	// kept for any later shader loading the same file.  Clearing
+	// releases them (new loads go back to the disk).
+	static void ClearShaderFileCache();
+
 	// Simple helpers
 	bool IsShaderValid() { return shaderValid; }
 
@@ -52,6 +109,34 @@ public:
 	void CopyAllBufferData();
 	void CopyBufferData(std::string bufferName);
 
+	// Activates the shader through a particular cache (one per
+	// thread, say) without copying or touching any data
+	void BindShader(StateCache* cache);
+
+	// Switches a buffer to D3D11_USAGE_DYNAMIC, for buffers that
+	// change on (nearly) every draw.  Call it right after loading.
+	bool SetBufferDynamic(std::string bufferName);
+
+	// Per-draw data through a ConstantRing: copies a buffer's current
+	// data into the ring, then (after the ring's Upload) binds that
+	// copy in place of the shader's own buffer.  Nothing is
+	// allocated if the shader has no buffer by that name.
+	// Binding doesn't touch the shader's data, so any number of
+	// threads can bind through their own caches.
+	ConstantAllocation AllocateBufferData(std::string bufferName, ConstantRing* ring);
+	void BindBufferData(StateCache* context, std::string bufferName, ConstantRing* ring, const ConstantAllocation& allocation);
+
+	// Constant buffer uploads made by every shader since the last
+	// reset, and copies skipped because nothing had changed
+	static unsigned int GetUploadedBytes() { return uploadedBytes; }
+	static unsigned int GetUploadCount() { return uploadCount; }
+	static unsigned int GetSkippedCount() { return skippedCount; }
+	static void ResetUploadCounters() { uploadedBytes = 0; uploadCount = 0; skippedCount = 0; }
+
+	// When set, every shader binds through this instead of straight
+	// to its context, so redundant binds get dropped
+	static void SetStateCache(StateCache* cache) { stateCache = cache; }
+
 	// Sets arbitrary shader data
 	bool SetData(std::string name, const void* data, unsigned int size);
 
@@ -66,10 +151,38 @@ public:
 	bool SetMatrix4x4(std::string name, const float data[16]);
 	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
 
+	// Same as above, but by pre-hashed name ("name"_sn)
+	bool SetData(SimpleShaderName name, const void* data, unsigned int size);
+
+	bool SetInt(SimpleShaderName name, int data) { return SetData(name, &data, sizeof(int)); }
+	bool SetFloat(SimpleShaderName name, float data) { return SetData(name, &data, sizeof(float)); }
+	bool SetFloat2(SimpleShaderName name, const DirectX::XMFLOAT2& data) { return SetData(name, &data, sizeof(float) * 2); }
+	bool SetFloat3(SimpleShaderName name, const DirectX::XMFLOAT3& data) { return SetData(name, &data, sizeof(float) * 3); }
+	bool SetFloat4(SimpleShaderName name, const DirectX::XMFLOAT4& data) { return SetData(name, &data, sizeof(float) * 4); }
+	bool SetMatrix4x4(SimpleShaderName name, const DirectX::XMFLOAT4X4& data) { return SetData(name, &data, sizeof(float) * 16); }
+
+	// Same again, but with a handle from GetVariableHandle() - the
+	// fastest way to set anything that's set every frame
+	SimpleShaderHandle GetVariableHandle(std::string name);
+	bool SetData(const SimpleShaderHandle& handle, const void* data, unsigned int size);
+
+	bool SetInt(const SimpleShaderHandle& handle, int data) { return SetData(handle, &data, sizeof(int)); }
+	bool SetFloat(const SimpleShaderHandle& handle, float data) { return SetData(handle, &data, sizeof(float)); }
+	bool SetFloat2(const SimpleShaderHandle& handle, const DirectX::XMFLOAT2& data) { return SetData(handle, &data, sizeof(float) * 2); }
+	bool SetFloat3(const SimpleShaderHandle& handle, const DirectX::XMFLOAT3& data) { return SetData(handle, &data, sizeof(float) * 3); }
+	bool SetFloat4(const SimpleShaderHandle& handle, const DirectX::XMFLOAT4& data) { return SetData(handle, &data, sizeof(float) * 4); }
+	bool SetMatrix4x4(const SimpleShaderHandle& handle, const DirectX::XMFLOAT4X4& data) { return SetData(handle, &data, sizeof(float) * 16); }
+
 	// Setting shader resources
 	virtual bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv) = 0;
 	virtual bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState) = 0;
 
+	// Bind slots, for resolving names ahead of time - returns -1
+	// if the shader has no texture or sampler by that name
+	int GetTextureSlot(std::string name) { return (int)FindTextureBindIndex(name); }
+	int GetSamplerSlot(std::string name) { return (int)FindSamplerBindIndex(name); }
+	const std::unordered_map<std::string, unsigned int>& GetSamplers() { return samplerTable; }
+
 protected:
 	
 	bool shaderValid;
@@ -83,12 +196,29 @@ protected:
 	SimpleConstantBuffer* constantBuffers; // For index-based lookup
 	std::unordered_map<std::string, SimpleConstantBuffer*> cbTable;
 	std::unordered_map<std::string, SimpleShaderVariable> varTable;
+	std::unordered_map<unsigned int, const std::pair<const std::string, SimpleShaderVariable>*> hashTable; // Points into varTable
 	std::unordered_map<std::string, unsigned int> textureTable;
 	std::unordered_map<std::string, unsigned int> samplerTable;
 
+	// Shared by all shaders - may be null
+	static StateCache* stateCache;
+
+	// Upload statistics, shared by all shaders
+	static unsigned int uploadedBytes;
+	static unsigned int uploadCount;
+	static unsigned int skippedCount;
+
+	// Copies variable data into a local buffer, marking the bytes
+	// dirty only if they actually change
+	void WriteVariable(unsigned int bufferIndex, unsigned int byteOffset, const void* data, unsigned int size);
+
+	// Sends a buffer to the GPU if it's dirty
+	void UploadBuffer(SimpleConstantBuffer& cb);
+
 	// Pure virtual functions for dealing with shader types
-	virtual bool CreateShader(ID3DBlob* shaderBlob) = 0;
-	virtual void SetShaderAndCB() = 0;
+	virtual bool CreateShader(ID3DBlob* shaderBlob, const DxbcReflection& reflection) = 0;
+	virtual void SetShaderAndCB(StateCache* cache) = 0;	// Null binds straight to deviceContext
+	virtual StateCache::Stage GetStage() = 0;
 
 	virtual void CleanUp();
 
@@ -116,8 +246,9 @@ public:
 protected:
 	ID3D11InputLayout* inputLayout;
 	ID3D11VertexShader* shader;
-	bool CreateShader(ID3DBlob* shaderBlob);
-	void SetShaderAndCB();
+	bool CreateShader(ID3DBlob* shaderBlob, const DxbcReflection& reflection);
+	void SetShaderAndCB(StateCache* cache);
+	StateCache::Stage GetStage() { return StateCache::StageVertex; }
 	void CleanUp();
 };
 
@@ -137,8 +268,9 @@ public:
 
 protected:
 	ID3D11PixelShader* shader;
-	bool CreateShader(ID3DBlob* shaderBlob);
-	void SetShaderAndCB();
+	bool CreateShader(ID3DBlob* shaderBlob, const DxbcReflection& reflection);
+	void SetShaderAndCB(StateCache* cache);
+	StateCache::Stage GetStage() { return StateCache::StagePixel; }
 	void CleanUp();
 };
 
@@ -168,9 +300,10 @@ protected:
 	bool allowStreamOutRasterization;
 	unsigned int streamOutVertexSize;
 
-	bool CreateShader(ID3DBlob* shaderBlob);
-	bool CreateShaderWithStreamOut(ID3DBlob* shaderBlob);
-	void SetShaderAndCB();
+	bool CreateShader(ID3DBlob* shaderBlob, const DxbcReflection& reflection);
+	bool CreateShaderWithStreamOut(ID3DBlob* shaderBlob, const DxbcReflection& reflection);
+	void SetShaderAndCB(StateCache* cache);
+	StateCache::Stage GetStage() { return StateCache::StageGeometry; }
 	void CleanUp();
 
 	// Helpers
@@ -0,0 +1,730 @@
+#include "SoftwareRasterizer.h"
+#include "JobSystem.h"
+#include <chrono>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#else
+#include <xmmintrin.h>
+#endif
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Eight pixels across - one AVX register, or two SSE ones
+// --------------------------------------------------------
+#if defined(__AVX__)
+typedef __m256 Lanes;
+static inline Lanes Splat(float f) { return _mm256_set1_ps(f); }
+static inline Lanes Ramp() { return _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7); }
+static inline Lanes Load(const float* p) { return _mm256_loadu_ps(p); }
+static inline void Store(float* p, Lanes a) { _mm256_storeu_ps(p, a); }
+static inline Lanes Add(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+static inline Lanes Mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+static inline Lanes Min(Lanes a, Lanes b) { return _mm256_min_ps(a, b); }
+static inline Lanes Max(Lanes a, Lanes b) { return _mm256_max_ps(a, b); }
+static inline Lanes And(Lanes a, Lanes b) { return _mm256_and_ps(a, b); }
+static inline Lanes GreaterEqual(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+static inline Lanes Greater(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+static inline Lanes LessEqual(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+static inline Lanes Less(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline Lanes Select(Lanes a, Lanes b, Lanes mask) { return _mm256_blendv_ps(a, b, mask); }
+static inline int Bits(Lanes mask) { return _mm256_movemask_ps(mask); }
+#else
+struct Lanes { __m128 Low, High; };
+static inline Lanes Make(__m128 low, __m128 high) { Lanes r = { low, high }; return r; }
+static inline Lanes Splat(float f) { return Make(_mm_set1_ps(f), _mm_set1_ps(f)); }
+static inline Lanes Ramp() { return Make(_mm_setr_ps(0, 1, 2, 3), _mm_setr_ps(4, 5, 6, 7)); }
+static inline Lanes Load(const float* p) { return Make(_mm_loadu_ps(p), _mm_loadu_ps(p + 4)); }
+static inline void Store(float* p, Lanes a) { _mm_storeu_ps(p, a.Low); _mm_storeu_ps(p + 4, a.High); }
+static inline Lanes Add(Lanes a, Lanes b) { return Make(_mm_add_ps(a.Low, b.Low), _mm_add_ps(a.High, b.High)); }
+static inline Lanes Mul(Lanes a, Lanes b) { return Make(_mm_mul_ps(a.Low, b.Low), _mm_mul_ps(a.High, b.High)); }
+static inline Lanes Min(Lanes a, Lanes b) { return Make(_mm_min_ps(a.Low, b.Low), _mm_min_ps(a.High, b.High)); }
+static inline Lanes Max(Lanes a, Lanes b) { return Make(_mm_max_ps(a.Low, b.Low), _mm_max_ps(a.High, b.High)); }
+static inline Lanes And(Lanes a, Lanes b) { return Make(_mm_and_ps(a.Low, b.Low), _mm_and_ps(a.High, b.High)); }
+static inline Lanes GreaterEqual(Lanes a, Lanes b) { return Make(_mm_cmpge_ps(a.Low, b.Low), _mm_cmpge_ps(a.High, b.High)); }
+static inline Lanes Greater(Lanes a, Lanes b) { return Make(_mm_cmpgt_ps(a.Low, b.Low), _mm_cmpgt_ps(a.High, b.High)); }
+static inline Lanes LessEqual(Lanes a, Lanes b) { return Make(_mm_cmple_ps(a.Low, b.Low), _mm_cmple_ps(a.High, b.High)); }
+static inline Lanes Less(Lanes a, Lanes b) { return Make(_mm_cmplt_ps(a.Low, b.Low), _mm_cmplt_ps(a.High, b.High)); }
+static inline Lanes Select(Lanes a, Lanes b, Lanes mask)
+{
+	return Make(
+		_mm_or_ps(_mm_and_ps(mask.Low, b.Low), _mm_andnot_ps(mask.Low, a.Low)),
+		_mm_or_ps(_mm_and_ps(mask.High, b.High), _mm_andnot_ps(mask.High, a.High)));
+}
+static inline int Bits(Lanes mask) { return _mm_movemask_ps(mask.Low) | (_mm_movemask_ps(mask.High) << 4); }
+#endif
+
+static inline int CountBits(int bits)
+{
+	int count = 0;
+	for (; bits; bits &= bits - 1)
+		count++;
+	return count;
+}
+
+typedef std::chrono::high_resolution_clock RasterClock;
+static double MillisecondsSince(RasterClock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(RasterClock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// Small vector helpers for the pixel shader
+// --------------------------------------------------------
+static inline float Dot3(const float a[3], const float b[3])
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static inline void Normalize3(float v[3])
+{
+	float length = sqrtf(Dot3(v, v));
+	float scale = length > 0.0f ? 1.0f / length : 0.0f;
+	v[0] *= scale;
+	v[1] *= scale;
+	v[2] *= scale;
+}
+
+static inline float Saturate(float f)
+{
+	return f < 0.0f ? 0.0f : (f > 1.0f ? 1.0f : f);
+}
+
+// Row j of a matrix transposed for HLSL is column j of the
+// original, so mul(float4(p, 1), M) in HLSL is dot(row j, p)
+static inline void TransformPoint(const XMFLOAT4X4& m, const XMFLOAT3& p, float* out, int count)
+{
+	for (int j = 0; j < count; j++)
+		out[j] = m.m[j][0] * p.x + m.m[j][1] * p.y + m.m[j][2] * p.z + m.m[j][3];
+}
+
+static inline void TransformVector(const XMFLOAT4X4& m, const XMFLOAT3& v, float* out)
+{
+	for (int j = 0; j < 3; j++)
+		out[j] = m.m[j][0] * v.x + m.m[j][1] * v.y + m.m[j][2] * v.z;
+}
+
+SoftwareRasterizer::SoftwareRasterizer(JobSystem* jobSystem, int width, int height)
+	: jobSystem(jobSystem), width(0), height(0)
+{
+	SoftwareLights noLights = {};
+	lights = noLights;
+	SoftwareStats noStats = {};
+	stats = noStats;
+	Resize(width, height);
+}
+
+SoftwareRasterizer::~SoftwareRasterizer()
+{ }
+
+void SoftwareRasterizer::Resize(int width, int height)
+{
+	this->width = width > 0 ? width : 1;
+	this->height = height > 0 ? height : 1;
+	tilesX = (this->width + TileSize - 1) / TileSize;
+	tilesY = (this->height + TileSize - 1) / TileSize;
+	depthStride = tilesX * TileSize;
+
+	color.assign(this->width * this->height * 4, 0.0f);
+	depth.assign(depthStride * this->height, 1.0f);
+	bins.resize(tilesX * tilesY);
+	tileCounters.resize(tilesX * tilesY);
+}
+
+XMFLOAT4X4 SoftwareRasterizer::SkyViewProjection(const XMFLOAT4X4& view, const XMFLOAT4X4& projection)
+{
+	// Transposed, the view's translation is the last column
+	XMFLOAT4X4 noMovement = view;
+	noMovement.m[0][3] = 0;
+	noMovement.m[1][3] = 0;
+	noMovement.m[2][3] = 0;
+
+	// (view * projection) transposed is projection' * view'
+	XMFLOAT4X4 result;
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			result.m[i][j] = 0;
+			for (int k = 0; k < 4; k++)
+				result.m[i][j] += projection.m[i][k] * noMovement.m[k][j];
+		}
+	}
+	return result;
+}
+
+// --------------------------------------------------------
+// Drawing
+// --------------------------------------------------------
+void SoftwareRasterizer::BeginFrame(const float clearColor[4], const SoftwareLights& lights)
+{
+	this->lights = lights;
+	draws.clear();
+
+	for (unsigned int i = 0; i < color.size(); i += 4)
+	{
+		color[i + 0] = clearColor[0];
+		color[i + 1] = clearColor[1];
+		color[i + 2] = clearColor[2];
+		color[i + 3] = clearColor[3];
+	}
+	depth.assign(depth.size(), 1.0f);
+}
+
+void SoftwareRasterizer::Submit(const SoftwareDraw& draw)
+{
+	if (draw.Vertices != 0 && draw.Indices != 0 && draw.IndexCount >= 3)
+		draws.push_back(draw);
+}
+
+void SoftwareRasterizer::Render()
+{
+	SoftwareStats frameStats = {};
+	frameStats.Draws = (int)draws.size();
+	for (unsigned int i = 0; i < draws.size(); i++)
+		frameStats.Triangles += draws[i].IndexCount / 3;
+
+	// Vertices and triangle set up, a draw per job
+	RasterClock::time_point start = RasterClock::now();
+	if (work.size() < draws.size())
+		work.resize(draws.size());
+	if (jobSystem)
+		jobSystem->ParallelFor((int)draws.size(), 1, SetUpDraws, this);
+	else
+		SetUpDraws(0, (int)draws.size(), this);
+	frameStats.VertexMs = MillisecondsSince(start);
+
+	// Binning stays on one thread, so each tile sees its
+	// triangles in submit order
+	start = RasterClock::now();
+	for (unsigned int t = 0; t < bins.size(); t++)
+		bins[t].clear();
+	for (unsigned int d = 0; d < draws.size(); d++)
+	{
+		frameStats.Culled += work[d].Culled;
+		frameStats.Clipped += work[d].Clipped;
+		const std::vector<Triangle>& triangles = work[d].Triangles;
+		for (unsigned int i = 0; i < triangles.size(); i++)
+		{
+			const Triangle& triangle = triangles[i];
+			for (int ty = triangle.MinY / TileSize; ty <= triangle.MaxY / TileSize; ty++)
+			{
+				for (int tx = triangle.MinX / TileSize; tx <= triangle.MaxX / TileSize; tx++)
+				{
+					bins[ty * tilesX + tx].push_back(&triangle);
+					frameStats.TileTriangles++;
+				}
+			}
+		}
+	}
+	frameStats.BinMs = MillisecondsSince(start);
+
+	// Tiles never share pixels, so they need no locking
+	start = RasterClock::now();
+	int tileCount = tilesX * tilesY;
+	if (jobSystem)
+		jobSystem->ParallelFor(tileCount, 1, RasterizeTiles, this);
+	else
+		RasterizeTiles(0, tileCount, this);
+	frameStats.RasterMs = MillisecondsSince(start);
+
+	for (int t = 0; t < tileCount; t++)
+	{
+		frameStats.PixelsCovered += tileCounters[t].Covered;
+		frameStats.PixelsShaded += tileCounters[t].Shaded;
+	}
+	stats = frameStats;
+}
+
+void SoftwareRasterizer::SetUpDraws(int start, int end, void* userData)
+{
+	SoftwareRasterizer* rasterizer = (SoftwareRasterizer*)userData;
+	for (int i = start; i < end; i++)
+		rasterizer->SetUpDraw(i);
+}
+
+void SoftwareRasterizer::RasterizeTiles(int start, int end, void* userData)
+{
+	SoftwareRasterizer* rasterizer = (SoftwareRasterizer*)userData;
+	for (int i = start; i < end; i++)
+		rasterizer->RasterizeTile(i);
+}
+
+// --------------------------------------------------------
+// VertexShader (or SkyVS) for every vertex, then each
+// triangle is rejected, clipped or passed on whole
+// --------------------------------------------------------
+void SoftwareRasterizer::SetUpDraw(int index)
+{
+	const SoftwareDraw& draw = draws[index];
+	DrawWork& target = work[index];
+	target.Triangles.clear();
+	target.Culled = 0;
+	target.Clipped = 0;
+
+	target.Vertices.resize(draw.VertexCount);
+	for (int i = 0; i < draw.VertexCount; i++)
+	{
+		const Vertex& in = draw.Vertices[i];
+		ClipVertex& out = target.Vertices[i];
+		TransformPoint(draw.WorldViewProj, in.Position, out.Position, 4);
+
+		if (draw.Sky)
+		{
+			// At the far plane, sampled in the vertex's direction
+			out.Position[2] = out.Position[3];
+			out.Attributes[0] = in.Position.x;
+			out.Attributes[1] = in.Position.y;
+			out.Attributes[2] = in.Position.z;
+			for (int a = 3; a < AttributeCount; a++)
+				out.Attributes[a] = 0;
+		}
+		else
+		{
+			TransformPoint(draw.World, in.Position, &out.Attributes[0], 3);
+			TransformVector(draw.World, in.Normal, &out.Attributes[3]);
+			TransformVector(draw.World, in.Tangent, &out.Attributes[6]);
+			out.Attributes[9] = in.UV.x;
+			out.Attributes[10] = in.UV.y;
+		}
+	}
+
+	for (int i = 0; i + 2 < draw.IndexCount; i += 3)
+	{
+		const ClipVertex* v[3];
+		bool valid = true;
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int vertex = draw.Indices[i + k];
+			valid = valid && vertex < (unsigned int)draw.VertexCount;
+			v[k] = valid ? &target.Vertices[vertex] : 0;
+		}
+		if (!valid)
+		{
+			target.Culled++;
+			continue;
+		}
+
+		// Entirely outside one side of the view volume
+		int outside = 0x3f;
+		int crossing = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			const float* p = v[k]->Position;
+			int code = 0;
+			if (p[0] < -p[3]) code |= 1;
+			if (p[0] > p[3]) code |= 2;
+			if (p[1] < -p[3]) code |= 4;
+			if (p[1] > p[3]) code |= 8;
+			if (p[2] < 0) code |= 16;
+			if (p[2] > p[3]) code |= 32;
+			outside &= code;
+			crossing |= code & (16 | 32);
+		}
+		if (outside)
+		{
+			target.Culled++;
+			continue;
+		}
+
+		if (crossing == 0)
+		{
+			AddTriangle(target, draw, v[0], v[1], v[2]);
+			continue;
+		}
+
+		// Clip against the near (z = 0) and far (z = w) planes, as
+		// D3D does with depth clipping on (the default), leaving
+		// up to five corners to fan into triangles
+		target.Clipped++;
+		ClipVertex corners[3], nearClipped[4], clipped[5];
+		for (int k = 0; k < 3; k++)
+			corners[k] = *v[k];
+		int count = ClipPolygon(corners, 3, false, nearClipped);
+		count = ClipPolygon(nearClipped, count, true, clipped);
+		for (int k = 1; k + 1 < count; k++)
+			AddTriangle(target, draw, &clipped[0], &clipped[k], &clipped[k + 1]);
+	}
+}
+
+// --------------------------------------------------------
+// Cuts a convex polygon down to the inside of the near plane
+// (z >= 0) or the far plane (z <= w), returning how many
+// corners are left - at most one more than it had
+// --------------------------------------------------------
+int SoftwareRasterizer::ClipPolygon(const ClipVertex* in, int count, bool farPlane, ClipVertex* out)
+{
+	int outCount = 0;
+	for (int k = 0; k < count; k++)
+	{
+		const ClipVertex& a = in[k];
+		const ClipVertex& b = in[(k + 1) % count];
+		float da = farPlane ? a.Position[3] - a.Position[2] : a.Position[2];
+		float db = farPlane ? b.Position[3] - b.Position[2] : b.Position[2];
+		if (da >= 0)
+			out[outCount++] = a;
+		if ((da >= 0) != (db >= 0))
+		{
+			float t = da / (da - db);
+			ClipVertex& corner = out[outCount++];
+			for (int c = 0; c < 4; c++)
+				corner.Position[c] = a.Position[c] + (b.Position[c] - a.Position[c]) * t;
+			for (int c = 0; c < AttributeCount; c++)
+				corner.Attributes[c] = a.Attributes[c] + (b.Attributes[c] - a.Attributes[c]) * t;
+		}
+	}
+	return outCount;
+}
+
+// --------------------------------------------------------
+// Projects a triangle to the screen, culls it the way the
+// draw's rasterizer state would, and works out its edges
+// --------------------------------------------------------
+void SoftwareRasterizer::AddTriangle(DrawWork& target, const SoftwareDraw& draw, const ClipVertex* v0, const ClipVertex* v1, const ClipVertex* v2)
+{
+	const ClipVertex* v[3] = { v0, v1, v2 };
+	float sx[3], sy[3], sz[3], invW[3];
+	for (int k = 0; k < 3; k++)
+	{
+		float w = v[k]->Position[3];
+		if (w <= 0.000001f)
+		{
+			target.Culled++;
+			return;
+		}
+		invW[k] = 1.0f / w;
+		sx[k] = (v[k]->Position[0] * invW[k] * 0.5f + 0.5f) * width;
+		sy[k] = (0.5f - v[k]->Position[1] * invW[k] * 0.5f) * height;
+		sz[k] = v[k]->Position[2] * invW[k];
+	}
+
+	// Clockwise on screen (y down) is front facing, and comes out
+	// positive.  The sky culls its front faces instead.
+	float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sy[1] - sy[0]) * (sx[2] - sx[0]);
+	if (draw.Sky ? area >= 0 : area <= 0)
+	{
+		target.Culled++;
+		return;
+	}
+
+	// Keep the area positive, so inside is where every edge is
+	int order[3] = { 0, 1, 2 };
+	if (area < 0)
+	{
+		order[1] = 2;
+		order[2] = 1;
+		area = -area;
+	}
+
+	Triangle triangle;
+	triangle.Draw = &draw;
+	triangle.InvArea = 1.0f / area;
+
+	float minX = sx[0], maxX = sx[0], minY = sy[0], maxY = sy[0];
+	for (int k = 0; k < 3; k++)
+	{
+		int vertex = order[k];
+		int a = order[(k + 1) % 3];
+		int b = order[(k + 2) % 3];
+
+		// Edge from a to b, opposite this vertex.  C comes from the
+		// same end whichever way round the edge is, so neighbours
+		// sharing it get exactly opposite edge functions.
+		int anchor = (sy[a] < sy[b] || (sy[a] == sy[b] && sx[a] < sx[b])) ? a : b;
+		triangle.EdgeA[k] = sy[a] - sy[b];
+		triangle.EdgeB[k] = sx[b] - sx[a];
+		triangle.EdgeC[k] = -(triangle.EdgeA[k] * sx[anchor] + triangle.EdgeB[k] * sy[anchor]);
+		triangle.TopLeft[k] = triangle.EdgeA[k] > 0 || (triangle.EdgeA[k] == 0 && triangle.EdgeB[k] > 0);
+
+		triangle.InvW[k] = invW[vertex];
+		for (int c = 0; c < AttributeCount; c++)
+			triangle.Attributes[k][c] = v[vertex]->Attributes[c] * invW[vertex];
+
+		minX = fminf(minX, sx[vertex]);
+		maxX = fmaxf(maxX, sx[vertex]);
+		minY = fminf(minY, sy[vertex]);
+		maxY = fmaxf(maxY, sy[vertex]);
+	}
+
+	// Depth is linear on screen, so it's a plane
+	for (int c = 0; c < 3; c++)
+		triangle.DepthPlane[c] = 0;
+	for (int k = 0; k < 3; k++)
+	{
+		float z = sz[order[k]] * triangle.InvArea;
+		triangle.DepthPlane[0] += triangle.EdgeA[k] * z;
+		triangle.DepthPlane[1] += triangle.EdgeB[k] * z;
+		triangle.DepthPlane[2] += triangle.EdgeC[k] * z;
+	}
+
+	triangle.MinX = minX > 0 ? (int)minX : 0;
+	triangle.MinY = minY > 0 ? (int)minY : 0;
+	triangle.MaxX = maxX < width - 1 ? (int)ceilf(maxX) : width - 1;
+	triangle.MaxY = maxY < height - 1 ? (int)ceilf(maxY) : height - 1;
+	if (triangle.MinX > triangle.MaxX || triangle.MinY > triangle.MaxY)
+	{
+		target.Culled++;
+		return;
+	}
+
+	target.Triangles.push_back(triangle);
+}
+
+// --------------------------------------------------------
+// Every triangle binned to a tile, in order, eight pixels of
+// a row at a time
+// --------------------------------------------------------
+void SoftwareRasterizer::RasterizeTile(int tile)
+{
+	int tileX = (tile % tilesX) * TileSize;
+	int tileY = (tile / tilesX) * TileSize;
+	int tileEndX = tileX + TileSize < width ? tileX + TileSize : width;
+	int tileEndY = tileY + TileSize < height ? tileY + TileSize : height;
+
+	long long covered = 0;
+	long long shaded = 0;
+	const Lanes zero = Splat(0.0f);
+	const Lanes one = Splat(1.0f);
+	const Lanes centers = Add(Ramp(), Splat(0.5f));
+	const Lanes screenEnd = Splat((float)tileEndX);
+
+	const std::vector<const Triangle*>& bin = bins[tile];
+	for (unsigned int i = 0; i < bin.size(); i++)
+	{
+		const Triangle& triangle = *bin[i];
+		int minX = triangle.MinX > tileX ? triangle.MinX : tileX;
+		int minY = triangle.MinY > tileY ? triangle.MinY : tileY;
+		int maxX = triangle.MaxX < tileEndX - 1 ? triangle.MaxX : tileEndX - 1;
+		int maxY = triangle.MaxY < tileEndY - 1 ? triangle.MaxY : tileEndY - 1;
+
+		// Tiles start on a multiple of 8, so this stays inside
+		minX &= ~7;
+
+		Lanes edgeA[3], edgeB[3], edgeC[3];
+		for (int k = 0; k < 3; k++)
+		{
+			edgeA[k] = Splat(triangle.EdgeA[k]);
+			edgeB[k] = Splat(triangle.EdgeB[k]);
+			edgeC[k] = Splat(triangle.EdgeC[k]);
+		}
+		Lanes depthA = Splat(triangle.DepthPlane[0]);
+		Lanes depthB = Splat(triangle.DepthPlane[1]);
+		Lanes depthC = Splat(triangle.DepthPlane[2]);
+		bool sky = triangle.Draw->Sky;
+
+		for (int y = minY; y <= maxY; y++)
+		{
+			Lanes py = Splat(y + 0.5f);
+			float* depthRow = &depth[y * depthStride];
+			float* colorRow = &color[y * width * 4];
+
+			for (int x = minX; x <= maxX; x += 8)
+			{
+				Lanes px = Add(Splat((float)x), centers);
+
+				// Inside every edge - on an edge counts only for top
+				// and left edges, so shared edges are drawn once
+				Lanes edges[3];
+				Lanes inside = Less(px, screenEnd);
+				for (int k = 0; k < 3; k++)
+				{
+					edges[k] = Add(Add(Mul(edgeA[k], px), Mul(edgeB[k], py)), edgeC[k]);
+					inside = And(inside, triangle.TopLeft[k] ? GreaterEqual(edges[k], zero) : Greater(edges[k], zero));
+				}
+				int insideBits = Bits(inside);
+				if (insideBits == 0)
+					continue;
+				covered += CountBits(insideBits);
+
+				// Triangles are already clipped to the depth range, so
+				// the clamp only catches rounding (D3D clamps after
+				// clipping too), and the sky passes at the far plane
+				// (lessEqual)
+				Lanes z = Min(Max(Add(Add(Mul(depthA, px), Mul(depthB, py)), depthC), zero), one);
+				Lanes stored = Load(depthRow + x);
+				Lanes pass = And(inside, sky ? LessEqual(z, stored) : Less(z, stored));
+				int passBits = Bits(pass);
+				if (passBits == 0)
+					continue;
+				Store(depthRow + x, Select(stored, z, pass));
+				shaded += CountBits(passBits);
+
+				float weights[3][8];
+				for (int k = 0; k < 3; k++)
+					Store(weights[k], edges[k]);
+				for (int lane = 0; lane < 8; lane++)
+				{
+					if (passBits & (1 << lane))
+					{
+						ShadePixel(triangle, x + lane + 0.5f, y + 0.5f,
+							weights[0][lane] * triangle.InvArea,
+							weights[1][lane] * triangle.InvArea,
+							weights[2][lane] * triangle.InvArea,
+							&colorRow[(x + lane) * 4]);
+					}
+				}
+			}
+		}
+	}
+
+	tileCounters[tile].Covered = covered;
+	tileCounters[tile].Shaded = shaded;
+}
+
+// --------------------------------------------------------
+// PixelShader.hlsl (or SkyPS.hlsl) for one pixel.  x and y are
+// its center, and w0-w2 are screen space weights, corrected for
+// perspective here.
+// --------------------------------------------------------
+void SoftwareRasterizer::ShadePixel(const Triangle& triangle, float x, float y, float w0, float w1, float w2, float* out)
+{
+	const SoftwareDraw& draw = *triangle.Draw;
+	float w = 1.0f / (w0 * triangle.InvW[0] + w1 * triangle.InvW[1] + w2 * triangle.InvW[2]);
+
+	float a[AttributeCount];
+	for (int c = 0; c < AttributeCount; c++)
+		a[c] = (w0 * triangle.Attributes[0][c] + w1 * triangle.Attributes[1][c] + w2 * triangle.Attributes[2][c]) * w;
+
+	const SoftwareTexture* diffuseTexture = draw.Material ? draw.Material->Diffuse : 0;
+	const SoftwareTexture* normalTexture = draw.Material ? draw.Material->NormalMap : 0;
+
+	if (draw.Sky)
+	{
+		if (diffuseTexture)
+			diffuseTexture->SampleDirection(a, out);
+		else
+			out[0] = out[1] = out[2] = out[3] = 0.0f;
+		return;
+	}
+
+	float* worldPos = &a[0];
+	float* normal = &a[3];
+	float* tangent = &a[6];
+	Normalize3(normal);
+	Normalize3(tangent);
+
+	// Normal mapping - a missing map is flat
+	float normalFromMap[4] = { 0.5f, 0.5f, 1.0f, 1.0f };
+	if (normalTexture)
+		normalTexture->Sample(a[9], a[10], normalFromMap);
+	for (int c = 0; c < 3; c++)
+		normalFromMap[c] = normalFromMap[c] * 2 - 1;
+
+	float dotTN = Dot3(tangent, normal);
+	float T[3] = { tangent[0] - normal[0] * dotTN, tangent[1] - normal[1] * dotTN, tangent[2] - normal[2] * dotTN };
+	Normalize3(T);
+	float B[3] = {
+		T[1] * normal[2] - T[2] * normal[1],
+		T[2] * normal[0] - T[0] * normal[2],
+		T[0] * normal[1] - T[1] * normal[0] };
+
+	float N[3];
+	for (int c = 0; c < 3; c++)
+		N[c] = normalFromMap[0] * T[c] + normalFromMap[1] * B[c] + normalFromMap[2] * normal[c];
+	Normalize3(N);
+
+	// Directional light
+	float lightDir[3] = { lights.DirLightDirection.x, lights.DirLightDirection.y, lights.DirLightDirection.z };
+	Normalize3(lightDir);
+	float toLight[3] = { -lightDir[0], -lightDir[1], -lightDir[2] };
+	float dirNdotL = Saturate(Dot3(N, toLight));
+
+	// Point light
+	float toPoint[3] = {
+		lights.PointLightPosition.x - worldPos[0],
+		lights.PointLightPosition.y - worldPos[1],
+		lights.PointLightPosition.z - worldPos[2] };
+	Normalize3(toPoint);
+	float pointNdotL = Saturate(Dot3(N, toPoint));
+
+	// Point light specular
+	float toCamera[3] = {
+		lights.CameraPosition.x - worldPos[0],
+		lights.CameraPosition.y - worldPos[1],
+		lights.CameraPosition.z - worldPos[2] };
+	Normalize3(toCamera);
+	float incoming = -Dot3(toPoint, N);
+	float reflected[3];
+	for (int c = 0; c < 3; c++)
+		reflected[c] = -toPoint[c] - 2 * incoming * N[c];
+	float spec = powf(fmaxf(Dot3(reflected, toCamera), 0.0f), 64.0f);
+
+	float diffuseColor[4] = { 1, 1, 1, 1 };
+	if (diffuseTexture)
+		diffuseTexture->Sample(a[9], a[10], diffuseColor);
+
+	// The shader lerps to this with a weight of 1, so its sky
+	// reflection never shows
+	const float* pointColor = &lights.PointLightColor.x;
+	const float* dirColor = &lights.DirLightColor.x;
+	float surface[4];
+	for (int c = 0; c < 4; c++)
+	{
+		surface[c] =
+			(pointColor[c] * pointNdotL * diffuseColor[c]) * (lights.PointLightColor.w * 10.0f) +
+			(dirColor[c] * dirNdotL * diffuseColor[c]) * (lights.DirLightColor.w * 10.0f) +
+			(c < 3 ? spec : 1.0f);
+	}
+
+	// Neon point lights - only the ones that reach this pixel's cluster
+	if (lights.Clusters)
+	{
+		float viewDepth =
+			(worldPos[0] - lights.CameraPosition.x) * lights.CameraForward.x +
+			(worldPos[1] - lights.CameraPosition.y) * lights.CameraForward.y +
+			(worldPos[2] - lights.CameraPosition.z) * lights.CameraForward.z;
+		int cluster = lights.Clusters->GetCluster(x, y, viewDepth, (float)width, (float)height);
+		const ClusterRange& range = lights.Clusters->GetRanges()[cluster];
+		const std::vector<unsigned int>& indices = lights.Clusters->GetIndices();
+		for (unsigned int i = 0; i < range.Count; i++)
+		{
+			const ClusterLight& light = lights.PointLights[indices[range.Offset + i]];
+			float toNeon[3] = {
+				light.Position.x - worldPos[0],
+				light.Position.y - worldPos[1],
+				light.Position.z - worldPos[2] };
+			float distance = sqrtf(Dot3(toNeon, toNeon));
+			float falloff = Saturate(1 - distance / light.Radius);
+			float invDistance = 1.0f / fmaxf(distance, 0.0001f);
+			float NdotL = Saturate(Dot3(N, toNeon) * invDistance);
+			float amount = light.Intensity * falloff * falloff * NdotL;
+			surface[0] += light.Color.x * amount * diffuseColor[0];
+			surface[1] += light.Color.y * amount * diffuseColor[1];
+			surface[2] += light.Color.z * amount * diffuseColor[2];
+		}
+	}
+
+	if (surface[0] + surface[1] + surface[2] > 1.5f)
+	{
+		surface[0] += draw.Bloom.x;
+		surface[1] += draw.Bloom.y;
+		surface[2] += draw.Bloom.z;
+		surface[3] = 0;
+	}
+
+	for (int c = 0; c < 4; c++)
+		out[c] = surface[c];
+}
+
+// --------------------------------------------------------
+// Results
+// --------------------------------------------------------
+void SoftwareRasterizer::GetPixels(std::vector<unsigned char>& rgba)
+{
+	rgba.resize(color.size());
+	for (unsigned int i = 0; i < color.size(); i++)
+		rgba[i] = (unsigned char)(Saturate(color[i]) * 255.0f + 0.5f);
+}
+
+bool SoftwareRasterizer::SaveTGA(const std::string& path)
+{
+	std::vector<unsigned char> rgba;
+	GetPixels(rgba);
+
+	// The swap chain ignores alpha, so screenshots should too
+	for (unsigned int i = 3; i < rgba.size(); i += 4)
+		rgba[i] = 255;
+	return SoftwareTexture::SaveTGA(path, width, height, &rgba[0]);
+}
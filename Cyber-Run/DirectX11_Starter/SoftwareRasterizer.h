@@ -0,0 +1,190 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+#include "SoftwareTexture.h"
+#include "LightClusters.h"
+#include "Vertex.h"
+
+class JobSystem;
+
+// --------------------------------------------------------
+// PixelShader's per-frame lighting.  The game fills one of
+// these for its perFrame buffer too, so both paths light the
+// scene the same.
+// --------------------------------------------------------
+struct SoftwareLights
+{
+	DirectX::XMFLOAT3 DirLightDirection;
+	DirectX::XMFLOAT4 DirLightColor;
+	DirectX::XMFLOAT3 PointLightPosition;
+	DirectX::XMFLOAT4 PointLightColor;
+	DirectX::XMFLOAT3 CameraPosition;
+
+	// Clustered point lights, already binned for this frame, or
+	// none when Clusters is null
+	const ClusterLight* PointLights;
+	const LightClusters* Clusters;
+	DirectX::XMFLOAT3 CameraForward;
+};
+
+// --------------------------------------------------------
+// The textures a draw reads.  Sky draws read Diffuse as the
+// sky, in any direction (see SoftwareTexture::SampleDirection).
+// --------------------------------------------------------
+struct SoftwareMaterial
+{
+	const SoftwareTexture* Diffuse;
+	const SoftwareTexture* NormalMap;
+};
+
+// --------------------------------------------------------
+// One mesh to draw.  Matrices are transposed for HLSL, like
+// RenderItem's, so the same ones work here.  Sky draws use
+// SkyViewProjection() instead of a world-view-projection.
+// --------------------------------------------------------
+struct SoftwareDraw
+{
+	const Vertex* Vertices;
+	int VertexCount;
+	const unsigned int* Indices;
+	int IndexCount;
+	DirectX::XMFLOAT4X4 World;
+	DirectX::XMFLOAT4X4 WorldViewProj;
+	const SoftwareMaterial* Material;
+	DirectX::XMFLOAT3 Bloom;
+	bool Sky;
+};
+
+// --------------------------------------------------------
+// What the last frame cost
+// --------------------------------------------------------
+struct SoftwareStats
+{
+	int Draws;
+	int Triangles;			// Submitted
+	int Culled;				// Back facing, off screen or behind the camera
+	int Clipped;			// Crossed the near or far plane
+	int TileTriangles;		// Triangles summed over every tile they touch
+	long long PixelsCovered;
+	long long PixelsShaded;	// Passed the depth test
+	double VertexMs;		// Transform, clip and set up
+	double BinMs;
+	double RasterMs;
+};
+
+// --------------------------------------------------------
+// Draws meshes on the CPU, the way the game's shaders do,
+// for machines without a GPU.
+//
+//   rasterizer->BeginFrame(clearColor, lights);
+//   rasterizer->Submit(draw);	// for each mesh
+//   rasterizer->Render();
+//   rasterizer->SaveTGA("frame.tga");
+//
+// Render() transforms and sets up each draw's triangles on
+// the job workers, sorts them into TileSize square tiles, then
+// rasterizes the tiles on the job workers.  Edge functions and
+// the depth test run 8 pixels at a time (AVX, or two SSE
+// halves); the pixels that pass are shaded one at a time with
+// PixelShader.hlsl's lighting.  Triangles keep their submit
+// order within each tile, so the result doesn't depend on how
+// the jobs were scheduled.
+// --------------------------------------------------------
+class SoftwareRasterizer
+{
+public:
+	static const int TileSize = 64;
+
+	SoftwareRasterizer(JobSystem* jobSystem, int width, int height);
+	~SoftwareRasterizer();
+
+	void Resize(int width, int height);
+	int GetWidth() { return width; }
+	int GetHeight() { return height; }
+
+	// Drawing
+	void BeginFrame(const float clearColor[4], const SoftwareLights& lights);
+	void Submit(const SoftwareDraw& draw);
+	void Render();
+
+	// The frame as floats (RGBA), or saturated to 8 bits
+	const float* GetColor() { return &color[0]; }
+	void GetPixels(std::vector<unsigned char>& rgba);
+	bool SaveTGA(const std::string& path);
+
+	const SoftwareStats& GetStats() { return stats; }
+
+	// What SkyVS multiplies the sky's vertices by - the view
+	// without its translation, then the projection (both
+	// transposed for HLSL, and so is the result)
+	static DirectX::XMFLOAT4X4 SkyViewProjection(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection);
+
+private:
+	// World position, normal, tangent and UV - or, for the sky,
+	// the direction to sample
+	static const int AttributeCount = 11;
+
+	struct ClipVertex
+	{
+		float Position[4];
+		float Attributes[AttributeCount];
+	};
+
+	// A triangle ready to rasterize.  Edge i is opposite vertex
+	// i, so E_i / (2 * area) is vertex i's screen weight.
+	struct Triangle
+	{
+		float EdgeA[3], EdgeB[3], EdgeC[3];
+		bool TopLeft[3];
+		float InvArea;
+		float DepthPlane[3];		// Depth = [0]x + [1]y + [2]
+		float InvW[3];
+		float Attributes[3][AttributeCount];	// Divided by w
+		int MinX, MinY, MaxX, MaxY;
+		const SoftwareDraw* Draw;
+	};
+
+	// Each draw's triangles, set up by one job
+	struct DrawWork
+	{
+		std::vector<ClipVertex> Vertices;
+		std::vector<Triangle> Triangles;
+		int Culled;
+		int Clipped;
+	};
+
+	// Counters each tile job writes on its own
+	struct TileCounters
+	{
+		long long Covered;
+		long long Shaded;
+	};
+
+	JobSystem* jobSystem;
+	int width;
+	int height;
+	int depthStride;	// Rounded up to whole tiles, for 8 wide loads
+	int tilesX;
+	int tilesY;
+
+	std::vector<float> color;
+	std::vector<float> depth;
+	SoftwareLights lights;
+
+	std::vector<SoftwareDraw> draws;
+	std::vector<DrawWork> work;
+	std::vector<std::vector<const Triangle*> > bins;
+	std::vector<TileCounters> tileCounters;
+	SoftwareStats stats;
+
+	void SetUpDraw(int index);
+	static int ClipPolygon(const ClipVertex* in, int count, bool farPlane, ClipVertex* out);
+	void AddTriangle(DrawWork& target, const SoftwareDraw& draw, const ClipVertex* v0, const ClipVertex* v1, const ClipVertex* v2);
+	void RasterizeTile(int tile);
+	void ShadePixel(const Triangle& triangle, float x, float y, float w0, float w1, float w2, float* out);
+
+	static void SetUpDraws(int start, int end, void* userData);
+	static void RasterizeTiles(int start, int end, void* userData);
+};
@@ -0,0 +1,227 @@
+#include "SoftwareTexture.h"
+#include <cmath>
+#include <fstream>
+
+static const float Pi = 3.14159265f;
+
+SoftwareTexture::SoftwareTexture()
+	: width(0), height(0)
+{ }
+
+// --------------------------------------------------------
+// Types 2 (uncompressed) and 10 (RLE) true color TGAs
+// --------------------------------------------------------
+bool SoftwareTexture::LoadTGA(const std::string& path)
+{
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	unsigned char header[18];
+	if (!file.read((char*)header, sizeof(header)))
+		return false;
+
+	int type = header[2];
+	int fileWidth = header[12] | (header[13] << 8);
+	int fileHeight = header[14] | (header[15] << 8);
+	int bytesPerPixel = header[16] / 8;
+	bool topDown = (header[17] & 0x20) != 0;
+	if ((type != 2 && type != 10) || (bytesPerPixel != 3 && bytesPerPixel != 4) || fileWidth == 0 || fileHeight == 0)
+		return false;
+	file.seekg(header[0], std::ios::cur);	// Image ID
+
+	// Read everything as BGR(A), in file order
+	int pixelCount = fileWidth * fileHeight;
+	std::vector<unsigned char> raw(pixelCount * bytesPerPixel);
+	if (type == 2)
+	{
+		if (!file.read((char*)&raw[0], raw.size()))
+			return false;
+	}
+	else
+	{
+		int pixel = 0;
+		while (pixel < pixelCount)
+		{
+			unsigned char packet;
+			if (!file.read((char*)&packet, 1))
+				return false;
+
+			int run = (packet & 0x7f) + 1;
+			if (pixel + run > pixelCount)
+				return false;
+			if (packet & 0x80)
+			{
+				unsigned char value[4];
+				if (!file.read((char*)value, bytesPerPixel))
+					return false;
+				for (int i = 0; i < run; i++)
+					for (int c = 0; c < bytesPerPixel; c++)
+						raw[(pixel + i) * bytesPerPixel + c] = value[c];
+			}
+			else if (!file.read((char*)&raw[pixel * bytesPerPixel], run * bytesPerPixel))
+			{
+				return false;
+			}
+			pixel += run;
+		}
+	}
+
+	width = fileWidth;
+	height = fileHeight;
+	texels.resize(pixelCount * 4);
+	for (int y = 0; y < height; y++)
+	{
+		int fileRow = topDown ? y : height - 1 - y;
+		for (int x = 0; x < width; x++)
+		{
+			const unsigned char* in = &raw[(fileRow * width + x) * bytesPerPixel];
+			unsigned char* out = &texels[(y * width + x) * 4];
+			out[0] = in[2];
+			out[1] = in[1];
+			out[2] = in[0];
+			out[3] = bytesPerPixel == 4 ? in[3] : 255;
+		}
+	}
+	return true;
+}
+
+void SoftwareTexture::CreateSolid(unsigned char r, unsigned char g, unsigned char b, unsigned char a)
+{
+	width = 1;
+	height = 1;
+	texels.resize(4);
+	texels[0] = r;
+	texels[1] = g;
+	texels[2] = b;
+	texels[3] = a;
+}
+
+void SoftwareTexture::CreateGrid(int size, int cells)
+{
+	width = size;
+	height = size;
+	texels.resize(size * size * 4);
+
+	int cellSize = size / cells > 0 ? size / cells : 1;
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			bool line = x % cellSize < 2 || y % cellSize < 2;
+			unsigned char* out = &texels[(y * size + x) * 4];
+			out[0] = line ? 230 : 40;
+			out[1] = line ? 230 : 40;
+			out[2] = line ? 255 : 48;
+			out[3] = 255;
+		}
+	}
+}
+
+void SoftwareTexture::CreateSkyGradient(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	texels.resize(width * height * 4);
+
+	// Top row is straight up, bottom row straight down
+	for (int y = 0; y < height; y++)
+	{
+		float up = cosf(Pi * (y + 0.5f) / height);
+		float t = up > 0 ? up : 0;
+		unsigned char r = (unsigned char)(255 * (0.75f - 0.45f * t));
+		unsigned char g = (unsigned char)(255 * (0.85f - 0.35f * t));
+		unsigned char b = (unsigned char)(255 * (0.95f - 0.15f * t));
+		if (up < 0)
+		{
+			r = 60; g = 60; b = 70;
+		}
+		for (int x = 0; x < width; x++)
+		{
+			unsigned char* out = &texels[(y * width + x) * 4];
+			out[0] = r;
+			out[1] = g;
+			out[2] = b;
+			out[3] = 255;
+		}
+	}
+}
+
+void SoftwareTexture::Sample(float u, float v, float color[4]) const
+{
+	if (texels.empty())
+	{
+		color[0] = color[1] = color[2] = color[3] = 0.0f;
+		return;
+	}
+
+	float tx = u * width - 0.5f;
+	float ty = v * height - 0.5f;
+	float fx0 = floorf(tx);
+	float fy0 = floorf(ty);
+	float fx = tx - fx0;
+	float fy = ty - fy0;
+
+	// Wrap, including for negative coordinates
+	int x0 = (int)fmodf(fx0, (float)width);
+	int y0 = (int)fmodf(fy0, (float)height);
+	if (x0 < 0) x0 += width;
+	if (y0 < 0) y0 += height;
+	int x1 = x0 + 1 < width ? x0 + 1 : 0;
+	int y1 = y0 + 1 < height ? y0 + 1 : 0;
+
+	const unsigned char* t00 = &texels[(y0 * width + x0) * 4];
+	const unsigned char* t10 = &texels[(y0 * width + x1) * 4];
+	const unsigned char* t01 = &texels[(y1 * width + x0) * 4];
+	const unsigned char* t11 = &texels[(y1 * width + x1) * 4];
+	for (int c = 0; c < 4; c++)
+	{
+		float top = t00[c] + (t10[c] - t00[c]) * fx;
+		float bottom = t01[c] + (t11[c] - t01[c]) * fx;
+		color[c] = (top + (bottom - top) * fy) * (1.0f / 255.0f);
+	}
+}
+
+void SoftwareTexture::SampleDirection(const float direction[3], float color[4]) const
+{
+	float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+	if (length == 0.0f)
+		length = 1.0f;
+
+	float u = 0.5f + atan2f(direction[0], direction[2]) / (2.0f * Pi);
+	float v = acosf(fmaxf(-1.0f, fminf(1.0f, direction[1] / length))) / Pi;
+	Sample(u, v, color);
+}
+
+bool SoftwareTexture::SaveTGA(const std::string& path, int width, int height, const unsigned char* rgba)
+{
+	std::ofstream file(path.c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	// Uncompressed, 32 bit, rows from the top
+	unsigned char header[18] = {};
+	header[2] = 2;
+	header[12] = width & 0xff;
+	header[13] = (width >> 8) & 0xff;
+	header[14] = height & 0xff;
+	header[15] = (height >> 8) & 0xff;
+	header[16] = 32;
+	header[17] = 0x28;
+	file.write((const char*)header, sizeof(header));
+
+	std::vector<unsigned char> row(width * 4);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			const unsigned char* in = &rgba[(y * width + x) * 4];
+			row[x * 4 + 0] = in[2];
+			row[x * 4 + 1] = in[1];
+			row[x * 4 + 2] = in[0];
+			row[x * 4 + 3] = in[3];
+		}
+		file.write((const char*)&row[0], row.size());
+	}
+	return file.good();
+}
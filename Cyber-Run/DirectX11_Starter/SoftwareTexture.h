@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// An 8 bit RGBA texture in memory, for the SoftwareRasterizer.
+//
+// Only TGA files can be read (WIC, which loads the game's
+// JPGs and DDS files, is Windows only), so each texture has a
+// made up stand-in for when its file can't be read.  Debug has
+// grid.tga and gridNormals.tga; SunnyCubeMap.dds isn't checked
+// in at all, so the sky is always the gradient for now.
+// --------------------------------------------------------
+class SoftwareTexture
+{
+public:
+	SoftwareTexture();
+
+	// Uncompressed or RLE TGA, 24 or 32 bit
+	bool LoadTGA(const std::string& path);
+
+	// Stand-ins
+	void CreateSolid(unsigned char r, unsigned char g, unsigned char b, unsigned char a);
+	void CreateGrid(int size, int cells);		// Bright lines on dark squares
+	void CreateSkyGradient(int width, int height);	// Latitude-longitude, like Sample(Direction)
+
+	bool IsEmpty() const { return texels.empty(); }
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+
+	// Bilinear, wrapping - like the game's trilinear sampler
+	// without the mip maps.  Writes RGBA in [0, 1].
+	void Sample(float u, float v, float color[4]) const;
+
+	// Treats the texture as a latitude-longitude panorama and
+	// samples it in a direction, standing in for a cube map
+	void SampleDirection(const float direction[3], float color[4]) const;
+
+	// Writes 8 bit RGBA pixels as a 32 bit TGA
+	static bool SaveTGA(const std::string& path, int width, int height, const unsigned char* rgba);
+
+private:
+	int width;
+	int height;
+	std::vector<unsigned char> texels;	// RGBA, row by row from the top
+};
@@ -0,0 +1,391 @@
+#include "StateCache.h"
+
+StateCache::StateCache(ID3D11DeviceContext* context)
+	: context(context), context1(0)
+{
+	// Only there with the 11.1 runtime (Windows 8, or 7 with the
+	// platform update)
+	if (FAILED(context->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&context1)))
+		context1 = 0;
+
+	Invalidate();
+	ResetCounters();
+}
+
+StateCache::~StateCache()
+{
+	if (context1) context1->Release();
+}
+
+void StateCache::Invalidate()
+{
+	for (int s = 0; s < StageCount; s++)
+	{
+		StageState& stage = stages[s];
+		stage.Shader = 0;
+		stage.ShaderKnown = false;
+		for (UINT i = 0; i < MaxConstantBuffers; i++) { stage.ConstantBuffers[i] = 0; stage.ConstantFirst[i] = 0; stage.ConstantCount[i] = 0; stage.ConstantBuffersKnown[i] = false; }
+		for (UINT i = 0; i < MaxShaderResources; i++) { stage.ShaderResources[i] = 0; stage.ShaderResourcesKnown[i] = false; }
+		for (UINT i = 0; i < MaxSamplers; i++) { stage.Samplers[i] = 0; stage.SamplersKnown[i] = false; }
+	}
+
+	inputLayoutKnown = false;
+	topologyKnown = false;
+	for (UINT i = 0; i < MaxVertexBuffers; i++)
+		vertexBuffersKnown[i] = false;
+	indexBufferKnown = false;
+	rasterStateKnown = false;
+	depthStateKnown = false;
+	blendStateKnown = false;
+}
+
+void StateCache::ResetCounters()
+{
+	issuedCount = 0;
+	filteredCount = 0;
+}
+
+// --------------------------------------------------------
+// Counts a call, and returns true if it should be dropped
+// --------------------------------------------------------
+bool StateCache::Filter(bool redundant)
+{
+	if (redundant)
+		filteredCount++;
+	else
+		issuedCount++;
+	return redundant;
+}
+
+// --------------------------------------------------------
+// D3D quietly unbinds shader resources that end up bound as
+// render targets (and the other way around), so after any
+// render target change the bound SRVs aren't known anymore
+// --------------------------------------------------------
+void StateCache::ForgetShaderResources()
+{
+	for (int s = 0; s < StageCount; s++)
+		for (UINT i = 0; i < MaxShaderResources; i++)
+			stages[s].ShaderResourcesKnown[i] = false;
+}
+
+// --------------------------------------------------------
+// Input assembler
+// --------------------------------------------------------
+void StateCache::IASetInputLayout(ID3D11InputLayout* layout)
+{
+	if (Filter(inputLayoutKnown && inputLayout == layout))
+		return;
+
+	inputLayout = layout;
+	inputLayoutKnown = true;
+	context->IASetInputLayout(layout);
+}
+
+void StateCache::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY _topology)
+{
+	if (Filter(topologyKnown && topology == _topology))
+		return;
+
+	topology = _topology;
+	topologyKnown = true;
+	context->IASetPrimitiveTopology(_topology);
+}
+
+void StateCache::IASetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets)
+{
+	// Only dropped when every slot in the range already matches
+	bool redundant = startSlot + count <= MaxVertexBuffers;
+	for (UINT i = 0; i < count && redundant; i++)
+	{
+		UINT slot = startSlot + i;
+		redundant =
+			vertexBuffersKnown[slot] &&
+			vertexBuffers[slot] == buffers[i] &&
+			vertexStrides[slot] == strides[i] &&
+			vertexOffsets[slot] == offsets[i];
+	}
+	if (Filter(redundant))
+		return;
+
+	for (UINT i = 0; i < count && startSlot + i < MaxVertexBuffers; i++)
+	{
+		UINT slot = startSlot + i;
+		vertexBuffers[slot] = buffers[i];
+		vertexStrides[slot] = strides[i];
+		vertexOffsets[slot] = offsets[i];
+		vertexBuffersKnown[slot] = true;
+	}
+	context->IASetVertexBuffers(startSlot, count, buffers, strides, offsets);
+}
+
+void StateCache::IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset)
+{
+	if (Filter(indexBufferKnown && indexBuffer == buffer && indexFormat == format && indexOffset == offset))
+		return;
+
+	indexBuffer = buffer;
+	indexFormat = format;
+	indexOffset = offset;
+	indexBufferKnown = true;
+	context->IASetIndexBuffer(buffer, format, offset);
+}
+
+// --------------------------------------------------------
+// Shaders and their resources
+// --------------------------------------------------------
+void StateCache::VSSetShader(ID3D11VertexShader* shader)
+{
+	StageState& stage = stages[StageVertex];
+	if (Filter(stage.ShaderKnown && stage.Shader == shader))
+		return;
+
+	stage.Shader = shader;
+	stage.ShaderKnown = true;
+	context->VSSetShader(shader, 0, 0);
+}
+
+void StateCache::PSSetShader(ID3D11PixelShader* shader)
+{
+	StageState& stage = stages[StagePixel];
+	if (Filter(stage.ShaderKnown && stage.Shader == shader))
+		return;
+
+	stage.Shader = shader;
+	stage.ShaderKnown = true;
+	context->PSSetShader(shader, 0, 0);
+}
+
+void StateCache::GSSetShader(ID3D11GeometryShader* shader)
+{
+	StageState& stage = stages[StageGeometry];
+	if (Filter(stage.ShaderKnown && stage.Shader == shader))
+		return;
+
+	stage.Shader = shader;
+	stage.ShaderKnown = true;
+	context->GSSetShader(shader, 0, 0);
+}
+
+void StateCache::SetConstantBuffer(Stage stage, UINT slot, ID3D11Buffer* buffer)
+{
+	StageState& state = stages[stage];
+	if (slot < MaxConstantBuffers)
+	{
+		if (Filter(state.ConstantBuffersKnown[slot] && state.ConstantBuffers[slot] == buffer && state.ConstantCount[slot] == 0))
+			return;
+
+		state.ConstantBuffers[slot] = buffer;
+		state.ConstantFirst[slot] = 0;
+		state.ConstantCount[slot] = 0;
+		state.ConstantBuffersKnown[slot] = true;
+	}
+	else
+	{
+		Filter(false);
+	}
+
+	switch (stage)
+	{
+	case StageVertex: context->VSSetConstantBuffers(slot, 1, &buffer); break;
+	case StagePixel: context->PSSetConstantBuffers(slot, 1, &buffer); break;
+	case StageGeometry: context->GSSetConstantBuffers(slot, 1, &buffer); break;
+	}
+}
+
+// --------------------------------------------------------
+// The Windows 7 platform update's runtime ignores a new offset
+// when the buffer itself is already bound to the slot, so a
+// buffer moving to another range is unbound first
+// --------------------------------------------------------
+void StateCache::SetConstantBufferRange(Stage stage, UINT slot, ID3D11Buffer* buffer, UINT firstConstant, UINT constantCount)
+{
+	if (context1 == 0)
+	{
+		SetConstantBuffer(stage, slot, buffer);
+		return;
+	}
+
+	StageState& state = stages[stage];
+	bool rebind = true;
+	if (slot < MaxConstantBuffers)
+	{
+		if (Filter(state.ConstantBuffersKnown[slot] && state.ConstantBuffers[slot] == buffer &&
+			state.ConstantFirst[slot] == firstConstant && state.ConstantCount[slot] == constantCount))
+			return;
+
+		rebind = !state.ConstantBuffersKnown[slot] || state.ConstantBuffers[slot] == buffer;
+		state.ConstantBuffers[slot] = buffer;
+		state.ConstantFirst[slot] = firstConstant;
+		state.ConstantCount[slot] = constantCount;
+		state.ConstantBuffersKnown[slot] = true;
+	}
+	else
+	{
+		Filter(false);
+	}
+
+	ID3D11Buffer* nothing = 0;
+	switch (stage)
+	{
+	case StageVertex:
+		if (rebind) context1->VSSetConstantBuffers(slot, 1, &nothing);
+		context1->VSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount);
+		break;
+	case StagePixel:
+		if (rebind) context1->PSSetConstantBuffers(slot, 1, &nothing);
+		context1->PSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount);
+		break;
+	case StageGeometry:
+		if (rebind) context1->GSSetConstantBuffers(slot, 1, &nothing);
+		context1->GSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount);
+		break;
+	}
+}
+
+void StateCache::SetShaderResource(Stage stage, UINT slot, ID3D11ShaderResourceView* srv)
+{
+	StageState& state = stages[stage];
+	if (slot < MaxShaderResources)
+	{
+		if (Filter(state.ShaderResourcesKnown[slot] && state.ShaderResources[slot] == srv))
+			return;
+
+		state.ShaderResources[slot] = srv;
+		state.ShaderResourcesKnown[slot] = true;
+	}
+	else
+	{
+		Filter(false);
+	}
+
+	switch (stage)
+	{
+	case StageVertex: context->VSSetShaderResources(slot, 1, &srv); break;
+	case StagePixel: context->PSSetShaderResources(slot, 1, &srv); break;
+	case StageGeometry: context->GSSetShaderResources(slot, 1, &srv); break;
+	}
+}
+
+void StateCache::SetSampler(Stage stage, UINT slot, ID3D11SamplerState* sampler)
+{
+	StageState& state = stages[stage];
+	if (slot < MaxSamplers)
+	{
+		if (Filter(state.SamplersKnown[slot] && state.Samplers[slot] == sampler))
+			return;
+
+		state.Samplers[slot] = sampler;
+		state.SamplersKnown[slot] = true;
+	}
+	else
+	{
+		Filter(false);
+	}
+
+	switch (stage)
+	{
+	case StageVertex: context->VSSetSamplers(slot, 1, &sampler); break;
+	case StagePixel: context->PSSetSamplers(slot, 1, &sampler); break;
+	case StageGeometry: context->GSSetSamplers(slot, 1, &sampler); break;
+	}
+}
+
+// --------------------------------------------------------
+// Ranges of shader resources and samplers - dropped only when
+// every slot already matches, otherwise the whole range goes
+// through as one call
+// --------------------------------------------------------
+void StateCache::SetShaderResources(Stage stage, UINT startSlot, UINT count, ID3D11ShaderResourceView* const* srvs)
+{
+	StageState& state = stages[stage];
+	bool redundant = startSlot + count <= MaxShaderResources;
+	for (UINT i = 0; i < count && redundant; i++)
+		redundant = state.ShaderResourcesKnown[startSlot + i] && state.ShaderResources[startSlot + i] == srvs[i];
+	if (Filter(redundant))
+		return;
+
+	for (UINT i = 0; i < count && startSlot + i < MaxShaderResources; i++)
+	{
+		state.ShaderResources[startSlot + i] = srvs[i];
+		state.ShaderResourcesKnown[startSlot + i] = true;
+	}
+
+	switch (stage)
+	{
+	case StageVertex: context->VSSetShaderResources(startSlot, count, srvs); break;
+	case StagePixel: context->PSSetShaderResources(startSlot, count, srvs); break;
+	case StageGeometry: context->GSSetShaderResources(startSlot, count, srvs); break;
+	}
+}
+
+void StateCache::SetSamplers(Stage stage, UINT startSlot, UINT count, ID3D11SamplerState* const* samplers)
+{
+	StageState& state = stages[stage];
+	bool redundant = startSlot + count <= MaxSamplers;
+	for (UINT i = 0; i < count && redundant; i++)
+		redundant = state.SamplersKnown[startSlot + i] && state.Samplers[startSlot + i] == samplers[i];
+	if (Filter(redundant))
+		return;
+
+	for (UINT i = 0; i < count && startSlot + i < MaxSamplers; i++)
+	{
+		state.Samplers[startSlot + i] = samplers[i];
+		state.SamplersKnown[startSlot + i] = true;
+	}
+
+	switch (stage)
+	{
+	case StageVertex: context->VSSetSamplers(startSlot, count, samplers); break;
+	case StagePixel: context->PSSetSamplers(startSlot, count, samplers); break;
+	case StageGeometry: context->GSSetSamplers(startSlot, count, samplers); break;
+	}
+}
+
+// --------------------------------------------------------
+// Rasterizer and output merger
+// --------------------------------------------------------
+void StateCache::RSSetState(ID3D11RasterizerState* state)
+{
+	if (Filter(rasterStateKnown && rasterState == state))
+		return;
+
+	rasterState = state;
+	rasterStateKnown = true;
+	context->RSSetState(state);
+}
+
+void StateCache::OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT _stencilRef)
+{
+	if (Filter(depthStateKnown && depthState == state && stencilRef == _stencilRef))
+		return;
+
+	depthState = state;
+	stencilRef = _stencilRef;
+	depthStateKnown = true;
+	context->OMSetDepthStencilState(state, _stencilRef);
+}
+
+// No blend factor or sample mask - every blend state here is
+// used with the defaults
+void StateCache::OMSetBlendState(ID3D11BlendState* state)
+{
+	if (Filter(blendStateKnown && blendState == state))
+		return;
+
+	blendState = state;
+	blendStateKnown = true;
+	context->OMSetBlendState(state, 0, 0xFFFFFFFF);
+}
+
+// --------------------------------------------------------
+// Render targets only change a couple of times a frame, so
+// these always go through - the cache just has to forget
+// which shader resources are still bound
+// --------------------------------------------------------
+void StateCache::OMSetRenderTargets(UINT count, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv)
+{
+	Filter(false);
+	ForgetShaderResources();
+	context->OMSetRenderTargets(count, rtvs, dsv);
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <d3d11_1.h>
+
+// --------------------------------------------------------
+// Thin wrapper around the immediate context that remembers
+// what is bound and drops calls that wouldn't change anything.
+//
+// Anything that binds state behind its back (SpriteBatch, or
+// resources being recreated on resize) has to be followed by
+// Invalidate(), so the next call of each kind goes through.
+// --------------------------------------------------------
+class StateCache
+{
+public:
+	// Shader stages with shadowed constant buffers, SRVs and samplers
+	enum Stage
+	{
+		StageVertex = 0,
+		StagePixel,
+		StageGeometry,
+		StageCount
+	};
+
+	StateCache(ID3D11DeviceContext* context);
+	~StateCache();
+
+	ID3D11DeviceContext* GetContext() { return context; }
+
+	// Forgets everything, so no call is filtered until it's known again
+	void Invalidate();
+
+	// Input assembler
+	void IASetInputLayout(ID3D11InputLayout* layout);
+	void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+	void IASetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets);
+	void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset);
+
+	// Shaders and their resources
+	void VSSetShader(ID3D11VertexShader* shader);
+	void PSSetShader(ID3D11PixelShader* shader);
+	void GSSetShader(ID3D11GeometryShader* shader);
+	void SetConstantBuffer(Stage stage, UINT slot, ID3D11Buffer* buffer);
+
+	// Binds part of a buffer - counted in 16-byte constants, both
+	// multiples of 16.  Needs the D3D 11.1 runtime; without it the
+	// whole buffer is bound (see HasConstantOffsets).
+	void SetConstantBufferRange(Stage stage, UINT slot, ID3D11Buffer* buffer, UINT firstConstant, UINT constantCount);
+	bool HasConstantOffsets() { return context1 != 0; }
+	void SetShaderResource(Stage stage, UINT slot, ID3D11ShaderResourceView* srv);
+	void SetSampler(Stage stage, UINT slot, ID3D11SamplerState* sampler);
+
+	// Consecutive slots in one call, issued only if any slot differs
+	void SetShaderResources(Stage stage, UINT startSlot, UINT count, ID3D11ShaderResourceView* const* srvs);
+	void SetSamplers(Stage stage, UINT startSlot, UINT count, ID3D11SamplerState* const* samplers);
+
+	// Rasterizer and output merger
+	void RSSetState(ID3D11RasterizerState* state);
+	void OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef);
+	void OMSetBlendState(ID3D11BlendState* state);
+	void OMSetRenderTargets(UINT count, ID3D11RenderTargetView* const* rtvs, ID3D11DepthStencilView* dsv);
+
+	// How many calls reached the context, and how many were dropped
+	int GetIssuedCount() { return issuedCount; }
+	int GetFilteredCount() { return filteredCount; }
+	void ResetCounters();
+
+private:
+	// Slots past these are rarely used here, and always go through
+	static const UINT MaxVertexBuffers = 4;
+	static const UINT MaxConstantBuffers = D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT;
+	static const UINT MaxShaderResources = 16;
+	static const UINT MaxSamplers = D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT;
+
+	ID3D11DeviceContext* context;
+	ID3D11DeviceContext1* context1;		// Null before D3D 11.1
+
+	// Everything is "unknown" until set through the cache once
+	struct StageState
+	{
+		ID3D11DeviceChild* Shader;
+		bool ShaderKnown;
+		ID3D11Buffer* ConstantBuffers[MaxConstantBuffers];
+		UINT ConstantFirst[MaxConstantBuffers];		// Count 0 is the whole buffer
+		UINT ConstantCount[MaxConstantBuffers];
+		bool ConstantBuffersKnown[MaxConstantBuffers];
+		ID3D11ShaderResourceView* ShaderResources[MaxShaderResources];
+		bool ShaderResourcesKnown[MaxShaderResources];
+		ID3D11SamplerState* Samplers[MaxSamplers];
+		bool SamplersKnown[MaxSamplers];
+	};
+	StageState stages[StageCount];
+
+	ID3D11InputLayout* inputLayout;
+	bool inputLayoutKnown;
+	D3D11_PRIMITIVE_TOPOLOGY topology;
+	bool topologyKnown;
+
+	ID3D11Buffer* vertexBuffers[MaxVertexBuffers];
+	UINT vertexStrides[MaxVertexBuffers];
+	UINT vertexOffsets[MaxVertexBuffers];
+	bool vertexBuffersKnown[MaxVertexBuffers];
+
+	ID3D11Buffer* indexBuffer;
+	DXGI_FORMAT indexFormat;
+	UINT indexOffset;
+	bool indexBufferKnown;
+
+	ID3D11RasterizerState* rasterState;
+	bool rasterStateKnown;
+	ID3D11DepthStencilState* depthState;
+	UINT stencilRef;
+	bool depthStateKnown;
+	ID3D11BlendState* blendState;
+	bool blendStateKnown;
+
+	int issuedCount;
+	int filteredCount;
+
+	void ForgetShaderResources();
+	bool Filter(bool redundant);
+};
@@ -0,0 +1,161 @@
+#include "SweptCollider.h"
+#include <xmmintrin.h>
+#include <cmath>
+
+using namespace DirectX;
+
+// Padding boxes sit this far away so they can never be hit
+static const float FarAway = 1.0e30f;
+
+// Movement smaller than this along an axis is treated as no movement
+static const float MinMovement = 1.0e-7f;
+
+// Candidates there's room for up front, so play doesn't grow the arrays
+static const int ReservedCandidates = 16;
+
+SweptCollider::SweptCollider()
+{
+	ids.reserve(ReservedCandidates);
+	minX.reserve(ReservedCandidates); minY.reserve(ReservedCandidates); minZ.reserve(ReservedCandidates);
+	maxX.reserve(ReservedCandidates); maxY.reserve(ReservedCandidates); maxZ.reserve(ReservedCandidates);
+	Begin(CollisionBox{ XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0) }, XMFLOAT3(0, 0, 0));
+}
+
+SweptCollider::~SweptCollider()
+{ }
+
+// --------------------------------------------------------
+// Starts a new sweep.  The moving box is stored as a center
+// point plus half size, so the candidates can be grown by that
+// half size and the test becomes a segment vs box test.
+// --------------------------------------------------------
+void SweptCollider::Begin(const CollisionBox& box, const XMFLOAT3& _displacement)
+{
+	halfSize = XMFLOAT3(
+		(box.Max.x - box.Min.x) * 0.5f,
+		(box.Max.y - box.Min.y) * 0.5f,
+		(box.Max.z - box.Min.z) * 0.5f);
+	origin = XMFLOAT3(
+		box.Min.x + halfSize.x,
+		box.Min.y + halfSize.y,
+		box.Min.z + halfSize.z);
+	displacement = _displacement;
+
+	// Everything the box touches along the track this tick
+	float endZ = origin.z + displacement.z;
+	sweepMinZ = fminf(origin.z, endZ) - halfSize.z;
+	sweepMaxZ = fmaxf(origin.z, endZ) + halfSize.z;
+
+	// Keep the capacity around so steady state doesn't allocate
+	ids.clear();
+	minX.clear(); minY.clear(); minZ.clear();
+	maxX.clear(); maxY.clear(); maxZ.clear();
+}
+
+// --------------------------------------------------------
+// Broadphase - only keep candidates whose z range overlaps the
+// range swept this tick.  Kept boxes are grown by the moving
+// box's half size (Minkowski sum) for the narrow phase.
+// --------------------------------------------------------
+bool SweptCollider::AddCandidate(int id, const XMFLOAT3& center, const XMFLOAT3& candidateHalfSize)
+{
+	if (center.z + candidateHalfSize.z < sweepMinZ || center.z - candidateHalfSize.z > sweepMaxZ)
+		return false;
+
+	ids.push_back(id);
+	minX.push_back(center.x - candidateHalfSize.x - halfSize.x);
+	minY.push_back(center.y - candidateHalfSize.y - halfSize.y);
+	minZ.push_back(center.z - candidateHalfSize.z - halfSize.z);
+	maxX.push_back(center.x + candidateHalfSize.x + halfSize.x);
+	maxY.push_back(center.y + candidateHalfSize.y + halfSize.y);
+	maxZ.push_back(center.z + candidateHalfSize.z + halfSize.z);
+	return true;
+}
+
+// --------------------------------------------------------
+// Pads the candidate arrays up to a multiple of four with
+// boxes that can't be reached, so the batch loop has no tail
+// --------------------------------------------------------
+void SweptCollider::PadToBatch()
+{
+	while (minX.size() % 4 != 0)
+	{
+		minX.push_back(FarAway); minY.push_back(FarAway); minZ.push_back(FarAway);
+		maxX.push_back(FarAway); maxY.push_back(FarAway); maxZ.push_back(FarAway);
+	}
+}
+
+// --------------------------------------------------------
+// Slab test for one axis on four boxes at once.  Narrows the
+// [enter, exit] interval, or clears "inside" for boxes the
+// segment can never reach when it doesn't move on this axis.
+// --------------------------------------------------------
+static inline void SweepAxis(
+	const float* boxMin, const float* boxMax,
+	float start, float delta,
+	__m128& enter, __m128& exit, __m128& inside)
+{
+	__m128 lo = _mm_loadu_ps(boxMin);
+	__m128 hi = _mm_loadu_ps(boxMax);
+	__m128 o = _mm_set1_ps(start);
+
+	if (delta > -MinMovement && delta < MinMovement)
+	{
+		// Not moving on this axis - we must already be within the slab
+		inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(o, lo), _mm_cmple_ps(o, hi)));
+		return;
+	}
+
+	__m128 inv = _mm_set1_ps(1.0f / delta);
+	__m128 t1 = _mm_mul_ps(_mm_sub_ps(lo, o), inv);
+	__m128 t2 = _mm_mul_ps(_mm_sub_ps(hi, o), inv);
+	enter = _mm_max_ps(enter, _mm_min_ps(t1, t2));
+	exit = _mm_min_ps(exit, _mm_max_ps(t1, t2));
+}
+
+// --------------------------------------------------------
+// Narrow phase - tests the swept segment against every
+// candidate, four per iteration.  Contacts anywhere in the
+// tick (time 0 - 1, inclusive) are reported.
+// --------------------------------------------------------
+int SweptCollider::Sweep(std::vector<SweptHit>& hits)
+{
+	hits.clear();
+
+	int count = (int)ids.size();
+	if (count == 0)
+		return 0;
+
+	PadToBatch();
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 allSet = _mm_cmpeq_ps(zero, zero);
+
+	for (int i = 0; i < count; i += 4)
+	{
+		__m128 enter = zero;
+		__m128 exit = one;
+		__m128 inside = allSet;
+
+		SweepAxis(&minX[i], &maxX[i], origin.x, displacement.x, enter, exit, inside);
+		SweepAxis(&minY[i], &maxY[i], origin.y, displacement.y, enter, exit, inside);
+		SweepAxis(&minZ[i], &maxZ[i], origin.z, displacement.z, enter, exit, inside);
+
+		// Hit when the slabs overlap somewhere inside this tick
+		__m128 hit = _mm_and_ps(inside, _mm_cmple_ps(enter, exit));
+		int mask = _mm_movemask_ps(hit);
+		if (mask == 0)
+			continue;
+
+		float times[4];
+		_mm_storeu_ps(times, enter);
+		for (int lane = 0; lane < 4 && i + lane < count; lane++)
+		{
+			if (mask & (1 << lane))
+				hits.push_back(SweptHit{ ids[i + lane], times[lane] });
+		}
+	}
+
+	return (int)hits.size();
+}
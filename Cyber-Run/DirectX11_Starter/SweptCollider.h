@@ -0,0 +1,66 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// --------------------------------------------------------
+// Axis-aligned box described by its min and max corners
+// --------------------------------------------------------
+struct CollisionBox
+{
+	DirectX::XMFLOAT3 Min;
+	DirectX::XMFLOAT3 Max;
+};
+
+// --------------------------------------------------------
+// A single result from a sweep - which candidate was hit
+// and how far along the movement (0 - 1) the contact happened
+// --------------------------------------------------------
+struct SweptHit
+{
+	int Id;
+	float Time;
+};
+
+// --------------------------------------------------------
+// Continuous collision for a box moving along a straight
+// segment over one tick.  Candidates are culled with a cheap
+// z-range broadphase as they are added, stored as
+// structure-of-arrays and then tested four at a time with SSE.
+// --------------------------------------------------------
+class SweptCollider
+{
+public:
+	SweptCollider();
+	~SweptCollider();
+
+	// Starts a new sweep of "box" moving by "displacement" this tick
+	void Begin(const CollisionBox& box, const DirectX::XMFLOAT3& displacement);
+
+	// Adds a candidate box (center + half size) if it passes the broadphase
+	// Returns true if the candidate was kept for the narrow phase
+	bool AddCandidate(int id, const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& halfSize);
+
+	// Runs the batched narrow phase over all kept candidates
+	// Returns the number of hits written to "hits"
+	int Sweep(std::vector<SweptHit>& hits);
+
+	int GetCandidateCount() { return (int)ids.size(); }
+
+private:
+	// The moving box, reduced to a point by growing each candidate
+	DirectX::XMFLOAT3 origin;
+	DirectX::XMFLOAT3 halfSize;
+	DirectX::XMFLOAT3 displacement;
+
+	// Broadphase range along the track
+	float sweepMinZ;
+	float sweepMaxZ;
+
+	// Candidate data (structure-of-arrays for SIMD)
+	std::vector<int> ids;
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+
+	void PadToBatch();
+};
@@ -0,0 +1,54 @@
+// --------------------------------------------------------
+// Checks the CPU bloom chain against its golden file, the same
+// comparison -bench bloom makes, without Windows or D3D, e.g.
+//
+//   g++ -std=c++11 -O2 -I../DirectX11_Starter ../DirectX11_Starter/BloomFilter.cpp BloomCheck.cpp -o bloomcheck
+//
+// Usage:
+//
+//   bloomcheck [bloom.golden]              Compares, 0 if it matches
+//   bloomcheck <bloom.golden> <out>        Also saves the result to out
+//
+// The golden file is checked in as Debug/bloom.golden.  On a
+// mismatch, look over the new result before replacing it.
+// --------------------------------------------------------
+#include "BloomFilter.h"
+
+#include <cstdio>
+#include <string>
+
+int main(int argc, char* argv[])
+{
+	std::string goldenPath = argc > 1 ? argv[1] : "bloom.golden";
+
+	BloomImage scene, result, actual;
+	BloomFilter::MakeGoldenScene(scene);
+	BloomFilter::Run(scene, result, BloomFilter::GetGoldenSettings());
+	BloomFilter::SampleGolden(result, actual);
+
+	if (argc > 2)
+	{
+		if (!BloomFilter::WriteGolden(argv[2], actual))
+		{
+			printf("Can't write %s\n", argv[2]);
+			return 1;
+		}
+		printf("Saved %dx%d samples to %s\n", actual.Width, actual.Height, argv[2]);
+	}
+
+	BloomImage expected(actual.Width, actual.Height);
+	if (!BloomFilter::ReadGolden(goldenPath, expected))
+	{
+		printf("FAILED: %s is missing or isn't %d floats\n", goldenPath.c_str(), (int)expected.Pixels.size());
+		return 1;
+	}
+
+	float error = BloomFilter::MaxDifference(actual, expected);
+	printf("Bloom golden: %d floats, max difference %g\n", (int)actual.Pixels.size(), error);
+	if (error > 0.0001f)
+	{
+		printf("FAILED: differs from %s\n", goldenPath.c_str());
+		return 1;
+	}
+	return 0;
+}
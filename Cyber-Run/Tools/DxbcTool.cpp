@@ -0,0 +1,113 @@
+// --------------------------------------------------------
+// Command line front end for DxbcReader.  Has no Windows or
+// D3D dependencies, so it builds anywhere, e.g.
+//
+//   g++ -std=c++11 -I../DirectX11_Starter ../DirectX11_Starter/DxbcReader.cpp DxbcTool.cpp -o dxbctool
+//
+// Usage:
+//
+//   dxbctool <shader.cso>                 Prints the shader's reflection
+//   dxbctool <shader.cso> <header.h>      Also writes its cbuffer structs
+//
+// Structs are named after the file plus the buffer, so
+// VertexShader.cso's "perObject" becomes VertexShaderPerObject.
+// --------------------------------------------------------
+#include "DxbcReader.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+static const char* ProgramName(unsigned int type)
+{
+	switch (type)
+	{
+	case DxbcReader::ProgramPixel: return "pixel";
+	case DxbcReader::ProgramVertex: return "vertex";
+	case DxbcReader::ProgramGeometry: return "geometry";
+	case DxbcReader::ProgramHull: return "hull";
+	case DxbcReader::ProgramDomain: return "domain";
+	case DxbcReader::ProgramCompute: return "compute";
+	}
+	return "unknown";
+}
+
+static void PrintSignature(const char* label, const std::vector<DxbcSignatureElement>& elements)
+{
+	for (size_t i = 0; i < elements.size(); i++)
+	{
+		const DxbcSignatureElement& e = elements[i];
+		printf("  %-6s %s%u  register %u  mask 0x%X\n", label, e.SemanticName.c_str(), e.SemanticIndex, e.Register, e.Mask);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		printf("Usage: dxbctool <shader.cso> [header.h]\n");
+		return 1;
+	}
+
+	std::string path = argv[1];
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file)
+	{
+		printf("Can't open %s\n", path.c_str());
+		return 1;
+	}
+	std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	DxbcReader reader;
+	if (!reader.Parse(bytes.data(), bytes.size()))
+	{
+		printf("%s: %s\n", path.c_str(), reader.GetError().c_str());
+		return 1;
+	}
+	const DxbcReflection& reflection = reader.GetReflection();
+
+	printf("%s: %s shader, model %u.%u\n", path.c_str(), ProgramName(reflection.ProgramType), reflection.MajorVersion, reflection.MinorVersion);
+	for (size_t c = 0; c < reflection.ConstantBuffers.size(); c++)
+	{
+		const DxbcConstantBuffer& buffer = reflection.ConstantBuffers[c];
+		const DxbcBinding* binding = reflection.FindBinding(buffer.Name);
+		printf("  cbuffer %s  (%u bytes, register b%u)\n", buffer.Name.c_str(), buffer.Size, binding ? binding->BindPoint : 0);
+		for (size_t v = 0; v < buffer.Variables.size(); v++)
+		{
+			const DxbcVariable& variable = buffer.Variables[v];
+			printf("    %-24s offset %4u  size %4u\n", variable.Name.c_str(), variable.Offset, variable.Size);
+		}
+	}
+	for (size_t b = 0; b < reflection.Bindings.size(); b++)
+	{
+		const DxbcBinding& binding = reflection.Bindings[b];
+		if (binding.Type == DxbcReader::InputTexture)
+			printf("  texture %s  register t%u\n", binding.Name.c_str(), binding.BindPoint);
+		else if (binding.Type == DxbcReader::InputSampler)
+			printf("  sampler %s  register s%u\n", binding.Name.c_str(), binding.BindPoint);
+	}
+	PrintSignature("input", reflection.Inputs);
+	PrintSignature("output", reflection.Outputs);
+
+	if (argc < 3)
+		return 0;
+
+	// Prefix is the file name without its folder or extension
+	std::string prefix = path;
+	size_t slash = prefix.find_last_of("/\\");
+	if (slash != std::string::npos) prefix = prefix.substr(slash + 1);
+	size_t dot = prefix.find_last_of('.');
+	if (dot != std::string::npos) prefix = prefix.substr(0, dot);
+
+	std::ofstream header(argv[2]);
+	header << DxbcReader::GenerateHeader(reflection, prefix, prefix + ".cso");
+	if (!header)
+	{
+		printf("Can't write %s\n", argv[2]);
+		return 1;
+	}
+	printf("Wrote %s\n", argv[2]);
+	return 0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+// --------------------------------------------------------
+// Just enough of DirectXMath's storage types for the tools
+// that build the game's CPU code off Windows (see
+// SoftwareRender.cpp).  None of the XM functions are here -
+// the code those tools link only stores and reads floats.
+//
+// Never on the game's include path: Windows builds use the
+// real header.
+// --------------------------------------------------------
+namespace DirectX
+{
+	struct XMFLOAT2
+	{
+		float x, y;
+
+		XMFLOAT2() = default;
+		XMFLOAT2(float x, float y) : x(x), y(y) {}
+	};
+
+	struct XMFLOAT3
+	{
+		float x, y, z;
+
+		XMFLOAT3() = default;
+		XMFLOAT3(float x, float y, float z) : x(x), y(y), z(z) {}
+	};
+
+	struct XMFLOAT4
+	{
+		float x, y, z, w;
+
+		XMFLOAT4() = default;
+		XMFLOAT4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+	};
+
+	struct XMFLOAT4X4
+	{
+		union
+		{
+			struct
+			{
+				float _11, _12, _13, _14;
+				float _21, _22, _23, _24;
+				float _31, _32, _33, _34;
+				float _41, _42, _43, _44;
+			};
+			float m[4][4];
+		};
+
+		XMFLOAT4X4() = default;
+	};
+}
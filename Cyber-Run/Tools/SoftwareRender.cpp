@@ -0,0 +1,461 @@
+// --------------------------------------------------------
+// Draws the start of the level with the SoftwareRasterizer,
+// without Windows, D3D or a GPU, e.g.
+//
+//   cd Tools
+//   g++ -std=c++11 -O2 -pthread -DPROFILER_DISABLED -IPortable -I../DirectX11_Starter
+//       ../DirectX11_Starter/SoftwareRasterizer.cpp ../DirectX11_Starter/SoftwareTexture.cpp
+//       ../DirectX11_Starter/LightClusters.cpp ../DirectX11_Starter/JobSystem.cpp
+//       SoftwareRender.cpp -o softwarerender
+//
+// (add -mavx for the 8 wide path).  Portable/DirectXMath.h
+// stands in for the real header off Windows; on Windows, leave
+// out -IPortable.  The profiler is left out, as it's MSVC only.
+//
+// Usage:
+//
+//   softwarerender [data] [out.tga]
+//
+// data is the folder with the game's files (../Debug by
+// default).  The frame is drawn on the job workers and then on
+// this thread alone, and the two must match.  Prints their
+// checksum and saves the frame (software.tga by default).
+// Returns 0 when it all worked.
+//
+// It's the scene -bench software draws first, minus the
+// players: the first platform, the five collectibles in fixed
+// lanes, an obstacle, their neon and the sky.  grid.tga and
+// gridNormals.tga are the game's grid.jpg and gridNormals.jpg
+// converted.  SunnyCubeMap.dds isn't checked in, so the sky is
+// SoftwareTexture's gradient unless SunnyCubeMap.tga is there.
+// --------------------------------------------------------
+#include "SoftwareRasterizer.h"
+#include "JobSystem.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+static const int Width = 800;
+static const int Height = 600;
+
+// --------------------------------------------------------
+// An OBJ file as triangles, read the way Mesh's OBJ
+// constructor reads it (which uses sscanf_s, so can't be
+// built here)
+// --------------------------------------------------------
+struct SceneMesh
+{
+	std::vector<Vertex> Vertices;
+	std::vector<unsigned int> Indices;
+};
+
+static bool LoadOBJ(const std::string& path, SceneMesh& mesh)
+{
+	FILE* file = fopen(path.c_str(), "r");
+	if (file == 0)
+		return false;
+
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT3> normals;
+	std::vector<XMFLOAT2> uvs;
+	char chars[512];
+	while (fgets(chars, sizeof(chars), file))
+	{
+		XMFLOAT3 v;
+		int p[3], t[3], n[3];
+		if (sscanf(chars, "vn %f %f %f", &v.x, &v.y, &v.z) == 3)
+			normals.push_back(v);
+		else if (sscanf(chars, "vt %f %f", &v.x, &v.y) == 2)
+			uvs.push_back(XMFLOAT2(v.x, v.y));
+		else if (sscanf(chars, "v %f %f %f", &v.x, &v.y, &v.z) == 3)
+			positions.push_back(v);
+		else if (sscanf(chars, "f %d/%d/%d %d/%d/%d %d/%d/%d", &p[0], &t[0], &n[0], &p[1], &t[1], &n[1], &p[2], &t[2], &n[2]) == 9)
+		{
+			// OBJ indices are 1-based
+			for (int i = 0; i < 3; i++)
+			{
+				if (p[i] < 1 || p[i] > (int)positions.size() ||
+					t[i] < 1 || t[i] > (int)uvs.size() ||
+					n[i] < 1 || n[i] > (int)normals.size())
+				{
+					fclose(file);
+					return false;
+				}
+
+				Vertex vertex;
+				vertex.Position = positions[p[i] - 1];
+				vertex.UV = uvs[t[i] - 1];
+				vertex.Normal = normals[n[i] - 1];
+				vertex.Tangent = XMFLOAT3(0, 0, 0);
+				mesh.Indices.push_back((unsigned int)mesh.Vertices.size());
+				mesh.Vertices.push_back(vertex);
+			}
+		}
+	}
+	fclose(file);
+
+	// Mesh::CalculateTangents - each triangle's UV tangent, then
+	// made orthogonal to the normal
+	for (size_t i = 0; i + 2 < mesh.Vertices.size(); i += 3)
+	{
+		Vertex* v1 = &mesh.Vertices[i];
+		Vertex* v2 = &mesh.Vertices[i + 1];
+		Vertex* v3 = &mesh.Vertices[i + 2];
+
+		float x1 = v2->Position.x - v1->Position.x;
+		float y1 = v2->Position.y - v1->Position.y;
+		float z1 = v2->Position.z - v1->Position.z;
+		float x2 = v3->Position.x - v1->Position.x;
+		float y2 = v3->Position.y - v1->Position.y;
+		float z2 = v3->Position.z - v1->Position.z;
+		float s1 = v2->UV.x - v1->UV.x;
+		float t1 = v2->UV.y - v1->UV.y;
+		float s2 = v3->UV.x - v1->UV.x;
+		float t2 = v3->UV.y - v1->UV.y;
+
+		float r = 1.0f / (s1 * t2 - s2 * t1);
+		XMFLOAT3 tangent((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r, (t2 * z1 - t1 * z2) * r);
+		for (int j = 0; j < 3; j++)
+		{
+			mesh.Vertices[i + j].Tangent.x += tangent.x;
+			mesh.Vertices[i + j].Tangent.y += tangent.y;
+			mesh.Vertices[i + j].Tangent.z += tangent.z;
+		}
+	}
+
+	for (size_t i = 0; i < mesh.Vertices.size(); i++)
+	{
+		XMFLOAT3& n = mesh.Vertices[i].Normal;
+		XMFLOAT3& t = mesh.Vertices[i].Tangent;
+		float d = n.x * t.x + n.y * t.y + n.z * t.z;
+		t = XMFLOAT3(t.x - n.x * d, t.y - n.y * d, t.z - n.z * d);
+
+		// Like XMVector3Normalize, zero (or broken) stays zero
+		float length = sqrtf(t.x * t.x + t.y * t.y + t.z * t.z);
+		if (length > 0 && std::isfinite(length))
+			t = XMFLOAT3(t.x / length, t.y / length, t.z / length);
+		else
+			t = XMFLOAT3(0, 0, 0);
+	}
+	return !mesh.Indices.empty();
+}
+
+// --------------------------------------------------------
+// Matrices, built like DirectXMath's (row vectors, left
+// handed) and stored transposed for HLSL, like Camera's and
+// GameEntity's
+// --------------------------------------------------------
+static XMFLOAT4X4 Transpose(const XMFLOAT4X4& m)
+{
+	XMFLOAT4X4 result;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			result.m[i][j] = m.m[j][i];
+	return result;
+}
+
+static XMFLOAT4X4 Multiply(const XMFLOAT4X4& a, const XMFLOAT4X4& b)
+{
+	XMFLOAT4X4 result;
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			result.m[i][j] = 0;
+			for (int k = 0; k < 4; k++)
+				result.m[i][j] += a.m[i][k] * b.m[k][j];
+		}
+	}
+	return result;
+}
+
+static XMFLOAT4X4 Zero()
+{
+	XMFLOAT4X4 result;
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			result.m[i][j] = 0;
+	return result;
+}
+
+// GameEntity::UpdateWorldMatrix without rotation (transposed)
+static XMFLOAT4X4 WorldMatrix(XMFLOAT3 position, XMFLOAT3 scale)
+{
+	XMFLOAT4X4 world = Zero();
+	world.m[0][0] = scale.x;
+	world.m[1][1] = scale.y;
+	world.m[2][2] = scale.z;
+	world.m[3][0] = position.x;
+	world.m[3][1] = position.y;
+	world.m[3][2] = position.z;
+	world.m[3][3] = 1;
+	return Transpose(world);
+}
+
+// Camera::UpdateViewMatrix, looking down +z (transposed)
+static XMFLOAT4X4 ViewMatrix(XMFLOAT3 position)
+{
+	XMFLOAT4X4 view = Zero();
+	view.m[0][0] = 1;
+	view.m[1][1] = 1;
+	view.m[2][2] = 1;
+	view.m[3][0] = -position.x;
+	view.m[3][1] = -position.y;
+	view.m[3][2] = -position.z;
+	view.m[3][3] = 1;
+	return Transpose(view);
+}
+
+// Camera::UpdateProjectionMatrix (transposed)
+static XMFLOAT4X4 ProjectionMatrix(float aspectRatio)
+{
+	const float fieldOfView = 0.25f * 3.1415926535f;
+	const float nearZ = 0.1f;
+	const float farZ = 100.0f;
+
+	float yScale = 1.0f / tanf(fieldOfView * 0.5f);
+	float range = farZ / (farZ - nearZ);
+
+	XMFLOAT4X4 projection = Zero();
+	projection.m[0][0] = yScale / aspectRatio;
+	projection.m[1][1] = yScale;
+	projection.m[2][2] = range;
+	projection.m[2][3] = 1;
+	projection.m[3][2] = -range * nearZ;
+	return Transpose(projection);
+}
+
+// --------------------------------------------------------
+// The level's objects and lights, as MyDemoGame sets them up
+// --------------------------------------------------------
+struct SceneObject
+{
+	const SceneMesh* ObjectMesh;
+	XMFLOAT3 Position;
+	XMFLOAT3 Scale;
+	int Group;		// MyDemoGame::GetGroupBloom's
+	bool Sky;
+};
+
+static void AddObject(std::vector<SceneObject>& objects, const SceneMesh* mesh, XMFLOAT3 position, XMFLOAT3 scale, int group, bool sky)
+{
+	SceneObject object = { mesh, position, scale, group, sky };
+	objects.push_back(object);
+}
+
+// MyDemoGame::CaptureLights
+static void AddLights(const std::vector<SceneObject>& objects, std::vector<ClusterLight>& lights)
+{
+	static const XMFLOAT3 palette[4] =
+	{
+		XMFLOAT3(0.0f, 1.0f, 1.0f),
+		XMFLOAT3(1.0f, 0.0f, 1.0f),
+		XMFLOAT3(1.0f, 0.9f, 0.0f),
+		XMFLOAT3(0.2f, 1.0f, 0.2f),
+	};
+
+	ClusterLight light;
+	int collectibles = 0;
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		const SceneObject& object = objects[i];
+		if (object.Group == 1)
+		{
+			light.Radius = 1.0f;
+			light.Intensity = 0.6f;
+			for (float z = -object.Scale.z * 0.5f; z <= object.Scale.z * 0.5f; z += 0.5f)
+			{
+				for (int side = 0; side < 2; side++)
+				{
+					light.Position = XMFLOAT3(object.Position.x + (side ? object.Scale.x : -object.Scale.x) * 0.5f, object.Position.y + object.Scale.y * 0.5f, object.Position.z + z);
+					light.Color = palette[side];
+					lights.push_back(light);
+				}
+			}
+		}
+		else if (object.Group == 2)
+		{
+			light.Position = object.Position;
+			light.Radius = 2.5f;
+			light.Color = palette[collectibles++ % 4];
+			light.Intensity = 1.0f;
+			lights.push_back(light);
+		}
+		else if (object.Group == 3)
+		{
+			light.Position = object.Position;
+			light.Radius = 3.0f;
+			light.Color = XMFLOAT3(1.0f, 0.1f, 0.1f);
+			light.Intensity = 1.0f;
+			lights.push_back(light);
+		}
+	}
+}
+
+// MyDemoGame::GetGroupBloom, with the game's starting amounts
+static XMFLOAT3 GroupBloom(int group)
+{
+	const float x = 0.25f, y = 0.0f, z = 0.5f;
+	switch (group)
+	{
+	case 0: return XMFLOAT3(x, y, z);
+	case 1: return XMFLOAT3(x, z, y);
+	case 2: return XMFLOAT3(z, x, y);
+	default: return XMFLOAT3(y, z, x);
+	}
+}
+
+// --------------------------------------------------------
+// Draws the scene the way MyDemoGame::DrawSoftware does.
+// With no job system, everything runs on this thread.
+// --------------------------------------------------------
+static double Draw(JobSystem* jobSystem, const std::vector<SceneObject>& objects, const std::vector<ClusterLight>& pointLights,
+	const SoftwareMaterial& main, const SoftwareMaterial& sky, std::vector<unsigned char>& pixels, SoftwareStats& stats)
+{
+	XMFLOAT3 cameraPosition(0, 0, -5);
+	XMFLOAT4X4 view = ViewMatrix(cameraPosition);
+	XMFLOAT4X4 projection = ProjectionMatrix((float)Width / Height);
+	XMFLOAT4X4 viewProj = Multiply(projection, view);
+	XMFLOAT4X4 skyViewProj = SoftwareRasterizer::SkyViewProjection(view, projection);
+
+	SoftwareRasterizer rasterizer(jobSystem, Width, Height);
+	LightClusters clusters(jobSystem);
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	clusters.SetProjection(projection);
+	clusters.Bin(view, &pointLights[0], (int)pointLights.size());
+
+	// MyDemoGame::GetSceneLights
+	SoftwareLights lights;
+	lights.DirLightDirection = XMFLOAT3(0, -1, 0);
+	lights.DirLightColor = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+	lights.PointLightPosition = XMFLOAT3(0, 2, 0);
+	lights.PointLightColor = XMFLOAT4(0.3f, 0.3f, 1.0f, 0.0f);
+	lights.CameraPosition = cameraPosition;
+	lights.PointLights = &pointLights[0];
+	lights.Clusters = &clusters;
+	lights.CameraForward = XMFLOAT3(view.m[2][0], view.m[2][1], view.m[2][2]);
+
+	const float clearColor[4] = { 0, 0, 0, 0 };
+	rasterizer.BeginFrame(clearColor, lights);
+
+	// The sky goes last, like the render queue's sky pass
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		const SceneObject& object = objects[i];
+
+		SoftwareDraw draw;
+		draw.Vertices = &object.ObjectMesh->Vertices[0];
+		draw.VertexCount = (int)object.ObjectMesh->Vertices.size();
+		draw.Indices = &object.ObjectMesh->Indices[0];
+		draw.IndexCount = (int)object.ObjectMesh->Indices.size();
+		draw.World = WorldMatrix(object.Position, object.Scale);
+		draw.WorldViewProj = object.Sky ? skyViewProj : Multiply(viewProj, draw.World);
+		draw.Material = object.Sky ? &sky : &main;
+		draw.Bloom = GroupBloom(object.Group);
+		draw.Sky = object.Sky;
+		rasterizer.Submit(draw);
+	}
+	rasterizer.Render();
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	rasterizer.GetPixels(pixels);
+	stats = rasterizer.GetStats();
+	return ms;
+}
+
+// FNV-1a over the 8 bit pixels
+static unsigned int Checksum(const std::vector<unsigned char>& pixels)
+{
+	unsigned int hash = 2166136261u;
+	for (size_t i = 0; i < pixels.size(); i++)
+		hash = (hash ^ pixels[i]) * 16777619u;
+	return hash;
+}
+
+// Loads a texture from the data folder, or makes its stand-in
+static void LoadTexture(SoftwareTexture& texture, const std::string& data, const char* file)
+{
+	if (texture.LoadTGA(data + "/" + file))
+		printf("  %s: %dx%d\n", file, texture.GetWidth(), texture.GetHeight());
+	else
+		printf("  %s: missing, using a stand-in\n", file);
+}
+
+int main(int argc, char* argv[])
+{
+	std::string data = argc > 1 ? argv[1] : "../Debug";
+	std::string outPath = argc > 2 ? argv[2] : "software.tga";
+
+	SceneMesh cube, sphere;
+	if (!LoadOBJ(data + "/cube.obj", cube) || !LoadOBJ(data + "/sphere.obj", sphere))
+	{
+		printf("FAILED: can't read cube.obj and sphere.obj from %s\n", data.c_str());
+		return 1;
+	}
+
+	// InitSoftwareRendering's textures and stand-ins
+	SoftwareTexture diffuse, normals, skyTexture;
+	LoadTexture(diffuse, data, "grid.tga");
+	LoadTexture(normals, data, "gridNormals.tga");
+	LoadTexture(skyTexture, data, "SunnyCubeMap.tga");
+	if (diffuse.IsEmpty())
+		diffuse.CreateGrid(256, 8);
+	if (normals.IsEmpty())
+		normals.CreateSolid(128, 128, 255, 255);
+	if (skyTexture.IsEmpty())
+		skyTexture.CreateSkyGradient(256, 128);
+
+	SoftwareMaterial main = { &diffuse, &normals };
+	SoftwareMaterial sky = { &skyTexture, 0 };
+
+	// MyDemoGame::CreateGeometry, with the collectibles' lanes
+	// fixed so every run draws the same thing
+	std::vector<SceneObject> objects;
+	const float lanes[3] = { -0.75f, 0.0f, 0.75f };
+	AddObject(objects, &cube, XMFLOAT3(0.0f, -2.0f, 2.5f), XMFLOAT3(3.0f, 2.0f, 15.0f), 1, false);
+	for (int i = 0; i < 5; i++)
+		AddObject(objects, &sphere, XMFLOAT3(lanes[i % 3], -0.5f, 2.0f * i), XMFLOAT3(0.1f, 0.1f, 0.1f), 2, false);
+	AddObject(objects, &cube, XMFLOAT3(0.0f, -0.9f, 9.0f), XMFLOAT3(3.0f, 0.2f, 0.2f), 3, false);
+	AddObject(objects, &sphere, XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1), 0, true);
+
+	std::vector<ClusterLight> pointLights;
+	AddLights(objects, pointLights);
+
+	JobSystem jobSystem;
+	std::vector<unsigned char> threaded, single;
+	SoftwareStats stats;
+	double threadedMs = Draw(&jobSystem, objects, pointLights, main, sky, threaded, stats);
+	double singleMs = Draw(0, objects, pointLights, main, sky, single, stats);
+
+	unsigned int threadedSum = Checksum(threaded);
+	unsigned int singleSum = Checksum(single);
+	printf("Software - %dx%d, %d draws, %d triangles, %d lights, %lld pixels shaded\n",
+		Width, Height, stats.Draws, stats.Triangles, (int)pointLights.size(), stats.PixelsShaded);
+	printf("  %d workers: %.2f ms, checksum %08x\n", jobSystem.GetWorkerCount(), threadedMs, threadedSum);
+	printf("  One thread: %.2f ms, checksum %08x\n", singleMs, singleSum);
+
+	bool match = threaded == single;
+
+	// Saved like SoftwareRasterizer::SaveTGA, without alpha
+	for (size_t i = 3; i < threaded.size(); i += 4)
+		threaded[i] = 255;
+	if (!SoftwareTexture::SaveTGA(outPath, Width, Height, &threaded[0]))
+	{
+		printf("FAILED: can't write %s\n", outPath.c_str());
+		return 1;
+	}
+	printf("Saved %s\n", outPath.c_str());
+
+	if (!match)
+	{
+		printf("FAILED: the job workers and one thread drew different frames\n");
+		return 1;
+	}
+	return 0;
+}